@@ -0,0 +1,1273 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * xls2img benchmark harness
+ *
+ * Generates synthetic compound files (see xls2img_corpus.c), runs the extraction phases
+ * repeatedly and reports latency percentiles and throughput per phase, followed by
+ * micro-benchmarks of the signature scanner, the PNG/JPEG end finders and checks. Everything runs
+ * in memory, so the numbers are free of disk effects and the harness needs no input files. The one
+ * exception is --sparse, which writes a multi-GiB file with a hole and extracts it through a mapping.
+ *
+ * The image carving source is compiled into this translation unit so that its static scan
+ * kernels can be timed directly.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+#if !defined(_WIN32) && !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64
+#endif
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <xls2img.h>
+#include "xls2img_corpus.h"
+#include "xls2img_images.c"
+#include "xls2img_crc32.h"
+
+#define BENCH_DEFAULT_ITERATIONS 20
+#define BENCH_KERNEL_SIZE (16 * 1024 * 1024)
+#define BENCH_SPARSE_GAP (4608ULL << 20)  // puts the workbook of --sparse beyond 4.5 GiB
+
+enum {
+    PHASE_OPEN = 0,
+    PHASE_WORKBOOK,
+    PHASE_EXTRACT,
+    PHASE_TOTAL,
+    PHASE_COUNT
+};
+
+static const char* const phase_names[PHASE_COUNT] = {
+    "xls2img_open", "xls2img_get_workbook", "xls2img_extract_images", "total"
+};
+
+#define BENCH_TRACE_EVENTS 4096
+#define BENCH_MAX_THREADS 64
+
+static const char* const event_names[] = {
+    "", "sector_read", "fat_lookup", "record", "drawing_group", "drawing_group",
+    "header", "image_accepted", "image_rejected", "alloc"
+};
+
+// Chrome trace output (-T), written from the trace flush callback
+static FILE* trace_file = NULL;
+static int trace_pid = 0;
+static int trace_written = 0;
+static uint64_t trace_base_ns = 0;
+
+static unsigned long long bench_now_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (unsigned long long)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+        (unsigned long long)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+#endif
+}
+
+static int compare_ull(const void* a, const void* b)
+{
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of a sorted sample
+static unsigned long long percentile(const unsigned long long* sorted, int count, int pct)
+{
+    int rank = (pct * count + 99) / 100;
+    if (rank < 1)
+        rank = 1;
+    return sorted[rank - 1];
+}
+
+static double mb_per_s(size_t bytes, unsigned long long ns)
+{
+    return ns ? (double)bytes / (1024.0 * 1024.0) / ((double)ns / 1e9) : 0.0;
+}
+
+static void print_spec(const CORPUS_SPEC* spec, const CORPUS_FILE* file)
+{
+    printf("corpus: v%d, fragmentation %d%%, difat depth %d, %d images of ~%zu bytes (%d%% png), "
+        "continue %zu, file %.2f MB, workbook %.2f MB\n",
+        spec->version, spec->fragmentation, spec->difat_depth, spec->image_count, spec->image_size,
+        spec->png_percent, spec->continue_size, file->size / (1024.0 * 1024.0), file->workbook_size / (1024.0 * 1024.0));
+}
+
+// Checks the extracted images against what the generator wrote.
+static int verify_result(const CORPUS_FILE* file, const XLS2IMG_RESULT* result)
+{
+    if (result->count != file->image_count)
+    {
+        fprintf(stderr, "error: extracted %d images, expected %d\n", result->count, file->image_count);
+        return 0;
+    }
+    for (int i = 0; i < result->count; i++)
+    {
+        if ((int)result->images[i].format != file->image_formats[i] || result->images[i].size != file->image_sizes[i])
+        {
+            fprintf(stderr, "error: image %d is format %d, %zu bytes, expected format %d, %zu bytes\n", i + 1,
+                (int)result->images[i].format, result->images[i].size, file->image_formats[i], file->image_sizes[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Writes a batch of events as Chrome trace events, one process per corpus. The drawing group is a duration
+// event, everything else an instant event.
+static void trace_write_events(const XLS2IMG_EVENT* events, size_t count, void* user)
+{
+    (void)user;
+    for (size_t i = 0; i < count; i++)
+    {
+        const XLS2IMG_EVENT* e = &events[i];
+        if (e->type >= sizeof(event_names) / sizeof(event_names[0]))
+            continue;
+        if (!trace_base_ns)
+            trace_base_ns = e->time_ns;
+
+        const char* phase = e->type == XLS2IMG_EVENT_DRAWING_GROUP_START ? "B" : e->type == XLS2IMG_EVENT_DRAWING_GROUP_END ? "E" : "i";
+        fprintf(trace_file, "%s\n{\"name\":\"%s\",\"ph\":\"%s\",%s\"ts\":%.3f,\"pid\":%d,\"tid\":1,"
+            "\"args\":{\"kind\":%u,\"offset\":%llu,\"size\":%llu}}", trace_written ? "," : "", event_names[e->type], phase,
+            phase[0] == 'i' ? "\"s\":\"t\"," : "", (e->time_ns - trace_base_ns) / 1000.0, trace_pid, (unsigned)e->kind,
+            (unsigned long long)e->offset, (unsigned long long)e->size);
+        trace_written = 1;
+    }
+}
+
+#define BENCH_CHUNK_SIZE (64 * 1024)
+
+// Images delivered by the push parser, checked against the generator as they arrive
+typedef struct {
+    const CORPUS_FILE* file;
+    int count;
+    int ok;
+} BENCH_PUSH;
+
+static int bench_push_image(const XLS2IMG_IMAGE* image, void* user)
+{
+    BENCH_PUSH* push = (BENCH_PUSH*)user;
+    if (push->count >= push->file->image_count || (int)image->format != push->file->image_formats[push->count] ||
+        image->prefix_size + image->size != push->file->image_sizes[push->count])
+        push->ok = 0;
+    push->count++;
+    return XLS2IMG_SUCCESS;
+}
+
+// Streams the workbook through a cursor into the push parser in fixed chunks, so neither the workbook nor the
+// drawing group is ever held in memory
+static int bench_push_parser(const CORPUS_FILE* file, int iterations)
+{
+    unsigned long long* samples = (unsigned long long*)calloc((size_t)iterations, sizeof(unsigned long long));
+    uint8_t* chunk = (uint8_t*)malloc(BENCH_CHUNK_SIZE);
+    XLS2IMG_READER* reader = NULL;
+    int ok = samples && chunk && xls2img_open(&reader, file->data, file->size) == XLS2IMG_SUCCESS;
+    size_t peak_bytes = 0;
+
+    for (int it = 0; it < iterations && ok; it++)
+    {
+        XLS2IMG_ALLOCATOR allocator;
+        memset(&allocator, 0, sizeof(allocator));
+        XLS2IMG_EXTRACT_OPTIONS options;
+        memset(&options, 0, sizeof(options));
+        options.allocator = &allocator;
+        BENCH_PUSH push = { file, 0, 1 };
+
+        unsigned long long t0 = bench_now_ns();
+        XLS2IMG_CURSOR* cursor = NULL;
+        XLS2IMG_PARSER* parser = NULL;
+        int ret = xls2img_cursor_open(&cursor, reader, &options);
+        if (ret == XLS2IMG_SUCCESS)
+            ret = xls2img_parser_open(&parser, bench_push_image, &push, &options);
+        for (size_t pos = 0; ret == XLS2IMG_SUCCESS && pos < file->workbook_size; pos += BENCH_CHUNK_SIZE)
+        {
+            size_t len = file->workbook_size - pos < BENCH_CHUNK_SIZE ? file->workbook_size - pos : BENCH_CHUNK_SIZE;
+            ret = xls2img_cursor_read(cursor, pos, chunk, len);
+            if (ret == XLS2IMG_SUCCESS)
+                ret = xls2img_parser_feed(parser, chunk, len);
+        }
+        if (ret == XLS2IMG_SUCCESS)
+            ret = xls2img_parser_finish(parser);
+        xls2img_parser_close(parser);
+        xls2img_cursor_close(cursor);
+        samples[it] = bench_now_ns() - t0;
+
+        if ((ret < 0 && !(ret == XLS2IMG_ERROR_NO_IMAGES && file->image_count == 0)) || !push.ok ||
+            push.count != file->image_count || allocator.current_bytes != 0)
+        {
+            fprintf(stderr, "error: push parser extracted %d images (%s)\n", push.count, xls2img_strerror(ret));
+            ok = 0;
+        }
+        if (allocator.peak_bytes > peak_bytes)
+            peak_bytes = allocator.peak_bytes;
+    }
+
+    if (ok)
+    {
+        qsort(samples, iterations, sizeof(*samples), compare_ull);
+        printf("  push parser, %d KB chunks: p50 %.1f us, %.1f MB/s, peak memory %zu bytes\n", BENCH_CHUNK_SIZE / 1024,
+            percentile(samples, iterations, 50) / 1000.0, mb_per_s(file->workbook_size, percentile(samples, iterations, 50)),
+            peak_bytes);
+    }
+    xls2img_close(reader);
+    free(chunk);
+    free(samples);
+    return ok;
+}
+
+// Builds the .x2i index once, then serves images from it the way a server would for each request: open the index
+// bytes and copy one image out of the file, without a reader
+static int bench_index(const CORPUS_FILE* file, int iterations)
+{
+    if (file->image_count == 0)
+        return 1;
+
+    unsigned long long* samples = (unsigned long long*)calloc((size_t)iterations, sizeof(unsigned long long));
+    XLS2IMG_READER* reader = NULL;
+    void* index_data = NULL;
+    size_t index_size = 0;
+    size_t largest = 0;
+    for (int i = 0; i < file->image_count; i++)
+        if (file->image_sizes[i] > largest)
+            largest = file->image_sizes[i];
+    uint8_t* image = (uint8_t*)malloc(largest);
+
+    unsigned long long t0 = bench_now_ns();
+    int ret = samples && image ? xls2img_open(&reader, file->data, file->size) : XLS2IMG_ERROR_OUT_OF_MEMORY;
+    if (ret == XLS2IMG_SUCCESS)
+        ret = xls2img_index_build(reader, 0, &index_data, &index_size, NULL);
+    unsigned long long build_ns = bench_now_ns() - t0;
+    xls2img_close(reader);
+
+    int ok = ret == XLS2IMG_SUCCESS;
+    if (!ok)
+        fprintf(stderr, "error: cannot build the index (%s)\n", xls2img_strerror(ret));
+    for (int it = 0; it < iterations && ok; it++)
+    {
+        int number = it % file->image_count;
+        XLS2IMG_INDEX* index = NULL;
+        XLS2IMG_INDEX_IMAGE info;
+
+        t0 = bench_now_ns();
+        ret = xls2img_index_open(&index, index_data, index_size);
+        if (ret == XLS2IMG_SUCCESS)
+            ret = xls2img_index_get_image(index, number, &info);
+        if (ret == XLS2IMG_SUCCESS)
+            ret = info.prefix_size + info.size == file->image_sizes[number] ?
+                xls2img_index_read_image(index, number, file->data, file->size, image, largest) : XLS2IMG_ERROR_FILE_CORRUPTED;
+        xls2img_index_close(index);
+        samples[it] = bench_now_ns() - t0;
+
+        if (ret != XLS2IMG_SUCCESS)
+        {
+            fprintf(stderr, "error: cannot serve image %d from the index (%s)\n", number + 1, xls2img_strerror(ret));
+            ok = 0;
+        }
+    }
+
+    if (ok)
+    {
+        qsort(samples, iterations, sizeof(*samples), compare_ull);
+        printf("  index: %zu bytes, built in %.1f us; one image from it: p50 %.1f us\n", index_size, build_ns / 1000.0,
+            percentile(samples, iterations, 50) / 1000.0);
+    }
+    xls2img_free_index_data(index_data);
+    free(image);
+    free(samples);
+    return ok;
+}
+
+// Carving from the workbook with and without verify; every generated PNG and JPEG must come back checked and valid
+static int bench_verify(const CORPUS_FILE* file, int iterations)
+{
+    unsigned long long* samples = (unsigned long long*)calloc((size_t)iterations * 2, sizeof(unsigned long long));
+    XLS2IMG_READER* reader = NULL;
+    void* workbook = NULL;
+    size_t workbook_size = 0;
+    int ret = samples ? xls2img_open(&reader, file->data, file->size) : XLS2IMG_ERROR_OUT_OF_MEMORY;
+    if (ret == XLS2IMG_SUCCESS)
+        ret = xls2img_get_workbook(reader, &workbook, &workbook_size);
+    int ok = ret == XLS2IMG_SUCCESS;
+
+    for (int it = 0; it < iterations * 2 && ok; it++)
+    {
+        // alternate, so both modes see the same cache and clock conditions
+        XLS2IMG_EXTRACT_OPTIONS options;
+        memset(&options, 0, sizeof(options));
+        options.verify = it & 1;
+        XLS2IMG_RESULT result = { NULL, 0 };
+
+        unsigned long long t0 = bench_now_ns();
+        ret = xls2img_extract_images_ex(workbook, workbook_size, &result, &options);
+        samples[(it & 1) * iterations + it / 2] = bench_now_ns() - t0;
+
+        if (ret < 0 && !(ret == XLS2IMG_ERROR_NO_IMAGES && file->image_count == 0))
+            ok = 0;
+        for (int i = 0; i < result.count && ok; i++)
+            if (result.images[i].check != (options.verify ? XLS2IMG_CHECK_VERIFIED : 0))
+            {
+                fprintf(stderr, "error: image %d failed verification (check %u)\n", i + 1, result.images[i].check);
+                ok = 0;
+            }
+        xls2img_free_result(&result);
+    }
+
+    if (ok)
+    {
+        qsort(samples, iterations, sizeof(*samples), compare_ull);
+        qsort(samples + iterations, iterations, sizeof(*samples), compare_ull);
+        unsigned long long plain = percentile(samples, iterations, 50);
+        unsigned long long verified = percentile(samples + iterations, iterations, 50);
+        printf("  verify: extract p50 %.1f us, with verify %.1f us (%+.1f%%), %d images valid\n", plain / 1000.0,
+            verified / 1000.0, plain ? 100.0 * ((double)verified - (double)plain) / (double)plain : 0.0, file->image_count);
+    }
+    else
+        fprintf(stderr, "error: verified extraction failed (%s)\n", xls2img_strerror(ret));
+    xls2img_free_workbook_data(workbook);
+    xls2img_close(reader);
+    free(samples);
+    return ok;
+}
+
+static void* bench_count_alloc(size_t size, void* user)
+{
+    (*(unsigned long long*)user)++;
+    return malloc(size);
+}
+
+static void* bench_count_realloc(void* ptr, size_t old_size, size_t new_size, void* user)
+{
+    (void)old_size;
+    (*(unsigned long long*)user)++;
+    return realloc(ptr, new_size);
+}
+
+static void bench_count_free(void* ptr, size_t size, void* user)
+{
+    (void)size;
+    (void)user;
+    free(ptr);
+}
+
+// One file read through a session, or through malloc with a NULL session; the allocations are left to the caller
+static int bench_session_file(const CORPUS_FILE* file, XLS2IMG_SESSION* session, XLS2IMG_ALLOCATOR* allocator, XLS2IMG_RESULT* result,
+    void** workbook)
+{
+    XLS2IMG_READER* reader = NULL;
+    size_t workbook_size = 0;
+    int ret = session ? xls2img_session_open(session, &reader, file->data, file->size)
+                      : xls2img_open_ex(&reader, file->data, file->size, allocator);
+    if (ret == XLS2IMG_SUCCESS)
+        ret = xls2img_get_workbook(reader, workbook, &workbook_size);
+    if (ret == XLS2IMG_SUCCESS)
+    {
+        XLS2IMG_EXTRACT_OPTIONS options;
+        memset(&options, 0, sizeof(options));
+        options.allocator = session ? xls2img_session_allocator(session) : allocator;
+        ret = xls2img_extract_images_ex(*workbook, workbook_size, result, &options);
+    }
+    if (!session)
+        xls2img_close(reader);
+    return ret;
+}
+
+// Back to back files through one session, which is reset after each, against a fresh allocation of everything
+static int bench_session(const CORPUS_FILE* file, int iterations)
+{
+    unsigned long long* samples = (unsigned long long*)calloc((size_t)iterations * 2, sizeof(unsigned long long));
+    unsigned long long heap_calls[2] = { 0, 0 };
+    XLS2IMG_ALLOCATOR allocators[2];
+    memset(allocators, 0, sizeof(allocators));
+    for (int mode = 0; mode < 2; mode++)
+    {
+        allocators[mode].alloc = bench_count_alloc;
+        allocators[mode].realloc = bench_count_realloc;
+        allocators[mode].free = bench_count_free;
+        allocators[mode].user = &heap_calls[mode];
+    }
+
+    XLS2IMG_SESSION* session = NULL;
+    int ret = samples ? xls2img_session_create(&session, &allocators[1], 0) : XLS2IMG_ERROR_OUT_OF_MEMORY;
+    int ok = ret == XLS2IMG_SUCCESS;
+    unsigned long long warm_calls = 0;
+
+    // one unmeasured file fills the session
+    for (int it = -2; it < iterations * 2 && ok; it++)
+    {
+        int mode = it & 1;
+        XLS2IMG_RESULT result = { NULL, 0 };
+        void* workbook = NULL;
+        if (it == 0)
+            warm_calls = heap_calls[1];
+
+        unsigned long long t0 = bench_now_ns();
+        ret = bench_session_file(file, mode ? session : NULL, &allocators[mode], &result, &workbook);
+        if (mode)
+            xls2img_session_reset(session);
+        else
+        {
+            xls2img_free_result(&result);
+            xls2img_free_workbook_data(workbook);
+        }
+        if (it >= 0)
+            samples[mode * iterations + it / 2] = bench_now_ns() - t0;
+
+        if (ret < 0 && !(ret == XLS2IMG_ERROR_NO_IMAGES && file->image_count == 0))
+            ok = 0;
+    }
+
+    if (ok)
+    {
+        qsort(samples, iterations, sizeof(*samples), compare_ull);
+        qsort(samples + iterations, iterations, sizeof(*samples), compare_ull);
+        unsigned long long plain = percentile(samples, iterations, 50);
+        unsigned long long reused = percentile(samples + iterations, iterations, 50);
+        printf("  session: file p50 %.1f us, fresh allocations %.1f us (%+.1f%%); heap calls per file %.1f, fresh %.1f\n",
+            reused / 1000.0, plain / 1000.0, plain ? 100.0 * ((double)reused - (double)plain) / (double)plain : 0.0,
+            (double)(heap_calls[1] - warm_calls) / iterations, (double)heap_calls[0] / (iterations + 1));
+    }
+    else
+        fprintf(stderr, "error: extraction through a session failed (%s)\n", xls2img_strerror(ret));
+    xls2img_session_destroy(session);
+    free(samples);
+    return ok;
+}
+
+// Extraction restricted to one format at a time, checked against that format's images of the corpus
+static int bench_formats(const CORPUS_FILE* file, int iterations)
+{
+    static const XLS2IMG_FORMAT formats[] = { XLS2IMG_PNG, XLS2IMG_JPG };
+    static const char* const format_names[] = { "png", "jpg" };
+
+    unsigned long long* samples = (unsigned long long*)calloc((size_t)iterations, sizeof(unsigned long long));
+    XLS2IMG_READER* reader = NULL;
+    void* workbook = NULL;
+    size_t workbook_size = 0;
+    int ok = samples && xls2img_open(&reader, file->data, file->size) == XLS2IMG_SUCCESS &&
+        xls2img_get_workbook(reader, &workbook, &workbook_size) == XLS2IMG_SUCCESS;
+
+    for (int f = 0; f < 2 && ok; f++)
+    {
+        if (!(xls2img_get_formats() & XLS2IMG_FORMAT_MASK(formats[f])))
+            continue;
+
+        XLS2IMG_EXTRACT_OPTIONS options;
+        memset(&options, 0, sizeof(options));
+        options.formats = XLS2IMG_FORMAT_MASK(formats[f]);
+
+        for (int it = 0; it < iterations && ok; it++)
+        {
+            XLS2IMG_RESULT result = { NULL, 0 };
+            unsigned long long t0 = bench_now_ns();
+            int ret = xls2img_extract_images_ex(workbook, workbook_size, &result, &options);
+            samples[it] = bench_now_ns() - t0;
+
+            int expected = 0;
+            for (int i = 0; i < file->image_count && ok; i++)
+            {
+                if (file->image_formats[i] != (int)formats[f])
+                    continue;
+                ok = expected < result.count && (int)result.images[expected].format == file->image_formats[i] &&
+                    result.images[expected].size == file->image_sizes[i];
+                expected++;
+            }
+            if (!ok || result.count != expected || (ret < 0 && !(ret == XLS2IMG_ERROR_NO_IMAGES && expected == 0)))
+            {
+                fprintf(stderr, "error: %s only extraction found %d images, expected %d\n", format_names[f], result.count, expected);
+                ok = 0;
+            }
+            xls2img_free_result(&result);
+        }
+
+        if (ok)
+        {
+            qsort(samples, iterations, sizeof(*samples), compare_ull);
+            printf("  %s only: p50 %.1f us, %.1f MB/s\n", format_names[f], percentile(samples, iterations, 50) / 1000.0,
+                mb_per_s(workbook_size, percentile(samples, iterations, 50)));
+        }
+    }
+
+    xls2img_free_workbook_data(workbook);
+    xls2img_close(reader);
+    free(samples);
+    return ok;
+}
+
+// One thread of the shared reader run (-j): its own cursor and allocator over the reader all threads use
+typedef struct {
+    const XLS2IMG_READER* reader;
+    const CORPUS_FILE* file;
+    int iterations;
+    int ok;
+} BENCH_WORKER;
+
+#ifdef _WIN32
+static DWORD WINAPI bench_worker(LPVOID arg)
+#else
+static void* bench_worker(void* arg)
+#endif
+{
+    BENCH_WORKER* worker = (BENCH_WORKER*)arg;
+    XLS2IMG_ALLOCATOR allocator;
+    memset(&allocator, 0, sizeof(allocator));
+    XLS2IMG_EXTRACT_OPTIONS options;
+    memset(&options, 0, sizeof(options));
+    options.allocator = &allocator;
+
+    XLS2IMG_CURSOR* cursor = NULL;
+    worker->ok = xls2img_cursor_open(&cursor, worker->reader, &options) == XLS2IMG_SUCCESS;
+    for (int it = 0; it < worker->iterations && worker->ok; it++)
+    {
+        void* workbook = NULL;
+        size_t workbook_size = 0;
+        XLS2IMG_RESULT result = { NULL, 0 };
+
+        int ret = xls2img_cursor_get_workbook(cursor, &workbook, &workbook_size);
+        if (ret == XLS2IMG_SUCCESS)
+            ret = xls2img_extract_images_ex(workbook, workbook_size, &result, &options);
+        if (ret < 0 && !(ret == XLS2IMG_ERROR_NO_IMAGES && worker->file->image_count == 0))
+            worker->ok = 0;
+        else
+            worker->ok = verify_result(worker->file, &result);
+
+        // images stored in one piece are read again straight from the sectors, in ascending order
+        for (int i = 0; i < result.count && worker->ok; i++)
+        {
+            const XLS2IMG_IMAGE* img = &result.images[i];
+            if (img->span != img->size)
+                continue;
+            void* copy = malloc(img->size);
+            worker->ok = copy && xls2img_cursor_read(cursor, img->offset, copy, img->size) == XLS2IMG_SUCCESS &&
+                memcmp(copy, img->data, img->size) == 0;
+            free(copy);
+        }
+
+        xls2img_free_result(&result);
+        xls2img_free_workbook_data(workbook);
+    }
+    xls2img_cursor_close(cursor);
+
+    if (allocator.current_bytes != 0)
+        worker->ok = 0;
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+// Runs the workbook copy and extraction on several threads sharing one reader and reports the aggregate throughput
+static int bench_shared_reader(const CORPUS_FILE* file, int threads, int iterations)
+{
+    XLS2IMG_READER* reader = NULL;
+    if (xls2img_open(&reader, file->data, file->size) != XLS2IMG_SUCCESS)
+    {
+        fprintf(stderr, "error: cannot open corpus\n");
+        return 0;
+    }
+
+    BENCH_WORKER workers[BENCH_MAX_THREADS];
+#ifdef _WIN32
+    HANDLE handles[BENCH_MAX_THREADS];
+#else
+    pthread_t handles[BENCH_MAX_THREADS];
+#endif
+    int started = 0;
+    int ok = 1;
+
+    unsigned long long t0 = bench_now_ns();
+    for (; started < threads; started++)
+    {
+        workers[started].reader = reader;
+        workers[started].file = file;
+        workers[started].iterations = iterations;
+        workers[started].ok = 0;
+#ifdef _WIN32
+        handles[started] = CreateThread(NULL, 0, bench_worker, &workers[started], 0, NULL);
+        if (!handles[started]) break;
+#else
+        if (pthread_create(&handles[started], NULL, bench_worker, &workers[started]) != 0) break;
+#endif
+    }
+    for (int i = 0; i < started; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(handles[i], INFINITE);
+        CloseHandle(handles[i]);
+#else
+        pthread_join(handles[i], NULL);
+#endif
+        ok = ok && workers[i].ok;
+    }
+    unsigned long long t1 = bench_now_ns();
+    xls2img_close(reader);
+
+    if (started < threads)
+    {
+        fprintf(stderr, "error: cannot start %d threads\n", threads);
+        return 0;
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "error: a thread sharing the reader extracted wrong data\n");
+        return 0;
+    }
+    printf("  shared reader: %d threads x %d runs, %.1f MB/s aggregate\n", threads, iterations,
+        mb_per_s((size_t)threads * iterations * file->size, t1 - t0));
+    return 1;
+}
+
+static int bench_corpus(const CORPUS_SPEC* spec, int iterations, int threads)
+{
+    CORPUS_FILE file;
+    if (!corpus_generate(spec, &file))
+    {
+        fprintf(stderr, "error: cannot generate corpus\n");
+        return 0;
+    }
+    print_spec(spec, &file);
+
+    // a build without some formats (XLS2IMG_FORMATS) yields only the images of the others
+    int kept = 0;
+    for (int i = 0; i < file.image_count; i++)
+    {
+        if (!(xls2img_get_formats() & XLS2IMG_FORMAT_MASK(file.image_formats[i])))
+            continue;
+        file.image_formats[kept] = file.image_formats[i];
+        file.image_sizes[kept] = file.image_sizes[i];
+        kept++;
+    }
+    file.image_count = kept;
+
+    unsigned long long* samples = (unsigned long long*)calloc((size_t)iterations * PHASE_COUNT, sizeof(unsigned long long));
+    if (!samples)
+    {
+        corpus_free(&file);
+        return 0;
+    }
+
+    // counters of the first iteration, only filled in when the sources are built with XLS2IMG_STATS
+    XLS2IMG_STATS stats;
+    memset(&stats, 0, sizeof(stats));
+    int have_stats = 0;
+    size_t peak_bytes = 0;
+
+    // events of the first iteration, only recorded when the sources are built with XLS2IMG_TRACE
+    static XLS2IMG_EVENT events[BENCH_TRACE_EVENTS];
+    XLS2IMG_TRACE trace;
+    memset(&trace, 0, sizeof(trace));
+    trace.events = events;
+    trace.capacity = BENCH_TRACE_EVENTS;
+    trace.flush = trace_write_events;
+    int have_trace = 0;
+    trace_pid++;
+
+    int ok = 1;
+    for (int it = 0; it < iterations && ok; it++)
+    {
+        XLS2IMG_READER* reader = NULL;
+        void* workbook = NULL;
+        size_t workbook_size = 0;
+        XLS2IMG_RESULT result = { NULL, 0 };
+
+        // counts every library allocation; nothing may be left once the iteration is cleaned up
+        XLS2IMG_ALLOCATOR allocator;
+        memset(&allocator, 0, sizeof(allocator));
+
+        unsigned long long t0 = bench_now_ns();
+        int ret = xls2img_open_ex(&reader, file.data, file.size, &allocator);
+        unsigned long long t1 = bench_now_ns();
+        if (ret == XLS2IMG_SUCCESS && it == 0)
+        {
+            have_stats = xls2img_set_stats(reader, &stats) == XLS2IMG_SUCCESS;
+            have_trace = trace_file && xls2img_set_trace(reader, &trace) == XLS2IMG_SUCCESS;
+        }
+        if (ret == XLS2IMG_SUCCESS)
+            ret = xls2img_get_workbook(reader, &workbook, &workbook_size);
+        unsigned long long t2 = bench_now_ns();
+        if (ret == XLS2IMG_SUCCESS)
+        {
+            XLS2IMG_EXTRACT_OPTIONS options;
+            memset(&options, 0, sizeof(options));
+            options.stats = it == 0 && have_stats ? &stats : NULL;
+            options.trace = it == 0 && have_trace ? &trace : NULL;
+            options.allocator = &allocator;
+            ret = xls2img_extract_images_ex(workbook, workbook_size, &result, &options);
+        }
+        unsigned long long t3 = bench_now_ns();
+
+        if (ret < 0 && !(ret == XLS2IMG_ERROR_NO_IMAGES && file.image_count == 0))
+        {
+            fprintf(stderr, "error: %s\n", xls2img_strerror(ret));
+            ok = 0;
+        }
+        else if (it == 0)
+            ok = verify_result(&file, &result);
+
+        if (it == 0 && have_trace)
+            xls2img_trace_flush(&trace);
+
+        samples[PHASE_OPEN * iterations + it] = t1 - t0;
+        samples[PHASE_WORKBOOK * iterations + it] = t2 - t1;
+        samples[PHASE_EXTRACT * iterations + it] = t3 - t2;
+        samples[PHASE_TOTAL * iterations + it] = t3 - t0;
+
+        xls2img_free_result(&result);
+        xls2img_free_workbook_data(workbook);
+        xls2img_close(reader);
+
+        if (allocator.current_bytes != 0)
+        {
+            fprintf(stderr, "error: %zu bytes still allocated after cleanup\n", allocator.current_bytes);
+            ok = 0;
+        }
+        if (it == 0)
+            peak_bytes = allocator.peak_bytes;
+    }
+
+    if (ok)
+    {
+        printf("  %-24s %12s %12s %12s %12s\n", "phase", "p50 us", "p90 us", "p99 us", "MB/s (p50)");
+        for (int phase = 0; phase < PHASE_COUNT; phase++)
+        {
+            unsigned long long* s = samples + (size_t)phase * iterations;
+            qsort(s, iterations, sizeof(*s), compare_ull);
+
+            printf("  %-24s %12.1f %12.1f %12.1f", phase_names[phase], percentile(s, iterations, 50) / 1000.0,
+                percentile(s, iterations, 90) / 1000.0, percentile(s, iterations, 99) / 1000.0);
+
+            // open only parses the header; the workbook copy is measured against the file, carving against the workbook
+            if (phase == PHASE_OPEN)
+                printf(" %12s\n", "-");
+            else
+                printf(" %12.1f\n", mb_per_s(phase == PHASE_EXTRACT ? file.workbook_size : file.size, percentile(s, iterations, 50)));
+        }
+
+        printf("  peak memory: %zu bytes (%.2fx the file)\n", peak_bytes, (double)peak_bytes / file.size);
+
+        if (have_stats)
+        {
+            printf("  stats: %llu sectors, %llu fat / %llu minifat lookups, %llu bytes copied\n",
+                (unsigned long long)stats.sectors_visited, (unsigned long long)stats.fat_lookups,
+                (unsigned long long)stats.minifat_lookups,
+                (unsigned long long)stats.bytes_copied);
+            printf("  stats: %llu records, %llu continue, %llu headers (%llu rejected), %llu allocations, peak %llu bytes\n",
+                (unsigned long long)stats.records_walked, (unsigned long long)stats.continue_segments,
+                (unsigned long long)stats.headers_found, (unsigned long long)stats.headers_rejected,
+                (unsigned long long)stats.allocations, (unsigned long long)stats.peak_bytes);
+            printf("  stats: workbook %.1f us, extract %.1f us (scan %.1f us)\n", stats.workbook_ns / 1000.0,
+                stats.extract_ns / 1000.0, stats.scan_ns / 1000.0);
+        }
+    }
+
+    if (ok)
+        ok = bench_push_parser(&file, iterations);
+    if (ok)
+        ok = bench_index(&file, iterations);
+    if (ok)
+        ok = bench_verify(&file, iterations);
+    if (ok)
+        ok = bench_session(&file, iterations);
+    if (ok)
+        ok = bench_formats(&file, iterations);
+    if (ok && threads > 1)
+        ok = bench_shared_reader(&file, threads, iterations);
+
+    free(samples);
+    corpus_free(&file);
+    return ok;
+}
+
+// Best of several runs of a kernel over bytes of input
+static void report_kernel(const char* name, size_t bytes, const unsigned long long* runs, int count)
+{
+    unsigned long long best = runs[0];
+    for (int i = 1; i < count; i++)
+        if (runs[i] < best)
+            best = runs[i];
+    printf("  %-28s %10.1f MB/s\n", name, mb_per_s(bytes, best));
+}
+
+static int bench_kernels(int iterations)
+{
+    size_t size = BENCH_KERNEL_SIZE;
+    uint8_t* data = (uint8_t*)malloc(size);
+    unsigned long long* runs = (unsigned long long*)malloc((size_t)iterations * sizeof(unsigned long long));
+    if (!data || !runs)
+    {
+        free(data);
+        free(runs);
+        return 0;
+    }
+
+    printf("kernels: %d runs over %zu MB, best run\n", iterations, size / (1024 * 1024));
+    uint32_t state = 12345;
+    volatile size_t sink = 0;
+
+    // signature scans over data without any header, the common case between images: every built-in format
+    // through the lead byte table, and single formats, which memchr skips to their lead byte
+    static const struct {
+        const char* name;
+        unsigned int formats;
+    } scans[] = {
+        { "scan all formats (no hit)", XLS2IMG_FORMATS_ALL },
+        { "scan png (no hit)", XLS2IMG_FORMAT_MASK(XLS2IMG_PNG) },
+        { "scan jpg (no hit)", XLS2IMG_FORMAT_MASK(XLS2IMG_JPG) },
+        { "scan all formats (SOI/64B)", XLS2IMG_FORMATS_ALL },
+        { "scan jpg (SOI/64B)", XLS2IMG_FORMAT_MASK(XLS2IMG_JPG) },
+    };
+    static XLS2IMG_SCANNER scanner;
+    const XLS2IMG_FORMAT_DESC* desc = NULL;
+    corpus_fill_random(data, size, &state);
+
+    for (size_t s = 0; s < sizeof(scans) / sizeof(scans[0]); s++)
+    {
+        // then the same with a dense sprinkling of SOI markers that are not JPEG headers
+        if (s == 3)
+        {
+            for (size_t i = 0; i + 1 < size; i += 64)
+            {
+                data[i] = 0xFF;
+                data[i + 1] = 0xD8;
+            }
+        }
+
+        xls2img_scanner_init(&scanner, scans[s].formats & xls2img_get_formats());
+        if (!scanner.formats)
+            continue;
+        for (int i = 0; i < iterations; i++)
+        {
+            unsigned long long t0 = bench_now_ns();
+            sink += (size_t)scanner.scan(&scanner, data, size - XLS2IMG_SCAN_LOOKAHEAD + 1, size, &desc);
+            runs[i] = bench_now_ns() - t0;
+        }
+        report_kernel(scans[s].name, size, runs, iterations);
+    }
+
+#ifdef XLS2IMG_WITH_PNG
+    // chunk walk over a PNG split into 4 KiB IDAT chunks
+    corpus_write_png(data, size, 4096, &state);
+    for (int i = 0; i < iterations; i++)
+    {
+        unsigned long long t0 = bench_now_ns();
+        sink += (size_t)xls2img_find_png_end(data, size);
+        runs[i] = bench_now_ns() - t0;
+    }
+    report_kernel("find_png_end (4 KiB chunks)", size, runs, iterations);
+
+    // the PNG check on its own and fused into the copy of the image, against a plain copy and the bare CRC
+    uint8_t* copy = (uint8_t*)malloc(size);
+    if (copy)
+    {
+        for (int i = 0; i < iterations; i++)
+        {
+            unsigned long long t0 = bench_now_ns();
+            memcpy(copy, data, size);
+            runs[i] = bench_now_ns() - t0;
+            sink += copy[i];
+        }
+        report_kernel("memcpy", size, runs, iterations);
+        for (int i = 0; i < iterations; i++)
+        {
+            unsigned long long t0 = bench_now_ns();
+            sink += xls2img_crc32(0, data, size);
+            runs[i] = bench_now_ns() - t0;
+        }
+        report_kernel("crc32 (slicing-by-8)", size, runs, iterations);
+        for (int i = 0; i < iterations; i++)
+        {
+            unsigned long long t0 = bench_now_ns();
+            sink += xls2img_verify(XLS2IMG_PNG, data, size, NULL);
+            runs[i] = bench_now_ns() - t0;
+        }
+        report_kernel("verify png (4 KiB chunks)", size, runs, iterations);
+        for (int i = 0; i < iterations; i++)
+        {
+            unsigned long long t0 = bench_now_ns();
+            sink += xls2img_verify(XLS2IMG_PNG, data, size, copy);
+            runs[i] = bench_now_ns() - t0;
+        }
+        report_kernel("verify png + copy", size, runs, iterations);
+        free(copy);
+    }
+#endif
+
+#ifdef XLS2IMG_WITH_JPG
+    // backward search for the EOI of a small JPEG followed by the rest of the block
+    corpus_fill_random(data, size, &state);
+    corpus_write_jpg(data, 4096, &state);
+    for (int i = 0; i < iterations; i++)
+    {
+        unsigned long long t0 = bench_now_ns();
+        sink += (size_t)xls2img_find_jpg_end(data + size, data);
+        runs[i] = bench_now_ns() - t0;
+    }
+    report_kernel("find_jpg_end (EOI at start)", size, runs, iterations);
+
+    // marker walk over a JPEG whose scan data fills the block
+    corpus_write_jpg(data, size, &state);
+    for (int i = 0; i < iterations; i++)
+    {
+        unsigned long long t0 = bench_now_ns();
+        sink += xls2img_verify(XLS2IMG_JPG, data, size, NULL);
+        runs[i] = bench_now_ns() - t0;
+    }
+    report_kernel("verify jpg (one scan)", size, runs, iterations);
+#endif
+
+    (void)sink;
+    free(data);
+    free(runs);
+    return 1;
+}
+
+// Writes a sparse corpus: the gap is skipped with a seek, which leaves a hole on file systems that support them
+static int write_sparse(const char* path, const CORPUS_FILE* file)
+{
+    FILE* fp = fopen(path, "wb");
+    if (!fp)
+        return 0;
+    int ok = fwrite(file->data, 1, file->head_size, fp) == file->head_size;
+#ifdef _WIN32
+    ok = ok && _fseeki64(fp, (long long)file->gap_size, SEEK_CUR) == 0;
+#else
+    ok = ok && (uint64_t)(off_t)file->gap_size == file->gap_size && fseeko(fp, (off_t)file->gap_size, SEEK_CUR) == 0;
+#endif
+    ok = ok && fwrite(file->data + file->head_size, 1, file->size - file->head_size, fp) == file->size - file->head_size;
+    if (fclose(fp) != 0)
+        ok = 0;
+    return ok;
+}
+
+// Maps a file read-only, the way the tool's large-file mode does
+static int map_sparse(const char* path, uint64_t size, const uint8_t** view)
+{
+    if (size > SIZE_MAX)
+        return 0;
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return 0;
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (!mapping)
+        return 0;
+    *view = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    return *view != NULL;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    void* addr = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    *view = (const uint8_t*)addr;
+    return addr != MAP_FAILED;
+#endif
+}
+
+static void unmap_sparse(const uint8_t* view, uint64_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(view);
+#else
+    munmap((void*)view, (size_t)size);
+#endif
+}
+
+// Writes a compound file whose workbook stream lies gap bytes in, past the 32-bit and 2 GiB limits, and streams its
+// images out of a read-only mapping. The images are checked against the generator and the first workbook sector
+// against its place behind the gap.
+static int bench_sparse(const CORPUS_SPEC* spec, uint64_t gap, const char* path, int iterations)
+{
+    CORPUS_FILE file;
+    if (!corpus_generate_sparse(spec, gap, &file))
+    {
+        fprintf(stderr, "error: cannot generate corpus\n");
+        return 0;
+    }
+    uint64_t file_size = file.gap_size + file.size;
+    uint64_t workbook_offset = file.head_size + file.gap_size;
+    printf("sparse corpus: %s, %.2f GB, workbook of %.2f MB at %.2f GB, %d images of ~%zu bytes\n", path,
+        file_size / (1024.0 * 1024.0 * 1024.0), file.workbook_size / (1024.0 * 1024.0),
+        workbook_offset / (1024.0 * 1024.0 * 1024.0), spec->image_count, spec->image_size);
+
+    int ok = write_sparse(path, &file);
+    free(file.data);
+    file.data = NULL;
+    if (!ok)
+    {
+        fprintf(stderr, "error: cannot write %s\n", path);
+        corpus_free(&file);
+        return 0;
+    }
+
+    const uint8_t* view = NULL;
+    if (!map_sparse(path, file_size, &view))
+    {
+        fprintf(stderr, "error: cannot map %s (%.2f GB)\n", path, file_size / (1024.0 * 1024.0 * 1024.0));
+        corpus_free(&file);
+        return 0;
+    }
+
+    unsigned long long* samples = (unsigned long long*)calloc((size_t)iterations, sizeof(unsigned long long));
+    XLS2IMG_READER* reader = NULL;
+    ok = samples && xls2img_open(&reader, view, (size_t)file_size) == XLS2IMG_SUCCESS;
+
+    XLS2IMG_EXTENT extent;
+    if (ok && (xls2img_get_workbook_extents(reader, 0, 1, &extent, 1) != 1 || extent.offset < workbook_offset))
+    {
+        fprintf(stderr, "error: workbook does not start behind offset %llu\n", (unsigned long long)workbook_offset);
+        ok = 0;
+    }
+
+    size_t peak_bytes = 0;
+    for (int it = 0; it < iterations && ok; it++)
+    {
+        XLS2IMG_ALLOCATOR allocator;
+        memset(&allocator, 0, sizeof(allocator));
+        XLS2IMG_EXTRACT_OPTIONS options;
+        memset(&options, 0, sizeof(options));
+        options.allocator = &allocator;
+        BENCH_PUSH push = { &file, 0, 1 };
+
+        unsigned long long t0 = bench_now_ns();
+        int ret = xls2img_stream_images(reader, bench_push_image, &push, &options);
+        samples[it] = bench_now_ns() - t0;
+
+        if ((ret < 0 && !(ret == XLS2IMG_ERROR_NO_IMAGES && file.image_count == 0)) || !push.ok ||
+            push.count != file.image_count || allocator.current_bytes != 0)
+        {
+            fprintf(stderr, "error: extracted %d images from the sparse corpus (%s)\n", push.count, xls2img_strerror(ret));
+            ok = 0;
+        }
+        if (allocator.peak_bytes > peak_bytes)
+            peak_bytes = allocator.peak_bytes;
+    }
+
+    if (ok)
+    {
+        qsort(samples, iterations, sizeof(*samples), compare_ull);
+        printf("  stream from mapping: p50 %.1f us, %.1f MB/s, peak memory %zu bytes\n",
+            percentile(samples, iterations, 50) / 1000.0, mb_per_s(file.workbook_size, percentile(samples, iterations, 50)),
+            peak_bytes);
+    }
+    xls2img_close(reader);
+    unmap_sparse(view, file_size);
+    free(samples);
+    corpus_free(&file);
+    return ok;
+}
+
+static void print_usage(void)
+{
+    fprintf(stderr, "Usage: xls2img_bench [options]\n"
+        "Without corpus options a fixed matrix of corpora is measured.\n"
+        "  -n, --iterations N     runs per corpus and kernel (default %d)\n"
+        "  -v, --version 3|4      sector version: 512 or 4096-byte sectors\n"
+        "  -F, --fragmentation P  percentage of workbook sectors out of chain order\n"
+        "  -d, --difat N          number of DIFAT sectors\n"
+        "  -w, --workbook-size B  minimum workbook stream size\n"
+        "  -i, --images N         number of images\n"
+        "  -S, --image-size B     average image size (+-50%%)\n"
+        "  -p, --png P            percentage of PNG images, the rest are JPEG\n"
+        "  -c, --continue B       largest record payload before CONTINUE records (default 8224)\n"
+        "  -r, --seed N           generator seed\n"
+        "  -o, --write FILE       write the generated compound file and exit\n"
+        "  -T, --trace FILE       write the events of each corpus' first run as a Chrome trace (XLS2IMG_TRACE builds)\n"
+        "  -j, --threads N        also run N threads extracting through one shared reader (max %d)\n"
+        "  -L, --sparse FILE      write the corpus as a sparse FILE with the workbook behind a gap and extract it\n"
+        "                         through a memory mapping (needs a 64-bit build), then exit\n"
+        "      --gap B            bytes of free sectors in front of the workbook of --sparse (default 4.5 GiB)\n"
+        "      --no-kernels       skip the kernel micro-benchmarks\n",
+        BENCH_DEFAULT_ITERATIONS, BENCH_MAX_THREADS);
+}
+
+int main(int argc, char* argv[])
+{
+    CORPUS_SPEC spec;
+    corpus_default_spec(&spec);
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    int threads = 1;
+    int custom = 0;
+    int kernels = 1;
+    const char* write_path = NULL;
+    const char* trace_path = NULL;
+    const char* sparse_path = NULL;
+    uint64_t gap = BENCH_SPARSE_GAP;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        int takes_value = 1;
+
+        if ((strcmp(arg, "-n") == 0 || strcmp(arg, "--iterations") == 0) && value)
+            iterations = atoi(value);
+        else if ((strcmp(arg, "-v") == 0 || strcmp(arg, "--version") == 0) && value)
+            spec.version = atoi(value);
+        else if ((strcmp(arg, "-F") == 0 || strcmp(arg, "--fragmentation") == 0) && value)
+            spec.fragmentation = atoi(value);
+        else if ((strcmp(arg, "-d") == 0 || strcmp(arg, "--difat") == 0) && value)
+            spec.difat_depth = atoi(value);
+        else if ((strcmp(arg, "-w") == 0 || strcmp(arg, "--workbook-size") == 0) && value)
+            spec.workbook_size = (size_t)strtoull(value, NULL, 10);
+        else if ((strcmp(arg, "-i") == 0 || strcmp(arg, "--images") == 0) && value)
+            spec.image_count = atoi(value);
+        else if ((strcmp(arg, "-S") == 0 || strcmp(arg, "--image-size") == 0) && value)
+            spec.image_size = (size_t)strtoull(value, NULL, 10);
+        else if ((strcmp(arg, "-p") == 0 || strcmp(arg, "--png") == 0) && value)
+            spec.png_percent = atoi(value);
+        else if ((strcmp(arg, "-c") == 0 || strcmp(arg, "--continue") == 0) && value)
+            spec.continue_size = (size_t)strtoull(value, NULL, 10);
+        else if ((strcmp(arg, "-r") == 0 || strcmp(arg, "--seed") == 0) && value)
+            spec.seed = (uint32_t)strtoul(value, NULL, 10);
+        else if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--write") == 0) && value)
+            write_path = value;
+        else if ((strcmp(arg, "-T") == 0 || strcmp(arg, "--trace") == 0) && value)
+            trace_path = value;
+        else if ((strcmp(arg, "-j") == 0 || strcmp(arg, "--threads") == 0) && value)
+            threads = atoi(value);
+        else if ((strcmp(arg, "-L") == 0 || strcmp(arg, "--sparse") == 0) && value)
+            sparse_path = value;
+        else if (strcmp(arg, "--gap") == 0 && value)
+            gap = strtoull(value, NULL, 10);
+        else if (strcmp(arg, "--no-kernels") == 0)
+        {
+            kernels = 0;
+            takes_value = 0;
+        }
+        else
+        {
+            print_usage();
+            return 1;
+        }
+
+        if (takes_value)
+        {
+            // every option but the iteration count, the thread count, the output paths, the gap and --no-kernels shapes the corpus
+            if (strcmp(arg, "-n") != 0 && strcmp(arg, "--iterations") != 0 && strcmp(arg, "-o") != 0 && strcmp(arg, "--write") != 0 &&
+                strcmp(arg, "-T") != 0 && strcmp(arg, "--trace") != 0 && strcmp(arg, "-j") != 0 && strcmp(arg, "--threads") != 0 &&
+                strcmp(arg, "-L") != 0 && strcmp(arg, "--sparse") != 0 && strcmp(arg, "--gap") != 0)
+                custom = 1;
+            i++;
+        }
+    }
+
+    if (iterations < 1)
+        iterations = 1;
+    if (threads > BENCH_MAX_THREADS)
+        threads = BENCH_MAX_THREADS;
+
+    if (sparse_path)
+        return bench_sparse(&spec, gap, sparse_path, iterations) ? 0 : 1;
+
+    if (write_path)
+    {
+        CORPUS_FILE file;
+        if (!corpus_generate(&spec, &file))
+        {
+            fprintf(stderr, "error: cannot generate corpus\n");
+            return 1;
+        }
+        FILE* fp = fopen(write_path, "wb");
+        int ok = fp && fwrite(file.data, 1, file.size, fp) == file.size;
+        if (fp && fclose(fp) != 0)
+            ok = 0;
+        if (ok)
+            print_spec(&spec, &file);
+        else
+            fprintf(stderr, "error: cannot write %s\n", write_path);
+        corpus_free(&file);
+        return ok ? 0 : 1;
+    }
+
+    if (trace_path)
+    {
+        trace_file = fopen(trace_path, "w");
+        if (!trace_file)
+        {
+            fprintf(stderr, "error: cannot write %s\n", trace_path);
+            return 1;
+        }
+        fputs("{\"traceEvents\":[", trace_file);
+    }
+
+    int ok = 1;
+    if (custom)
+        ok = bench_corpus(&spec, iterations, threads);
+    else
+    {
+        // small and large sectors, fragmented chains, deep DIFAT, heavy CONTINUE splitting
+        static const CORPUS_SPEC matrix[] = {
+            { 3,  0, 0,        0,  8,   64 * 1024, 50, 8224, 1 },
+            { 4,  0, 0,        0,  8,   64 * 1024, 50, 8224, 1 },
+            { 3,  0, 0, 48 << 20, 20, 1024 * 1024, 50, 8224, 2 },
+            { 4, 50, 0, 48 << 20, 20, 1024 * 1024, 50, 8224, 2 },
+            { 3,  0, 2,        0, 64,   16 * 1024, 80, 8224, 3 },
+            { 3,  0, 0,        0, 32,  128 * 1024,  0,  512, 4 },
+        };
+        for (size_t i = 0; i < sizeof(matrix) / sizeof(matrix[0]) && ok; i++)
+            ok = bench_corpus(&matrix[i], iterations, threads);
+    }
+
+    if (trace_file)
+    {
+        fputs("\n]}\n", trace_file);
+        if (fclose(trace_file) != 0)
+            ok = 0;
+        if (!trace_written)
+            fprintf(stderr, "warning: no events recorded, rebuild with -DXLS2IMG_TRACE=ON\n");
+    }
+
+    if (ok && kernels)
+        ok = bench_kernels(iterations);
+    return ok ? 0 : 1;
+}
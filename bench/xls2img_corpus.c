@@ -0,0 +1,582 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Synthetic XLS corpus generator
+ *
+ * Builds compound files in memory with the layout the reader and the image carver rely on:
+ * a Workbook stream made of a BOF record, filler records, a MsoDrawingGroup split into
+ * CONTINUE records and an EOF record. The drawing group holds a BStore container with one
+ * BLIP per image. Image payloads are structurally valid PNG (chunk walk with CRCs) and JFIF
+ * JPEG (marker segments, one scan of random bytes) files; they are meant for carving and
+ * verification, not for decoding.
+ */
+
+#include "xls2img_corpus.h"
+#include <stdlib.h>
+#include <string.h>
+#include <xls2img.h>
+
+#define CFB_ENDOFCHAIN 0xFFFFFFFEu
+#define CFB_FREESECT 0xFFFFFFFFu
+#define CFB_FATSECT 0xFFFFFFFDu
+#define CFB_DIFSECT 0xFFFFFFFCu
+#define CFB_HEADER_DIFAT 109
+#define CFB_MINI_STREAM_CUTOFF 4096
+#define CFB_ENTRY_SIZE 128
+
+#define BIFF_BOF 0x0809
+#define BIFF_EOF 0x000A
+#define BIFF_SST 0x00FC
+#define BIFF_MSODRAWINGGROUP 0x00EB
+#define BIFF_CONTINUE 0x003C
+#define BIFF_MAX_RECORD 8224
+
+// smallest payloads corpus_write_png/corpus_write_jpg can produce
+#define PNG_MIN_SIZE 57
+#define JPG_MIN_SIZE 45
+
+static uint32_t corpus_rand(uint32_t* state)
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static void store_u16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void store_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void store_be32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size)
+{
+    static uint32_t table[256];
+    if (table[1] == 0)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+void corpus_fill_random(uint8_t* data, size_t size, uint32_t* state)
+{
+    size_t i = 0;
+    while (i < size)
+    {
+        uint32_t r = corpus_rand(state);
+        for (int k = 0; k < 4 && i < size; k++, r >>= 8)
+        {
+            uint8_t b = (uint8_t)r;
+            data[i++] = b == 0xFF ? 0xFE : b;
+        }
+    }
+}
+
+// Writes one PNG chunk with the given payload length; the payload is filled with random bytes.
+static uint8_t* png_write_chunk(uint8_t* p, const char* type, size_t len, uint32_t* state)
+{
+    store_be32(p, (uint32_t)len);
+    memcpy(p + 4, type, 4);
+    if (len > 0 && memcmp(type, "IHDR", 4) != 0)
+        corpus_fill_random(p + 8, len, state);
+    store_be32(p + 8 + len, crc32_update(0, p + 4, len + 4));
+    return p + 12 + len;
+}
+
+void corpus_write_png(uint8_t* out, size_t size, size_t chunk_size, uint32_t* state)
+{
+    static const uint8_t signature[8] = { 0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A };
+    if (chunk_size < 12)
+        chunk_size = 12;
+
+    uint8_t* p = out;
+    memcpy(p, signature, 8);
+    p += 8;
+
+    // 1x1 RGB header
+    static const uint8_t ihdr[13] = { 0, 0, 0, 1, 0, 0, 0, 1, 8, 2, 0, 0, 0 };
+    memcpy(p + 8, ihdr, sizeof(ihdr));
+    p = png_write_chunk(p, "IHDR", sizeof(ihdr), state);
+
+    // IDAT chunks take everything but the trailing IEND, each at least the 12 bytes of framing
+    size_t remaining = size - (size_t)(p - out) - 12;
+    do
+    {
+        size_t len = remaining - 12;
+        if (len > chunk_size)
+            len = remaining - 12 - chunk_size < 12 ? chunk_size - 12 : chunk_size;
+        p = png_write_chunk(p, "IDAT", len, state);
+        remaining -= 12 + len;
+    } while (remaining > 0);
+
+    png_write_chunk(p, "IEND", 0, state);
+}
+
+void corpus_write_jpg(uint8_t* out, size_t size, uint32_t* state)
+{
+    // SOI, APP0 JFIF, a one-component SOF0 and the SOS of its only scan
+    static const uint8_t jfif[43] = {
+        0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00,
+        0xFF, 0xC0, 0x00, 0x0B, 0x08, 0x00, 0x01, 0x00, 0x01, 0x01, 0x01, 0x11, 0x00,
+        0xFF, 0xDA, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3F, 0x00
+    };
+    memcpy(out, jfif, sizeof(jfif));
+    corpus_fill_random(out + sizeof(jfif), size - sizeof(jfif) - 2, state);
+    out[size - 2] = 0xFF;
+    out[size - 1] = 0xD9;
+}
+
+void corpus_default_spec(CORPUS_SPEC* spec)
+{
+    memset(spec, 0, sizeof(*spec));
+    spec->version = 3;
+    spec->image_count = 8;
+    spec->image_size = 64 * 1024;
+    spec->png_percent = 50;
+    spec->continue_size = BIFF_MAX_RECORD;
+    spec->seed = 1;
+}
+
+// Growable byte buffer for the workbook stream
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} CORPUS_BUFFER;
+
+static uint8_t* buffer_reserve(CORPUS_BUFFER* buffer, size_t size)
+{
+    if (buffer->size + size > buffer->capacity)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->size + size)
+            capacity *= 2;
+
+        uint8_t* data = (uint8_t*)realloc(buffer->data, capacity);
+        if (!data)
+            return NULL;
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+
+    uint8_t* p = buffer->data + buffer->size;
+    buffer->size += size;
+    return p;
+}
+
+static int buffer_add_record(CORPUS_BUFFER* buffer, uint16_t type, const uint8_t* payload, size_t size)
+{
+    uint8_t* p = buffer_reserve(buffer, 4 + size);
+    if (!p)
+        return 0;
+    store_u16(p, type);
+    store_u16(p + 2, (uint16_t)size);
+    if (size > 0)
+        memcpy(p + 4, payload, size);
+    return 1;
+}
+
+// Office Art record header: version/instance, type, length
+static void art_header(uint8_t* p, uint16_t ver_inst, uint16_t type, uint32_t len)
+{
+    store_u16(p, ver_inst);
+    store_u16(p + 2, type);
+    store_u32(p + 4, len);
+}
+
+// FBSE (44 bytes) + BLIP header (8) + UID and tag (17) precede each image
+#define BSE_PREFIX_SIZE 69
+
+static void bse_prefix(uint8_t* p, int format, size_t image_size, uint32_t* state)
+{
+    uint8_t blip_type = format == XLS2IMG_PNG ? 6 : 5;
+    uint32_t blip_len = (uint32_t)(17 + image_size);
+
+    memset(p, 0, BSE_PREFIX_SIZE);
+    art_header(p, (uint16_t)(0x0002 | (blip_type << 4)), 0xF007, 36 + 8 + blip_len);
+    p[8] = blip_type;
+    p[9] = blip_type;
+    corpus_fill_random(p + 10, 16, state);
+    store_u32(p + 28, 8 + blip_len);
+    store_u32(p + 32, 1);
+
+    art_header(p + 44, format == XLS2IMG_PNG ? 0x6E00 : 0x46A0, format == XLS2IMG_PNG ? 0xF01E : 0xF01D, blip_len);
+    memcpy(p + 52, p + 10, 16);
+    p[68] = 0xFF;
+}
+
+// The drawing group: container headers, one BSE per image and a split menu colors trailer.
+static uint8_t* build_drawing_group(const CORPUS_SPEC* spec, CORPUS_FILE* file, size_t* size)
+{
+    uint32_t state = spec->seed ? spec->seed : 1;
+
+    // pick sizes first so the containers can be sized up front
+    size_t total = 0;
+    for (int i = 0; i < spec->image_count; i++)
+    {
+        int format = (int)(corpus_rand(&state) % 100) < spec->png_percent ? XLS2IMG_PNG : XLS2IMG_JPG;
+        size_t min_size = format == XLS2IMG_PNG ? PNG_MIN_SIZE : JPG_MIN_SIZE;
+        size_t image_size = spec->image_size / 2 + (spec->image_size ? corpus_rand(&state) % (spec->image_size + 1) : 0);
+        if (image_size < min_size)
+            image_size = min_size;
+
+        // a 0xFF in the length fields between two images could pose as a JPEG end marker,
+        // which would make the expected sizes ambiguous
+        uint8_t prefix[BSE_PREFIX_SIZE];
+        for (;;)
+        {
+            uint32_t probe = state;
+            bse_prefix(prefix, format, image_size, &probe);
+            if (!memchr(prefix, 0xFF, BSE_PREFIX_SIZE - 1))
+                break;
+            image_size++;
+        }
+
+        file->image_formats[i] = format;
+        file->image_sizes[i] = image_size;
+        total += BSE_PREFIX_SIZE + image_size;
+    }
+
+    size_t header_size = 8 + 8 + 16 + 8;
+    size_t trailer_size = 8 + 16;
+    *size = header_size + total + trailer_size;
+
+    uint8_t* data = (uint8_t*)malloc(*size);
+    if (!data)
+        return NULL;
+
+    // OfficeArtDggContainer, OfficeArtFDGG, OfficeArtBStoreContainer
+    uint8_t* p = data;
+    art_header(p, 0x000F, 0xF000, (uint32_t)(*size - 8));
+    art_header(p + 8, 0x0000, 0xF006, 16);
+    memset(p + 16, 0, 16);
+    store_u32(p + 16, 0x0400);
+    art_header(p + 32, (uint16_t)(0x000F | (spec->image_count << 4)), 0xF001, (uint32_t)total);
+    p += header_size;
+
+    for (int i = 0; i < spec->image_count; i++)
+    {
+        bse_prefix(p, file->image_formats[i], file->image_sizes[i], &state);
+        p += BSE_PREFIX_SIZE;
+        if (file->image_formats[i] == XLS2IMG_PNG)
+            corpus_write_png(p, file->image_sizes[i], 32 * 1024, &state);
+        else
+            corpus_write_jpg(p, file->image_sizes[i], &state);
+        p += file->image_sizes[i];
+    }
+
+    // OfficeArtSplitMenuColorContainer, its values hold no 0xFF
+    art_header(p, 0x0040, 0xF11E, 16);
+    store_u32(p + 8, 0x0800000D);
+    store_u32(p + 12, 0x0800000C);
+    store_u32(p + 16, 0x08000017);
+    store_u32(p + 20, 0x100000F7);
+    return data;
+}
+
+static uint8_t* build_workbook(const CORPUS_SPEC* spec, CORPUS_FILE* file, size_t* size)
+{
+    size_t continue_size = spec->continue_size;
+    if (continue_size == 0 || continue_size > BIFF_MAX_RECORD)
+        continue_size = BIFF_MAX_RECORD;
+
+    size_t group_size;
+    uint8_t* group = build_drawing_group(spec, file, &group_size);
+    if (!group)
+        return NULL;
+
+    // BOF + drawing group records + EOF, the rest of the requested size is filler
+    size_t group_records = (group_size + continue_size - 1) / continue_size;
+    size_t fixed = 4 + 16 + group_size + group_records * 4 + 4;
+    size_t target = spec->workbook_size > CFB_MINI_STREAM_CUTOFF ? spec->workbook_size : CFB_MINI_STREAM_CUTOFF;
+    size_t filler = target > fixed ? target - fixed : 0;
+
+    CORPUS_BUFFER buffer = { NULL, 0, 0 };
+    uint8_t bof[16] = { 0x00, 0x06, 0x05, 0x00 };
+    int ok = buffer_add_record(&buffer, BIFF_BOF, bof, sizeof(bof));
+
+    uint32_t state = (spec->seed ? spec->seed : 1) ^ 0x9E3779B9u;
+    while (ok && filler > 0)
+    {
+        // a record needs at least its 4-byte header
+        size_t len = filler - 4 < BIFF_MAX_RECORD ? filler - 4 : BIFF_MAX_RECORD;
+        if (filler < 4)
+            len = 0;
+        uint8_t* p = buffer_reserve(&buffer, 4 + len);
+        ok = p != NULL;
+        if (ok)
+        {
+            store_u16(p, BIFF_SST);
+            store_u16(p + 2, (uint16_t)len);
+            corpus_fill_random(p + 4, len, &state);
+        }
+        filler = filler > 4 + len ? filler - 4 - len : 0;
+    }
+
+    for (size_t offset = 0; ok && offset < group_size; offset += continue_size)
+    {
+        size_t len = group_size - offset < continue_size ? group_size - offset : continue_size;
+        ok = buffer_add_record(&buffer, offset == 0 ? BIFF_MSODRAWINGGROUP : BIFF_CONTINUE, group + offset, len);
+    }
+    ok = ok && buffer_add_record(&buffer, BIFF_EOF, NULL, 0);
+
+    free(group);
+    if (!ok)
+    {
+        free(buffer.data);
+        return NULL;
+    }
+    *size = buffer.size;
+    return buffer.data;
+}
+
+static void cfb_write_entry(uint8_t* p, const char* name, uint8_t type, uint32_t child, uint32_t start, uint64_t size)
+{
+    size_t len = strlen(name);
+    memset(p, 0, CFB_ENTRY_SIZE);
+    for (size_t i = 0; i < len; i++)
+        store_u16(p + i * 2, (uint16_t)name[i]);
+    store_u16(p + 64, (uint16_t)((len + 1) * 2));
+    p[66] = type;
+    p[67] = 1;
+    store_u32(p + 68, CFB_FREESECT);
+    store_u32(p + 72, CFB_FREESECT);
+    store_u32(p + 76, child);
+    store_u32(p + 116, start);
+    store_u32(p + 120, (uint32_t)size);
+    store_u32(p + 124, (uint32_t)(size >> 32));
+}
+
+// Lays out the compound file with gap_sectors free sectors between the DIFAT and the workbook. Only the sectors
+// before and behind the gap are generated, see CORPUS_FILE.
+static int corpus_build(const CORPUS_SPEC* spec, size_t gap_sectors, CORPUS_FILE* file)
+{
+    memset(file, 0, sizeof(*file));
+    if ((spec->version != 3 && spec->version != 4) || spec->image_count < 0 ||
+        spec->fragmentation < 0 || spec->fragmentation > 100 || spec->difat_depth < 0)
+        return 0;
+
+    file->image_count = spec->image_count;
+    file->image_formats = (int*)calloc(spec->image_count + 1, sizeof(int));
+    file->image_sizes = (size_t*)calloc(spec->image_count + 1, sizeof(size_t));
+    if (!file->image_formats || !file->image_sizes)
+    {
+        corpus_free(file);
+        return 0;
+    }
+
+    size_t workbook_size;
+    uint8_t* workbook = build_workbook(spec, file, &workbook_size);
+    if (!workbook)
+    {
+        corpus_free(file);
+        return 0;
+    }
+    file->workbook_size = workbook_size;
+
+    // sector 0 holds the directory, then the FAT, the DIFAT and the workbook
+    size_t sector_size = spec->version == 3 ? 512 : 4096;
+    size_t per_sector = sector_size / 4;
+    size_t data_sectors = (workbook_size + sector_size - 1) / sector_size;
+    size_t fat_sectors = 1, difat_sectors = 0;
+    for (;;)
+    {
+        size_t needed = fat_sectors;
+        size_t total = 1 + fat_sectors + difat_sectors + gap_sectors + data_sectors;
+        if (needed < (total + per_sector - 1) / per_sector)
+            needed = (total + per_sector - 1) / per_sector;
+        if (spec->difat_depth > 0 && needed < CFB_HEADER_DIFAT + (spec->difat_depth - 1) * (per_sector - 1) + 1)
+            needed = CFB_HEADER_DIFAT + (spec->difat_depth - 1) * (per_sector - 1) + 1;
+
+        size_t difat_needed = needed > CFB_HEADER_DIFAT ? (needed - CFB_HEADER_DIFAT + per_sector - 2) / (per_sector - 1) : 0;
+        if (needed == fat_sectors && difat_needed == difat_sectors)
+            break;
+        fat_sectors = needed;
+        difat_sectors = difat_needed;
+    }
+
+    // sector numbers from 0xFFFFFFFA on are reserved
+    size_t total_sectors = 1 + fat_sectors + difat_sectors + gap_sectors + data_sectors;
+    if (total_sectors >= 0xFFFFFFFA)
+    {
+        free(workbook);
+        corpus_free(file);
+        return 0;
+    }
+    file->head_size = sector_size * (2 + fat_sectors + difat_sectors);
+    file->gap_size = (uint64_t)gap_sectors * sector_size;
+    file->size = sector_size * (1 + total_sectors - gap_sectors);
+    file->data = (uint8_t*)calloc(1, file->size);
+    uint32_t* chain = (uint32_t*)malloc((data_sectors + 1) * sizeof(uint32_t));
+    uint32_t* fat = (uint32_t*)malloc(fat_sectors * per_sector * sizeof(uint32_t));
+    if (!file->data || !chain || !fat)
+    {
+        free(workbook);
+        free(chain);
+        free(fat);
+        corpus_free(file);
+        return 0;
+    }
+
+    // physical sector of each logical workbook sector, shuffled by the fragmentation level
+    uint32_t state = (spec->seed ? spec->seed : 1) ^ 0x85EBCA6Bu;
+    size_t data_start = 1 + fat_sectors + difat_sectors + gap_sectors;
+    for (size_t i = 0; i < data_sectors; i++)
+        chain[i] = (uint32_t)(data_start + i);
+    for (size_t i = 0; i < data_sectors; i++)
+    {
+        if ((int)(corpus_rand(&state) % 100) < spec->fragmentation)
+        {
+            size_t j = corpus_rand(&state) % data_sectors;
+            uint32_t t = chain[i];
+            chain[i] = chain[j];
+            chain[j] = t;
+        }
+    }
+
+    for (size_t i = 0; i < fat_sectors * per_sector; i++)
+        fat[i] = CFB_FREESECT;
+    fat[0] = CFB_ENDOFCHAIN;
+    for (size_t i = 0; i < fat_sectors; i++)
+        fat[1 + i] = CFB_FATSECT;
+    for (size_t i = 0; i < difat_sectors; i++)
+        fat[1 + fat_sectors + i] = CFB_DIFSECT;
+    for (size_t i = 0; i < data_sectors; i++)
+        fat[chain[i]] = i + 1 < data_sectors ? chain[i + 1] : CFB_ENDOFCHAIN;
+
+    uint8_t* base = file->data + sector_size;
+    for (size_t i = 0; i < fat_sectors * per_sector; i++)
+        store_u32(base + (1 * sector_size) + i * 4, fat[i]);
+
+    for (size_t i = 0; i < data_sectors; i++)
+    {
+        size_t len = workbook_size - i * sector_size < sector_size ? workbook_size - i * sector_size : sector_size;
+        memcpy(base + (chain[i] - gap_sectors) * sector_size, workbook + i * sector_size, len);
+    }
+
+    // directory: the root and the Workbook stream, the remaining slots are empty
+    for (size_t i = 0; i < sector_size / CFB_ENTRY_SIZE; i++)
+    {
+        uint8_t* entry = base + i * CFB_ENTRY_SIZE;
+        store_u32(entry + 68, CFB_FREESECT);
+        store_u32(entry + 72, CFB_FREESECT);
+        store_u32(entry + 76, CFB_FREESECT);
+    }
+    cfb_write_entry(base, "Root Entry", 5, 1, CFB_ENDOFCHAIN, 0);
+    cfb_write_entry(base + CFB_ENTRY_SIZE, "Workbook", 2, CFB_FREESECT, chain[0], workbook_size);
+
+    // header
+    uint8_t* h = file->data;
+    static const uint8_t signature[8] = { 0xD0, 0xCF, 0x11, 0xE0, 0xA1, 0xB1, 0x1A, 0xE1 };
+    memcpy(h, signature, 8);
+    store_u16(h + 24, 0x003E);
+    store_u16(h + 26, (uint16_t)spec->version);
+    store_u16(h + 28, 0xFFFE);
+    store_u16(h + 30, spec->version == 3 ? 9 : 12);
+    store_u16(h + 32, 6);
+    store_u32(h + 40, spec->version == 3 ? 0 : 1);
+    store_u32(h + 44, (uint32_t)fat_sectors);
+    store_u32(h + 48, 0);
+    store_u32(h + 56, CFB_MINI_STREAM_CUTOFF);
+    store_u32(h + 60, CFB_ENDOFCHAIN);
+    store_u32(h + 64, 0);
+    store_u32(h + 68, difat_sectors ? (uint32_t)(1 + fat_sectors) : CFB_ENDOFCHAIN);
+    store_u32(h + 72, (uint32_t)difat_sectors);
+    for (size_t i = 0; i < CFB_HEADER_DIFAT; i++)
+        store_u32(h + 76 + i * 4, i < fat_sectors ? (uint32_t)(1 + i) : CFB_FREESECT);
+
+    // DIFAT sectors: per_sector - 1 FAT locations and the next DIFAT sector
+    size_t next_fat = CFB_HEADER_DIFAT;
+    for (size_t i = 0; i < difat_sectors; i++)
+    {
+        uint8_t* p = base + (1 + fat_sectors + i) * sector_size;
+        for (size_t k = 0; k < per_sector - 1; k++, next_fat++)
+            store_u32(p + k * 4, next_fat < fat_sectors ? (uint32_t)(1 + next_fat) : CFB_FREESECT);
+        store_u32(p + (per_sector - 1) * 4, i + 1 < difat_sectors ? (uint32_t)(1 + fat_sectors + i + 1) : CFB_ENDOFCHAIN);
+    }
+
+    free(workbook);
+    free(chain);
+    free(fat);
+    return 1;
+}
+
+int corpus_generate(const CORPUS_SPEC* spec, CORPUS_FILE* file)
+{
+    return corpus_build(spec, 0, file);
+}
+
+int corpus_generate_sparse(const CORPUS_SPEC* spec, uint64_t gap, CORPUS_FILE* file)
+{
+    uint64_t sector_size = spec->version == 3 ? 512 : 4096;
+    uint64_t gap_sectors = (gap + sector_size - 1) / sector_size;
+    if (gap_sectors >= 0xFFFFFFFA || gap_sectors > SIZE_MAX)
+    {
+        memset(file, 0, sizeof(*file));
+        return 0;
+    }
+    return corpus_build(spec, (size_t)gap_sectors, file);
+}
+
+void corpus_free(CORPUS_FILE* file)
+{
+    free(file->data);
+    free(file->image_formats);
+    free(file->image_sizes);
+    memset(file, 0, sizeof(*file));
+}
@@ -0,0 +1,104 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef XLS2IMG_CORPUS_H
+#define XLS2IMG_CORPUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Shape of a synthetic compound file
+ */
+typedef struct {
+    int version;                /* 3 (512-byte sectors) or 4 (4096-byte sectors) */
+    int fragmentation;          /* percentage of workbook sectors moved out of chain order */
+    int difat_depth;            /* number of DIFAT sectors, padding the FAT as needed */
+    size_t workbook_size;       /* minimum workbook stream size, filler records make up the difference */
+    int image_count;
+    size_t image_size;          /* average image size, actual sizes vary by +-50% */
+    int png_percent;            /* share of PNG images, the rest are JPEG */
+    size_t continue_size;       /* largest record payload before CONTINUE records take over (at most 8224) */
+    uint32_t seed;
+} CORPUS_SPEC;
+
+/**
+ * @brief A generated compound file and the images it should yield
+ * @details The file is data[0, head_size), gap_size zero bytes, then data[head_size, size); only
+ *          corpus_generate_sparse leaves a gap.
+ */
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t head_size;
+    uint64_t gap_size;          /* free sectors between the DIFAT and the workbook stream */
+    size_t workbook_size;
+    int image_count;
+    int* image_formats;         /* XLS2IMG_FORMAT of each image, in stream order */
+    size_t* image_sizes;
+} CORPUS_FILE;
+
+/**
+ * @brief Fills a spec with the defaults: v3, no fragmentation, 8 mixed images of 64 KiB
+ */
+void corpus_default_spec(CORPUS_SPEC* spec);
+
+/**
+ * @brief Generates a compound file with a Workbook stream holding a MsoDrawingGroup of images
+ * @return 1 on success, 0 on an invalid spec or allocation failure
+ */
+int corpus_generate(const CORPUS_SPEC* spec, CORPUS_FILE* file);
+
+/**
+ * @brief Generates a compound file whose workbook stream lies behind gap bytes (rounded up to whole sectors) of free
+ *        sectors, for files larger than memory: the gap is never generated and can be written as a hole
+ * @return 1 on success, 0 on an invalid spec, a gap beyond the sector numbers or allocation failure
+ */
+int corpus_generate_sparse(const CORPUS_SPEC* spec, uint64_t gap, CORPUS_FILE* file);
+
+/**
+ * @brief Frees a generated file
+ */
+void corpus_free(CORPUS_FILE* file);
+
+/**
+ * @brief Fills a buffer with deterministic pseudo-random bytes that contain no 0xFF
+ * @details Without 0xFF bytes the data can hold neither a JPEG marker nor a false image end.
+ */
+void corpus_fill_random(uint8_t* data, size_t size, uint32_t* state);
+
+/**
+ * @brief Writes a PNG of exactly size bytes (at least 57), split into IDAT chunks of at most chunk_size bytes
+ */
+void corpus_write_png(uint8_t* out, size_t size, size_t chunk_size, uint32_t* state);
+
+/**
+ * @brief Writes a JFIF JPEG of exactly size bytes (at least 45)
+ */
+void corpus_write_jpg(uint8_t* out, size_t size, uint32_t* state);
+
+#endif /* XLS2IMG_CORPUS_H */
@@ -40,18 +40,19 @@ static int read_file(const wchar_t* filepath, unsigned char** buffer, size_t* si
         return 0;
     }
 
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    // ftell's long is 32 bits on Windows, the 64-bit variants also size workbooks over 2 GiB
+    _fseeki64(fp, 0, SEEK_END);
+    long long file_size = _ftelli64(fp);
+    _fseeki64(fp, 0, SEEK_SET);
 
-    if (file_size <= 0)
+    if (file_size <= 0 || (unsigned long long)file_size > SIZE_MAX)
     {
         fclose(fp);
         fwprintf(stderr, L"Error: File size is zero or invalid\n");
         return 0;
     }
 
-    *buffer = (unsigned char*)malloc(file_size);
+    *buffer = (unsigned char*)malloc((size_t)file_size);
     if (!*buffer)
     {
         fclose(fp);
@@ -59,7 +60,7 @@ static int read_file(const wchar_t* filepath, unsigned char** buffer, size_t* si
         return 0;
     }
 
-    size_t bytes_read = fread(*buffer, 1, file_size, fp);
+    size_t bytes_read = fread(*buffer, 1, (size_t)file_size, fp);
     fclose(fp);
 
     if (bytes_read != (size_t)file_size)
@@ -139,13 +140,13 @@ int main()
         for (int i = 0; i < images.count; i++)
         {
             const XLS2IMG_IMAGE* img = &images.images[i];
-            const char* format_str = (img->format == XLS2IMG_PNG) ? "PNG" : "JPEG";
+            const char* format_str = xls2img_format_extension(img->format);
 
             printf("Image %d: Format=%s, Size=%zu bytes\n", i + 1, format_str, img->size);
 
             // Generate filename
             char filename[256];
-            snprintf(filename, sizeof(filename), "image_%d.%s", i + 1, (img->format == XLS2IMG_PNG) ? "png" : "jpg");
+            snprintf(filename, sizeof(filename), "image_%d.%s", i + 1, format_str);
 
             // Save image
             if (save_image(filename, img->data, img->size))
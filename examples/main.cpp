@@ -30,7 +30,7 @@
 #include <memory>
 #include <windows.h>
 #include <string>
-#include <xls2img.h>
+#include <xls2img.hpp>
 
 static bool read_file(const wchar_t* filepath, std::unique_ptr<unsigned char[]>& buffer, size_t& size) {
     FILE* fp = _wfopen(filepath, L"rb");
@@ -40,19 +40,20 @@ static bool read_file(const wchar_t* filepath, std::unique_ptr<unsigned char[]>&
         return false;
     }
 
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    // ftell's long is 32 bits on Windows, the 64-bit variants also size workbooks over 2 GiB
+    _fseeki64(fp, 0, SEEK_END);
+    long long file_size = _ftelli64(fp);
+    _fseeki64(fp, 0, SEEK_SET);
 
-    if (file_size <= 0)
+    if (file_size <= 0 || static_cast<unsigned long long>(file_size) > SIZE_MAX)
     {
         fclose(fp);
         std::wcerr << L"Error: File size is zero or invalid" << std::endl;
         return false;
     }
 
-    buffer = std::make_unique<unsigned char[]>(file_size);
-    size_t bytes_read = fread(buffer.get(), 1, file_size, fp);
+    buffer = std::make_unique<unsigned char[]>(static_cast<size_t>(file_size));
+    size_t bytes_read = fread(buffer.get(), 1, static_cast<size_t>(file_size), fp);
     fclose(fp);
 
     if (bytes_read != static_cast<size_t>(file_size))
@@ -90,59 +91,44 @@ int main()
     if (!read_file(filepath, file_buffer, file_size))
         return -1;
 
-    // Initialize xls2img reader
-    XLS2IMG_READER* reader = nullptr;
-    int ret = xls2img_open(&reader, file_buffer.get(), file_size);
-    if (ret != XLS2IMG_SUCCESS)
+    // Initialize xls2img reader; the wrapper types close and free what they own
+    auto reader = xls2img::Reader::open(file_buffer.get(), file_size);
+    if (!reader)
     {
-        std::cerr << "Initialization failed: " << xls2img_strerror(ret) << std::endl;
+        std::cerr << "Initialization failed: " << reader.error().message() << std::endl;
         return -1;
     }
 
     // Extract workbook stream
-    void* workbook_data = nullptr;
-    size_t workbook_size = 0;
-
-    ret = xls2img_get_workbook(reader, &workbook_data, &workbook_size);
-    if (ret != XLS2IMG_SUCCESS)
+    auto workbook = reader->workbook();
+    if (!workbook)
     {
-        std::cerr << "Failed to extract workbook: " << xls2img_strerror(ret) << std::endl;
-        xls2img_close(reader);
+        std::cerr << "Failed to extract workbook: " << workbook.error().message() << std::endl;
         return -1;
     }
 
-    // Extract images
-    XLS2IMG_RESULT images = { nullptr, 0 };
-    ret = xls2img_extract_images(workbook_data, workbook_size, &images);
-
-    // Process results
-    if (ret > 0)
+    // Extract images one at a time
+    int count = 0;
+    auto images = workbook->image_range();
+    for (const xls2img::Image& img : images)
     {
-        std::cout << "Extracted " << images.count << " images" << std::endl;
-
-        for (int i = 0; i < images.count; ++i)
-        {
-            const XLS2IMG_IMAGE& img = images.images[i];
-            const char* format_str = (img.format == XLS2IMG_PNG) ? "PNG" : "JPEG";
+        const char* format_str = xls2img_format_extension(img.format);
+        ++count;
 
-            std::cout << "Image " << (i + 1) << ": Format=" << format_str << ", Size=" << img.size << " bytes" << std::endl;
+        std::cout << "Image " << count << ": Format=" << format_str << ", Size=" << img.data.size() << " bytes" << std::endl;
 
-            std::string filename = "image_" + std::to_string(i + 1) + ((img.format == XLS2IMG_PNG) ? ".png" : ".jpg");
+        std::string filename = "image_" + std::to_string(count) + "." + format_str;
 
-            if (save_image(filename.c_str(), img.data, img.size))
-                std::cout << "  -> Saved to: " << filename << std::endl;
-            else
-                std::cerr << "  -> Failed to save: " << filename << std::endl;
-        }
-
-        xls2img_free_result(&images);
+        if (save_image(filename.c_str(), img.data.data(), img.data.size()))
+            std::cout << "  -> Saved to: " << filename << std::endl;
+        else
+            std::cerr << "  -> Failed to save: " << filename << std::endl;
     }
-    else
-        std::cerr << "Failed to extract images: " << xls2img_strerror(ret) << std::endl;
 
-    // Cleanup
-    xls2img_free_workbook_data(workbook_data);
-    xls2img_close(reader);
+    if (images.status() > 0)
+        std::cout << "Extracted " << count << " images" << std::endl;
+    else
+        std::cerr << "Failed to extract images: " << xls2img_strerror(images.status()) << std::endl;
 
     std::cout << "Image extraction completed." << std::endl;
     return 0;
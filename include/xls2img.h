@@ -58,6 +58,11 @@ extern "C" {
 #define XLS2IMG_ERROR_NO_WORKBOOK -4
 #define XLS2IMG_ERROR_NO_IMAGES -5
 #define XLS2IMG_ERROR_OUT_OF_MEMORY -6
+#define XLS2IMG_ERROR_UNSUPPORTED -7
+#define XLS2IMG_ERROR_CHAIN_CYCLE -8
+#define XLS2IMG_ERROR_LIMIT_EXCEEDED -9
+#define XLS2IMG_ERROR_CANCELLED -10
+#define XLS2IMG_ERROR_TIMEOUT -11
 
     /**
      * @brief Image format enumeration
@@ -66,8 +71,39 @@ extern "C" {
         XLS2IMG_UNKNOWN = 0,  /* Unknown format */
         XLS2IMG_PNG = 1,      /* PNG format */
         XLS2IMG_JPG = 2,      /* JPG/JPEG format */
+        XLS2IMG_GIF = 3,      /* GIF format */
+        XLS2IMG_BMP = 4,      /* BMP format, DIB blips get a synthesized BITMAPFILEHEADER */
+        XLS2IMG_TIFF = 5,     /* TIFF format */
+        XLS2IMG_EMF = 6,      /* Enhanced metafile, uncompressed blips only */
+        XLS2IMG_WMF = 7,      /* Windows metafile, uncompressed blips only */
     } XLS2IMG_FORMAT;
 
+    /**
+     * @brief Bit of a format in a format mask, see XLS2IMG_EXTRACT_OPTIONS.formats
+     */
+#define XLS2IMG_FORMAT_MASK(format) (1u << (format))
+#define XLS2IMG_FORMATS_ALL (XLS2IMG_FORMAT_MASK(XLS2IMG_PNG) | XLS2IMG_FORMAT_MASK(XLS2IMG_JPG) | \
+    XLS2IMG_FORMAT_MASK(XLS2IMG_GIF) | XLS2IMG_FORMAT_MASK(XLS2IMG_BMP) | XLS2IMG_FORMAT_MASK(XLS2IMG_TIFF) | \
+    XLS2IMG_FORMAT_MASK(XLS2IMG_EMF) | XLS2IMG_FORMAT_MASK(XLS2IMG_WMF))
+
+    /**
+     * @brief Bits of XLS2IMG_IMAGE.check, see XLS2IMG_EXTRACT_OPTIONS.verify
+     * @details An image was found valid if check is XLS2IMG_CHECK_VERIFIED alone.
+     */
+#define XLS2IMG_CHECK_VERIFIED 0x1u         /* the format has a check (PNG, JPEG) and it ran */
+#define XLS2IMG_CHECK_BAD_CRC 0x2u          /* a PNG chunk CRC does not match the chunk */
+#define XLS2IMG_CHECK_BAD_STRUCTURE 0x4u    /* PNG chunks or JPEG marker segments are truncated, out of order or do not reach the end marker */
+
+    /**
+     * @brief Container format of the file data, detected by xls2img_open
+     */
+    typedef enum {
+        XLS2IMG_CONTAINER_CFB = 0,    /* XLS compound file, or a compound file without a known document stream */
+        XLS2IMG_CONTAINER_OOXML = 1,  /* XLSX or XLSM ZIP package */
+        XLS2IMG_CONTAINER_DOC = 2,    /* Word 97-2003 compound file, with a WordDocument stream */
+        XLS2IMG_CONTAINER_PPT = 3,    /* PowerPoint 97-2003 compound file, with a PowerPoint Document stream */
+    } XLS2IMG_CONTAINER;
+
     /**
      * @brief Image information structure
      */
@@ -75,6 +111,12 @@ extern "C" {
         XLS2IMG_FORMAT format;  /* Image format */
         size_t size;            /* Image data size */
         void* data;             /* Image data pointer */
+        size_t offset;          /* Offset of the first image byte in the workbook stream (the picture stream of a DOC or PPT file), or of the stored entry data in an OOXML package */
+        size_t span;            /* Length of the workbook stream range holding the image, larger than size when record headers interrupt it */
+        const void* prefix;     /* Bytes that precede data in the image file, such as the BITMAPFILEHEADER of a DIB; NULL in results, which copy them into data */
+        size_t prefix_size;     /* Size of prefix */
+        const char* path;       /* Container path of an image found in an embedded object, such as "MBD0012ABCD" or "ObjectPool/_1234/MBD0001", NULL for an image of the file itself */
+        unsigned int check;     /* XLS2IMG_CHECK_* bits, 0 unless XLS2IMG_EXTRACT_OPTIONS.verify is set */
     } XLS2IMG_IMAGE;
 
     /**
@@ -85,11 +127,272 @@ extern "C" {
         int count;              /* Number of images */
     } XLS2IMG_RESULT;
 
+    /**
+     * @brief Byte range of the XLS file data
+     */
+    typedef struct {
+        size_t offset;          /* Offset in the buffer passed to xls2img_open */
+        size_t size;            /* Range length */
+    } XLS2IMG_EXTENT;
+
+    /**
+     * @brief Work counters and phase timers, filled in when the library is built with XLS2IMG_STATS
+     * @details Counters accumulate, so zero the struct before the calls it should cover.
+     */
+    typedef struct {
+        uint64_t sectors_visited;       /* sectors and mini sectors whose data was copied */
+        uint64_t fat_lookups;           /* FAT entries read while following chains */
+        uint64_t minifat_lookups;       /* MiniFAT entries read while following mini chains */
+        uint64_t bytes_copied;          /* bytes copied into the workbook, the drawing group and the images */
+        uint64_t records_walked;        /* BIFF records visited */
+        uint64_t continue_segments;     /* CONTINUE records appended to the drawing group */
+        uint64_t headers_found;         /* candidate image headers found by the signature scan */
+        uint64_t headers_rejected;      /* candidates without a valid image end */
+        uint64_t allocations;           /* malloc and realloc calls */
+        uint64_t bytes_allocated;       /* total bytes requested, growth only for realloc */
+        uint64_t live_bytes;            /* bytes held by the library's buffers, including returned results */
+        uint64_t peak_bytes;            /* highest live_bytes */
+        uint64_t workbook_ns;           /* xls2img_get_workbook: directory lookup and sector chain copy */
+        uint64_t scan_ns;               /* signature scan and image end search in the drawing group */
+        uint64_t extract_ns;            /* xls2img_extract_images_stats as a whole, scan_ns included */
+    } XLS2IMG_STATS;
+
+    /**
+     * @brief Work limits for untrusted input, a zero field means no limit
+     * @details Exceeding a limit aborts the call with XLS2IMG_ERROR_LIMIT_EXCEEDED.
+     */
+    typedef struct {
+        uint64_t max_sectors;           /* sectors or mini sectors of the workbook stream */
+        uint64_t max_bytes;             /* workbook stream size, or size of each OOXML media entry */
+        uint64_t max_records;           /* BIFF records walked */
+        uint64_t max_images;            /* images extracted */
+        uint64_t max_output_bytes;      /* total size of the extracted images */
+    } XLS2IMG_LIMITS;
+
+    /**
+     * @brief Trace event types, recorded when the library is built with XLS2IMG_TRACE
+     */
+    typedef enum {
+        XLS2IMG_EVENT_SECTOR_READ = 1,          /* kind: 0 sector, 1 mini sector; offset/size: file range copied */
+        XLS2IMG_EVENT_FAT_LOOKUP = 2,           /* kind: 0 FAT, 1 MiniFAT; offset: sector; size: next sector */
+        XLS2IMG_EVENT_RECORD = 3,               /* kind: BIFF record type; offset: record header in the workbook; size: payload */
+        XLS2IMG_EVENT_DRAWING_GROUP_START = 4,  /* offset: MsoDrawingGroup record in the workbook */
+        XLS2IMG_EVENT_DRAWING_GROUP_END = 5,    /* offset: first record after the group; size: collected bytes */
+        XLS2IMG_EVENT_HEADER = 6,               /* kind: XLS2IMG_FORMAT; offset: candidate header in the workbook */
+        XLS2IMG_EVENT_IMAGE_ACCEPTED = 7,       /* kind: XLS2IMG_FORMAT; offset/size: image in the workbook */
+        XLS2IMG_EVENT_IMAGE_REJECTED = 8,       /* kind: XLS2IMG_FORMAT; offset: header without a valid image end */
+        XLS2IMG_EVENT_ALLOC = 9,                /* kind: 0 malloc, 1 realloc, 2 free; offset: old size; size: new size */
+    } XLS2IMG_EVENT_TYPE;
+
+    /**
+     * @brief One trace event
+     */
+    typedef struct {
+        uint64_t time_ns;       /* monotonic xls2img_clock_ns time, nanoseconds from an unspecified start */
+        uint16_t type;          /* XLS2IMG_EVENT_TYPE */
+        uint16_t reserved;
+        uint32_t kind;          /* type specific, see XLS2IMG_EVENT_TYPE */
+        uint64_t offset;
+        uint64_t size;
+    } XLS2IMG_EVENT;
+
+    /**
+     * @brief Receives a batch of trace events in the order they were recorded
+     */
+    typedef void (*XLS2IMG_TRACE_FUNC)(const XLS2IMG_EVENT* events, size_t count, void* user);
+
+    /**
+     * @brief Ring buffer of trace events, owned by the caller
+     * @details Zero it, then set events and capacity. With flush set, a full buffer is handed to flush as one
+     *          batch and emptied; without it the oldest events are overwritten and counted in dropped. Pending
+     *          events are events[(head + i) % capacity] for i < count, or are delivered by xls2img_trace_flush.
+     */
+    typedef struct {
+        XLS2IMG_EVENT* events;
+        size_t capacity;
+        size_t head;
+        size_t count;
+        uint64_t dropped;
+        XLS2IMG_TRACE_FUNC flush;
+        void* user;
+    } XLS2IMG_TRACE;
+
+    /**
+     * @brief Allocator used for the reader, its tables, workbook data and extraction results
+     * @details Set alloc and free together, or leave all three function pointers NULL to use malloc, realloc and
+     *          free and only count. realloc may be NULL, a block is then moved with alloc, a copy and free.
+     *          Frees and reallocs receive the size that was allocated. The library updates current_bytes and
+     *          peak_bytes without synchronization; share one allocator between threads only if they never
+     *          allocate concurrently, or ignore the counters.
+     */
+    typedef struct {
+        void* (*alloc)(size_t size, void* user);
+        void* (*realloc)(void* ptr, size_t old_size, size_t new_size, void* user);
+        void (*free)(void* ptr, size_t size, void* user);
+        void* user;
+        size_t current_bytes;           /* bytes currently allocated through this allocator */
+        size_t peak_bytes;              /* highest current_bytes */
+    } XLS2IMG_ALLOCATOR;
+
+    /**
+     * @brief Receives the progress of a long read: done of total bytes of the stream or package being read
+     * @details total is 0 when the size is not known up front, as for data pushed into a parser.
+     */
+    typedef void (*XLS2IMG_PROGRESS_FUNC)(uint64_t done, uint64_t total, void* user);
+
+    /**
+     * @brief Cancellation flag, deadline and progress callback of a read, owned by the caller
+     * @details Zero it, then set deadline_ns and progress as needed. The library polls it before the first byte and
+     *          about every XLS2IMG_CONTROL_INTERVAL bytes of the sector copy, the BIFF record walk and the package
+     *          entries; a set flag ends the call with XLS2IMG_ERROR_CANCELLED and a passed deadline with
+     *          XLS2IMG_ERROR_TIMEOUT, after every buffer of the call is released. progress runs on the reading thread.
+     */
+    typedef struct {
+        volatile long cancelled;        /* set through xls2img_cancel, from any thread */
+        uint64_t deadline_ns;           /* absolute time on the monotonic xls2img_clock_ns clock, 0 for none */
+        XLS2IMG_PROGRESS_FUNC progress; /* called at each poll, NULL for none */
+        void* user;                     /* passed to progress */
+    } XLS2IMG_CONTROL;
+
+#define XLS2IMG_CONTROL_INTERVAL ((size_t)1 << 20)
+
+    /**
+     * @brief Optional inputs of xls2img_extract_images_ex and xls2img_cursor_open, NULL members are unused
+     */
+    typedef struct {
+        const XLS2IMG_LIMITS* limits;   /* work limits */
+        XLS2IMG_STATS* stats;           /* counters to update */
+        XLS2IMG_TRACE* trace;           /* event ring buffer */
+        XLS2IMG_ALLOCATOR* allocator;   /* allocator for the result and working buffers, NULL for malloc */
+        unsigned int formats;           /* XLS2IMG_FORMAT_MASK bits of the formats to extract, 0 for all */
+        unsigned int embedded_depth;    /* levels of embedded objects xls2img_read_images and xls2img_stream_images descend into, 0 for none */
+        int verify;                     /* nonzero to check PNG chunk CRCs and JPEG marker segments and report them in XLS2IMG_IMAGE.check; results are checked while they are copied */
+        XLS2IMG_CONTROL* control;       /* cancellation, deadline and progress */
+    } XLS2IMG_EXTRACT_OPTIONS;
+
+    /**
+     * @brief Incremental image extractor fed with chunks of the workbook stream
+     */
+    typedef struct XLS2IMG_PARSER XLS2IMG_PARSER;
+
+    /**
+     * @brief Receives an image completed by a push parser
+     * @details image->data and image->prefix point into the parser's buffers and are only valid during the call. The
+     *          image file is prefix followed by data; data alone is the image as stored in the workbook.
+     * @param[in] image The image, with its offset and span in the workbook stream
+     * @param[in] user The user pointer passed to xls2img_parser_open
+     * @return XLS2IMG_SUCCESS to continue, any other value stops the parser and is returned by the feed or finish call
+     */
+    typedef int (*XLS2IMG_IMAGE_FUNC)(const XLS2IMG_IMAGE* image, void* user);
+
     /**
      * @brief XLS file reader context
+     * @details Every index of a reader is built by the open, after which it is never modified: any number of threads
+     *          may read through one reader with their own cursors, without locking. xls2img_set_stats, xls2img_set_trace
+     *          and xls2img_set_limits configure it and must not run while other threads use it. The reader-level read
+     *          functions may also run concurrently as long as no stats or trace is attached and the reader's allocator
+     *          is safe to call from several threads.
      */
     typedef struct XLS2IMG_READER XLS2IMG_READER;
 
+    /**
+     * @brief Read position and per-thread state over a shared reader
+     * @details Holds the sector chain position, the cycle detection bitmap and the limits, stats, trace and allocator
+     *          of its reads. A cursor belongs to one thread at a time. Reads at increasing offsets continue the chain
+     *          walk where the previous read stopped.
+     */
+    typedef struct XLS2IMG_CURSOR XLS2IMG_CURSOR;
+
+    /**
+     * @brief Releases a buffer handed over with xls2img_open_owned
+     * @param[in] buffer The buffer passed to xls2img_open_owned
+     * @param[in] user The user pointer passed to xls2img_open_owned
+     */
+    typedef void (*XLS2IMG_RELEASE_FUNC)(void* buffer, void* user);
+
+    /**
+     * @brief Buffer cache for extracting file after file on one thread
+     * @details A session is an allocator that keeps the blocks freed through it and hands them out again: readers,
+     *          their FAT and directory tables, workbook data, drawing group buffers and results. Once a worker has
+     *          processed a file like the next one, opening and extracting it allocates nothing from the heap. A
+     *          session is not thread-safe; give each worker its own.
+     */
+    typedef struct XLS2IMG_SESSION XLS2IMG_SESSION;
+
+    /**
+     * @brief Image index of a file, opened over the bytes of an .x2i index written by xls2img_index_build
+     * @details The index records where the images of a file lie in it, so one image can be copied out of the file
+     *          without opening a reader. It is never modified once opened and may be shared between threads.
+     */
+    typedef struct XLS2IMG_INDEX XLS2IMG_INDEX;
+
+    /**
+     * @brief Identity of the file an index was built from, see xls2img_index_get_info
+     */
+    typedef struct {
+        uint64_t file_size;             /* size of the file */
+        uint64_t mtime;                 /* modification time passed to xls2img_index_build, in the caller's units */
+        uint64_t file_hash;             /* 64-bit FNV-1a of the whole file */
+        XLS2IMG_CONTAINER container;    /* container format of the file */
+        int image_count;                /* images recorded */
+        uint64_t stream_size;           /* size of the workbook stream, or of the Pictures stream of a PPT file */
+        int stream_extent_count;        /* byte ranges of the file holding that stream, see xls2img_index_get_stream_extents */
+    } XLS2IMG_INDEX_INFO;
+
+    /**
+     * @brief One image recorded in an index, see xls2img_index_get_image
+     */
+    typedef struct {
+        XLS2IMG_FORMAT format;  /* Image format */
+        size_t size;            /* Image data size, without the prefix */
+        size_t offset;          /* XLS2IMG_IMAGE offset of the image */
+        const void* prefix;     /* Bytes that precede the data in the image file, pointing into the index; NULL if none */
+        size_t prefix_size;     /* Size of prefix */
+        int extent_count;       /* Byte ranges of the file holding the data, 0 if the image cannot be located in it */
+        int deflated;           /* The single extent holds the image as a raw DEFLATE stream, as an OOXML entry does */
+    } XLS2IMG_INDEX_IMAGE;
+
+    /**
+     * @brief Grows the memory an export is written to, typically a shared memory mapping
+     * @param[in] base Memory returned by the previous call, NULL on the first call
+     * @param[in] size Bytes needed, more than in the previous call
+     * @param[in] user The user pointer passed to xls2img_export_images
+     * @return Memory of at least size bytes starting with the contents of base, NULL on failure
+     */
+    typedef void* (*XLS2IMG_EXPORT_FUNC)(void* base, size_t size, void* user);
+
+#define XLS2IMG_EXPORT_MAGIC 0x45493258u    /* "X2IE" read as a little-endian uint32 */
+#define XLS2IMG_EXPORT_VERSION 1
+#define XLS2IMG_EXPORT_ALIGN 64             /* alignment of the image files in an export */
+
+    /**
+     * @brief Start of an export written by xls2img_export_images
+     * @details The header is followed by the image files, each at a multiple of XLS2IMG_EXPORT_ALIGN, and then by
+     *          the table of count XLS2IMG_EXPORT_ENTRY at table_offset, 8-byte aligned. Fields are in the byte order of
+     *          the writing machine, as an export is handed to another process on the same machine.
+     */
+    typedef struct {
+        uint32_t magic;         /* XLS2IMG_EXPORT_MAGIC */
+        uint32_t version;       /* XLS2IMG_EXPORT_VERSION */
+        uint32_t count;         /* entries in the table */
+        uint32_t entry_size;    /* sizeof(XLS2IMG_EXPORT_ENTRY); later versions may append fields */
+        uint64_t table_offset;  /* offset of the table from the start of the export */
+        uint64_t size;          /* bytes of the export */
+    } XLS2IMG_EXPORT_HEADER;
+
+    /**
+     * @brief One image of an export, in the order xls2img_stream_images delivers them
+     */
+    typedef struct {
+        uint64_t offset;        /* offset of the image file from the start of the export */
+        uint64_t size;          /* size of the image file, prefix included */
+        uint64_t source_offset; /* XLS2IMG_IMAGE offset of the image */
+        uint32_t format;        /* XLS2IMG_FORMAT */
+        uint32_t hash;          /* CRC-32 of the image file, the one zlib's crc32 computes */
+        uint32_t check;         /* XLS2IMG_CHECK_* bits, 0 unless XLS2IMG_EXTRACT_OPTIONS.verify is set */
+        uint32_t reserved;
+    } XLS2IMG_EXPORT_ENTRY;
+
     /**
      * @brief Get error message from error code
      * @param[in] error_code Error code returned by xls2img functions
@@ -99,6 +402,10 @@ extern "C" {
 
     /**
      * @brief Create a reader for XLS file data
+     * @details An XLSX or XLSM package, recognized by its first bytes, is opened instead through its ZIP central
+     *          directory; only its xl/media entries are indexed and it has no workbook stream, see xls2img_read_images.
+     *          A compound file without a Workbook stream but with a PowerPoint Document or WordDocument stream is
+     *          opened as a presentation or Word document, which have no workbook stream either.
      * @param[out] reader Returns the created reader pointer
      * @param[in] buffer XLS file data buffer
      * @param[in] len buffer size
@@ -106,14 +413,150 @@ extern "C" {
      */
     XLS2IMG_API int xls2img_open(XLS2IMG_READER** reader, const void* buffer, size_t len);
 
+    /**
+     * @brief Create a reader whose allocations go through a caller-supplied allocator
+     * @details The allocator is used for the reader itself and for the data returned by xls2img_get_workbook,
+     *          which xls2img_free_workbook_data releases through it. It must outlive the reader and that data.
+     * @param[out] reader Returns the created reader pointer
+     * @param[in] buffer XLS file data buffer
+     * @param[in] len buffer size
+     * @param[in,out] allocator Allocator and byte counters, NULL for malloc
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_open_ex(XLS2IMG_READER** reader, const void* buffer, size_t len, XLS2IMG_ALLOCATOR* allocator);
+
+    /**
+     * @brief Create a reader that takes ownership of the XLS file data buffer
+     * @details The buffer is not copied. On success the reader owns it and calls release(buffer, user)
+     *          from xls2img_close, so the caller must not free or modify it afterwards.
+     *          On failure ownership stays with the caller.
+     * @param[out] reader Returns the created reader pointer
+     * @param[in] buffer XLS file data buffer
+     * @param[in] len buffer size
+     * @param[in] release Function releasing the buffer, allocated by the caller's own allocator
+     * @param[in] user User pointer passed to release
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_open_owned(XLS2IMG_READER** reader, void* buffer, size_t len, XLS2IMG_RELEASE_FUNC release, void* user);
+
+    /**
+     * @brief Create a session
+     * @param[out] session Returns the created session
+     * @param[in,out] allocator Allocator the session's blocks come from, NULL for malloc; it must outlive the session
+     * @param[in] max_cached Bytes of freed blocks the session keeps, 0 for no limit; beyond it blocks are released
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_session_create(XLS2IMG_SESSION** session, XLS2IMG_ALLOCATOR* allocator, size_t max_cached);
+
+    /**
+     * @brief Allocator of a session, for XLS2IMG_EXTRACT_OPTIONS.allocator and xls2img_open_ex
+     * @param[in] session The session
+     * @return The allocator, valid until the session is destroyed
+     */
+    XLS2IMG_API XLS2IMG_ALLOCATOR* xls2img_session_allocator(XLS2IMG_SESSION* session);
+
+    /**
+     * @brief Create a reader whose allocations, and the results of xls2img_read_images, come from a session
+     * @details Same as xls2img_open_ex with the session's allocator.
+     * @param[in] session The session
+     * @param[out] reader Returns the created reader pointer
+     * @param[in] buffer XLS file data buffer
+     * @param[in] len buffer size
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_session_open(XLS2IMG_SESSION* session, XLS2IMG_READER** reader, const void* buffer, size_t len);
+
+    /**
+     * @brief Take back everything allocated from a session at once
+     * @details Readers, cursors, parsers, workbook data and results of the session become invalid and must not be
+     *          used, closed or freed afterwards; their blocks are kept for the next file. Freeing them one by one
+     *          instead is just as cheap, reset saves the bookkeeping and covers error paths.
+     * @param[in] session The session
+     */
+    XLS2IMG_API void xls2img_session_reset(XLS2IMG_SESSION* session);
+
+    /**
+     * @brief Destroy a session, releasing its cached blocks and everything still allocated from it
+     * @param[in] session The session to destroy
+     */
+    XLS2IMG_API void xls2img_session_destroy(XLS2IMG_SESSION* session);
+
+    /**
+     * @brief Attach a statistics struct to the reader
+     * @details The reader updates it from xls2img_get_workbook and xls2img_get_workbook_extents.
+     * @param[in] reader XLS2IMG reader
+     * @param[in] stats Struct to update, NULL to detach; it must outlive its use by the reader
+     * @return XLS2IMG_SUCCESS on success, XLS2IMG_ERROR_UNSUPPORTED if the library was built without XLS2IMG_STATS
+     */
+    XLS2IMG_API int xls2img_set_stats(XLS2IMG_READER* reader, XLS2IMG_STATS* stats);
+
+    /**
+     * @brief Attach a trace ring buffer to the reader
+     * @details The reader records sector reads, FAT lookups and allocations from xls2img_get_workbook and
+     *          xls2img_get_workbook_extents.
+     * @param[in] reader XLS2IMG reader
+     * @param[in] trace Ring buffer to append to, NULL to detach; it must outlive its use by the reader
+     * @return XLS2IMG_SUCCESS on success, XLS2IMG_ERROR_UNSUPPORTED if the library was built without XLS2IMG_TRACE
+     */
+    XLS2IMG_API int xls2img_set_trace(XLS2IMG_READER* reader, XLS2IMG_TRACE* trace);
+
+    /**
+     * @brief Deliver the pending events of a trace ring buffer to its flush callback and empty it
+     * @param[in,out] trace Ring buffer; without a flush callback the events are discarded
+     */
+    XLS2IMG_API void xls2img_trace_flush(XLS2IMG_TRACE* trace);
+
+    /**
+     * @brief Set the work limits applied by xls2img_get_workbook and xls2img_get_workbook_extents
+     * @details Only max_sectors and max_bytes concern the reader; the limits are copied.
+     * @param[in] reader XLS2IMG reader
+     * @param[in] limits Limits to apply, NULL to remove them
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_set_limits(XLS2IMG_READER* reader, const XLS2IMG_LIMITS* limits);
+
+    /**
+     * @brief Attach a control to the reader
+     * @details xls2img_get_workbook, xls2img_get_workbook_extents, xls2img_read_images and xls2img_stream_images
+     *          poll it; options->control takes its place for the calls given options.
+     * @param[in] reader XLS2IMG reader
+     * @param[in] control Control to poll, NULL to detach; it must outlive its use by the reader
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_set_control(XLS2IMG_READER* reader, XLS2IMG_CONTROL* control);
+
+    /**
+     * @brief Ask the reads polling a control to stop
+     * @details Safe to call from any thread, including a progress callback; the reads end with
+     *          XLS2IMG_ERROR_CANCELLED at their next poll.
+     * @param[in,out] control Control to cancel
+     */
+    XLS2IMG_API void xls2img_cancel(XLS2IMG_CONTROL* control);
+
+    /**
+     * @brief Current time of the clock XLS2IMG_CONTROL.deadline_ns is measured on
+     * @details A monotonic clock, QueryPerformanceCounter on Windows and CLOCK_MONOTONIC elsewhere. Its origin is
+     *          unspecified, so only differences are meaningful: set a deadline as xls2img_clock_ns() plus a timeout.
+     * @return Nanoseconds since an unspecified starting point
+     */
+    XLS2IMG_API uint64_t xls2img_clock_ns(void);
+
     /**
      * @brief Close and free the reader
      * @param[in] reader The reader pointer to deallocate
      */
     XLS2IMG_API void xls2img_close(XLS2IMG_READER* reader);
 
+    /**
+     * @brief Container format of the data the reader was opened on
+     * @param[in] reader XLS2IMG reader
+     * @return XLS2IMG_CONTAINER_CFB, XLS2IMG_CONTAINER_OOXML, XLS2IMG_CONTAINER_DOC or XLS2IMG_CONTAINER_PPT
+     */
+    XLS2IMG_API XLS2IMG_CONTAINER xls2img_get_container(const XLS2IMG_READER* reader);
+
     /**
      * @brief Extract workbook stream from XLS file
+     * @details Fails with XLS2IMG_ERROR_NO_WORKBOOK for an OOXML package, a DOC or a PPT file.
      * @param[in] reader XLS2IMG reader
      * @param[out] data Output parameter, returns workbook data pointer
      * @param[out] size Output parameter, returns workbook data size
@@ -121,6 +564,69 @@ extern "C" {
      */
     XLS2IMG_API int xls2img_get_workbook(XLS2IMG_READER* reader, void** data, size_t* size);
 
+    /**
+     * @brief Map a range of the workbook stream to byte ranges of the XLS file data through the sector chain
+     * @details Physically adjacent sectors are merged, so a range stored in consecutive sectors yields one extent.
+     *          An image whose span equals its size can be copied straight from the source file using the extents of
+     *          [offset, offset + size). In an OOXML package offsets are file offsets and any range is one extent.
+     * @param[in] reader XLS2IMG reader
+     * @param[in] offset Offset in the workbook stream
+     * @param[in] size Range length
+     * @param[out] extents Receives up to max_extents extents in stream order, may be NULL if max_extents is 0
+     * @param[in] max_extents Capacity of extents
+     * @return Number of extents the range occupies (only the first max_extents are stored), error code on failure (<0)
+     */
+    XLS2IMG_API int xls2img_get_workbook_extents(XLS2IMG_READER* reader, size_t offset, size_t size,
+        XLS2IMG_EXTENT* extents, int max_extents);
+
+    /**
+     * @brief Create a cursor for reading the workbook of a reader from one thread
+     * @details The reader must outlive the cursor. options->limits defaults to the reader's limits and
+     *          options->allocator to the reader's allocator; the stats and trace attached to the reader are not used.
+     * @param[out] cursor Returns the created cursor pointer
+     * @param[in] reader XLS2IMG reader, possibly shared with other threads
+     * @param[in] options Limits, stats, trace and allocator of the cursor's reads, may be NULL
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_cursor_open(XLS2IMG_CURSOR** cursor, const XLS2IMG_READER* reader, const XLS2IMG_EXTRACT_OPTIONS* options);
+
+    /**
+     * @brief Close and free the cursor
+     * @param[in] cursor The cursor pointer to deallocate
+     */
+    XLS2IMG_API void xls2img_cursor_close(XLS2IMG_CURSOR* cursor);
+
+    /**
+     * @brief Extract the workbook stream through a cursor, see xls2img_get_workbook
+     * @param[in] cursor XLS2IMG cursor
+     * @param[out] data Output parameter, returns workbook data pointer, freed with xls2img_free_workbook_data
+     * @param[out] size Output parameter, returns workbook data size
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_cursor_get_workbook(XLS2IMG_CURSOR* cursor, void** data, size_t* size);
+
+    /**
+     * @brief Copy a range of the workbook stream, such as an image at XLS2IMG_IMAGE offset and span
+     * @param[in] cursor XLS2IMG cursor
+     * @param[in] offset Offset in the workbook stream
+     * @param[out] buffer Receives size bytes
+     * @param[in] size Range length
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_cursor_read(XLS2IMG_CURSOR* cursor, size_t offset, void* buffer, size_t size);
+
+    /**
+     * @brief Map a range of the workbook stream to byte ranges of the XLS file data, see xls2img_get_workbook_extents
+     * @param[in] cursor XLS2IMG cursor
+     * @param[in] offset Offset in the workbook stream
+     * @param[in] size Range length
+     * @param[out] extents Receives up to max_extents extents in stream order, may be NULL if max_extents is 0
+     * @param[in] max_extents Capacity of extents
+     * @return Number of extents the range occupies (only the first max_extents are stored), error code on failure (<0)
+     */
+    XLS2IMG_API int xls2img_cursor_get_workbook_extents(XLS2IMG_CURSOR* cursor, size_t offset, size_t size,
+        XLS2IMG_EXTENT* extents, int max_extents);
+
     /** 
      *  @brief Frees the workbook data buffer allocated by xls2img_get_workbook.
      *  @param[in] data The pointer returned by xls2img_get_workbook.
@@ -136,6 +642,273 @@ extern "C" {
      */
     XLS2IMG_API int xls2img_extract_images(const void* workbook_data, size_t workbook_size, XLS2IMG_RESULT* result);
 
+    /**
+     * @brief Extract images from workbook data and update statistics
+     * @details Identical to xls2img_extract_images; stats is left untouched if the library was built without XLS2IMG_STATS.
+     * @param[in] workbook_data workbook stream data pointer
+     * @param[in] workbook_size workbook stream size
+     * @param[out] result Output parameter, returns extracted image information
+     * @param[in,out] stats Struct to update, may be NULL
+     * @return Number of images extracted on success (>=1), error code on failure (<=0)
+     */
+    XLS2IMG_API int xls2img_extract_images_stats(const void* workbook_data, size_t workbook_size, XLS2IMG_RESULT* result,
+        XLS2IMG_STATS* stats);
+
+    /**
+     * @brief Extract images from workbook data with work limits, statistics or tracing
+     * @details Of the limits, max_bytes bounds workbook_size, max_records, max_images and max_output_bytes bound the
+     *          extraction and max_sectors is ignored. Nothing is returned in result when a limit is exceeded.
+     *          A formats mask limits the scan to the headers of those formats; one that selects no built-in format
+     *          fails with XLS2IMG_ERROR_UNSUPPORTED.
+     * @param[in] workbook_data workbook stream data pointer
+     * @param[in] workbook_size workbook stream size
+     * @param[out] result Output parameter, returns extracted image information
+     * @param[in] options Optional inputs, may be NULL
+     * @return Number of images extracted on success (>=1), error code on failure (<=0)
+     */
+    XLS2IMG_API int xls2img_extract_images_ex(const void* workbook_data, size_t workbook_size, XLS2IMG_RESULT* result,
+        const XLS2IMG_EXTRACT_OPTIONS* options);
+
+    /**
+     * @brief Create a push parser that extracts images from a workbook stream delivered in chunks
+     * @details Finds the same images as xls2img_extract_images_ex, but only buffers the image in progress instead of
+     *          the workbook or the whole drawing group. Each image is passed to on_image once its end is known, which
+     *          is when the next image header or the end of the drawing group arrives.
+     * @param[out] parser Returns the created parser pointer
+     * @param[in] on_image Callback receiving each image
+     * @param[in] user User pointer passed to on_image
+     * @param[in] options Limits, stats, trace and allocator, may be NULL; max_bytes bounds the bytes fed
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_parser_open(XLS2IMG_PARSER** parser, XLS2IMG_IMAGE_FUNC on_image, void* user,
+        const XLS2IMG_EXTRACT_OPTIONS* options);
+
+    /**
+     * @brief Feed the next chunk of the workbook stream
+     * @details Chunks may have any size and split records anywhere. After an error every later call returns it.
+     * @param[in] parser XLS2IMG parser
+     * @param[in] data Chunk data, not referenced after the call
+     * @param[in] size Chunk size
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_parser_feed(XLS2IMG_PARSER* parser, const void* data, size_t size);
+
+    /**
+     * @brief Signal the end of the workbook stream and deliver the last image
+     * @param[in] parser XLS2IMG parser
+     * @return Number of images delivered (>=1), XLS2IMG_ERROR_NO_IMAGES or another error code (<0)
+     */
+    XLS2IMG_API int xls2img_parser_finish(XLS2IMG_PARSER* parser);
+
+    /**
+     * @brief Close and free the parser
+     * @param[in] parser The parser pointer to deallocate
+     */
+    XLS2IMG_API void xls2img_parser_close(XLS2IMG_PARSER* parser);
+
+    /**
+     * @brief Extract the images of a reader's file and pass each one to a callback
+     * @details For an XLS file the push parser reads the workbook stream in place, sector by sector, without copying
+     *          it. For an OOXML package every xl/media entry of a selected format is an image: stored entries are
+     *          passed as views into the file data and deflated ones are inflated into a buffer valid during the call.
+     *          A PPT file is scanned through its Pictures stream. A DOC file is scanned through its Data stream, then
+     *          through each blip of the BStore in its table stream, which lies in the table or WordDocument stream;
+     *          image offsets are in the stream the image was read from.
+     *          With options->embedded_depth set, the objects embedded in the file are searched too: the MBD storages
+     *          of a workbook, the ObjectPool storages of a Word document and the xl/embeddings parts of a package.
+     *          A compound file or package held in an object's Ole10Native or Package stream is opened in place when
+     *          its sectors are contiguous and copied otherwise. Their images carry the object's path, their offsets
+     *          are in the object's own streams, and the limits apply to the whole search. Objects that cannot be read
+     *          are skipped.
+     *          options->limits defaults to the reader's limits and options->allocator to the reader's allocator; the
+     *          stats and trace attached to the reader are not used. The reader may be shared, as with a cursor.
+     * @param[in] reader XLS2IMG reader
+     * @param[in] on_image Callback receiving each image, see XLS2IMG_IMAGE_FUNC
+     * @param[in] user User pointer passed to on_image
+     * @param[in] options Limits, stats, trace, allocator, formats and embedded depth, may be NULL
+     * @return Number of images delivered (>=1), XLS2IMG_ERROR_NO_IMAGES or another error code (<0)
+     */
+    XLS2IMG_API int xls2img_stream_images(const XLS2IMG_READER* reader, XLS2IMG_IMAGE_FUNC on_image, void* user,
+        const XLS2IMG_EXTRACT_OPTIONS* options);
+
+    /**
+     * @brief Extract the images of a reader's file into a result, see xls2img_stream_images
+     * @details Works for XLS files and OOXML packages alike; the result is freed with xls2img_free_result, which also
+     *          releases the image paths.
+     * @param[in] reader XLS2IMG reader
+     * @param[out] result Output parameter, returns extracted image information
+     * @param[in] options Optional inputs, may be NULL
+     * @return Number of images extracted on success (>=1), error code on failure (<=0)
+     */
+    XLS2IMG_API int xls2img_read_images(const XLS2IMG_READER* reader, XLS2IMG_RESULT* result,
+        const XLS2IMG_EXTRACT_OPTIONS* options);
+
+    /**
+     * @brief Write the image index of a reader's file, the contents of an .x2i sidecar file
+     * @details Records the file size, mtime and hash, the extents of the workbook stream (the Pictures stream of a
+     *          PPT file) and, for each image xls2img_stream_images delivers, its format, size, prefix and extents in
+     *          the file. Record headers that interrupt an image are left out of its extents. The images of a DOC
+     *          file are recorded without extents, as are those of embedded objects, which are not searched.
+     *          A file without images gives an index without images.
+     * @param[in] reader XLS2IMG reader
+     * @param[in] mtime Modification time of the file, stored for the caller to compare, in any unit
+     * @param[out] data Returns the index bytes, freed with xls2img_free_index_data
+     * @param[out] size Returns the index size
+     * @param[in] options Limits, stats, trace, allocator and formats of the extraction, may be NULL
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_index_build(const XLS2IMG_READER* reader, uint64_t mtime, void** data, size_t* size,
+        const XLS2IMG_EXTRACT_OPTIONS* options);
+
+    /**
+     * @brief Frees the index bytes returned by xls2img_index_build
+     * @param[in] data The pointer returned by xls2img_index_build
+     */
+    XLS2IMG_API void xls2img_free_index_data(void* data);
+
+    /**
+     * @brief Open an index over the bytes of an .x2i file, typically a read-only mapping of it
+     * @details The bytes are checked once and not copied, so they must outlive the index. A truncated, modified or
+     *          foreign file fails with XLS2IMG_ERROR_FILE_CORRUPTED, one from another version of the format with
+     *          XLS2IMG_ERROR_WRONG_FORMAT.
+     * @param[out] index Returns the opened index
+     * @param[in] data Index bytes
+     * @param[in] size Index size
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_index_open(XLS2IMG_INDEX** index, const void* data, size_t size);
+
+    /**
+     * @brief Open an index whose own allocation goes through a caller-supplied allocator
+     * @details Same as xls2img_index_open; xls2img_index_close frees the index through the same allocator.
+     * @param[out] index Returns the opened index
+     * @param[in] data Index bytes
+     * @param[in] size Index size
+     * @param[in,out] allocator Allocator and byte counters, NULL for malloc; it must outlive the index
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_index_open_ex(XLS2IMG_INDEX** index, const void* data, size_t size, XLS2IMG_ALLOCATOR* allocator);
+
+    /**
+     * @brief Close and free the index
+     * @param[in] index The index pointer to deallocate
+     */
+    XLS2IMG_API void xls2img_index_close(XLS2IMG_INDEX* index);
+
+    /**
+     * @brief Identity of the indexed file; compare it with the file before trusting the index
+     * @param[in] index XLS2IMG index
+     * @param[out] info Receives the file identity and the counts
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_index_get_info(const XLS2IMG_INDEX* index, XLS2IMG_INDEX_INFO* info);
+
+    /**
+     * @brief Byte ranges of the file holding the workbook stream, in stream order
+     * @param[in] index XLS2IMG index
+     * @param[out] extents Receives up to max_extents extents, may be NULL if max_extents is 0
+     * @param[in] max_extents Capacity of extents
+     * @return Number of extents of the stream (only the first max_extents are stored), error code on failure (<0)
+     */
+    XLS2IMG_API int xls2img_index_get_stream_extents(const XLS2IMG_INDEX* index, XLS2IMG_EXTENT* extents, int max_extents);
+
+    /**
+     * @brief Describe an image of the index
+     * @param[in] index XLS2IMG index
+     * @param[in] number Image number, from 0, in the order xls2img_stream_images delivers them
+     * @param[out] image Receives the image description
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_index_get_image(const XLS2IMG_INDEX* index, int number, XLS2IMG_INDEX_IMAGE* image);
+
+    /**
+     * @brief Byte ranges of the file holding an image's data, in image order, for reading it with pread or the like
+     * @param[in] index XLS2IMG index
+     * @param[in] number Image number, from 0
+     * @param[out] extents Receives up to max_extents extents, may be NULL if max_extents is 0
+     * @param[in] max_extents Capacity of extents
+     * @return Number of extents of the image (only the first max_extents are stored), error code on failure (<0)
+     */
+    XLS2IMG_API int xls2img_index_get_image_extents(const XLS2IMG_INDEX* index, int number, XLS2IMG_EXTENT* extents,
+        int max_extents);
+
+    /**
+     * @brief Copy an image file out of the indexed file, without parsing it
+     * @details Writes the prefix followed by the data, inflating a deflated entry. The file must be the one the index
+     *          was built from: a different size fails with XLS2IMG_ERROR_INVALID_ARGUMENT, while other changes are up
+     *          to the caller to detect through xls2img_index_get_info. An image without extents fails with
+     *          XLS2IMG_ERROR_UNSUPPORTED and has to be extracted through a reader.
+     * @param[in] index XLS2IMG index
+     * @param[in] number Image number, from 0
+     * @param[in] file File data, typically a read-only mapping of the file
+     * @param[in] file_size File size
+     * @param[out] buffer Receives prefix_size + size bytes
+     * @param[in] buffer_size Capacity of buffer
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_index_read_image(const XLS2IMG_INDEX* index, int number, const void* file, size_t file_size,
+        void* buffer, size_t buffer_size);
+
+    /**
+     * @brief Write the images of a reader's file into one block of memory, for handing to another process
+     * @details Each image file is copied once, from the file or the parser's buffers straight into the memory grow
+     *          provides, and hashed by the same pass; no result buffers are allocated. grow is asked for doubling
+     *          sizes, so the memory may end up larger than the export. A file without images gives an export with an
+     *          empty table. Images of embedded objects are exported without their path.
+     * @param[in] reader XLS2IMG reader
+     * @param[in] grow Function providing the memory
+     * @param[in] user User pointer passed to grow
+     * @param[out] data Returns the memory holding the export, the last one grow returned; on failure too, for the
+     *             caller to release
+     * @param[out] size Returns the export size
+     * @param[in] options Limits, stats, allocator, formats, embedded depth, verify and control of the extraction,
+     *            may be NULL
+     * @return XLS2IMG_SUCCESS on success, error code on failure
+     */
+    XLS2IMG_API int xls2img_export_images(const XLS2IMG_READER* reader, XLS2IMG_EXPORT_FUNC grow, void* user,
+        void** data, size_t* size, const XLS2IMG_EXTRACT_OPTIONS* options);
+
+    /**
+     * @brief Write the images of a reader's file into a sealed memfd, see xls2img_export_images
+     * @details The images are written into a shared mapping of the memfd, which is then truncated to the export
+     *          and sealed against writing, growing and shrinking. A process receiving the descriptor, for instance
+     *          over a Unix domain socket with SCM_RIGHTS, can mmap it read-only and rely on it never changing.
+     * @param[in] reader XLS2IMG reader
+     * @param[out] fd Returns the memfd, closed by the caller
+     * @param[out] size Returns the export size, the size of the memfd
+     * @param[in] options Options of the extraction as for xls2img_export_images, may be NULL
+     * @return XLS2IMG_SUCCESS on success, XLS2IMG_ERROR_UNSUPPORTED on systems other than Linux, error code on failure
+     */
+    XLS2IMG_API int xls2img_export_memfd(const XLS2IMG_READER* reader, int* fd, size_t* size,
+        const XLS2IMG_EXTRACT_OPTIONS* options);
+
+    /**
+     * @brief Formats this build of the library can extract
+     * @details Set with XLS2IMG_FORMATS in CMake. Extraction with options that select none of them fails with
+     *          XLS2IMG_ERROR_UNSUPPORTED.
+     * @return XLS2IMG_FORMAT_MASK bits of the built-in formats
+     */
+    XLS2IMG_API unsigned int xls2img_get_formats(void);
+
+    /**
+     * @brief File name extension of a format
+     * @param[in] format Image format
+     * @return "png", "jpg", "gif", "bmp", "tif", "emf", "wmf", or "bin" for XLS2IMG_UNKNOWN
+     */
+    XLS2IMG_API const char* xls2img_format_extension(XLS2IMG_FORMAT format);
+
+    /**
+     * @brief Check the structure of an image without decoding it
+     * @details PNG: the signature, IHDR first, every chunk within the data with a matching CRC, and IEND. JPEG: SOI, every
+     *          marker segment within the data, a frame header before the first scan, and EOI behind the scan data.
+     *          Bytes behind IEND or EOI are not checked. Other formats have no check.
+     * @param[in] format Image format
+     * @param[in] data Image data, including any prefix
+     * @param[in] size Size of data
+     * @return XLS2IMG_CHECK_* bits, 0 for a format without a check
+     */
+    XLS2IMG_API unsigned int xls2img_verify_image(XLS2IMG_FORMAT format, const void* data, size_t size);
+
     /**
      * @brief Free image extraction results
      * @param[in] result The extracted image result to release
@@ -0,0 +1,576 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Header-only C++17 wrapper of the xls2img C API
+ *
+ * Move-only owners close and free what they hold, failures come back as expected<T> instead of
+ * being thrown, and image data is handed out as byte_span views into library-owned memory. Every
+ * member is a thin inline call of the matching C function.
+ */
+
+#ifndef XLS2IMG_HPP
+#define XLS2IMG_HPP
+
+#include "xls2img.h"
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory_resource>
+#include <utility>
+#include <variant>
+#include <vector>
+#if __has_include(<version>)
+#include <version>
+#endif
+#if defined(__cpp_lib_span)
+#include <span>
+#endif
+
+namespace xls2img {
+
+#if defined(__cpp_lib_span)
+    using byte_span = std::span<const std::byte>;
+#else
+    /**
+     * @brief Read-only view of bytes, std::span<const std::byte> where the standard library has it
+     */
+    class byte_span {
+    public:
+        using element_type = const std::byte;
+        using value_type = std::byte;
+        using size_type = std::size_t;
+        using pointer = const std::byte*;
+        using iterator = const std::byte*;
+
+        constexpr byte_span() noexcept = default;
+        constexpr byte_span(const std::byte* data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+        constexpr const std::byte* data() const noexcept { return data_; }
+        constexpr std::size_t size() const noexcept { return size_; }
+        constexpr std::size_t size_bytes() const noexcept { return size_; }
+        constexpr bool empty() const noexcept { return size_ == 0; }
+        constexpr iterator begin() const noexcept { return data_; }
+        constexpr iterator end() const noexcept { return data_ + size_; }
+        constexpr const std::byte& operator[](std::size_t index) const noexcept { return data_[index]; }
+        constexpr byte_span subspan(std::size_t offset, std::size_t count) const noexcept { return byte_span(data_ + offset, count); }
+
+    private:
+        const std::byte* data_ = nullptr;
+        std::size_t size_ = 0;
+    };
+#endif
+
+    /**
+     * @brief An xls2img error code
+     */
+    class error {
+    public:
+        constexpr explicit error(int code) noexcept : code_(code) {}
+        constexpr int code() const noexcept { return code_; }
+        const char* message() const noexcept { return xls2img_strerror(code_); }
+
+    private:
+        int code_;
+    };
+
+    /**
+     * @brief A value or the error that prevented it, in the manner of std::expected
+     * @details value(), operator* and operator-> require has_value(); error() requires !has_value().
+     */
+    template <class T>
+    class expected {
+    public:
+        expected(T&& value) noexcept : v_(std::in_place_index<0>, std::move(value)) {}
+        expected(::xls2img::error e) noexcept : v_(std::in_place_index<1>, e) {}
+
+        bool has_value() const noexcept { return v_.index() == 0; }
+        explicit operator bool() const noexcept { return has_value(); }
+
+        T& value() & noexcept { assert(has_value()); return *std::get_if<0>(&v_); }
+        const T& value() const& noexcept { assert(has_value()); return *std::get_if<0>(&v_); }
+        T&& value() && noexcept { assert(has_value()); return std::move(*std::get_if<0>(&v_)); }
+        T& operator*() & noexcept { return value(); }
+        const T& operator*() const& noexcept { return value(); }
+        T&& operator*() && noexcept { return std::move(*this).value(); }
+        T* operator->() noexcept { return &value(); }
+        const T* operator->() const noexcept { return &value(); }
+
+        ::xls2img::error error() const noexcept { assert(!has_value()); return *std::get_if<1>(&v_); }
+
+    private:
+        std::variant<T, ::xls2img::error> v_;
+    };
+
+    template <>
+    class expected<void> {
+    public:
+        expected() noexcept : code_(XLS2IMG_SUCCESS) {}
+        expected(::xls2img::error e) noexcept : code_(e.code()) {}
+
+        bool has_value() const noexcept { return code_ == XLS2IMG_SUCCESS; }
+        explicit operator bool() const noexcept { return has_value(); }
+        ::xls2img::error error() const noexcept { assert(!has_value()); return ::xls2img::error(code_); }
+
+    private:
+        int code_;
+    };
+
+    namespace detail {
+        inline expected<void> check(int ret) noexcept
+        {
+            if (ret < 0) return error(ret);
+            return {};
+        }
+    }
+
+    /**
+     * @brief XLS2IMG_ALLOCATOR backed by a std::pmr::memory_resource
+     * @details Pass get() to Reader::open or in XLS2IMG_EXTRACT_OPTIONS. The library keeps pointers to the C struct,
+     *          so the adapter is neither copyable nor movable and must outlive everything allocated through it.
+     */
+    class memory_resource_allocator {
+    public:
+        explicit memory_resource_allocator(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) noexcept
+        {
+            std::memset(&allocator_, 0, sizeof(allocator_));
+            allocator_.alloc = &memory_resource_allocator::allocate;
+            allocator_.realloc = &memory_resource_allocator::reallocate;
+            allocator_.free = &memory_resource_allocator::deallocate;
+            allocator_.user = resource;
+        }
+        memory_resource_allocator(const memory_resource_allocator&) = delete;
+        memory_resource_allocator& operator=(const memory_resource_allocator&) = delete;
+
+        XLS2IMG_ALLOCATOR* get() noexcept { return &allocator_; }
+        std::pmr::memory_resource* resource() const noexcept { return static_cast<std::pmr::memory_resource*>(allocator_.user); }
+        std::size_t current_bytes() const noexcept { return allocator_.current_bytes; }
+        std::size_t peak_bytes() const noexcept { return allocator_.peak_bytes; }
+
+    private:
+        static void* allocate(std::size_t size, void* user) noexcept
+        {
+            try
+            {
+                return static_cast<std::pmr::memory_resource*>(user)->allocate(size, alignof(std::max_align_t));
+            }
+            catch (...)
+            {
+                return nullptr;
+            }
+        }
+
+        // memory resources cannot grow a block in place, so a realloc is a copy; the old block survives a failure
+        static void* reallocate(void* ptr, std::size_t old_size, std::size_t new_size, void* user) noexcept
+        {
+            void* new_ptr = allocate(new_size, user);
+            if (new_ptr && ptr)
+            {
+                std::memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+                deallocate(ptr, old_size, user);
+            }
+            return new_ptr;
+        }
+
+        static void deallocate(void* ptr, std::size_t size, void* user) noexcept
+        {
+            static_cast<std::pmr::memory_resource*>(user)->deallocate(ptr, size, alignof(std::max_align_t));
+        }
+
+        XLS2IMG_ALLOCATOR allocator_;
+    };
+
+    /**
+     * @brief View of one extracted image
+     */
+    struct Image {
+        XLS2IMG_FORMAT format;  /* Image format */
+        byte_span data;         /* Image bytes */
+        std::size_t offset;     /* Offset of the first image byte in the workbook stream */
+        std::size_t span;       /* Length of the workbook stream range holding the image */
+        const char* path;       /* Container path of an image of an embedded object, nullptr for the file itself */
+        unsigned int check;     /* XLS2IMG_CHECK_* bits, 0 unless XLS2IMG_EXTRACT_OPTIONS.verify was set */
+    };
+
+    namespace detail {
+        inline Image make_image(const XLS2IMG_IMAGE& image) noexcept
+        {
+            return Image{ image.format, byte_span(static_cast<const std::byte*>(image.data), image.size), image.offset, image.span, image.path, image.check };
+        }
+    }
+
+    /**
+     * @brief Owner of an XLS2IMG_RESULT, a random access sequence of Image views
+     */
+    class ImageSet {
+    public:
+        class iterator {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = Image;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = Image;
+
+            iterator() noexcept = default;
+            explicit iterator(const XLS2IMG_IMAGE* image) noexcept : image_(image) {}
+
+            Image operator*() const noexcept { return detail::make_image(*image_); }
+            iterator& operator++() noexcept { ++image_; return *this; }
+            iterator operator++(int) noexcept { iterator it = *this; ++image_; return it; }
+            bool operator==(const iterator& other) const noexcept { return image_ == other.image_; }
+            bool operator!=(const iterator& other) const noexcept { return image_ != other.image_; }
+
+        private:
+            const XLS2IMG_IMAGE* image_ = nullptr;
+        };
+
+        ImageSet() noexcept { result_.images = nullptr; result_.count = 0; }
+        explicit ImageSet(const XLS2IMG_RESULT& result) noexcept : result_(result) {}
+        ImageSet(ImageSet&& other) noexcept : result_(other.result_) { other.result_.images = nullptr; other.result_.count = 0; }
+        ImageSet& operator=(ImageSet&& other) noexcept
+        {
+            if (this != &other)
+            {
+                xls2img_free_result(&result_);
+                result_ = other.result_;
+                other.result_.images = nullptr;
+                other.result_.count = 0;
+            }
+            return *this;
+        }
+        ~ImageSet() { xls2img_free_result(&result_); }
+
+        std::size_t size() const noexcept { return static_cast<std::size_t>(result_.count); }
+        bool empty() const noexcept { return result_.count == 0; }
+        Image operator[](std::size_t index) const noexcept { return detail::make_image(result_.images[index]); }
+        iterator begin() const noexcept { return iterator(result_.images); }
+        iterator end() const noexcept { return iterator(result_.images + result_.count); }
+        const XLS2IMG_RESULT& get() const noexcept { return result_; }
+
+    private:
+        XLS2IMG_RESULT result_;
+    };
+
+    /**
+     * @brief Lazy input range of the images of a workbook stream, driven by the push parser
+     * @details Each increment feeds the parser until it completes the next image, so only the images of one chunk are
+     *          held at a time. An image stored in one piece is a view into the workbook; one split by CONTINUE records
+     *          is copied into a buffer from the memory resource. A view is valid until the iterator is incremented.
+     *          The range refers to itself from the parser callback and can therefore not be copied or moved.
+     */
+    class ImageRange {
+    public:
+        class iterator {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = Image;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Image*;
+            using reference = const Image&;
+
+            iterator() noexcept = default;
+            explicit iterator(ImageRange* range) noexcept : range_(range) {}
+
+            const Image& operator*() const noexcept { return range_->current_; }
+            const Image* operator->() const noexcept { return &range_->current_; }
+            iterator& operator++() { if (!range_->next()) range_ = nullptr; return *this; }
+            void operator++(int) { ++*this; }
+            bool operator==(const iterator& other) const noexcept { return range_ == other.range_; }
+            bool operator!=(const iterator& other) const noexcept { return range_ != other.range_; }
+
+        private:
+            ImageRange* range_ = nullptr;
+        };
+
+        ImageRange(byte_span workbook, const XLS2IMG_EXTRACT_OPTIONS* options = nullptr,
+            std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : workbook_(workbook), options_(options), pending_(resource), storage_(resource) {}
+        ImageRange(const ImageRange&) = delete;
+        ImageRange& operator=(const ImageRange&) = delete;
+        ~ImageRange() { xls2img_parser_close(parser_); }
+
+        /**
+         * @brief Start the iteration; a range can be iterated once
+         */
+        iterator begin()
+        {
+            if (!parser_ && status_ == XLS2IMG_SUCCESS)
+                status_ = xls2img_parser_open(&parser_, &ImageRange::on_image, this, options_);
+            return next() ? iterator(this) : iterator();
+        }
+        iterator end() noexcept { return iterator(); }
+
+        /**
+         * @brief Why the iteration ended: the image count, XLS2IMG_ERROR_NO_IMAGES or an error code
+         */
+        int status() const noexcept { return status_; }
+
+    private:
+        struct Pending {
+            XLS2IMG_IMAGE image;        // data is null for images copied into storage_
+            std::size_t storage_offset;
+        };
+
+        static constexpr std::size_t chunk_size = 16 * 1024;
+
+        static int on_image(const XLS2IMG_IMAGE* image, void* user) noexcept
+        {
+            ImageRange* self = static_cast<ImageRange*>(user);
+            try
+            {
+                Pending pending = { *image, 0 };
+                if (image->span == image->size && image->prefix_size == 0)
+                    pending.image.data = const_cast<std::byte*>(self->workbook_.data()) + image->offset;
+                else
+                {
+                    // a synthesized prefix is stored in front of the payload so data is a complete file
+                    const std::byte* prefix = static_cast<const std::byte*>(image->prefix);
+                    const std::byte* data = static_cast<const std::byte*>(image->data);
+                    pending.image.data = nullptr;
+                    pending.image.size = image->prefix_size + image->size;
+                    pending.image.prefix = nullptr;
+                    pending.image.prefix_size = 0;
+                    pending.storage_offset = self->storage_.size();
+                    self->storage_.insert(self->storage_.end(), prefix, prefix + image->prefix_size);
+                    self->storage_.insert(self->storage_.end(), data, data + image->size);
+                }
+                self->pending_.push_back(pending);
+            }
+            catch (...)
+            {
+                return XLS2IMG_ERROR_OUT_OF_MEMORY;
+            }
+            return XLS2IMG_SUCCESS;
+        }
+
+        bool next()
+        {
+            if (head_ == pending_.size())
+            {
+                pending_.clear();
+                storage_.clear();
+                head_ = 0;
+                while (pending_.empty() && status_ == XLS2IMG_SUCCESS && !finished_)
+                {
+                    if (position_ < workbook_.size())
+                    {
+                        std::size_t len = workbook_.size() - position_ < chunk_size ? workbook_.size() - position_ : chunk_size;
+                        status_ = xls2img_parser_feed(parser_, workbook_.data() + position_, len);
+                        position_ += len;
+                    }
+                    else
+                    {
+                        status_ = xls2img_parser_finish(parser_);
+                        finished_ = true;
+                    }
+                }
+                if (pending_.empty())
+                    return false;
+            }
+
+            XLS2IMG_IMAGE image = pending_[head_].image;
+            if (!image.data)
+                image.data = storage_.data() + pending_[head_].storage_offset;
+            head_++;
+            current_ = detail::make_image(image);
+            return true;
+        }
+
+        byte_span workbook_;
+        const XLS2IMG_EXTRACT_OPTIONS* options_;
+        XLS2IMG_PARSER* parser_ = nullptr;
+        std::size_t position_ = 0;
+        bool finished_ = false;
+        int status_ = XLS2IMG_SUCCESS;
+        std::pmr::vector<Pending> pending_;
+        std::pmr::vector<std::byte> storage_;
+        std::size_t head_ = 0;
+        Image current_ = {};
+    };
+
+    /**
+     * @brief Owner of the workbook stream returned by xls2img_get_workbook
+     */
+    class Workbook {
+    public:
+        Workbook() noexcept = default;
+        Workbook(void* data, std::size_t size) noexcept : data_(data), size_(size) {}
+        Workbook(Workbook&& other) noexcept : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+        Workbook& operator=(Workbook&& other) noexcept
+        {
+            if (this != &other)
+            {
+                xls2img_free_workbook_data(data_);
+                data_ = std::exchange(other.data_, nullptr);
+                size_ = std::exchange(other.size_, 0);
+            }
+            return *this;
+        }
+        ~Workbook() { xls2img_free_workbook_data(data_); }
+
+        byte_span bytes() const noexcept { return byte_span(static_cast<const std::byte*>(data_), size_); }
+
+        /**
+         * @brief Extract every image at once, see xls2img_extract_images_ex
+         */
+        expected<ImageSet> images(const XLS2IMG_EXTRACT_OPTIONS* options = nullptr) const noexcept
+        {
+            XLS2IMG_RESULT result = { nullptr, 0 };
+            int ret = xls2img_extract_images_ex(data_, size_, &result, options);
+            if (ret < 0) return error(ret);
+            return ImageSet(result);
+        }
+
+        /**
+         * @brief Extract the images one at a time, see ImageRange; the workbook must outlive the range
+         */
+        ImageRange image_range(const XLS2IMG_EXTRACT_OPTIONS* options = nullptr,
+            std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const
+        {
+            return ImageRange(bytes(), options, resource);
+        }
+
+    private:
+        void* data_ = nullptr;
+        std::size_t size_ = 0;
+    };
+
+    /**
+     * @brief Owner of an XLS2IMG_CURSOR, the per-thread read state over a shared Reader
+     */
+    class Cursor {
+    public:
+        Cursor() noexcept = default;
+        explicit Cursor(XLS2IMG_CURSOR* cursor) noexcept : cursor_(cursor) {}
+        Cursor(Cursor&& other) noexcept : cursor_(std::exchange(other.cursor_, nullptr)) {}
+        Cursor& operator=(Cursor&& other) noexcept
+        {
+            if (this != &other)
+            {
+                xls2img_cursor_close(cursor_);
+                cursor_ = std::exchange(other.cursor_, nullptr);
+            }
+            return *this;
+        }
+        ~Cursor() { xls2img_cursor_close(cursor_); }
+
+        expected<Workbook> workbook() noexcept
+        {
+            void* data = nullptr;
+            std::size_t size = 0;
+            int ret = xls2img_cursor_get_workbook(cursor_, &data, &size);
+            if (ret < 0) return error(ret);
+            return Workbook(data, size);
+        }
+
+        expected<void> read(std::size_t offset, void* buffer, std::size_t size) noexcept
+        {
+            return detail::check(xls2img_cursor_read(cursor_, offset, buffer, size));
+        }
+
+        XLS2IMG_CURSOR* get() const noexcept { return cursor_; }
+
+    private:
+        XLS2IMG_CURSOR* cursor_ = nullptr;
+    };
+
+    /**
+     * @brief Owner of an XLS2IMG_READER
+     * @details The reader does not copy the file data, which must outlive it.
+     */
+    class Reader {
+    public:
+        Reader() noexcept = default;
+        explicit Reader(XLS2IMG_READER* reader) noexcept : reader_(reader) {}
+        Reader(Reader&& other) noexcept : reader_(std::exchange(other.reader_, nullptr)) {}
+        Reader& operator=(Reader&& other) noexcept
+        {
+            if (this != &other)
+            {
+                xls2img_close(reader_);
+                reader_ = std::exchange(other.reader_, nullptr);
+            }
+            return *this;
+        }
+        ~Reader() { xls2img_close(reader_); }
+
+        static expected<Reader> open(const void* data, std::size_t size, XLS2IMG_ALLOCATOR* allocator = nullptr) noexcept
+        {
+            XLS2IMG_READER* reader = nullptr;
+            int ret = xls2img_open_ex(&reader, data, size, allocator);
+            if (ret < 0) return error(ret);
+            return Reader(reader);
+        }
+
+        static expected<Reader> open(byte_span data, XLS2IMG_ALLOCATOR* allocator = nullptr) noexcept
+        {
+            return open(data.data(), data.size(), allocator);
+        }
+
+        expected<Workbook> workbook() const noexcept
+        {
+            void* data = nullptr;
+            std::size_t size = 0;
+            int ret = xls2img_get_workbook(reader_, &data, &size);
+            if (ret < 0) return error(ret);
+            return Workbook(data, size);
+        }
+
+        XLS2IMG_CONTAINER container() const noexcept { return xls2img_get_container(reader_); }
+
+        /**
+         * @brief Extract every image of an XLS, XLSX, DOC or PPT file at once, see xls2img_read_images
+         */
+        expected<ImageSet> images(const XLS2IMG_EXTRACT_OPTIONS* options = nullptr) const noexcept
+        {
+            XLS2IMG_RESULT result = { nullptr, 0 };
+            int ret = xls2img_read_images(reader_, &result, options);
+            if (ret < 0) return error(ret);
+            return ImageSet(result);
+        }
+
+        /**
+         * @brief Create a cursor for one thread, see xls2img_cursor_open
+         */
+        expected<Cursor> cursor(const XLS2IMG_EXTRACT_OPTIONS* options = nullptr) const noexcept
+        {
+            XLS2IMG_CURSOR* cursor = nullptr;
+            int ret = xls2img_cursor_open(&cursor, reader_, options);
+            if (ret < 0) return error(ret);
+            return Cursor(cursor);
+        }
+
+        XLS2IMG_READER* get() const noexcept { return reader_; }
+
+    private:
+        XLS2IMG_READER* reader_ = nullptr;
+    };
+
+}
+
+#endif /* XLS2IMG_HPP */
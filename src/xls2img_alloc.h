@@ -0,0 +1,156 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Internal allocation helpers
+ *
+ * Every allocation of the library goes through an XLS2IMG_ALLOCATOR, NULL meaning malloc, realloc and free.
+ * The helpers keep the allocator's byte counters up to date, so frees need the size that was allocated.
+ * Buffers the caller releases through xls2img_free_workbook_data or xls2img_free_result are blocks: they
+ * carry a small header naming their allocator and size, so the free functions need no context.
+ */
+
+#ifndef XLS2IMG_ALLOC_H
+#define XLS2IMG_ALLOC_H
+
+#include "xls2img.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef union {
+    struct {
+        XLS2IMG_ALLOCATOR* allocator;
+        size_t size;
+    } info;
+    uint64_t align[2];      // keeps the block data 16-byte aligned on 32 and 64-bit targets
+} XLS2IMG_BLOCK_HEADER;
+
+static inline void xls2img_mem_count(XLS2IMG_ALLOCATOR* allocator, size_t oldSize, size_t newSize)
+{
+    allocator->current_bytes += newSize;
+    allocator->current_bytes -= oldSize;
+    if (allocator->current_bytes > allocator->peak_bytes)
+        allocator->peak_bytes = allocator->current_bytes;
+}
+
+static inline void* xls2img_mem_alloc(XLS2IMG_ALLOCATOR* allocator, size_t size)
+{
+    if (!allocator) return malloc(size);
+
+    void* ptr = allocator->alloc ? allocator->alloc(size, allocator->user) : malloc(size);
+    if (ptr) xls2img_mem_count(allocator, 0, size);
+    return ptr;
+}
+
+static inline void* xls2img_mem_calloc(XLS2IMG_ALLOCATOR* allocator, size_t size)
+{
+    void* ptr = xls2img_mem_alloc(allocator, size);
+    if (ptr) memset(ptr, 0, size);
+    return ptr;
+}
+
+// alloc decides whose memory a block is: without it the allocator only counts and realloc and free are not called
+static inline void* xls2img_mem_realloc(XLS2IMG_ALLOCATOR* allocator, void* ptr, size_t oldSize, size_t newSize)
+{
+    if (!allocator) return realloc(ptr, newSize);
+
+    if (!ptr) oldSize = 0;
+    void* newPtr;
+    if (!allocator->alloc)
+        newPtr = realloc(ptr, newSize);
+    else if (allocator->realloc)
+        newPtr = allocator->realloc(ptr, oldSize, newSize, allocator->user);
+    else
+    {
+        // no realloc callback: move the block through the allocator's own alloc and free
+        newPtr = allocator->alloc(newSize, allocator->user);
+        if (newPtr && ptr)
+        {
+            memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+            allocator->free(ptr, oldSize, allocator->user);
+        }
+    }
+    if (newPtr) xls2img_mem_count(allocator, oldSize, newSize);
+    return newPtr;
+}
+
+static inline void xls2img_mem_free(XLS2IMG_ALLOCATOR* allocator, void* ptr, size_t size)
+{
+    if (!ptr) return;
+    if (!allocator)
+    {
+        free(ptr);
+        return;
+    }
+
+    if (allocator->alloc)
+        allocator->free(ptr, size, allocator->user);
+    else
+        free(ptr);
+    xls2img_mem_count(allocator, size, 0);
+}
+
+static inline void* xls2img_block_alloc(XLS2IMG_ALLOCATOR* allocator, size_t size)
+{
+    if (size > SIZE_MAX - sizeof(XLS2IMG_BLOCK_HEADER)) return NULL;
+
+    XLS2IMG_BLOCK_HEADER* header = (XLS2IMG_BLOCK_HEADER*)xls2img_mem_alloc(allocator, sizeof(XLS2IMG_BLOCK_HEADER) + size);
+    if (!header) return NULL;
+    header->info.allocator = allocator;
+    header->info.size = size;
+    return header + 1;
+}
+
+static inline void* xls2img_block_realloc(void* ptr, size_t size)
+{
+    XLS2IMG_BLOCK_HEADER* header = (XLS2IMG_BLOCK_HEADER*)ptr - 1;
+    if (size > SIZE_MAX - sizeof(XLS2IMG_BLOCK_HEADER)) return NULL;
+
+    XLS2IMG_BLOCK_HEADER* newHeader = (XLS2IMG_BLOCK_HEADER*)xls2img_mem_realloc(header->info.allocator, header,
+        sizeof(XLS2IMG_BLOCK_HEADER) + header->info.size, sizeof(XLS2IMG_BLOCK_HEADER) + size);
+    if (!newHeader) return NULL;
+    newHeader->info.size = size;
+    return newHeader + 1;
+}
+
+static inline XLS2IMG_ALLOCATOR* xls2img_block_allocator(void* ptr)
+{
+    return ((XLS2IMG_BLOCK_HEADER*)ptr - 1)->info.allocator;
+}
+
+static inline void xls2img_block_free(void* ptr)
+{
+    if (!ptr) return;
+
+    XLS2IMG_BLOCK_HEADER* header = (XLS2IMG_BLOCK_HEADER*)ptr - 1;
+    xls2img_mem_free(header->info.allocator, header, sizeof(XLS2IMG_BLOCK_HEADER) + header->info.size);
+}
+
+// Allocator a reader was opened with, the default for the reads through it; defined in xls2img_reader.c
+XLS2IMG_ALLOCATOR* xls2img_reader_allocator(const XLS2IMG_READER* reader);
+
+#endif /* XLS2IMG_ALLOC_H */
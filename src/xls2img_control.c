@@ -0,0 +1,87 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// clock_gettime and CLOCK_MONOTONIC are POSIX, not ISO C
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "xls2img.h"
+#include "xls2img_control.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define XLS2IMG_LOAD_FLAG(flag) _InterlockedOr((flag), 0)
+#define XLS2IMG_STORE_FLAG(flag, value) _InterlockedExchange((flag), (value))
+#else
+#define XLS2IMG_LOAD_FLAG(flag) __atomic_load_n((flag), __ATOMIC_ACQUIRE)
+#define XLS2IMG_STORE_FLAG(flag, value) __atomic_store_n((flag), (value), __ATOMIC_RELEASE)
+#endif
+
+// Monotonic, so a deadline is not moved by changes to the wall clock
+uint64_t xls2img_clock_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    uint64_t ticks = (uint64_t)counter.QuadPart;
+    uint64_t hz = (uint64_t)frequency.QuadPart;
+    // whole seconds and the remainder apart, so ticks * 10^9 cannot overflow
+    return ticks / hz * 1000000000u + ticks % hz * 1000000000u / hz;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void xls2img_cancel(XLS2IMG_CONTROL* control)
+{
+    if (control)
+        XLS2IMG_STORE_FLAG(&control->cancelled, 1);
+}
+
+int xls2img_checkpoint_poll(XLS2IMG_CHECKPOINT* checkpoint, uint64_t done)
+{
+    XLS2IMG_CONTROL* control = checkpoint->control;
+    if (XLS2IMG_LOAD_FLAG(&control->cancelled)) return XLS2IMG_ERROR_CANCELLED;
+    if (control->deadline_ns && xls2img_clock_ns() >= control->deadline_ns) return XLS2IMG_ERROR_TIMEOUT;
+
+    if (control->progress)
+    {
+        control->progress(done, checkpoint->total, control->user);
+        // the callback may cancel the read it reports on
+        if (XLS2IMG_LOAD_FLAG(&control->cancelled)) return XLS2IMG_ERROR_CANCELLED;
+    }
+    checkpoint->next = done + XLS2IMG_CONTROL_INTERVAL;
+    return XLS2IMG_SUCCESS;
+}
@@ -0,0 +1,63 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Internal cancellation checkpoints
+ *
+ * A checkpoint follows one loop through a stream or package and polls its XLS2IMG_CONTROL once the loop has
+ * advanced XLS2IMG_CONTROL_INTERVAL bytes past the previous poll. Between polls a check is one comparison, so
+ * the loops call it for every sector or record.
+ */
+
+#ifndef XLS2IMG_CONTROL_H
+#define XLS2IMG_CONTROL_H
+
+#include "xls2img.h"
+
+typedef struct {
+    XLS2IMG_CONTROL* control;       // NULL to skip every check
+    uint64_t total;                 // bytes the loop goes through, 0 if unknown
+    uint64_t next;                  // done value of the next poll, 0 polls at the first check
+} XLS2IMG_CHECKPOINT;
+
+// Polls the control: XLS2IMG_ERROR_CANCELLED or XLS2IMG_ERROR_TIMEOUT end the loop, otherwise progress is reported
+int xls2img_checkpoint_poll(XLS2IMG_CHECKPOINT* checkpoint, uint64_t done);
+
+static inline void xls2img_checkpoint_init(XLS2IMG_CHECKPOINT* checkpoint, XLS2IMG_CONTROL* control, uint64_t total)
+{
+    checkpoint->control = control;
+    checkpoint->total = total;
+    checkpoint->next = 0;
+}
+
+static inline int xls2img_checkpoint(XLS2IMG_CHECKPOINT* checkpoint, uint64_t done)
+{
+    if (!checkpoint->control || done < checkpoint->next) return XLS2IMG_SUCCESS;
+    return xls2img_checkpoint_poll(checkpoint, done);
+}
+
+#endif /* XLS2IMG_CONTROL_H */
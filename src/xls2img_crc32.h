@@ -0,0 +1,47 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * CRC-32
+ *
+ * The CRC of ISO 3309 and ITU-T V.42 that PNG chunks carry, computed eight bytes per step with slicing-by-8 tables.
+ * The copying variant stores each block it has read, so an image is checked and copied out in one pass.
+ */
+
+#ifndef XLS2IMG_CRC32_H
+#define XLS2IMG_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC of size bytes of data continuing crc, 0 to start
+uint32_t xls2img_crc32(uint32_t crc, const uint8_t* data, size_t size);
+
+// Same as xls2img_crc32, and copies the bytes to dst, which must not overlap src
+uint32_t xls2img_crc32_copy(uint32_t crc, uint8_t* dst, const uint8_t* src, size_t size);
+
+#endif /* XLS2IMG_CRC32_H */
@@ -0,0 +1,276 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// memfd_create, mremap and the file sealing commands are GNU extensions of the C library
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "xls2img.h"
+#include "xls2img_alloc.h"
+#include "xls2img_crc32.h"
+#include "xls2img_formats.h"
+#include "xls2img_stats.h"
+#include <string.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// First size asked of the grow function; it doubles from there, so an export of n bytes takes about log2(n) calls
+#define EXPORT_INITIAL_SIZE ((size_t)1 << 20)
+#define EXPORT_INITIAL_ENTRIES 16
+
+typedef struct {
+    XLS2IMG_EXPORT_FUNC grow;
+    void* user;
+    uint8_t* data;                  // last memory grow returned
+    size_t capacity;
+    size_t size;                    // bytes written
+    XLS2IMG_ALLOCATOR* allocator;   // for the table, which is kept aside until the images are written
+    XLS2IMG_EXPORT_ENTRY* entries;
+    size_t entry_capacity;
+    uint32_t count;
+    int verify;                     // check images as they are copied, the producers are told not to
+    XLS2IMG_STATS* stats;
+} ExportWriter;
+
+static size_t export_align(size_t n)
+{
+    return (n + (XLS2IMG_EXPORT_ALIGN - 1)) & ~(size_t)(XLS2IMG_EXPORT_ALIGN - 1);
+}
+
+// Makes the export memory hold at least size bytes
+static int export_reserve(ExportWriter* writer, size_t size)
+{
+    if (size <= writer->capacity) return XLS2IMG_SUCCESS;
+
+    size_t capacity = writer->capacity ? writer->capacity : EXPORT_INITIAL_SIZE;
+    while (capacity < size)
+    {
+        if (capacity > SIZE_MAX / 2) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+        capacity *= 2;
+    }
+
+    uint8_t* data = (uint8_t*)writer->grow(writer->data, capacity, writer->user);
+    if (!data) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+    writer->data = data;
+    writer->capacity = capacity;
+    return XLS2IMG_SUCCESS;
+}
+
+// Copies an image file to the end of the export, hashing it on the way, and records it in the table
+static int export_add_image(const XLS2IMG_IMAGE* image, void* user)
+{
+    ExportWriter* writer = (ExportWriter*)user;
+    if (writer->count == UINT32_MAX) return XLS2IMG_ERROR_LIMIT_EXCEEDED;
+
+    if (writer->count == writer->entry_capacity)
+    {
+        size_t capacity = writer->entry_capacity ? writer->entry_capacity * 2 : EXPORT_INITIAL_ENTRIES;
+        XLS2IMG_EXPORT_ENTRY* entries = (XLS2IMG_EXPORT_ENTRY*)xls2img_mem_realloc(writer->allocator, writer->entries,
+            writer->entry_capacity * sizeof(XLS2IMG_EXPORT_ENTRY), capacity * sizeof(XLS2IMG_EXPORT_ENTRY));
+        if (!entries) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+        writer->entries = entries;
+        writer->entry_capacity = capacity;
+    }
+
+    size_t offset = export_align(writer->size);
+    size_t size = image->prefix_size + image->size;
+    if (offset < writer->size || size < image->size || offset > SIZE_MAX - size) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+    int ret = export_reserve(writer, offset + size);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+
+    // the gap left by the alignment is zeroed, so the export depends on the images alone
+    uint8_t* dst = writer->data + offset;
+    memset(writer->data + writer->size, 0, offset - writer->size);
+    uint32_t hash = xls2img_crc32_copy(0, dst, (const uint8_t*)image->prefix, image->prefix_size);
+    unsigned int check = 0;
+    if (writer->verify)
+    {
+        check = xls2img_verify(image->format, (const uint8_t*)image->data, image->size, dst + image->prefix_size);
+        hash = xls2img_crc32(hash, dst + image->prefix_size, image->size);
+    }
+    else
+        hash = xls2img_crc32_copy(hash, dst + image->prefix_size, (const uint8_t*)image->data, image->size);
+    XLS2IMG_STAT_ADD(writer->stats, bytes_copied, size);
+
+    XLS2IMG_EXPORT_ENTRY* entry = &writer->entries[writer->count++];
+    entry->offset = offset;
+    entry->size = size;
+    entry->source_offset = image->offset;
+    entry->format = (uint32_t)image->format;
+    entry->hash = hash;
+    entry->check = check;
+    entry->reserved = 0;
+    writer->size = offset + size;
+    return XLS2IMG_SUCCESS;
+}
+
+// Appends the table and fills in the header
+static int export_finish(ExportWriter* writer)
+{
+    size_t table_offset = (writer->size + 7) & ~(size_t)7;
+    size_t table_size = (size_t)writer->count * sizeof(XLS2IMG_EXPORT_ENTRY);
+    if (table_offset < writer->size || table_offset > SIZE_MAX - table_size) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+    int ret = export_reserve(writer, table_offset + table_size);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+
+    memset(writer->data + writer->size, 0, table_offset - writer->size);
+    if (table_size)
+        memcpy(writer->data + table_offset, writer->entries, table_size);
+    writer->size = table_offset + table_size;
+
+    XLS2IMG_EXPORT_HEADER header;
+    memset(&header, 0, sizeof(header));
+    header.magic = XLS2IMG_EXPORT_MAGIC;
+    header.version = XLS2IMG_EXPORT_VERSION;
+    header.count = writer->count;
+    header.entry_size = (uint32_t)sizeof(XLS2IMG_EXPORT_ENTRY);
+    header.table_offset = table_offset;
+    header.size = writer->size;
+    memcpy(writer->data, &header, sizeof(header));
+    return XLS2IMG_SUCCESS;
+}
+
+int xls2img_export_images(const XLS2IMG_READER* reader, XLS2IMG_EXPORT_FUNC grow, void* user, void** data, size_t* size,
+    const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    if (!reader || !grow || !data || !size) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    *data = NULL;
+    *size = 0;
+
+    XLS2IMG_EXTRACT_OPTIONS resolved;
+    if (options)
+        resolved = *options;
+    else
+        memset(&resolved, 0, sizeof(resolved));
+    if (!resolved.allocator)
+        resolved.allocator = xls2img_reader_allocator(reader);
+
+    ExportWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.grow = grow;
+    writer.user = user;
+    writer.allocator = resolved.allocator;
+    writer.verify = resolved.verify;
+    writer.stats = resolved.stats;
+
+    // the images follow the header, the table follows the images once their count is known
+    int ret = export_reserve(&writer, export_align(sizeof(XLS2IMG_EXPORT_HEADER)));
+    if (ret == XLS2IMG_SUCCESS)
+    {
+        writer.size = export_align(sizeof(XLS2IMG_EXPORT_HEADER));
+        memset(writer.data, 0, writer.size);
+
+        // the writer checks the images it copies
+        resolved.verify = 0;
+        ret = xls2img_stream_images(reader, export_add_image, &writer, &resolved);
+        if (ret >= 0 || ret == XLS2IMG_ERROR_NO_IMAGES)
+            ret = export_finish(&writer);
+    }
+    xls2img_mem_free(writer.allocator, writer.entries, writer.entry_capacity * sizeof(XLS2IMG_EXPORT_ENTRY));
+
+    // on failure the memory is still handed back, it is the caller's to release
+    *data = writer.data;
+    if (ret != XLS2IMG_SUCCESS) return ret;
+    *size = writer.size;
+    return XLS2IMG_SUCCESS;
+}
+
+#if defined(__linux__)
+
+typedef struct {
+    int fd;
+    void* map;
+    size_t map_size;
+} MemfdExport;
+
+// Grows the memfd and its mapping; mremap moves the pages rather than copying them
+static void* memfd_grow(void* base, size_t size, void* user)
+{
+    MemfdExport* memfd = (MemfdExport*)user;
+    if (ftruncate(memfd->fd, (off_t)size) != 0) return NULL;
+
+    void* map = base ? mremap(base, memfd->map_size, size, MREMAP_MAYMOVE) :
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd->fd, 0);
+    if (map == MAP_FAILED) return NULL;
+    memfd->map = map;
+    memfd->map_size = size;
+    return map;
+}
+
+int xls2img_export_memfd(const XLS2IMG_READER* reader, int* fd, size_t* size, const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    if (!reader || !fd || !size) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    *fd = -1;
+    *size = 0;
+
+    MemfdExport memfd;
+    memset(&memfd, 0, sizeof(memfd));
+    memfd.fd = memfd_create("xls2img", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd.fd < 0)
+        return errno == ENOSYS || errno == EINVAL ? XLS2IMG_ERROR_UNSUPPORTED : XLS2IMG_ERROR_OUT_OF_MEMORY;
+
+    void* data = NULL;
+    size_t export_size = 0;
+    int ret = xls2img_export_images(reader, memfd_grow, &memfd, &data, &export_size, options);
+    if (memfd.map)
+        munmap(memfd.map, memfd.map_size);
+
+    // with the writable mapping gone the contents can be frozen: the receiver maps a file that never changes
+    if (ret == XLS2IMG_SUCCESS &&
+        (ftruncate(memfd.fd, (off_t)export_size) != 0 ||
+            fcntl(memfd.fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0))
+        ret = XLS2IMG_ERROR_OUT_OF_MEMORY;
+    if (ret != XLS2IMG_SUCCESS)
+    {
+        close(memfd.fd);
+        return ret;
+    }
+
+    *fd = memfd.fd;
+    *size = export_size;
+    return XLS2IMG_SUCCESS;
+}
+
+#else
+
+int xls2img_export_memfd(const XLS2IMG_READER* reader, int* fd, size_t* size, const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    (void)reader;
+    (void)options;
+    if (fd) *fd = -1;
+    if (size) *size = 0;
+    return XLS2IMG_ERROR_UNSUPPORTED;
+}
+
+#endif
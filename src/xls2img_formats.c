@@ -0,0 +1,652 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "xls2img_formats.h"
+#include "xls2img_crc32.h"
+#include <string.h>
+
+#if defined(XLS2IMG_WITH_GIF) || defined(XLS2IMG_WITH_BMP) || defined(XLS2IMG_WITH_TIFF) || defined(XLS2IMG_WITH_WMF)
+static uint16_t read_le16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+#endif
+
+#if defined(XLS2IMG_WITH_BMP) || defined(XLS2IMG_WITH_TIFF) || defined(XLS2IMG_WITH_EMF) || defined(XLS2IMG_WITH_WMF)
+static uint32_t read_le32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+#endif
+
+#ifdef XLS2IMG_WITH_BMP
+static void write_le32(uint8_t* p, uint32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+#endif
+
+#if defined(XLS2IMG_WITH_GIF) || defined(XLS2IMG_WITH_BMP) || defined(XLS2IMG_WITH_TIFF) || defined(XLS2IMG_WITH_EMF) || \
+    defined(XLS2IMG_WITH_WMF)
+// An end found from the header, if the image lies within the data
+static ptrdiff_t size_within(uint64_t size, size_t available)
+{
+    return size > 0 && size <= available && size <= PTRDIFF_MAX ? (ptrdiff_t)size : -1;
+}
+#endif
+
+#ifdef XLS2IMG_WITH_PNG
+// PNG Signature: 89 50 4E 47 0D 0A 1A 0A
+static int png_match(const uint8_t* p)
+{
+    return p[0] == 0x89 && p[1] == 0x50 && p[2] == 0x4E && p[3] == 0x47 &&
+        p[4] == 0x0D && p[5] == 0x0A && p[6] == 0x1A && p[7] == 0x0A;
+}
+
+ptrdiff_t xls2img_find_png_end(const uint8_t* data, size_t size)
+{
+    if (size < 8) return -1;
+
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+
+    if (!(p[0] == 0x89 && p[1] == 0x50 && p[2] == 0x4E && p[3] == 0x47))
+        return -1;
+
+    p += 8;
+
+    while (p < end)
+    {
+        if (end - p < 8) return -1;
+
+        uint32_t chunk_len = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        const uint8_t* chunk_type = p + 4;
+
+        // the chunk, CRC included, must lie within the data
+        if (end - p < 12 || chunk_len > (size_t)(end - p) - 12) return -1;
+
+        if (chunk_type[0] == 'I' && chunk_type[1] == 'E' &&
+            chunk_type[2] == 'N' && chunk_type[3] == 'D')
+            return (p + 12) - data; // 4(Len) + 4(Type) + 4(CRC)
+
+        p += 12 + chunk_len;
+    }
+    return -1;
+}
+
+static uint32_t read_be32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// The signature, IHDR first, every chunk within the image and its CRC matching, up to IEND; bytes behind IEND are
+// copied unchecked. Each chunk is copied by the CRC loop that reads it.
+static unsigned int png_verify(const uint8_t* image, size_t size, uint8_t* copy)
+{
+    unsigned int check = XLS2IMG_CHECK_VERIFIED;
+    size_t pos = 0;
+    int ended = 0;
+    if (size >= 8 && png_match(image))
+    {
+        if (copy)
+            memcpy(copy, image, 8);
+        pos = 8;
+        while (!ended && size - pos >= 12)
+        {
+            uint32_t len = read_be32(image + pos);
+            const uint8_t* type = image + pos + 4;
+            if (len > 0x7FFFFFFFu || len > size - pos - 12 || (pos == 8) != (memcmp(type, "IHDR", 4) == 0))
+                break;
+
+            uint32_t crc;
+            if (copy)
+            {
+                memcpy(copy + pos, image + pos, 4);
+                crc = xls2img_crc32_copy(0, copy + pos + 4, type, len + 4);
+                memcpy(copy + pos + 8 + len, type + 4 + len, 4);
+            }
+            else
+                crc = xls2img_crc32(0, type, len + 4);
+            if (crc != read_be32(type + 4 + len))
+                check |= XLS2IMG_CHECK_BAD_CRC;
+
+            ended = memcmp(type, "IEND", 4) == 0;
+            pos += 12 + (size_t)len;
+        }
+    }
+
+    if (copy)
+        memcpy(copy + pos, image + pos, size - pos);
+    if (!ended)
+        check |= XLS2IMG_CHECK_BAD_STRUCTURE;
+    return check;
+}
+#endif
+
+#ifdef XLS2IMG_WITH_JPG
+// SOI, then APP0 with the JFIF identifier or APP1 with the Exif identifier; the segment length is not checked
+static int jpg_match(const uint8_t* p)
+{
+    if (p[0] != 0xFF || p[1] != 0xD8 || p[2] != 0xFF)
+        return 0;
+    if (p[3] == 0xE0)
+        return p[6] == 'J' && p[7] == 'F' && p[8] == 'I' && p[9] == 'F';
+    if (p[3] == 0xE1)
+        return p[6] == 'E' && p[7] == 'x' && p[8] == 'i' && p[9] == 'f';
+    return 0;
+}
+
+ptrdiff_t xls2img_find_jpg_end(const uint8_t* start_search_from, const uint8_t* actual_start_of_last_jpg)
+{
+    const uint8_t* p = start_search_from - 2;
+    const uint8_t* limit = actual_start_of_last_jpg;
+
+    while (p >= limit)
+    {
+        if (p[0] == 0xFF && p[1] == 0xD9)
+            return (p + 2) - actual_start_of_last_jpg; // Returns the size relative to the previous JPEG starting position
+        p--;
+    }
+    return -1;
+}
+
+// The last EOI before the next header
+static ptrdiff_t jpg_end(const uint8_t* image, size_t available)
+{
+    return xls2img_find_jpg_end(image + available, image);
+}
+
+// The marker segments from SOI to EOI: each within the image, a frame header before the first scan, and the
+// entropy-coded data behind each scan header running to a marker other than RSTn. Bytes behind EOI are not checked.
+// JPEG has no checksum and the walk reads only segment headers and searches the scan data, so it copies with memcpy.
+static unsigned int jpg_verify(const uint8_t* image, size_t size, uint8_t* copy)
+{
+    const unsigned int bad = XLS2IMG_CHECK_VERIFIED | XLS2IMG_CHECK_BAD_STRUCTURE;
+    if (copy)
+        memcpy(copy, image, size);
+    if (size < 4 || image[0] != 0xFF || image[1] != 0xD8)
+        return bad;
+
+    int frame = 0;
+    int scan = 0;
+    size_t pos = 2;
+    while (pos < size && image[pos] == 0xFF)
+    {
+        // a marker may be preceded by fill bytes
+        while (pos < size && image[pos] == 0xFF)
+            pos++;
+        if (pos == size)
+            break;
+        uint8_t marker = image[pos++];
+        if (marker == 0xD9)
+            return scan ? XLS2IMG_CHECK_VERIFIED : bad;
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+            continue;
+        if (marker == 0x00 || marker == 0xD8 || size - pos < 2)
+            break;
+
+        size_t len = ((size_t)image[pos] << 8) | image[pos + 1];
+        if (len < 2 || len > size - pos)
+            break;
+        pos += len;
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+            frame = 1;
+        if (marker != 0xDA)
+            continue;
+        if (!frame)
+            break;
+        scan = 1;
+
+        // stuffed 0xFF 0x00 and restart markers belong to the scan data
+        const uint8_t* ff;
+        while ((ff = (const uint8_t*)memchr(image + pos, 0xFF, size - pos)) != NULL)
+        {
+            pos = (size_t)(ff - image);
+            if (size - pos < 2 || (ff[1] != 0x00 && (ff[1] < 0xD0 || ff[1] > 0xD7)))
+                break;
+            pos += 2;
+        }
+        if (!ff)
+            break;
+    }
+    return bad;
+}
+#endif
+
+#ifdef XLS2IMG_WITH_GIF
+// GIF87a or GIF89a and a logical screen of nonzero width and height
+static int gif_match(const uint8_t* p)
+{
+    return p[0] == 'G' && p[1] == 'I' && p[2] == 'F' && p[3] == '8' && (p[4] == '7' || p[4] == '9') && p[5] == 'a' &&
+        read_le16(p + 6) != 0 && read_le16(p + 8) != 0;
+}
+
+// Walks the blocks after the logical screen descriptor up to the trailer
+static ptrdiff_t gif_end(const uint8_t* image, size_t available)
+{
+    size_t pos = 13;
+    if (available < pos) return -1;
+    if (image[10] & 0x80)
+        pos += (size_t)3 << ((image[10] & 7) + 1);   // global color table
+
+    while (pos < available)
+    {
+        uint8_t block = image[pos++];
+        if (block == 0x3B)
+            return size_within(pos, available);
+
+        if (block == 0x2C)
+        {
+            // image descriptor, local color table and LZW minimum code size
+            if (available - pos < 10) return -1;
+            uint8_t flags = image[pos + 8];
+            pos += 9;
+            if (flags & 0x80)
+                pos += (size_t)3 << ((flags & 7) + 1);
+            pos++;
+        }
+        else if (block == 0x21)
+            pos++;      // extension label
+        else
+            return -1;
+
+        // data sub-blocks up to the zero-length terminator
+        for (;;)
+        {
+            if (pos >= available) return -1;
+            uint8_t len = image[pos++];
+            if (len == 0) break;
+            pos += len;
+        }
+    }
+    return -1;
+}
+#endif
+
+#ifdef XLS2IMG_WITH_BMP
+static int dib_header_size_valid(uint32_t size)
+{
+    return size == 40 || size == 52 || size == 56 || size == 108 || size == 124;
+}
+
+// A .bmp file: "BM", zero reserved fields and a pixel offset past the info header
+static int bmp_match(const uint8_t* p)
+{
+    uint32_t file_size = read_le32(p + 2);
+    uint32_t bits_offset = read_le32(p + 10);
+    uint32_t info_size = read_le32(p + 14);
+    return p[0] == 'B' && p[1] == 'M' && read_le32(p + 6) == 0 && (info_size == 12 || dib_header_size_valid(info_size)) &&
+        bits_offset >= 14 + info_size && file_size >= bits_offset;
+}
+
+static uint32_t bmp_size(const uint8_t* image)
+{
+    return read_le32(image + 2);
+}
+
+static ptrdiff_t bmp_end(const uint8_t* image, size_t available)
+{
+    return size_within(bmp_size(image), available);
+}
+
+// A DIB blip: the blip tag byte, then a BITMAPINFOHEADER or a later version of it with one plane, a valid bit count
+// and a known compression
+static int dib_match(const uint8_t* p)
+{
+    const uint8_t* info = p + 1;
+    int32_t width = (int32_t)read_le32(info + 4);
+    int32_t height = (int32_t)read_le32(info + 8);
+    uint16_t bit_count = read_le16(info + 14);
+    if (p[0] != 0xFF || !dib_header_size_valid(read_le32(info)) || width <= 0 || height == 0 || read_le16(info + 12) != 1)
+        return 0;
+    if (bit_count != 1 && bit_count != 4 && bit_count != 8 && bit_count != 16 && bit_count != 24 && bit_count != 32)
+        return 0;
+    return read_le32(info + 16) <= 6;
+}
+
+// Size of a DIB and the offset of its pixels, 0 if the header is incomplete or inconsistent
+static uint64_t dib_layout(const uint8_t* dib, size_t available, uint64_t* bits_offset)
+{
+    if (available < 40) return 0;
+
+    uint32_t info_size = read_le32(dib);
+    int64_t width = (int32_t)read_le32(dib + 4);
+    int64_t height = (int32_t)read_le32(dib + 8);
+    uint32_t bit_count = read_le16(dib + 14);
+    uint32_t compression = read_le32(dib + 16);
+    uint32_t colors = read_le32(dib + 32);
+    if (available < info_size || colors > 65536) return 0;
+    if (colors == 0 && bit_count <= 8)
+        colors = 1u << bit_count;
+
+    // a plain BITMAPINFOHEADER is followed by the channel masks of BI_BITFIELDS and BI_ALPHABITFIELDS
+    uint64_t masks = info_size == 40 && compression == 3 ? 12 : info_size == 40 && compression == 6 ? 16 : 0;
+    uint64_t offset = info_size + masks + (uint64_t)colors * 4;
+
+    uint64_t pixels;
+    if (compression == 0 || compression == 3 || compression == 6)
+        pixels = (((uint64_t)width * bit_count + 31) / 32) * 4 * (uint64_t)(height < 0 ? -height : height);
+    else
+        pixels = read_le32(dib + 20);  // RLE, JPEG and PNG data give their size in biSizeImage
+    if (pixels == 0) return 0;
+
+    *bits_offset = offset;
+    return offset + pixels;
+}
+
+static ptrdiff_t dib_end(const uint8_t* image, size_t available)
+{
+    uint64_t bits_offset;
+    uint64_t size = dib_layout(image, available, &bits_offset);
+    return size < UINT32_MAX - 14 ? size_within(size, available) : -1;
+}
+
+// The BITMAPFILEHEADER that makes the DIB a .bmp file
+static size_t dib_prefix(const uint8_t* image, size_t size, uint8_t* prefix)
+{
+    uint64_t bits_offset = 0;
+    dib_layout(image, size, &bits_offset);
+    prefix[0] = 'B';
+    prefix[1] = 'M';
+    write_le32(prefix + 2, (uint32_t)(14 + size));
+    write_le32(prefix + 6, 0);
+    write_le32(prefix + 10, (uint32_t)(14 + bits_offset));
+    return 14;
+}
+#endif
+
+#ifdef XLS2IMG_WITH_TIFF
+#define TIFF_MAX_IFDS 64
+
+static uint32_t tiff_read16(const uint8_t* p, int big_endian)
+{
+    return big_endian ? (uint32_t)((p[0] << 8) | p[1]) : read_le16(p);
+}
+
+static uint32_t tiff_read32(const uint8_t* p, int big_endian)
+{
+    return big_endian ? ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3] : read_le32(p);
+}
+
+static uint32_t tiff_type_size(uint32_t type)
+{
+    static const uint8_t sizes[13] = { 0, 1, 1, 2, 4, 8, 1, 1, 2, 4, 8, 4, 8 };
+    return type < 13 ? sizes[type] : 0;
+}
+
+// A TIFF blip: the blip tag byte, then "II*\0" or "MM\0*" and the offset of the first IFD. The tag keeps the TIFF
+// header inside the Exif segment of a JPEG, which follows "Exif\0\0", from matching.
+static int tiff_match(const uint8_t* p)
+{
+    const uint8_t* t = p + 1;
+    if (p[0] != 0xFF)
+        return 0;
+    if (t[0] == 'I' && t[1] == 'I' && t[2] == 42 && t[3] == 0)
+        return read_le32(t + 4) >= 8;
+    if (t[0] == 'M' && t[1] == 'M' && t[2] == 0 && t[3] == 42)
+        return tiff_read32(t + 4, 1) >= 8;
+    return 0;
+}
+
+// Value index of a SHORT or LONG entry whose values have been checked to lie within the data
+static uint32_t tiff_entry_value(const uint8_t* image, const uint8_t* entry, uint32_t index, int big_endian)
+{
+    uint32_t type = tiff_read16(entry + 2, big_endian);
+    uint32_t size = type == 3 ? 2 : 4;
+    const uint8_t* values = (uint64_t)tiff_read32(entry + 4, big_endian) * size <= 4 ? entry + 8 : image + tiff_read32(entry + 8, big_endian);
+    return size == 2 ? tiff_read16(values + index * 2, big_endian) : tiff_read32(values + index * 4, big_endian);
+}
+
+// TIFF has no end marker: the image ends with the furthest of its IFDs, out-of-line values and strips or tiles
+static ptrdiff_t tiff_end(const uint8_t* image, size_t available)
+{
+    // offset tags and the byte count tags that go with them: strips, tiles and the JPEG interchange format
+    static const uint16_t offset_tags[3] = { 273, 324, 513 };
+    static const uint16_t count_tags[3] = { 279, 325, 514 };
+
+    if (available < 8) return -1;
+    int big_endian = image[0] == 'M';
+    uint64_t end = 8;
+    uint32_t ifd = tiff_read32(image + 4, big_endian);
+
+    for (int n = 0; ifd != 0 && n < TIFF_MAX_IFDS; n++)
+    {
+        if (ifd < 8 || (uint64_t)ifd + 2 > available) return -1;
+        uint32_t entry_count = tiff_read16(image + ifd, big_endian);
+        uint64_t ifd_end = (uint64_t)ifd + 2 + (uint64_t)entry_count * 12 + 4;
+        if (ifd_end > available) return -1;
+        if (ifd_end > end) end = ifd_end;
+
+        const uint8_t* offsets[3] = { NULL, NULL, NULL };
+        const uint8_t* counts[3] = { NULL, NULL, NULL };
+        for (uint32_t e = 0; e < entry_count; e++)
+        {
+            const uint8_t* entry = image + ifd + 2 + (size_t)e * 12;
+            uint32_t tag = tiff_read16(entry, big_endian);
+            uint32_t type = tiff_read16(entry + 2, big_endian);
+            uint64_t bytes = (uint64_t)tiff_read32(entry + 4, big_endian) * tiff_type_size(type);
+            if (bytes > 4)
+            {
+                uint64_t values_end = (uint64_t)tiff_read32(entry + 8, big_endian) + bytes;
+                if (values_end > available) return -1;
+                if (values_end > end) end = values_end;
+            }
+            for (int t = 0; t < 3; t++)
+            {
+                if (tag == offset_tags[t] && (type == 3 || type == 4))
+                    offsets[t] = entry;
+                else if (tag == count_tags[t] && (type == 3 || type == 4))
+                    counts[t] = entry;
+            }
+        }
+
+        for (int t = 0; t < 3; t++)
+        {
+            if (!offsets[t] || !counts[t])
+                continue;
+            uint32_t n_offsets = tiff_read32(offsets[t] + 4, big_endian);
+            uint32_t n_counts = tiff_read32(counts[t] + 4, big_endian);
+            uint32_t pieces = n_offsets < n_counts ? n_offsets : n_counts;
+            for (uint32_t i = 0; i < pieces; i++)
+            {
+                uint64_t piece_end = (uint64_t)tiff_entry_value(image, offsets[t], i, big_endian) +
+                    tiff_entry_value(image, counts[t], i, big_endian);
+                if (piece_end > available) return -1;
+                if (piece_end > end) end = piece_end;
+            }
+        }
+
+        ifd = tiff_read32(image + ifd + 2 + (size_t)entry_count * 12, big_endian);
+    }
+    return size_within(end, available);
+}
+#endif
+
+#ifdef XLS2IMG_WITH_EMF
+// EMR_HEADER: record type 1, the " EMF" signature and a file size that holds the header
+static int emf_match(const uint8_t* p)
+{
+    uint32_t header_size = read_le32(p + 4);
+    uint32_t file_size = read_le32(p + 48);
+    return read_le32(p) == 1 && read_le32(p + 40) == 0x464D4520 && header_size >= 88 && header_size <= file_size &&
+        (file_size & 3) == 0;
+}
+
+static uint32_t emf_size(const uint8_t* image)
+{
+    return read_le32(image + 48);
+}
+
+static ptrdiff_t emf_end(const uint8_t* image, size_t available)
+{
+    return size_within(emf_size(image), available);
+}
+#endif
+
+#ifdef XLS2IMG_WITH_WMF
+#define WMF_PLACEABLE_KEY 0x9AC6CDD7
+
+// METAHEADER: memory or disk metafile, 9-word header, version 1 or 3 and no parameters
+static int wmf_header_valid(const uint8_t* h)
+{
+    uint32_t type = read_le16(h);
+    uint32_t version = read_le16(h + 4);
+    return (type == 1 || type == 2) && read_le16(h + 2) == 9 && (version == 0x0100 || version == 0x0300) &&
+        read_le16(h + 16) == 0;
+}
+
+// A METAHEADER, or the 22-byte placeable header with a valid checksum in front of one
+static int wmf_match(const uint8_t* p)
+{
+    if (read_le32(p) != WMF_PLACEABLE_KEY)
+        return wmf_header_valid(p);
+
+    uint16_t checksum = 0;
+    for (int i = 0; i < 10; i++)
+        checksum ^= read_le16(p + i * 2);
+    return read_le16(p + 4) == 0 && checksum == read_le16(p + 20) && wmf_header_valid(p + 22);
+}
+
+// The size in words from the METAHEADER, behind the placeable header if there is one
+static uint32_t wmf_size(const uint8_t* image)
+{
+    uint32_t start = read_le32(image) == WMF_PLACEABLE_KEY ? 22 : 0;
+    uint32_t words = read_le32(image + start + 6);
+    return words < (UINT32_MAX - start) / 2 ? start + words * 2 : 0;
+}
+
+// The stated size, confirmed by the META_EOF record the metafile ends with
+static ptrdiff_t wmf_end(const uint8_t* image, size_t available)
+{
+    size_t start = read_le32(image) == WMF_PLACEABLE_KEY ? 22 : 0;
+    if (available < start + 18) return -1;
+
+    uint64_t size = wmf_size(image);
+    if (size < start + 18 + 6 || size > available) return -1;
+
+    const uint8_t* eof = image + size - 6;
+    if (read_le32(eof) != 3 || read_le16(eof + 4) != 0) return -1;
+    return size_within(size, available);
+}
+#endif
+
+const XLS2IMG_FORMAT_DESC xls2img_formats[] = {
+#ifdef XLS2IMG_WITH_PNG
+    { XLS2IMG_PNG, { 0x89, 0, 0 }, 0, 8, 0, png_match, xls2img_find_png_end, NULL, NULL, png_verify },
+#endif
+#ifdef XLS2IMG_WITH_JPG
+    { XLS2IMG_JPG, { 0xFF, 0, 0 }, 0, 10, 1, jpg_match, jpg_end, NULL, NULL, jpg_verify },
+#endif
+#ifdef XLS2IMG_WITH_GIF
+    { XLS2IMG_GIF, { 'G', 0, 0 }, 0, 10, 0, gif_match, gif_end, NULL, NULL, NULL },
+#endif
+#ifdef XLS2IMG_WITH_BMP
+    { XLS2IMG_BMP, { 'B', 0, 0 }, 0, 18, 0, bmp_match, bmp_end, bmp_size, NULL, NULL },
+    { XLS2IMG_BMP, { 0xFF, 0, 0 }, 1, 21, 0, dib_match, dib_end, NULL, dib_prefix, NULL },
+#endif
+#ifdef XLS2IMG_WITH_TIFF
+    { XLS2IMG_TIFF, { 0xFF, 0, 0 }, 1, 9, 0, tiff_match, tiff_end, NULL, NULL, NULL },
+#endif
+#ifdef XLS2IMG_WITH_EMF
+    { XLS2IMG_EMF, { 0x01, 0, 0 }, 0, 52, 0, emf_match, emf_end, emf_size, NULL, NULL },
+#endif
+#ifdef XLS2IMG_WITH_WMF
+    { XLS2IMG_WMF, { 0x01, 0x02, 0xD7 }, 0, 40, 0, wmf_match, wmf_end, wmf_size, NULL, NULL },
+#endif
+};
+
+const size_t xls2img_format_count = sizeof(xls2img_formats) / sizeof(xls2img_formats[0]);
+
+unsigned int xls2img_get_formats(void)
+{
+    unsigned int formats = 0;
+    for (size_t i = 0; i < xls2img_format_count; i++)
+        formats |= XLS2IMG_FORMAT_MASK(xls2img_formats[i].format);
+    return formats;
+}
+
+unsigned int xls2img_verify(XLS2IMG_FORMAT format, const uint8_t* image, size_t size, uint8_t* copy)
+{
+    for (size_t i = 0; i < xls2img_format_count; i++)
+        if (xls2img_formats[i].format == format && xls2img_formats[i].verify)
+            return xls2img_formats[i].verify(image, size, copy);
+    if (copy)
+        memcpy(copy, image, size);
+    return 0;
+}
+
+unsigned int xls2img_verify_image(XLS2IMG_FORMAT format, const void* data, size_t size)
+{
+    if (!data)
+        return 0;
+    return xls2img_verify(format, (const uint8_t*)data, size, NULL);
+}
+
+XLS2IMG_FORMAT xls2img_format_from_name(const char* name, size_t len)
+{
+    static const struct {
+        const char* extension;
+        XLS2IMG_FORMAT format;
+    } aliases[] = { { "jpeg", XLS2IMG_JPG }, { "jpe", XLS2IMG_JPG }, { "tiff", XLS2IMG_TIFF } };
+
+    size_t dot = len;
+    while (dot > 0 && name[dot - 1] != '.' && name[dot - 1] != '/')
+        dot--;
+    if (dot == 0 || name[dot - 1] != '.' || len - dot > 4)
+        return XLS2IMG_UNKNOWN;
+
+    char extension[5];
+    for (size_t i = dot; i < len; i++)
+        extension[i - dot] = (char)(name[i] >= 'A' && name[i] <= 'Z' ? name[i] - 'A' + 'a' : name[i]);
+    extension[len - dot] = '\0';
+
+    XLS2IMG_FORMAT format = XLS2IMG_UNKNOWN;
+    for (size_t i = 0; i < sizeof(aliases) / sizeof(aliases[0]); i++)
+        if (strcmp(extension, aliases[i].extension) == 0)
+            format = aliases[i].format;
+    for (int f = XLS2IMG_PNG; f <= XLS2IMG_WMF && format == XLS2IMG_UNKNOWN; f++)
+        if (strcmp(extension, xls2img_format_extension((XLS2IMG_FORMAT)f)) == 0)
+            format = (XLS2IMG_FORMAT)f;
+    return xls2img_get_formats() & XLS2IMG_FORMAT_MASK(format) ? format : XLS2IMG_UNKNOWN;
+}
+
+const char* xls2img_format_extension(XLS2IMG_FORMAT format)
+{
+    switch (format)
+    {
+        case XLS2IMG_PNG:   return "png";
+        case XLS2IMG_JPG:   return "jpg";
+        case XLS2IMG_GIF:   return "gif";
+        case XLS2IMG_BMP:   return "bmp";
+        case XLS2IMG_TIFF:  return "tif";
+        case XLS2IMG_EMF:   return "emf";
+        case XLS2IMG_WMF:   return "wmf";
+        default:            return "bin";
+    }
+}
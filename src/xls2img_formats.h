@@ -0,0 +1,93 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Image format registry
+ *
+ * Each format the scanner recognizes is a descriptor: the bytes its signature can start with, a match function
+ * that checks the signature and the header fields behind it, and an end finder that returns the image size once
+ * the data up to the next header is known. A format that states its size in the header also reports it, so the
+ * headers it embeds (the METAHEADER of a placeable WMF, a PNG in an EMF+ record) are skipped rather than taken for
+ * the next image. The scanner builds its lead byte table from the descriptors, so a new
+ * format adds table entries rather than a pass over the data. A format whose structure can be checked without
+ * decoding pixels has a verify function, which XLS2IMG_EXTRACT_OPTIONS.verify runs on every image.
+ */
+
+#ifndef XLS2IMG_FORMATS_H
+#define XLS2IMG_FORMATS_H
+
+#include "xls2img.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Formats compiled in, XLS2IMG_FORMATS in CMake; a build that names none gets all of them
+#if !defined(XLS2IMG_WITH_PNG) && !defined(XLS2IMG_WITH_JPG) && !defined(XLS2IMG_WITH_GIF) && \
+    !defined(XLS2IMG_WITH_BMP) && !defined(XLS2IMG_WITH_TIFF) && !defined(XLS2IMG_WITH_EMF) && !defined(XLS2IMG_WITH_WMF)
+#define XLS2IMG_WITH_PNG
+#define XLS2IMG_WITH_JPG
+#define XLS2IMG_WITH_GIF
+#define XLS2IMG_WITH_BMP
+#define XLS2IMG_WITH_TIFF
+#define XLS2IMG_WITH_EMF
+#define XLS2IMG_WITH_WMF
+#endif
+
+// Largest lookahead of any match function, and the smallest, which the last positions of a drawing group get
+#define XLS2IMG_SCAN_LOOKAHEAD 52
+#define XLS2IMG_SCAN_MIN_LOOKAHEAD 10
+
+// Largest synthesized prefix, the BITMAPFILEHEADER of a DIB
+#define XLS2IMG_MAX_PREFIX 14
+
+typedef struct {
+    XLS2IMG_FORMAT format;
+    uint8_t leads[3];           // bytes a signature can start with, 0 for unused slots
+    uint8_t skip;               // signature bytes before the image, the blip tag byte of TIFF and DIB
+    uint8_t lookahead;          // bytes from the lead byte the match function reads
+    uint8_t bounded_by_next;    // the end is searched backwards from the next header of any format
+    int (*match)(const uint8_t* p);
+    ptrdiff_t (*find_end)(const uint8_t* image, size_t available);              // image size, -1 if incomplete
+    uint32_t (*declared_size)(const uint8_t* image);                            // NULL if the header states none
+    size_t (*prefix)(const uint8_t* image, size_t size, uint8_t* prefix);       // NULL if the image needs none
+    unsigned int (*verify)(const uint8_t* image, size_t size, uint8_t* copy);  // XLS2IMG_CHECK_* bits, NULL if unchecked
+} XLS2IMG_FORMAT_DESC;
+
+// Built-in formats, in the order they are tried at a shared lead byte
+extern const XLS2IMG_FORMAT_DESC xls2img_formats[];
+extern const size_t xls2img_format_count;
+
+// Built-in format a file name's extension names, XLS2IMG_UNKNOWN if none does
+XLS2IMG_FORMAT xls2img_format_from_name(const char* name, size_t len);
+
+// XLS2IMG_CHECK_* bits of an image, 0 for a format without a check. copy, if not NULL, receives the size bytes of
+// the image; a check that reads all of them copies them in the same pass.
+unsigned int xls2img_verify(XLS2IMG_FORMAT format, const uint8_t* image, size_t size, uint8_t* copy);
+
+ptrdiff_t xls2img_find_png_end(const uint8_t* data, size_t size);
+ptrdiff_t xls2img_find_jpg_end(const uint8_t* start_search_from, const uint8_t* actual_start_of_last_jpg);
+
+#endif /* XLS2IMG_FORMATS_H */
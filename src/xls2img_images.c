@@ -25,6 +25,13 @@
  */
 
 #include "xls2img.h"
+#include "xls2img_alloc.h"
+#include "xls2img_control.h"
+#include "xls2img_formats.h"
+#include "xls2img_parser.h"
+#include "xls2img_stats.h"
+#include "xls2img_trace.h"
+#include <limits.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -36,148 +43,191 @@ enum {
     BIFF8_CONTINUE = 0x003C,
 };
 
-// Image processing
-static XLS2IMG_FORMAT xls2img_identify_format(const uint8_t* data)
-{
-    // PNG Signature
-    if (data[0] == 0x89 && data[1] == 0x50 && data[2] == 0x4E && data[3] == 0x47 &&
-        data[4] == 0x0D && data[5] == 0x0A && data[6] == 0x1A && data[7] == 0x0A)
-        return XLS2IMG_PNG;
+// Image header scanning
+
+typedef struct XLS2IMG_SCANNER XLS2IMG_SCANNER;
 
-    // JPG Signature
-    if (data[0] == 0xFF && data[1] == 0xD8)
-        return XLS2IMG_JPG;
+// Tests the first count positions of data, which holds available bytes; returns the first header and its descriptor
+typedef const uint8_t* (*XLS2IMG_SCAN_FUNC)(const XLS2IMG_SCANNER* scanner, const uint8_t* data, size_t count,
+    size_t available, const XLS2IMG_FORMAT_DESC** found);
+
+// Finds the headers of a set of formats in one pass. lead holds, for every byte value, the bits of the descriptors
+// whose signature can start with it (16 bits, so at most 16 descriptors); single_lead is that byte when all of
+// them share one, so memchr can skip to it.
+struct XLS2IMG_SCANNER {
+    XLS2IMG_SCAN_FUNC scan;
+    unsigned int formats;
+    int single_lead;
+    uint16_t lead[256];
+};
 
-    return XLS2IMG_UNKNOWN;
+// The first descriptor of candidates whose signature matches at p
+static const XLS2IMG_FORMAT_DESC* xls2img_match_at(unsigned int candidates, const uint8_t* p, size_t available)
+{
+    for (size_t d = 0; candidates; d++, candidates >>= 1)
+    {
+        const XLS2IMG_FORMAT_DESC* desc = &xls2img_formats[d];
+        if ((candidates & 1) && available >= desc->lookahead && desc->match(p))
+            return desc;
+    }
+    return NULL;
 }
 
-// quickly find the next possible image header within a data block.
-static const uint8_t* xls2img_find_next_header(const uint8_t* data, size_t size)
+static const uint8_t* xls2img_scan_table(const XLS2IMG_SCANNER* scanner, const uint8_t* data, size_t count,
+    size_t available, const XLS2IMG_FORMAT_DESC** found)
 {
-    // Subtract the maximum number of bytes that might need to be checked to prevent out-of-bounds access.
-    // PNG requires 8 bytes, JPEG (SOI + APPn + ID string) needs at least 2 (SOI) + 2 (Marker) + 2 (Len) + 4 (ID) = 10 bytes.
-    for (size_t i = 0; i < size - 9; i++)
+    for (size_t i = 0; i < count; i++)
     {
-        uint8_t firstByte = data[i];
-        uint8_t secondByte = data[i + 1];
-
-        // PNG Signature: 89 50 4E 47 0D 0A 1A 0A
-        if (firstByte == 0x89 && secondByte == 0x50 &&
-            data[i + 2] == 0x4E && data[i + 3] == 0x47 &&
-            data[i + 4] == 0x0D && data[i + 5] == 0x0A &&
-            data[i + 6] == 0x1A && data[i + 7] == 0x0A) {
+        unsigned int candidates = scanner->lead[data[i]];
+        if (candidates && (*found = xls2img_match_at(candidates, data + i, available - i)) != NULL)
             return data + i;
-        }
-
-        // Check for SOI marker
-        if (firstByte == 0xFF && secondByte == 0xD8)
-        {
-            if (i + 3 < size)
-            {
-                uint8_t app_marker_high = data[i + 2];
-                uint8_t app_marker_low = data[i + 3];
-
-                // JFIF
-                if (app_marker_high == 0xFF && app_marker_low == 0xE0)
-                {
-                    size_t app0_length_offset = i + 4;
-                    if (app0_length_offset + 1 < size)
-                    {
-                        uint16_t app0_length = ((uint16_t)data[app0_length_offset] << 8) | data[app0_length_offset + 1];
-
-                        size_t identifier_start_offset = app0_length_offset + 2;
-                        if (identifier_start_offset + 4 <= size)
-                        {
-                            if (data[identifier_start_offset] == 'J' &&
-                                data[identifier_start_offset + 1] == 'F' &&
-                                data[identifier_start_offset + 2] == 'I' &&
-                                data[identifier_start_offset + 3] == 'F') {
-                                return data + i;
-                            }
-                        }
-                    }
-                }
-                // Exif
-                else if (app_marker_high == 0xFF && app_marker_low == 0xE1)
-                {
-                    size_t app1_length_offset = i + 4;
-                    if (app1_length_offset + 1 < size)
-                    {
-                        uint16_t app1_length = ((uint16_t)data[app1_length_offset] << 8) | data[app1_length_offset + 1];
-
-                        size_t identifier_start_offset = app1_length_offset + 2;
-                        if (identifier_start_offset + 4 <= size)
-                        {
-                            if (data[identifier_start_offset] == 'E' &&
-                                data[identifier_start_offset + 1] == 'x' &&
-                                data[identifier_start_offset + 2] == 'i' &&
-                                data[identifier_start_offset + 3] == 'f') {
-                                return data + i;
-                            }
-                        }
-                    }
-                }
-            }
-        }
     }
     return NULL;
 }
 
-static int xls2img_find_png_end(const uint8_t* data, size_t size)
+static const uint8_t* xls2img_scan_single(const XLS2IMG_SCANNER* scanner, const uint8_t* data, size_t count,
+    size_t available, const XLS2IMG_FORMAT_DESC** found)
 {
-    if (size < 8) return -1;
-
     const uint8_t* p = data;
-    const uint8_t* end = data + size;
-
-    if (!(p[0] == 0x89 && p[1] == 0x50 && p[2] == 0x4E && p[3] == 0x47))
-        return -1;
-
-    p += 8;
-
+    const uint8_t* end = data + count;
     while (p < end)
     {
-        if (end - p < 8) return -1;
-
-        uint32_t chunk_len = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
-        const uint8_t* chunk_type = p + 4;
-
-        if (chunk_type[0] == 'I' && chunk_type[1] == 'E' &&
-            chunk_type[2] == 'N' && chunk_type[3] == 'D')
-            return (int)((p + 12) - data); // 4(Len) + 4(Type) + 4(CRC)
-
-        p += 12 + chunk_len;
-        if (p > end) return -1;
+        p = (const uint8_t*)memchr(p, scanner->single_lead, (size_t)(end - p));
+        if (!p) return NULL;
+        if ((*found = xls2img_match_at(scanner->lead[*p], p, available - (size_t)(p - data))) != NULL)
+            return p;
+        p++;
     }
-    return -1;
+    return NULL;
 }
 
-static int xls2img_find_jpg_end(const uint8_t* start_search_from, const uint8_t* actual_start_of_last_jpg)
+// Scan kernels by whether the formats share one lead byte
+static const XLS2IMG_SCAN_FUNC xls2img_scan_kernels[2] = { xls2img_scan_table, xls2img_scan_single };
+
+static void xls2img_scanner_init(XLS2IMG_SCANNER* scanner, unsigned int formats)
 {
-    const uint8_t* p = start_search_from - 2;
-    const uint8_t* limit = actual_start_of_last_jpg;
+    int lead_count = 0;
+    memset(scanner->lead, 0, sizeof(scanner->lead));
+    scanner->formats = 0;
+    scanner->single_lead = -1;
 
-    while (p >= limit)
+    for (size_t d = 0; d < xls2img_format_count; d++)
     {
-        if (p[0] == 0xFF && p[1] == 0xD9)
-            return (int)((p + 2) - actual_start_of_last_jpg); // Returns the size relative to the previous JPEG starting position
-        p--;
+        const XLS2IMG_FORMAT_DESC* desc = &xls2img_formats[d];
+        if (!(formats & XLS2IMG_FORMAT_MASK(desc->format)))
+            continue;
+
+        scanner->formats |= XLS2IMG_FORMAT_MASK(desc->format);
+        for (int l = 0; l < 3 && desc->leads[l]; l++)
+        {
+            if (!scanner->lead[desc->leads[l]])
+            {
+                lead_count++;
+                scanner->single_lead = desc->leads[l];
+            }
+            scanner->lead[desc->leads[l]] |= (uint16_t)(1u << d);
+        }
     }
-    return -1;
+
+    if (lead_count != 1)
+        scanner->single_lead = -1;
+    scanner->scan = xls2img_scan_kernels[scanner->single_lead >= 0];
+}
+
+// Formats requested by the options and compiled in, 0 if none of the requested ones is
+static unsigned int xls2img_selected_formats(const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    unsigned int formats = options && options->formats ? options->formats : XLS2IMG_FORMATS_ALL;
+    return formats & xls2img_get_formats();
 }
 
+// Maps a position in the collected data back to the workbook stream
+typedef struct {
+    size_t data_offset;      // offset of the record payload in the collected data
+    size_t workbook_offset;  // offset of the record payload in the workbook stream
+} CollectorSegment;
+
 // Buffer collection structure
 typedef struct {
     uint8_t* data;
     size_t size;
     size_t capacity;
+    CollectorSegment* segments;
+    size_t segment_count;
+    size_t segment_capacity;
+    XLS2IMG_ALLOCATOR* allocator;
+#ifdef XLS2IMG_ENABLE_STATS
+    XLS2IMG_STATS* stats;
+#endif
+#ifdef XLS2IMG_ENABLE_TRACE
+    XLS2IMG_TRACE* trace;
+#endif
 } BufferCollector;
 
-static void buffer_collector_init(BufferCollector* collector)
+static void buffer_collector_init(BufferCollector* collector, XLS2IMG_ALLOCATOR* allocator, XLS2IMG_STATS* stats, XLS2IMG_TRACE* trace)
 {
+    collector->allocator = allocator;
+#ifdef XLS2IMG_ENABLE_STATS
+    collector->stats = stats;
+#else
+    (void)stats;
+#endif
+#ifdef XLS2IMG_ENABLE_TRACE
+    collector->trace = trace;
+#else
+    (void)trace;
+#endif
     collector->data = NULL;
     collector->size = 0;
     collector->capacity = 0;
+    collector->segments = NULL;
+    collector->segment_count = 0;
+    collector->segment_capacity = 0;
+}
+
+// Records that the next appended bytes come from the given workbook offset.
+static int buffer_collector_add_segment(BufferCollector* collector, size_t workbook_offset)
+{
+    if (collector->segment_count >= collector->segment_capacity)
+    {
+        size_t new_capacity = collector->segment_capacity ? collector->segment_capacity * 2 : 16;
+        CollectorSegment* new_segments = (CollectorSegment*)xls2img_mem_realloc(collector->allocator, collector->segments,
+            collector->segment_capacity * sizeof(CollectorSegment), new_capacity * sizeof(CollectorSegment));
+        if (!new_segments)
+            return 0;
+        XLS2IMG_STAT_REALLOC(collector->stats, collector->segment_capacity * sizeof(CollectorSegment), new_capacity * sizeof(CollectorSegment));
+        XLS2IMG_TRACE_EVENT(collector->trace, XLS2IMG_EVENT_ALLOC, 1, collector->segment_capacity * sizeof(CollectorSegment),
+            new_capacity * sizeof(CollectorSegment));
+
+        collector->segments = new_segments;
+        collector->segment_capacity = new_capacity;
+    }
+
+    collector->segments[collector->segment_count].data_offset = collector->size;
+    collector->segments[collector->segment_count].workbook_offset = workbook_offset;
+    collector->segment_count++;
+    return 1;
+}
+
+// Translates an offset in the collected data into an offset in the workbook stream.
+static size_t buffer_collector_workbook_offset(const BufferCollector* collector, size_t data_offset)
+{
+    size_t lo = 0;
+    size_t hi = collector->segment_count;
+
+    if (hi == 0)
+        return data_offset;
+
+    // last segment starting at or before data_offset
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (collector->segments[mid].data_offset <= data_offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return collector->segments[lo].workbook_offset + (data_offset - collector->segments[lo].data_offset);
 }
 
 static int buffer_collector_append(BufferCollector* collector, const uint8_t* data, size_t size)
@@ -192,15 +242,18 @@ static int buffer_collector_append(BufferCollector* collector, const uint8_t* da
         // add some extra space to avoid realloc immediately next time
         new_capacity = new_capacity * 3 / 2;
 
-        uint8_t* new_data = (uint8_t*)realloc(collector->data, new_capacity);
+        uint8_t* new_data = (uint8_t*)xls2img_mem_realloc(collector->allocator, collector->data, collector->capacity, new_capacity);
         if (!new_data)
             return 0;
+        XLS2IMG_STAT_REALLOC(collector->stats, collector->capacity, new_capacity);
+        XLS2IMG_TRACE_EVENT(collector->trace, XLS2IMG_EVENT_ALLOC, 1, collector->capacity, new_capacity);
 
         collector->data = new_data;
         collector->capacity = new_capacity;
     }
 
     memcpy(collector->data + collector->size, data, size);
+    XLS2IMG_STAT_ADD(collector->stats, bytes_copied, size);
     collector->size += size;
 
     return 1;
@@ -210,190 +263,673 @@ static void buffer_collector_free(BufferCollector* collector)
 {
     if (collector->data)
     {
-        free(collector->data);
+        xls2img_mem_free(collector->allocator, collector->data, collector->capacity);
+        XLS2IMG_STAT_FREE(collector->stats, collector->capacity);
+        XLS2IMG_TRACE_EVENT(collector->trace, XLS2IMG_EVENT_ALLOC, 2, collector->capacity, 0);
         collector->data = NULL;
     }
+    if (collector->segments)
+    {
+        xls2img_mem_free(collector->allocator, collector->segments, collector->segment_capacity * sizeof(CollectorSegment));
+        XLS2IMG_STAT_FREE(collector->stats, collector->segment_capacity * sizeof(CollectorSegment));
+        XLS2IMG_TRACE_EVENT(collector->trace, XLS2IMG_EVENT_ALLOC, 2, collector->segment_capacity * sizeof(CollectorSegment), 0);
+        collector->segments = NULL;
+    }
     collector->size = 0;
     collector->capacity = 0;
+    collector->segment_count = 0;
+    collector->segment_capacity = 0;
+}
+
+// Drops the first n collected bytes; the segment map keeps translating the rest.
+static void buffer_collector_discard(BufferCollector* collector, size_t n)
+{
+    memmove(collector->data, collector->data + n, collector->size - n);
+    collector->size -= n;
+
+    // keep the last segment starting at or before n, moved to the new start
+    size_t first = 0;
+    while (first + 1 < collector->segment_count && collector->segments[first + 1].data_offset <= n)
+        first++;
+    if (first < collector->segment_count)
+    {
+        collector->segments[first].workbook_offset += n - collector->segments[first].data_offset;
+        collector->segments[first].data_offset = n;
+    }
+    for (size_t i = first; i < collector->segment_count; i++)
+    {
+        collector->segments[i - first] = collector->segments[i];
+        collector->segments[i - first].data_offset -= n;
+    }
+    collector->segment_count -= first;
+}
+
+// Size of the allocation holding the data of a result image, followed by its path if it has one
+static size_t result_image_size(const XLS2IMG_IMAGE* image)
+{
+    return image->size + (image->path ? strlen(image->path) + 1 : 0);
 }
 
-// Helper function to add an image to the result array.
-static int add_image_to_result(XLS2IMG_IMAGE** images, int* capacity, int* count, const uint8_t* data, size_t size, XLS2IMG_FORMAT format)
+// Helper function to add an image to the result array. A prefix is copied in front of the data, so result images
+// are complete files. The path is copied behind the data, in the same allocation. With verify the image is checked
+// by the copy, so check comes from here rather than from the producer.
+static int add_image_to_result(XLS2IMG_IMAGE** images, size_t* capacity, size_t* count, const XLS2IMG_IMAGE* image,
+    int verify, XLS2IMG_STATS* stats, XLS2IMG_TRACE* trace)
 {
+    (void)stats;
+    (void)trace;
     if (*count >= *capacity)
     {
-        int new_capacity = *capacity * 2;
-        XLS2IMG_IMAGE* new_images = realloc(*images, new_capacity * sizeof(XLS2IMG_IMAGE));
+        if (*capacity > SIZE_MAX / 2 / sizeof(XLS2IMG_IMAGE)) return 0;
+        size_t new_capacity = *capacity * 2;
+        XLS2IMG_IMAGE* new_images = (XLS2IMG_IMAGE*)xls2img_block_realloc(*images, new_capacity * sizeof(XLS2IMG_IMAGE));
         if (!new_images) return 0;
+        XLS2IMG_STAT_REALLOC(stats, *capacity * sizeof(XLS2IMG_IMAGE), new_capacity * sizeof(XLS2IMG_IMAGE));
+        XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_ALLOC, 1, *capacity * sizeof(XLS2IMG_IMAGE), new_capacity * sizeof(XLS2IMG_IMAGE));
         *images = new_images;
         *capacity = new_capacity;
     }
 
-    void* image_data = malloc(size);
+    size_t size = image->prefix_size + image->size;
+    size_t path_size = image->path ? strlen(image->path) + 1 : 0;
+    uint8_t* image_data = (uint8_t*)xls2img_mem_alloc(xls2img_block_allocator(*images), size + path_size);
     if (!image_data) return 0;
-
-    memcpy(image_data, data, size);
-    (*images)[*count].format = format;
+    XLS2IMG_STAT_ALLOC(stats, size + path_size);
+    XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_ALLOC, 0, 0, size + path_size);
+    if (path_size)
+        memcpy(image_data + size, image->path, path_size);
+
+    if (image->prefix_size)
+        memcpy(image_data, image->prefix, image->prefix_size);
+    unsigned int check = 0;
+    if (verify)
+        check = xls2img_verify(image->format, (const uint8_t*)image->data, image->size, image_data + image->prefix_size);
+    else
+        memcpy(image_data + image->prefix_size, image->data, image->size);
+    XLS2IMG_STAT_ADD(stats, bytes_copied, size);
+    (*images)[*count].format = image->format;
     (*images)[*count].size = size;
     (*images)[*count].data = image_data;
+    (*images)[*count].offset = image->offset;
+    (*images)[*count].span = image->span;
+    (*images)[*count].prefix = NULL;
+    (*images)[*count].prefix_size = 0;
+    (*images)[*count].path = path_size ? (const char*)image_data + size : NULL;
+    (*images)[*count].check = check;
     (*count)++;
     return 1;
 }
 
-// Helper function to finalize and add the last tracked image if valid.
-static void process_last_image_if_any(const uint8_t** last_img_start, XLS2IMG_FORMAT* last_img_fmt, XLS2IMG_IMAGE** images,
-    int* capacity, int* count, const uint8_t* current_block_ptr_or_end, const uint8_t* last_img_block_start)
+// Releases the images gathered so far when extraction is abandoned
+static void free_partial_images(XLS2IMG_IMAGE* images, size_t capacity, size_t count, XLS2IMG_STATS* stats, XLS2IMG_TRACE* trace)
 {
-    if (*last_img_start != NULL)
+    (void)capacity;
+    (void)stats;
+    (void)trace;
+    for (size_t i = 0; i < count; i++)
     {
-        int img_size = -1;
-        if (*last_img_fmt == XLS2IMG_PNG)
-            img_size = xls2img_find_png_end(*last_img_start, current_block_ptr_or_end - *last_img_start);
-        else if (*last_img_fmt == XLS2IMG_JPG)
-            img_size = xls2img_find_jpg_end(current_block_ptr_or_end, *last_img_start);
-
-        if (img_size > 0)
-            add_image_to_result(images, capacity, count, *last_img_start, img_size, *last_img_fmt);
-
-        // Reset the tracking variables after attempting to process.
-        *last_img_start = NULL;
-        *last_img_fmt = XLS2IMG_UNKNOWN;
+        size_t size = result_image_size(&images[i]);
+        xls2img_mem_free(xls2img_block_allocator(images), images[i].data, size);
+        XLS2IMG_STAT_FREE(stats, size);
+        XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_ALLOC, 2, size, 0);
     }
+    xls2img_block_free(images);
+    XLS2IMG_STAT_FREE(stats, capacity * sizeof(XLS2IMG_IMAGE));
+    XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_ALLOC, 2, capacity * sizeof(XLS2IMG_IMAGE), 0);
 }
 
-int xls2img_extract_images(const void* workbook_data, size_t workbook_size, XLS2IMG_RESULT* result)
-{
-    if (!workbook_data || workbook_size == 0 || !result)
-        return XLS2IMG_ERROR_INVALID_ARGUMENT;
+// Push parser state. Record headers may be split across feeds; of the drawing group only the window from the image in
+// progress (or the next untested header position) onwards is kept, so memory follows the largest image.
+struct XLS2IMG_PARSER {
+    XLS2IMG_IMAGE_FUNC on_image;
+    void* user;
+    XLS2IMG_ALLOCATOR* allocator;
+    XLS2IMG_LIMITS limits;
+#ifdef XLS2IMG_ENABLE_STATS
+    XLS2IMG_STATS* stats;
+#endif
+#ifdef XLS2IMG_ENABLE_TRACE
+    XLS2IMG_TRACE* trace;
+#endif
+    int error;                      // first error, returned by every later call
+    int raw;                        // OfficeArt data without records, see xls2img_parser.h
+    int verify;                     // set XLS2IMG_IMAGE.check of each image, see XLS2IMG_EXTRACT_OPTIONS.verify
+    XLS2IMG_CHECKPOINT checkpoint;  // polls the control across the bytes fed
+    XLS2IMG_SCANNER selected;       // headers of the formats to extract
+    XLS2IMG_SCANNER boundary;       // headers of every built-in format, which end an image bounded_by_next
+    size_t position;                // workbook bytes fed so far
+    uint8_t header[4];              // record header being received
+    size_t header_size;
+    size_t remaining;               // payload bytes of the current record still to come
+    int in_group;                   // inside an MsoDrawingGroup and its CONTINUE records
+    int group_payload;              // the current record's payload belongs to the drawing group
+    uint64_t records;
+    int image_count;
+    uint64_t output_bytes;
+    BufferCollector window;         // drawing group data from window_base on, mapped to the workbook
+    size_t window_base;             // drawing group offset of window.data[0]
+    size_t scan_pos;                // next drawing group offset to test for an image header
+    size_t candidate;               // drawing group offset of the header of the image in progress
+    const XLS2IMG_FORMAT_DESC* candidate_desc;  // NULL without an image in progress
+    size_t candidate_end;           // drawing group offset where the image in progress says it ends, 0 if unstated
+    uint8_t prefix[XLS2IMG_MAX_PREFIX];         // synthesized header of the image being delivered
+};
 
-    result->images = NULL;
-    result->count = 0;
+static void xls2img_parser_init(XLS2IMG_PARSER* parser, XLS2IMG_IMAGE_FUNC on_image, void* user, const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    memset(parser, 0, sizeof(XLS2IMG_PARSER));
+    parser->on_image = on_image;
+    parser->user = user;
+    parser->allocator = options ? options->allocator : NULL;
+    parser->verify = options ? options->verify : 0;
+    if (options && options->limits)
+        parser->limits = *options->limits;
+#ifdef XLS2IMG_ENABLE_STATS
+    parser->stats = options ? options->stats : NULL;
+#endif
+#ifdef XLS2IMG_ENABLE_TRACE
+    parser->trace = options ? options->trace : NULL;
+#endif
+    xls2img_checkpoint_init(&parser->checkpoint, options ? options->control : NULL, 0);
+    buffer_collector_init(&parser->window, parser->allocator, options ? options->stats : NULL, options ? options->trace : NULL);
+    xls2img_scanner_init(&parser->selected, xls2img_selected_formats(options));
+    xls2img_scanner_init(&parser->boundary, XLS2IMG_FORMATS_ALL);
+    parser->candidate_desc = NULL;
+}
 
-    const uint8_t* ptr = (const uint8_t*)workbook_data;
-    const uint8_t* end_ptr = ptr + workbook_size;
+// Ends the image in progress at group offset end and hands it to the callback if its end is found
+static int xls2img_parser_finish_image(XLS2IMG_PARSER* parser, size_t end)
+{
+    const XLS2IMG_FORMAT_DESC* desc = parser->candidate_desc;
+    size_t data_offset = parser->candidate + desc->skip - parser->window_base;
+    const uint8_t* start = parser->window.data + data_offset;
+    parser->candidate_desc = NULL;
 
-    int capacity = 16;
-    int count = 0;
-    XLS2IMG_IMAGE* images = (XLS2IMG_IMAGE*)malloc(capacity * sizeof(XLS2IMG_IMAGE));
-    if (!images)
-        return XLS2IMG_ERROR_INVALID_ARGUMENT;
+    ptrdiff_t img_size = end - parser->candidate > desc->skip ? desc->find_end(start, end - parser->candidate - desc->skip) : -1;
+    if (img_size <= 0)
+    {
+        XLS2IMG_STAT_ADD(parser->stats, headers_rejected, 1);
+        XLS2IMG_TRACE_EVENT(parser->trace, XLS2IMG_EVENT_IMAGE_REJECTED, desc->format,
+            buffer_collector_workbook_offset(&parser->window, data_offset), 0);
+        return XLS2IMG_SUCCESS;
+    }
 
-    BufferCollector mso_collector;
-    buffer_collector_init(&mso_collector);
-    int collecting_mso = 0;
+    XLS2IMG_IMAGE image;
+    image.format = desc->format;
+    image.size = (size_t)img_size;
+    image.data = (void*)start;
+    image.offset = buffer_collector_workbook_offset(&parser->window, data_offset);
+    image.span = buffer_collector_workbook_offset(&parser->window, data_offset + img_size - 1) + 1 - image.offset;
+    image.prefix = NULL;
+    image.prefix_size = desc->prefix ? desc->prefix(start, image.size, parser->prefix) : 0;
+    image.path = NULL;
+    image.check = parser->verify ? xls2img_verify(image.format, start, image.size, NULL) : 0;
+    if (image.prefix_size)
+        image.prefix = parser->prefix;
+
+    // Image counts are returned as an int, so INT_MAX images end the scan even without a limit
+    if (parser->image_count == INT_MAX || (parser->limits.max_images && (uint64_t)parser->image_count >= parser->limits.max_images) ||
+        (parser->limits.max_output_bytes && parser->output_bytes + image.prefix_size + image.size > parser->limits.max_output_bytes))
+        return XLS2IMG_ERROR_LIMIT_EXCEEDED;
+    XLS2IMG_TRACE_EVENT(parser->trace, XLS2IMG_EVENT_IMAGE_ACCEPTED, image.format, image.offset, image.size);
+
+    int ret = parser->on_image ? parser->on_image(&image, parser->user) : XLS2IMG_SUCCESS;
+    if (ret != XLS2IMG_SUCCESS) return ret;
+
+    parser->image_count++;
+    parser->output_bytes += image.prefix_size + img_size;
+    return XLS2IMG_SUCCESS;
+}
 
-    // Used to record the starting position and format of the previous image
-    const uint8_t* last_img_start = NULL;
-    XLS2IMG_FORMAT last_img_fmt = XLS2IMG_UNKNOWN;
+// Tests every group position whose XLS2IMG_SCAN_LOOKAHEAD bytes of lookahead have arrived, or at the end of the
+// group (final) every position with XLS2IMG_SCAN_MIN_LOOKAHEAD bytes; like the scan of a whole drawing group, the
+// last 9 bytes are never tested. An image in progress ends at the next header, unless its header states its size:
+// then it ends there, the headers it embeds are not tested, and if it is rejected the scan resumes behind its header.
+// Only headers of the selected formats are looked for, except while an image bounded_by_next (JPEG) is in progress:
+// its end is searched backwards from the next header of any format, so the boundary scan bounds it and a header of
+// an unselected format just ends it.
+static int xls2img_parser_scan(XLS2IMG_PARSER* parser, int final)
+{
+    XLS2IMG_STAT_TIMER(scan_start);
+    int ret = XLS2IMG_SUCCESS;
+    size_t window_end = parser->window_base + parser->window.size;
+    size_t lookahead = final ? XLS2IMG_SCAN_MIN_LOOKAHEAD : XLS2IMG_SCAN_LOOKAHEAD;
 
-    while (ptr < end_ptr)
+    for (;;)
     {
-        if (end_ptr - ptr < 4) break;
-
-        uint16_t recordType = (ptr[1] << 8) | ptr[0];
-        uint16_t recordSize = (ptr[3] << 8) | ptr[2];
-        ptr += 4;
+        if (parser->candidate_end)
+        {
+            if (window_end < parser->candidate_end)
+                break;
+            size_t end = parser->candidate_end;
+            size_t resume = parser->candidate + 1;
+            int image_count = parser->image_count;
+            parser->candidate_end = 0;
+            ret = xls2img_parser_finish_image(parser, end);
+            if (ret != XLS2IMG_SUCCESS) break;
+            parser->scan_pos = parser->image_count > image_count ? end : resume;
+            continue;
+        }
+        if (window_end - parser->scan_pos < lookahead)
+            break;
 
-        if (recordType == BIFF8_MsoDrawingGroup)
+        const uint8_t* from = parser->window.data + (parser->scan_pos - parser->window_base);
+        size_t available = window_end - parser->scan_pos;
+        size_t count = available - lookahead + 1;
+        const XLS2IMG_SCANNER* scanner = parser->candidate_desc && parser->candidate_desc->bounded_by_next ?
+            &parser->boundary : &parser->selected;
+        const XLS2IMG_FORMAT_DESC* desc = NULL;
+        const uint8_t* found = scanner->scan(scanner, from, count, available, &desc);
+        if (!found)
         {
-            collecting_mso = 1;
+            parser->scan_pos += count;
+            break;
+        }
 
-            // reset the collector to pre-allocate enough space
-            buffer_collector_free(&mso_collector);
-            mso_collector.data = (uint8_t*)malloc(recordSize * 2);
-            if (mso_collector.data)
-            {
-                mso_collector.capacity = recordSize * 2;
-                memcpy(mso_collector.data, ptr, recordSize);
-                mso_collector.size = recordSize;
-            }
+        size_t header = parser->window_base + (size_t)(found - parser->window.data);
+        if (parser->candidate_desc)
+        {
+            ret = xls2img_parser_finish_image(parser, header);
+            if (ret != XLS2IMG_SUCCESS) break;
         }
-        else if (collecting_mso && recordType == BIFF8_CONTINUE)
+
+        parser->scan_pos = header + 1;
+        if (!(parser->selected.formats & XLS2IMG_FORMAT_MASK(desc->format)))
+            continue;
+        parser->candidate = header;
+        parser->candidate_desc = desc;
+        if (desc->declared_size)
         {
-            // append to the MsoDrawingGroup data
-            if (!buffer_collector_append(&mso_collector, ptr, recordSize))
-            {
-                buffer_collector_free(&mso_collector);
-                free(images);
-                return XLS2IMG_ERROR_INVALID_ARGUMENT;
-            }
+            uint32_t declared = desc->declared_size(found + desc->skip);
+            parser->candidate_end = declared && declared <= SIZE_MAX - header - desc->skip ? header + desc->skip + declared : 0;
         }
-        else if (collecting_mso)
+        XLS2IMG_STAT_ADD(parser->stats, headers_found, 1);
+        XLS2IMG_TRACE_EVENT(parser->trace, XLS2IMG_EVENT_HEADER, desc->format,
+            buffer_collector_workbook_offset(&parser->window, header - parser->window_base), 0);
+    }
+
+    // nothing before the image in progress, or before the next position to test, is needed again
+    size_t keep = parser->candidate_desc ? parser->candidate : parser->scan_pos;
+    if (ret == XLS2IMG_SUCCESS && keep > parser->window_base)
+    {
+        buffer_collector_discard(&parser->window, keep - parser->window_base);
+        parser->window_base = keep;
+    }
+    XLS2IMG_STAT_ELAPSED(parser->stats, scan_ns, scan_start);
+    return ret;
+}
+
+static int xls2img_parser_end_group(XLS2IMG_PARSER* parser, size_t record_offset)
+{
+    (void)record_offset;
+    int ret = xls2img_parser_scan(parser, 1);
+
+    // the image in progress ends with the group; one that stated a larger size is rejected and the rest of the group
+    // is scanned from behind its header
+    while (ret == XLS2IMG_SUCCESS && parser->candidate_desc)
+    {
+        size_t resume = parser->candidate + 1;
+        int stated = parser->candidate_end != 0;
+        parser->candidate_end = 0;
+        ret = xls2img_parser_finish_image(parser, parser->window_base + parser->window.size);
+        if (ret != XLS2IMG_SUCCESS || !stated)
+            break;
+        parser->scan_pos = resume;
+        ret = xls2img_parser_scan(parser, 1);
+    }
+    XLS2IMG_TRACE_EVENT(parser->trace, XLS2IMG_EVENT_DRAWING_GROUP_END, 0, record_offset,
+        parser->window_base + parser->window.size);
+
+    buffer_collector_free(&parser->window);
+    parser->window_base = 0;
+    parser->scan_pos = 0;
+    parser->candidate_desc = NULL;
+    parser->candidate_end = 0;
+    parser->in_group = 0;
+    return ret;
+}
+
+// Decides what happens to the payload of the record whose header just completed
+static int xls2img_parser_record(XLS2IMG_PARSER* parser)
+{
+    uint16_t recordType = (parser->header[1] << 8) | parser->header[0];
+    uint16_t recordSize = (parser->header[3] << 8) | parser->header[2];
+    size_t record_offset = parser->position - 4;
+    XLS2IMG_STAT_ADD(parser->stats, records_walked, 1);
+    XLS2IMG_TRACE_EVENT(parser->trace, XLS2IMG_EVENT_RECORD, recordType, record_offset, recordSize);
+
+    if (parser->limits.max_records && ++parser->records > parser->limits.max_records)
+        return XLS2IMG_ERROR_LIMIT_EXCEEDED;
+
+    int ret = XLS2IMG_SUCCESS;
+    if (recordType == BIFF8_MsoDrawingGroup)
+    {
+        // a second group ends the first one
+        if (parser->in_group)
+            ret = xls2img_parser_end_group(parser, record_offset);
+        parser->in_group = 1;
+        parser->group_payload = 1;
+        XLS2IMG_TRACE_EVENT(parser->trace, XLS2IMG_EVENT_DRAWING_GROUP_START, 0, record_offset, recordSize);
+    }
+    else if (parser->in_group && recordType == BIFF8_CONTINUE)
+    {
+        parser->group_payload = 1;
+        XLS2IMG_STAT_ADD(parser->stats, continue_segments, 1);
+    }
+    else
+    {
+        if (parser->in_group)
+            ret = xls2img_parser_end_group(parser, record_offset);
+        parser->group_payload = 0;
+    }
+
+    parser->remaining = recordSize;
+    if (parser->remaining == 0)
+        parser->header_size = 0;
+    return ret;
+}
+
+int xls2img_parser_open(XLS2IMG_PARSER** parser, XLS2IMG_IMAGE_FUNC on_image, void* user, const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    if (!parser || !on_image) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+    if (!xls2img_selected_formats(options)) return XLS2IMG_ERROR_UNSUPPORTED;
+
+    XLS2IMG_PARSER* p = (XLS2IMG_PARSER*)xls2img_mem_alloc(options ? options->allocator : NULL, sizeof(XLS2IMG_PARSER));
+    if (!p) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+
+    xls2img_parser_init(p, on_image, user, options);
+    *parser = p;
+    return XLS2IMG_SUCCESS;
+}
+
+int xls2img_parser_open_raw(XLS2IMG_PARSER** parser, XLS2IMG_IMAGE_FUNC on_image, void* user, const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    int ret = xls2img_parser_open(parser, on_image, user, options);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+
+    (*parser)->raw = 1;
+    return xls2img_parser_begin_range(*parser, 0);
+}
+
+int xls2img_parser_begin_range(XLS2IMG_PARSER* parser, size_t position)
+{
+    if (!parser || !parser->raw) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+    if (parser->error != XLS2IMG_SUCCESS) return parser->error;
+
+    if (parser->in_group)
+        parser->error = xls2img_parser_end_group(parser, parser->position);
+    if (parser->error != XLS2IMG_SUCCESS) return parser->error;
+
+    // a record header that is never completed: the whole range is payload of the group
+    parser->position = position;
+    parser->header_size = 4;
+    parser->remaining = SIZE_MAX;
+    parser->in_group = 1;
+    parser->group_payload = 1;
+    XLS2IMG_TRACE_EVENT(parser->trace, XLS2IMG_EVENT_DRAWING_GROUP_START, 0, position, 0);
+    return XLS2IMG_SUCCESS;
+}
+
+int xls2img_parser_feed(XLS2IMG_PARSER* parser, const void* data, size_t size)
+{
+    if (!parser || (size > 0 && !data)) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+    if (parser->error != XLS2IMG_SUCCESS) return parser->error;
+
+    const uint8_t* ptr = (const uint8_t*)data;
+    const uint8_t* end_ptr = ptr + size;
+    int ret = XLS2IMG_SUCCESS;
+
+    if (parser->limits.max_bytes && parser->position + size > parser->limits.max_bytes)
+        ret = XLS2IMG_ERROR_LIMIT_EXCEEDED;
+
+    while (ret == XLS2IMG_SUCCESS && ptr < end_ptr)
+    {
+        ret = xls2img_checkpoint(&parser->checkpoint, parser->position);
+        if (ret != XLS2IMG_SUCCESS) break;
+
+        if (parser->header_size < 4)
         {
-            // this means that the MsoDrawingGroup chain is complete and that it is time to collect the image data
-            // there should be only one MsoDrawingGroup in the xls, so it will be executed only once
-            if (mso_collector.data && mso_collector.size > 0)
+            while (parser->header_size < 4 && ptr < end_ptr)
             {
-                const uint8_t* block_ptr = mso_collector.data;
-                const uint8_t* block_end = block_ptr + mso_collector.size;
-
-                while (block_ptr < block_end)
-                {
-                    const uint8_t* next_header = xls2img_find_next_header(block_ptr, block_end - block_ptr);
-
-                    // Process the previous image before moving the pointer.
-                    if (last_img_start != NULL && next_header != NULL)
-                        process_last_image_if_any(&last_img_start, &last_img_fmt, &images, &capacity, &count, next_header, last_img_start);
-
-                    if (!next_header)
-                        break;
-
-                    // Record the current found image header as the next candidate to be processed.
-                    block_ptr = next_header;
-                    XLS2IMG_FORMAT fmt = xls2img_identify_format(block_ptr);
-                    if (fmt == XLS2IMG_PNG || fmt == XLS2IMG_JPG)
-                    {
-                        last_img_start = block_ptr;
-                        last_img_fmt = fmt;
-                    }
-                    block_ptr++;
-                }
-
-                // After the loop, check if the last image was not processed (e.g., at the end of the block).
-                process_last_image_if_any(&last_img_start, &last_img_fmt, &images, &capacity, &count, block_end, last_img_start);
+                parser->header[parser->header_size++] = *ptr++;
+                parser->position++;
             }
-            buffer_collector_free(&mso_collector);
-            collecting_mso = 0;
+            if (parser->header_size == 4)
+                ret = xls2img_parser_record(parser);
+            continue;
+        }
 
-            last_img_start = NULL;
-            last_img_fmt = XLS2IMG_UNKNOWN;
+        size_t len = (size_t)(end_ptr - ptr) < parser->remaining ? (size_t)(end_ptr - ptr) : parser->remaining;
+        // the payload of a raw range has no records to stop at
+        if (len > XLS2IMG_CONTROL_INTERVAL)
+            len = XLS2IMG_CONTROL_INTERVAL;
+        if (parser->group_payload)
+        {
+            // a record split across feeds continues its segment
+            BufferCollector* window = &parser->window;
+            const CollectorSegment* last = window->segment_count ? &window->segments[window->segment_count - 1] : NULL;
+            int contiguous = last && last->workbook_offset + (window->size - last->data_offset) == parser->position;
+            if ((!contiguous && !buffer_collector_add_segment(window, parser->position)) ||
+                !buffer_collector_append(window, ptr, len))
+                ret = XLS2IMG_ERROR_OUT_OF_MEMORY;
+            else
+                ret = xls2img_parser_scan(parser, 0);
         }
+        ptr += len;
+        parser->position += len;
+        parser->remaining -= len;
+        if (parser->remaining == 0)
+            parser->header_size = 0;
+    }
 
-        ptr += recordSize;
-        if (ptr > end_ptr)
-            break;
+    parser->error = ret;
+    return ret;
+}
+
+int xls2img_parser_finish(XLS2IMG_PARSER* parser)
+{
+    if (!parser) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+    if (parser->error != XLS2IMG_SUCCESS) return parser->error;
+
+    // a drawing group that runs to the end of the stream, or into a truncated record, still gets scanned
+    if (parser->in_group)
+        parser->error = xls2img_parser_end_group(parser, parser->position);
+    if (parser->error != XLS2IMG_SUCCESS) return parser->error;
+
+    return parser->image_count > 0 ? parser->image_count : XLS2IMG_ERROR_NO_IMAGES;
+}
+
+void xls2img_parser_close(XLS2IMG_PARSER* parser)
+{
+    if (parser)
+    {
+        buffer_collector_free(&parser->window);
+        xls2img_mem_free(parser->allocator, parser, sizeof(XLS2IMG_PARSER));
+    }
+}
+
+// Collects the images of xls2img_extract_images_ex and xls2img_read_images into a result array
+typedef struct {
+    XLS2IMG_IMAGE* images;
+    size_t capacity;
+    size_t count;                   // at most INT_MAX, the count the result can report
+    int verify;                     // check images as they are copied, the producers are told not to
+    XLS2IMG_STATS* stats;
+    XLS2IMG_TRACE* trace;
+} ResultBuilder;
+
+static int result_builder_init(ResultBuilder* builder, const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    XLS2IMG_STATS* stats = options ? options->stats : NULL;
+    XLS2IMG_TRACE* trace = options ? options->trace : NULL;
+    (void)stats;
+    (void)trace;
+
+    builder->capacity = 16;
+    builder->count = 0;
+    builder->verify = options ? options->verify : 0;
+    builder->stats = stats;
+    builder->trace = trace;
+    builder->images = (XLS2IMG_IMAGE*)xls2img_block_alloc(options ? options->allocator : NULL, builder->capacity * sizeof(XLS2IMG_IMAGE));
+    if (!builder->images)
+        return XLS2IMG_ERROR_OUT_OF_MEMORY;
+    XLS2IMG_STAT_ALLOC(stats, builder->capacity * sizeof(XLS2IMG_IMAGE));
+    XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_ALLOC, 0, 0, builder->capacity * sizeof(XLS2IMG_IMAGE));
+    return XLS2IMG_SUCCESS;
+}
+
+static int result_builder_add(const XLS2IMG_IMAGE* image, void* user)
+{
+    ResultBuilder* builder = (ResultBuilder*)user;
+    if (builder->count >= INT_MAX)
+        return XLS2IMG_ERROR_LIMIT_EXCEEDED;
+    if (!add_image_to_result(&builder->images, &builder->capacity, &builder->count, image, builder->verify, builder->stats, builder->trace))
+        return XLS2IMG_ERROR_OUT_OF_MEMORY;
+    return XLS2IMG_SUCCESS;
+}
+
+// Hands the collected images to result, or releases them if the extraction ended with ret
+static int result_builder_finish(ResultBuilder* builder, int ret, XLS2IMG_RESULT* result)
+{
+    XLS2IMG_STATS* stats = builder->stats;
+    XLS2IMG_TRACE* trace = builder->trace;
+    (void)stats;
+    (void)trace;
+
+    if (ret < 0 && ret != XLS2IMG_ERROR_NO_IMAGES)
+    {
+        free_partial_images(builder->images, builder->capacity, builder->count, stats, trace);
+        return ret;
     }
+
+    XLS2IMG_IMAGE* images = builder->images;
+    size_t capacity = builder->capacity;
+    size_t count = builder->count;
     if (count > 0)
     {
         if (capacity > count * 2)
         {
-            XLS2IMG_IMAGE* new_images = (XLS2IMG_IMAGE*)realloc(images, count * sizeof(XLS2IMG_IMAGE));
+            XLS2IMG_IMAGE* new_images = (XLS2IMG_IMAGE*)xls2img_block_realloc(images, count * sizeof(XLS2IMG_IMAGE));
             if (new_images)
+            {
+                XLS2IMG_STAT_REALLOC(stats, capacity * sizeof(XLS2IMG_IMAGE), count * sizeof(XLS2IMG_IMAGE));
+                XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_ALLOC, 1, capacity * sizeof(XLS2IMG_IMAGE), count * sizeof(XLS2IMG_IMAGE));
                 images = new_images;
+            }
         }
 
         result->images = images;
-        result->count = count;
-        return count;
+        result->count = (int)count;
+        return (int)count;
     }
     else
     {
-        free(images);
+        xls2img_block_free(images);
+        XLS2IMG_STAT_FREE(stats, capacity * sizeof(XLS2IMG_IMAGE));
+        XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_ALLOC, 2, capacity * sizeof(XLS2IMG_IMAGE), 0);
         return XLS2IMG_ERROR_NO_IMAGES;
     }
 }
 
+int xls2img_extract_images(const void* workbook_data, size_t workbook_size, XLS2IMG_RESULT* result)
+{
+    return xls2img_extract_images_stats(workbook_data, workbook_size, result, NULL);
+}
+
+int xls2img_extract_images_stats(const void* workbook_data, size_t workbook_size, XLS2IMG_RESULT* result, XLS2IMG_STATS* stats)
+{
+    XLS2IMG_EXTRACT_OPTIONS options;
+    memset(&options, 0, sizeof(options));
+    options.stats = stats;
+    return xls2img_extract_images_ex(workbook_data, workbook_size, result, &options);
+}
+
+int xls2img_extract_images_ex(const void* workbook_data, size_t workbook_size, XLS2IMG_RESULT* result,
+    const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    if (!workbook_data || workbook_size == 0 || !result)
+        return XLS2IMG_ERROR_INVALID_ARGUMENT;
+    if (!xls2img_selected_formats(options))
+        return XLS2IMG_ERROR_UNSUPPORTED;
+
+    XLS2IMG_STATS* stats = options ? options->stats : NULL;
+    (void)stats;
+    XLS2IMG_STAT_TIMER(start);
+
+    result->images = NULL;
+    result->count = 0;
+
+    ResultBuilder builder;
+    int ret = result_builder_init(&builder, options);
+    if (ret != XLS2IMG_SUCCESS)
+        return ret;
+
+    // the builder checks the images it copies
+    XLS2IMG_EXTRACT_OPTIONS resolved;
+    if (options)
+        resolved = *options;
+    else
+        memset(&resolved, 0, sizeof(resolved));
+    resolved.verify = 0;
+
+    // the whole stream is one feed; the parser copies out of it only the image in progress
+    XLS2IMG_PARSER parser;
+    xls2img_parser_init(&parser, result_builder_add, &builder, &resolved);
+    parser.checkpoint.total = workbook_size;
+    ret = xls2img_parser_feed(&parser, workbook_data, workbook_size);
+    if (ret == XLS2IMG_SUCCESS)
+        ret = xls2img_parser_finish(&parser);
+    buffer_collector_free(&parser.window);
+
+    ret = result_builder_finish(&builder, ret, result);
+    if (ret > 0 || ret == XLS2IMG_ERROR_NO_IMAGES)
+        XLS2IMG_STAT_ELAPSED(stats, extract_ns, start);
+    return ret;
+}
+
+int xls2img_read_images(const XLS2IMG_READER* reader, XLS2IMG_RESULT* result, const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    if (!reader || !result)
+        return XLS2IMG_ERROR_INVALID_ARGUMENT;
+    if (!xls2img_selected_formats(options))
+        return XLS2IMG_ERROR_UNSUPPORTED;
+
+    result->images = NULL;
+    result->count = 0;
+
+    // the result array comes from the same allocator as the working buffers
+    XLS2IMG_EXTRACT_OPTIONS resolved;
+    if (options)
+        resolved = *options;
+    else
+        memset(&resolved, 0, sizeof(resolved));
+    if (!resolved.allocator)
+        resolved.allocator = xls2img_reader_allocator(reader);
+
+    ResultBuilder builder;
+    int ret = result_builder_init(&builder, &resolved);
+    if (ret != XLS2IMG_SUCCESS)
+        return ret;
+
+    // the builder checks the images it copies
+    resolved.verify = 0;
+    ret = xls2img_stream_images(reader, result_builder_add, &builder, &resolved);
+    return result_builder_finish(&builder, ret, result);
+}
+
 void xls2img_free_result(XLS2IMG_RESULT* result)
 {
     if (!result) return;
 
     if (result->images)
     {
+        // the image data comes from the allocator of the array
+        XLS2IMG_ALLOCATOR* allocator = xls2img_block_allocator(result->images);
         for (int i = 0; i < result->count; i++)
             if (result->images[i].data)
-                free(result->images[i].data);
+                xls2img_mem_free(allocator, result->images[i].data, result_image_size(&result->images[i]));
 
-        free(result->images);
+        xls2img_block_free(result->images);
         result->images = NULL;
     }
     result->count = 0;
@@ -0,0 +1,557 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "xls2img_index.h"
+#include "xls2img_alloc.h"
+#include "xls2img_inflate.h"
+#include <string.h>
+
+#define INDEX_MAGIC "X2IX"
+#define INDEX_VERSION 1
+#define INDEX_HEADER_SIZE 64
+#define INDEX_EXTENT_SIZE 16
+#define INDEX_IMAGE_SIZE 40
+#define INDEX_FLAG_DEFLATED 1u
+// extents fetched at once while mapping a range of the picture stream
+#define INDEX_EXTENT_BATCH 32
+
+// BIFF record headers interrupting the drawing group, left out of the image extents
+#define INDEX_RECORD_HEADER_SIZE 4
+
+struct XLS2IMG_INDEX {
+    const uint8_t* data;
+    size_t size;
+    const uint8_t* stream_extents;
+    const uint8_t* images;
+    const uint8_t* extents;
+    const uint8_t* prefixes;
+    uint32_t image_count;
+    uint32_t stream_extent_count;
+    uint32_t extent_count;
+    size_t prefixes_size;
+};
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} IndexBuffer;
+
+typedef struct {
+    XLS2IMG_ALLOCATOR* allocator;
+    XLS2IMG_CURSOR* extents_cursor;     // maps image ranges of the picture stream to the file, NULL without one
+    XLS2IMG_CURSOR* record_cursor;      // reads the record headers inside an image span
+    uint64_t stream_size;
+    const XLS2IMG_ZIP_ENTRY* media;     // package entries, in the order their images are delivered
+    size_t media_count;
+    size_t media_pos;
+    size_t record_next;                 // header of the next record to read
+    size_t payload_start;               // payload of the last record read
+    size_t payload_end;
+    IndexBuffer images;
+    IndexBuffer extents;
+    IndexBuffer prefixes;
+    uint32_t image_count;
+    uint32_t extent_count;
+    uint32_t image_extents;             // extents of the image being added
+} IndexBuilder;
+
+static uint32_t load_u32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t load_u64(const uint8_t* p)
+{
+    return (uint64_t)load_u32(p) | (uint64_t)load_u32(p + 4) << 32;
+}
+
+static void store_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void store_u64(uint8_t* p, uint64_t v)
+{
+    store_u32(p, (uint32_t)v);
+    store_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+// 64-bit FNV-1a, used for the file hash and the index checksum
+static uint64_t index_hash(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static uint8_t* index_buffer_grow(XLS2IMG_ALLOCATOR* allocator, IndexBuffer* buffer, size_t size)
+{
+    if (size > buffer->capacity - buffer->size)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity : 256;
+        while (capacity - buffer->size < size)
+        {
+            if (capacity > SIZE_MAX / 2) return NULL;
+            capacity *= 2;
+        }
+        uint8_t* data = (uint8_t*)xls2img_mem_realloc(allocator, buffer->data, buffer->capacity, capacity);
+        if (!data) return NULL;
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    uint8_t* p = buffer->data + buffer->size;
+    buffer->size += size;
+    return p;
+}
+
+static void index_buffer_free(XLS2IMG_ALLOCATOR* allocator, IndexBuffer* buffer)
+{
+    xls2img_mem_free(allocator, buffer->data, buffer->capacity);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+// Appends an extent of the image being added, merging it with the previous one when they are adjacent
+static int index_add_extent(IndexBuilder* builder, uint64_t offset, uint64_t size)
+{
+    if (builder->image_extents > 0)
+    {
+        uint8_t* last = builder->extents.data + builder->extents.size - INDEX_EXTENT_SIZE;
+        if (load_u64(last) + load_u64(last + 8) == offset)
+        {
+            store_u64(last + 8, load_u64(last + 8) + size);
+            return XLS2IMG_SUCCESS;
+        }
+    }
+    if (builder->extent_count == UINT32_MAX) return XLS2IMG_ERROR_LIMIT_EXCEEDED;
+
+    uint8_t* p = index_buffer_grow(builder->allocator, &builder->extents, INDEX_EXTENT_SIZE);
+    if (!p) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+    store_u64(p, offset);
+    store_u64(p + 8, size);
+    builder->extent_count++;
+    builder->image_extents++;
+    return XLS2IMG_SUCCESS;
+}
+
+// Adds the file extents of [offset, offset + size) of the picture stream
+static int index_add_range(IndexBuilder* builder, size_t offset, size_t size)
+{
+    XLS2IMG_EXTENT batch[INDEX_EXTENT_BATCH];
+    while (size > 0)
+    {
+        int count = xls2img_cursor_get_workbook_extents(builder->extents_cursor, offset, size, batch, INDEX_EXTENT_BATCH);
+        if (count < 0) return count;
+        if (count > INDEX_EXTENT_BATCH)
+            count = INDEX_EXTENT_BATCH;
+
+        for (int i = 0; i < count; i++)
+        {
+            int ret = index_add_extent(builder, batch[i].offset, batch[i].size);
+            if (ret != XLS2IMG_SUCCESS) return ret;
+            offset += batch[i].size;
+            size -= batch[i].size;
+        }
+    }
+    return XLS2IMG_SUCCESS;
+}
+
+// Adds the extents of an image interrupted by record headers: its span is walked record by record from where the
+// previous image left off, images being delivered in stream order
+static int index_add_span(IndexBuilder* builder, size_t offset, size_t size, size_t span)
+{
+    if (offset < builder->payload_start)
+    {
+        builder->record_next = 0;
+        builder->payload_start = 0;
+        builder->payload_end = 0;
+    }
+
+    size_t end = offset + span;
+    while (size > 0)
+    {
+        while (builder->payload_end <= offset)
+        {
+            uint8_t header[INDEX_RECORD_HEADER_SIZE];
+            if (builder->record_next > builder->stream_size - INDEX_RECORD_HEADER_SIZE ||
+                builder->stream_size < INDEX_RECORD_HEADER_SIZE)
+                return XLS2IMG_ERROR_FILE_CORRUPTED;
+            int ret = xls2img_cursor_read(builder->record_cursor, builder->record_next, header, sizeof(header));
+            if (ret != XLS2IMG_SUCCESS) return ret;
+
+            builder->payload_start = builder->record_next + INDEX_RECORD_HEADER_SIZE;
+            builder->payload_end = builder->payload_start + (header[3] << 8 | header[2]);
+            builder->record_next = builder->payload_end;
+        }
+        if (offset < builder->payload_start)
+            offset = builder->payload_start;
+
+        size_t len = builder->payload_end - offset;
+        if (len > size)
+            len = size;
+        int ret = index_add_range(builder, offset, len);
+        if (ret != XLS2IMG_SUCCESS) return ret;
+        offset += len;
+        size -= len;
+    }
+    return offset == end ? XLS2IMG_SUCCESS : XLS2IMG_ERROR_FILE_CORRUPTED;
+}
+
+static int index_add_image(const XLS2IMG_IMAGE* image, void* user)
+{
+    IndexBuilder* builder = (IndexBuilder*)user;
+    if (builder->image_count == INT32_MAX || builder->prefixes.size > UINT32_MAX - image->prefix_size)
+        return XLS2IMG_ERROR_LIMIT_EXCEEDED;
+
+    uint32_t first = builder->extent_count;
+    uint32_t flags = 0;
+    int ret = XLS2IMG_SUCCESS;
+    builder->image_extents = 0;
+
+    if (builder->media)
+    {
+        // the images of a package are its media entries in table order, minus the skipped ones
+        while (builder->media_pos < builder->media_count && builder->media[builder->media_pos].data_offset != image->offset)
+            builder->media_pos++;
+        if (builder->media_pos < builder->media_count)
+        {
+            const XLS2IMG_ZIP_ENTRY* entry = &builder->media[builder->media_pos++];
+            if (entry->method == 8)
+                flags |= INDEX_FLAG_DEFLATED;
+            ret = index_add_extent(builder, entry->data_offset, entry->stored_size);
+        }
+    }
+    else if (builder->extents_cursor && image->span == image->size)
+        ret = index_add_range(builder, image->offset, image->size);
+    else if (builder->extents_cursor)
+        ret = index_add_span(builder, image->offset, image->size, image->span);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+
+    uint8_t* entry = index_buffer_grow(builder->allocator, &builder->images, INDEX_IMAGE_SIZE);
+    uint8_t* prefix = image->prefix_size ? index_buffer_grow(builder->allocator, &builder->prefixes, image->prefix_size) : NULL;
+    if (!entry || (image->prefix_size && !prefix)) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+    if (prefix)
+        memcpy(prefix, image->prefix, image->prefix_size);
+
+    store_u32(entry, (uint32_t)image->format);
+    store_u32(entry + 4, flags);
+    store_u64(entry + 8, image->size);
+    store_u64(entry + 16, image->offset);
+    store_u32(entry + 24, first);
+    store_u32(entry + 28, builder->image_extents);
+    store_u32(entry + 32, (uint32_t)(builder->prefixes.size - image->prefix_size));
+    store_u32(entry + 36, (uint32_t)image->prefix_size);
+    builder->image_count++;
+    return XLS2IMG_SUCCESS;
+}
+
+static void index_builder_free(IndexBuilder* builder)
+{
+    xls2img_cursor_close(builder->extents_cursor);
+    xls2img_cursor_close(builder->record_cursor);
+    index_buffer_free(builder->allocator, &builder->images);
+    index_buffer_free(builder->allocator, &builder->extents);
+    index_buffer_free(builder->allocator, &builder->prefixes);
+}
+
+int xls2img_index_build(const XLS2IMG_READER* reader, uint64_t mtime, void** data, size_t* size,
+    const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    if (!reader || !data || !size) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    // embedded objects are not located in the file, so the index covers the file's own images
+    XLS2IMG_EXTRACT_OPTIONS resolved;
+    if (options)
+        resolved = *options;
+    else
+        memset(&resolved, 0, sizeof(resolved));
+    if (!resolved.allocator)
+        resolved.allocator = xls2img_reader_allocator(reader);
+    resolved.embedded_depth = 0;
+
+    IndexBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.allocator = resolved.allocator;
+    builder.media = xls2img_reader_media(reader, &builder.media_count);
+
+    XLS2IMG_EXTENT* stream_extents = NULL;
+    int stream_extent_count = 0;
+    int ret = xls2img_picture_cursor_open(&builder.extents_cursor, &builder.stream_size, reader, &resolved);
+    if (ret == XLS2IMG_SUCCESS && builder.extents_cursor)
+        ret = xls2img_picture_cursor_open(&builder.record_cursor, &builder.stream_size, reader, &resolved);
+    if (ret == XLS2IMG_SUCCESS && builder.stream_size > 0)
+    {
+        ret = xls2img_cursor_get_workbook_extents(builder.extents_cursor, 0, (size_t)builder.stream_size, NULL, 0);
+        if (ret > 0)
+        {
+            stream_extents = (XLS2IMG_EXTENT*)xls2img_mem_alloc(builder.allocator, ret * sizeof(XLS2IMG_EXTENT));
+            if (stream_extents)
+                stream_extent_count = ret;
+            ret = stream_extents ? xls2img_cursor_get_workbook_extents(builder.extents_cursor, 0, (size_t)builder.stream_size,
+                stream_extents, stream_extent_count) : XLS2IMG_ERROR_OUT_OF_MEMORY;
+        }
+        if (ret >= 0)
+            ret = XLS2IMG_SUCCESS;
+    }
+    if (ret == XLS2IMG_SUCCESS)
+    {
+        ret = xls2img_stream_images(reader, index_add_image, &builder, &resolved);
+        if (ret > 0 || ret == XLS2IMG_ERROR_NO_IMAGES)
+            ret = XLS2IMG_SUCCESS;
+    }
+
+    uint8_t* index = NULL;
+    size_t file_size = 0;
+    const uint8_t* file = xls2img_reader_data(reader, &file_size);
+    size_t stream_extents_offset = INDEX_HEADER_SIZE;
+    size_t images_offset = stream_extents_offset + (size_t)stream_extent_count * INDEX_EXTENT_SIZE;
+    size_t extents_offset = images_offset + builder.images.size;
+    size_t prefixes_offset = extents_offset + builder.extents.size;
+    size_t index_size = prefixes_offset + align8(builder.prefixes.size);
+    if (ret == XLS2IMG_SUCCESS)
+    {
+        index = (uint8_t*)xls2img_block_alloc(builder.allocator, index_size);
+        if (!index)
+            ret = XLS2IMG_ERROR_OUT_OF_MEMORY;
+    }
+    if (ret == XLS2IMG_SUCCESS)
+    {
+        memset(index, 0, index_size);
+        memcpy(index, INDEX_MAGIC, 4);
+        store_u32(index + 4, INDEX_VERSION);
+        store_u64(index + 16, file_size);
+        store_u64(index + 24, mtime);
+        store_u64(index + 32, index_hash(file, file_size));
+        store_u64(index + 40, builder.stream_size);
+        store_u32(index + 48, (uint32_t)xls2img_get_container(reader));
+        store_u32(index + 52, builder.image_count);
+        store_u32(index + 56, (uint32_t)stream_extent_count);
+        store_u32(index + 60, builder.extent_count);
+        for (int i = 0; i < stream_extent_count; i++)
+        {
+            store_u64(index + stream_extents_offset + i * INDEX_EXTENT_SIZE, stream_extents[i].offset);
+            store_u64(index + stream_extents_offset + i * INDEX_EXTENT_SIZE + 8, stream_extents[i].size);
+        }
+        if (builder.images.size)
+            memcpy(index + images_offset, builder.images.data, builder.images.size);
+        if (builder.extents.size)
+            memcpy(index + extents_offset, builder.extents.data, builder.extents.size);
+        if (builder.prefixes.size)
+            memcpy(index + prefixes_offset, builder.prefixes.data, builder.prefixes.size);
+        store_u64(index + 8, index_hash(index + 16, index_size - 16));
+
+        *data = index;
+        *size = index_size;
+    }
+
+    xls2img_mem_free(builder.allocator, stream_extents, stream_extent_count * sizeof(XLS2IMG_EXTENT));
+    index_builder_free(&builder);
+    return ret;
+}
+
+void xls2img_free_index_data(void* data)
+{
+    xls2img_block_free(data);
+}
+
+// Checks that the extents of an image stay inside the index and add up to what the image needs
+static int index_check_image(const XLS2IMG_INDEX* index, const uint8_t* entry)
+{
+    uint32_t first = load_u32(entry + 24);
+    uint32_t count = load_u32(entry + 28);
+    uint64_t size = load_u64(entry + 8);
+    if (first > index->extent_count || count > index->extent_count - first || count > INT32_MAX ||
+        load_u32(entry + 32) > index->prefixes_size || load_u32(entry + 36) > index->prefixes_size - load_u32(entry + 32) ||
+        size > SIZE_MAX || load_u64(entry + 16) > SIZE_MAX)
+        return 0;
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint64_t extent_size = load_u64(index->extents + (size_t)(first + i) * INDEX_EXTENT_SIZE + 8);
+        if (extent_size > UINT64_MAX - total) return 0;
+        total += extent_size;
+    }
+
+    // a deflated entry is one extent holding the compressed data
+    if (load_u32(entry + 4) & INDEX_FLAG_DEFLATED)
+        return count == 1 && total > 0 && size / XLS2IMG_INFLATE_MAX_RATIO <= total;
+    return count == 0 || total == size;
+}
+
+int xls2img_index_open(XLS2IMG_INDEX** index, const void* data, size_t size)
+{
+    return xls2img_index_open_ex(index, data, size, NULL);
+}
+
+int xls2img_index_open_ex(XLS2IMG_INDEX** index, const void* data, size_t size, XLS2IMG_ALLOCATOR* allocator)
+{
+    if (!index || !data) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    const uint8_t* p = (const uint8_t*)data;
+    if (size < INDEX_HEADER_SIZE || memcmp(p, INDEX_MAGIC, 4) != 0 || size % 8 != 0) return XLS2IMG_ERROR_FILE_CORRUPTED;
+    if (load_u32(p + 4) != INDEX_VERSION) return XLS2IMG_ERROR_WRONG_FORMAT;
+    if (index_hash(p + 16, size - 16) != load_u64(p + 8)) return XLS2IMG_ERROR_FILE_CORRUPTED;
+
+    uint32_t image_count = load_u32(p + 52);
+    uint32_t stream_extent_count = load_u32(p + 56);
+    uint32_t extent_count = load_u32(p + 60);
+    uint64_t tables = (uint64_t)stream_extent_count * INDEX_EXTENT_SIZE + (uint64_t)image_count * INDEX_IMAGE_SIZE +
+        (uint64_t)extent_count * INDEX_EXTENT_SIZE;
+    if (image_count > INT32_MAX || stream_extent_count > INT32_MAX || tables > size - INDEX_HEADER_SIZE)
+        return XLS2IMG_ERROR_FILE_CORRUPTED;
+
+    // a block remembers its allocator for xls2img_index_close
+    XLS2IMG_INDEX* x = (XLS2IMG_INDEX*)xls2img_block_alloc(allocator, sizeof(XLS2IMG_INDEX));
+    if (!x) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+    x->data = p;
+    x->size = size;
+    x->image_count = image_count;
+    x->stream_extent_count = stream_extent_count;
+    x->extent_count = extent_count;
+    x->stream_extents = p + INDEX_HEADER_SIZE;
+    x->images = x->stream_extents + (size_t)stream_extent_count * INDEX_EXTENT_SIZE;
+    x->extents = x->images + (size_t)image_count * INDEX_IMAGE_SIZE;
+    x->prefixes = x->extents + (size_t)extent_count * INDEX_EXTENT_SIZE;
+    x->prefixes_size = size - (size_t)(x->prefixes - p);
+
+    for (uint32_t i = 0; i < image_count; i++)
+    {
+        if (!index_check_image(x, x->images + (size_t)i * INDEX_IMAGE_SIZE))
+        {
+            xls2img_block_free(x);
+            return XLS2IMG_ERROR_FILE_CORRUPTED;
+        }
+    }
+
+    *index = x;
+    return XLS2IMG_SUCCESS;
+}
+
+void xls2img_index_close(XLS2IMG_INDEX* index)
+{
+    xls2img_block_free(index);
+}
+
+int xls2img_index_get_info(const XLS2IMG_INDEX* index, XLS2IMG_INDEX_INFO* info)
+{
+    if (!index || !info) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    info->file_size = load_u64(index->data + 16);
+    info->mtime = load_u64(index->data + 24);
+    info->file_hash = load_u64(index->data + 32);
+    info->stream_size = load_u64(index->data + 40);
+    info->container = (XLS2IMG_CONTAINER)load_u32(index->data + 48);
+    info->image_count = (int)index->image_count;
+    info->stream_extent_count = (int)index->stream_extent_count;
+    return XLS2IMG_SUCCESS;
+}
+
+static int index_copy_extents(const uint8_t* table, uint32_t count, XLS2IMG_EXTENT* extents, int max_extents)
+{
+    for (uint32_t i = 0; i < count && i < (uint32_t)max_extents; i++)
+    {
+        extents[i].offset = (size_t)load_u64(table + (size_t)i * INDEX_EXTENT_SIZE);
+        extents[i].size = (size_t)load_u64(table + (size_t)i * INDEX_EXTENT_SIZE + 8);
+    }
+    return (int)count;
+}
+
+int xls2img_index_get_stream_extents(const XLS2IMG_INDEX* index, XLS2IMG_EXTENT* extents, int max_extents)
+{
+    if (!index || max_extents < 0 || (max_extents > 0 && !extents)) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    return index_copy_extents(index->stream_extents, index->stream_extent_count, extents, max_extents);
+}
+
+int xls2img_index_get_image(const XLS2IMG_INDEX* index, int number, XLS2IMG_INDEX_IMAGE* image)
+{
+    if (!index || !image || number < 0 || (uint32_t)number >= index->image_count) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    const uint8_t* entry = index->images + (size_t)number * INDEX_IMAGE_SIZE;
+    image->format = (XLS2IMG_FORMAT)load_u32(entry);
+    image->deflated = (load_u32(entry + 4) & INDEX_FLAG_DEFLATED) != 0;
+    image->size = (size_t)load_u64(entry + 8);
+    image->offset = (size_t)load_u64(entry + 16);
+    image->extent_count = (int)load_u32(entry + 28);
+    image->prefix_size = load_u32(entry + 36);
+    image->prefix = image->prefix_size ? index->prefixes + load_u32(entry + 32) : NULL;
+    return XLS2IMG_SUCCESS;
+}
+
+int xls2img_index_get_image_extents(const XLS2IMG_INDEX* index, int number, XLS2IMG_EXTENT* extents, int max_extents)
+{
+    if (!index || number < 0 || (uint32_t)number >= index->image_count || max_extents < 0 || (max_extents > 0 && !extents))
+        return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    const uint8_t* entry = index->images + (size_t)number * INDEX_IMAGE_SIZE;
+    return index_copy_extents(index->extents + (size_t)load_u32(entry + 24) * INDEX_EXTENT_SIZE, load_u32(entry + 28),
+        extents, max_extents);
+}
+
+int xls2img_index_read_image(const XLS2IMG_INDEX* index, int number, const void* file, size_t file_size,
+    void* buffer, size_t buffer_size)
+{
+    XLS2IMG_INDEX_IMAGE image;
+    int ret = xls2img_index_get_image(index, number, &image);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+    if (!file || !buffer || file_size != load_u64(index->data + 16) || image.prefix_size > buffer_size ||
+        image.size > buffer_size - image.prefix_size)
+        return XLS2IMG_ERROR_INVALID_ARGUMENT;
+    if (image.extent_count == 0) return XLS2IMG_ERROR_UNSUPPORTED;
+
+    uint8_t* out = (uint8_t*)buffer;
+    if (image.prefix_size)
+        memcpy(out, image.prefix, image.prefix_size);
+    out += image.prefix_size;
+
+    const uint8_t* table = index->extents + (size_t)load_u32(index->images + (size_t)number * INDEX_IMAGE_SIZE + 24) * INDEX_EXTENT_SIZE;
+    for (int i = 0; i < image.extent_count; i++)
+    {
+        uint64_t offset = load_u64(table + (size_t)i * INDEX_EXTENT_SIZE);
+        uint64_t size = load_u64(table + (size_t)i * INDEX_EXTENT_SIZE + 8);
+        if (offset > file_size || size > file_size - offset) return XLS2IMG_ERROR_FILE_CORRUPTED;
+
+        const uint8_t* src = (const uint8_t*)file + offset;
+        if (image.deflated)
+            return xls2img_inflate(src, (size_t)size, out, image.size);
+        memcpy(out, src, (size_t)size);
+        out += size;
+    }
+    return XLS2IMG_SUCCESS;
+}
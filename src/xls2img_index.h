@@ -0,0 +1,62 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Sidecar image index
+ *
+ * An .x2i file describes where the images of one file lie in it, so that a server can copy image N straight
+ * out of the file instead of parsing it again. xls2img_index_build writes it through the reader; the reader
+ * functions below give it the picture stream and the package table it needs to locate the images.
+ *
+ * Layout (little endian, 8-byte aligned):
+ *   header         "X2IX", uint32 version, uint64 checksum (FNV-1a 64 of the bytes that follow),
+ *                  uint64 file size, uint64 mtime, uint64 file hash (FNV-1a 64 of the file), uint64 stream size,
+ *                  uint32 container, uint32 image count, uint32 stream extent count, uint32 image extent count
+ *   stream extents uint64 file offset, uint64 size
+ *   images         uint32 format, uint32 flags (bit 0: deflated), uint64 size, uint64 offset,
+ *                  uint32 first extent, uint32 extent count, uint32 prefix offset, uint32 prefix size
+ *   image extents  uint64 file offset, uint64 size
+ *   prefixes       the prefix bytes of every image, zero padded to 8 bytes
+ */
+
+#ifndef XLS2IMG_INDEX_H
+#define XLS2IMG_INDEX_H
+
+#include "xls2img.h"
+#include "xls2img_zip.h"
+
+// Opens a cursor over the stream the image offsets of the reader's document are in: the workbook, or the Pictures
+// stream of a presentation. A Word document, a package or a presentation without pictures gets no cursor.
+// Defined in xls2img_reader.c.
+int xls2img_picture_cursor_open(XLS2IMG_CURSOR** cursor, uint64_t* size, const XLS2IMG_READER* reader,
+    const XLS2IMG_EXTRACT_OPTIONS* options);
+
+// The file data of a reader, and the media table of a package (NULL for a compound file). Defined in xls2img_reader.c.
+const uint8_t* xls2img_reader_data(const XLS2IMG_READER* reader, size_t* size);
+const XLS2IMG_ZIP_ENTRY* xls2img_reader_media(const XLS2IMG_READER* reader, size_t* count);
+
+#endif /* XLS2IMG_INDEX_H */
@@ -0,0 +1,410 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "xls2img.h"
+#include "xls2img_inflate.h"
+#include <string.h>
+
+// Codes of up to INFLATE_FAST_BITS bits are decoded with one table lookup, longer ones canonically
+#define INFLATE_FAST_BITS 10
+#define INFLATE_FAST_SIZE (1 << INFLATE_FAST_BITS)
+#define INFLATE_MAX_BITS 15
+
+typedef struct {
+    uint16_t fast[INFLATE_FAST_SIZE];       // code length << 9 | symbol, 0 for codes longer than INFLATE_FAST_BITS
+    uint16_t first_code[INFLATE_MAX_BITS + 1];
+    uint16_t first_symbol[INFLATE_MAX_BITS + 1];
+    uint32_t max_code[INFLATE_MAX_BITS + 2]; // one past the last code of each length, left-aligned to 16 bits
+    uint8_t lengths[288];                   // by canonical code order
+    uint16_t symbols[288];
+} INFLATE_TABLE;
+
+// Input position. The symbol loop works on a local copy, which the output stores cannot alias.
+typedef struct {
+    const uint8_t* in;
+    const uint8_t* in_end;
+    size_t padding;                         // zero bytes loaded past the end of the input
+    uint64_t bits;                          // LSB first; bits above bit_count hold the next input byte
+    unsigned int bit_count;
+} INFLATE_BITS;
+
+typedef struct {
+    INFLATE_BITS input;
+    uint8_t* out;
+    size_t out_pos;
+    size_t out_size;
+    INFLATE_TABLE literals;
+    INFLATE_TABLE distances;
+} INFLATE_STATE;
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+    6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static unsigned int bit_reverse(unsigned int code, unsigned int bits)
+{
+    code = ((code & 0xAAAA) >> 1) | ((code & 0x5555) << 1);
+    code = ((code & 0xCCCC) >> 2) | ((code & 0x3333) << 2);
+    code = ((code & 0xF0F0) >> 4) | ((code & 0x0F0F) << 4);
+    code = ((code & 0xFF00) >> 8) | ((code & 0x00FF) << 8);
+    return code >> (16 - bits);
+}
+
+// Builds the decoding table of a canonical code. Incomplete codes are accepted, as the single distance code of a
+// block without matches is; over-subscribed ones are not.
+static int inflate_build(INFLATE_TABLE* table, const uint8_t* lengths, unsigned int count)
+{
+    unsigned int counts[INFLATE_MAX_BITS + 1];
+    unsigned int next_code[INFLATE_MAX_BITS + 1];
+    memset(counts, 0, sizeof(counts));
+    memset(table->fast, 0, sizeof(table->fast));
+    for (unsigned int i = 0; i < count; i++)
+        counts[lengths[i]]++;
+    counts[0] = 0;
+
+    unsigned int code = 0;
+    unsigned int symbol = 0;
+    for (unsigned int bits = 1; bits <= INFLATE_MAX_BITS; bits++)
+    {
+        next_code[bits] = code;
+        table->first_code[bits] = (uint16_t)code;
+        table->first_symbol[bits] = (uint16_t)symbol;
+        code += counts[bits];
+        if (counts[bits] && code - 1 >= (1u << bits))
+            return 0;
+        table->max_code[bits] = code << (16 - bits);
+        code <<= 1;
+        symbol += counts[bits];
+    }
+    table->max_code[INFLATE_MAX_BITS + 1] = 0x10000;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        unsigned int bits = lengths[i];
+        if (!bits)
+            continue;
+        unsigned int index = next_code[bits] - table->first_code[bits] + table->first_symbol[bits];
+        table->lengths[index] = (uint8_t)bits;
+        table->symbols[index] = (uint16_t)i;
+        if (bits <= INFLATE_FAST_BITS)
+        {
+            for (unsigned int j = bit_reverse(next_code[bits], bits); j < INFLATE_FAST_SIZE; j += 1u << bits)
+                table->fast[j] = (uint16_t)(bits << 9 | i);
+        }
+        next_code[bits]++;
+    }
+    return 1;
+}
+
+// Tops the bit buffer up to at least 56 bits. Away from the end of the input this is one unaligned load; the
+// bytes it takes are those that fit whole, the rest of the load is read again by the next refill.
+static void inflate_refill(INFLATE_BITS* s)
+{
+    if (s->in_end - s->in >= 8)
+    {
+        const uint8_t* p = s->in;
+        uint64_t word = (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+            ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+        s->bits |= word << s->bit_count;
+        s->in += (63 - s->bit_count) >> 3;
+        s->bit_count |= 56;
+        return;
+    }
+
+    while (s->bit_count <= 56)
+    {
+        if (s->in < s->in_end)
+            s->bits |= (uint64_t)*s->in++ << s->bit_count;
+        else
+            s->padding++;
+        s->bit_count += 8;
+    }
+}
+
+static unsigned int inflate_take(INFLATE_BITS* s, unsigned int n)
+{
+    unsigned int value = (unsigned int)(s->bits & ((1ull << n) - 1));
+    s->bits >>= n;
+    s->bit_count -= n;
+    return value;
+}
+
+// Decodes one symbol, -1 for a code the table does not assign. The buffer holds at least 15 bits.
+static int inflate_decode(INFLATE_BITS* s, const INFLATE_TABLE* table)
+{
+    unsigned int entry = table->fast[s->bits & (INFLATE_FAST_SIZE - 1)];
+    if (entry)
+    {
+        inflate_take(s, entry >> 9);
+        return (int)(entry & 511);
+    }
+
+    unsigned int code = bit_reverse((unsigned int)(s->bits & 0xFFFF), 16);
+    unsigned int bits = INFLATE_FAST_BITS + 1;
+    while (code >= table->max_code[bits])
+        bits++;
+    if (bits > INFLATE_MAX_BITS)
+        return -1;
+
+    unsigned int index = (code >> (16 - bits)) - table->first_code[bits] + table->first_symbol[bits];
+    if (index >= 288 || table->lengths[index] != bits)
+        return -1;
+    inflate_take(s, bits);
+    return table->symbols[index];
+}
+
+// Bits past the end of the input have been consumed, rather than only loaded
+static int inflate_overrun(const INFLATE_BITS* s)
+{
+    return s->padding * 8 > s->bit_count;
+}
+
+static int inflate_stored(INFLATE_STATE* s)
+{
+    // the block starts at the next byte boundary; return the whole bytes still buffered to the input
+    INFLATE_BITS* b = &s->input;
+    inflate_take(b, b->bit_count & 7);
+    size_t buffered = b->bit_count / 8;
+    if (b->padding > buffered)
+        return 0;
+    b->in -= buffered - b->padding;
+    b->padding = 0;
+    b->bits = 0;
+    b->bit_count = 0;
+
+    if (b->in_end - b->in < 4)
+        return 0;
+    size_t len = b->in[0] | (b->in[1] << 8);
+    size_t nlen = b->in[2] | (b->in[3] << 8);
+    b->in += 4;
+    if (len != (~nlen & 0xFFFF) || len > (size_t)(b->in_end - b->in) || len > s->out_size - s->out_pos)
+        return 0;
+
+    memcpy(s->out + s->out_pos, b->in, len);
+    b->in += len;
+    s->out_pos += len;
+    return 1;
+}
+
+static int inflate_dynamic_tables(INFLATE_STATE* s)
+{
+    static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    uint8_t lengths[288 + 32];
+    uint8_t code_lengths[19];
+    INFLATE_BITS* b = &s->input;
+
+    inflate_refill(b);
+    unsigned int literal_count = inflate_take(b, 5) + 257;
+    unsigned int distance_count = inflate_take(b, 5) + 1;
+    unsigned int code_length_count = inflate_take(b, 4) + 4;
+    if (literal_count > 286 || distance_count > 30)
+        return 0;
+
+    memset(code_lengths, 0, sizeof(code_lengths));
+    for (unsigned int i = 0; i < code_length_count; i++)
+    {
+        inflate_refill(b);
+        code_lengths[order[i]] = (uint8_t)inflate_take(b, 3);
+    }
+    if (!inflate_build(&s->literals, code_lengths, 19))
+        return 0;
+
+    unsigned int total = literal_count + distance_count;
+    unsigned int n = 0;
+    while (n < total)
+    {
+        inflate_refill(b);
+        if (inflate_overrun(b))
+            return 0;
+        int symbol = inflate_decode(b, &s->literals);
+        if (symbol < 0)
+            return 0;
+        if (symbol < 16)
+        {
+            lengths[n++] = (uint8_t)symbol;
+            continue;
+        }
+
+        unsigned int repeat;
+        uint8_t value = 0;
+        if (symbol == 16)
+        {
+            if (n == 0)
+                return 0;
+            value = lengths[n - 1];
+            repeat = 3 + inflate_take(b, 2);
+        }
+        else if (symbol == 17)
+            repeat = 3 + inflate_take(b, 3);
+        else
+            repeat = 11 + inflate_take(b, 7);
+        if (repeat > total - n)
+            return 0;
+        memset(lengths + n, value, repeat);
+        n += repeat;
+    }
+
+    // a block must be able to end
+    if (lengths[256] == 0)
+        return 0;
+    return inflate_build(&s->literals, lengths, literal_count) &&
+        inflate_build(&s->distances, lengths + literal_count, distance_count);
+}
+
+static int inflate_fixed_tables(INFLATE_STATE* s)
+{
+    uint8_t lengths[288];
+    memset(lengths, 8, 144);
+    memset(lengths + 144, 9, 112);
+    memset(lengths + 256, 7, 24);
+    memset(lengths + 280, 8, 8);
+    if (!inflate_build(&s->literals, lengths, 288))
+        return 0;
+    memset(lengths, 5, 30);
+    return inflate_build(&s->distances, lengths, 30);
+}
+
+// Decodes the symbols of a compressed block up to its end-of-block code
+static int inflate_codes(INFLATE_STATE* s)
+{
+    INFLATE_BITS b = s->input;
+    uint8_t* out = s->out;
+    size_t out_pos = s->out_pos;
+    size_t out_size = s->out_size;
+
+    for (;;)
+    {
+        // a refill leaves at least 56 bits, enough for several literals: a literal/length code and its extra bits
+        // take up to 20 bits, a distance code and its extra bits up to 28
+        if (b.bit_count < 20)
+        {
+            inflate_refill(&b);
+            if (b.padding && inflate_overrun(&b))
+                return 0;
+        }
+
+        int symbol = inflate_decode(&b, &s->literals);
+        if (symbol < 256)
+        {
+            if (symbol < 0 || out_pos == out_size)
+                return 0;
+            out[out_pos++] = (uint8_t)symbol;
+            continue;
+        }
+        if (symbol == 256)
+            break;
+
+        symbol -= 257;
+        if (symbol >= 29)
+            return 0;
+        size_t length = length_base[symbol] + inflate_take(&b, length_extra[symbol]);
+
+        if (b.bit_count < 28)
+            inflate_refill(&b);
+        symbol = inflate_decode(&b, &s->distances);
+        if (symbol < 0 || symbol >= 30)
+            return 0;
+        size_t distance = distance_base[symbol] + inflate_take(&b, distance_extra[symbol]);
+        if (distance > out_pos || length > out_size - out_pos)
+            return 0;
+
+        // a copy never overlaps its source: a match longer than its distance repeats the pattern, which doubles
+        // with every copy
+        uint8_t* dst = out + out_pos;
+        const uint8_t* src = dst - distance;
+        out_pos += length;
+        if (distance == 1)
+            memset(dst, *src, length);
+        else
+        {
+            while (length > (size_t)(dst - src))
+            {
+                size_t n = (size_t)(dst - src);
+                memcpy(dst, src, n);
+                dst += n;
+                length -= n;
+            }
+            memcpy(dst, src, length);
+        }
+    }
+
+    s->input = b;
+    s->out_pos = out_pos;
+    return 1;
+}
+
+int xls2img_inflate(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size)
+{
+    INFLATE_STATE s;
+    s.input.in = in;
+    s.input.in_end = in + in_size;
+    s.input.padding = 0;
+    s.input.bits = 0;
+    s.input.bit_count = 0;
+    s.out = out;
+    s.out_pos = 0;
+    s.out_size = out_size;
+
+    int final_block = 0;
+    int fixed_tables = 0;   // the tables hold the fixed codes, built by the first block that uses them
+    while (!final_block)
+    {
+        inflate_refill(&s.input);
+        final_block = (int)inflate_take(&s.input, 1);
+        unsigned int type = inflate_take(&s.input, 2);
+
+        int ok;
+        if (type == 0)
+            ok = inflate_stored(&s);
+        else if (type == 1)
+        {
+            ok = (fixed_tables || inflate_fixed_tables(&s)) && inflate_codes(&s);
+            fixed_tables = 1;
+        }
+        else if (type == 2)
+        {
+            fixed_tables = 0;
+            ok = inflate_dynamic_tables(&s) && inflate_codes(&s);
+        }
+        else
+            ok = 0;
+
+        if (!ok || inflate_overrun(&s.input))
+            return XLS2IMG_ERROR_FILE_CORRUPTED;
+    }
+
+    return s.out_pos == out_size && !inflate_overrun(&s.input) ? XLS2IMG_SUCCESS : XLS2IMG_ERROR_FILE_CORRUPTED;
+}
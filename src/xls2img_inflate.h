@@ -0,0 +1,50 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * DEFLATE decoder
+ *
+ * Decodes a raw DEFLATE stream (RFC 1951) whose input and output are both whole in memory, as the deflated
+ * entries of a ZIP package are: the central directory gives the decompressed size, so the output buffer is
+ * allocated once and every length and distance is checked against it instead of against a sliding window.
+ */
+
+#ifndef XLS2IMG_INFLATE_H
+#define XLS2IMG_INFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest ratio of decoded to encoded size: a 258-byte match costs at least 2 bits
+#define XLS2IMG_INFLATE_MAX_RATIO 1032
+
+// Decodes in into out, which receives exactly out_size bytes.
+// Returns XLS2IMG_SUCCESS, or XLS2IMG_ERROR_FILE_CORRUPTED if the stream is invalid, ends early or does not
+// decode to exactly out_size bytes.
+int xls2img_inflate(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size);
+
+#endif /* XLS2IMG_INFLATE_H */
@@ -0,0 +1,49 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * OfficeArt push parser
+ *
+ * The parser of xls2img_parser_open walks BIFF records and scans the payload of the drawing group. Presentations
+ * and Word documents store their blips outside any record stream, in the Pictures and Data streams or in ranges
+ * the BStore points at, so their data is scanned as it comes. Each range is scanned like one drawing group: an
+ * image in progress ends with it.
+ */
+
+#ifndef XLS2IMG_PARSER_H
+#define XLS2IMG_PARSER_H
+
+#include "xls2img.h"
+
+// Opens a parser that scans every byte fed, as a range starting at stream offset 0
+int xls2img_parser_open_raw(XLS2IMG_PARSER** parser, XLS2IMG_IMAGE_FUNC on_image, void* user,
+    const XLS2IMG_EXTRACT_OPTIONS* options);
+
+// Ends the range fed so far, delivering its last image, and starts one at stream offset position
+int xls2img_parser_begin_range(XLS2IMG_PARSER* parser, size_t position);
+
+#endif /* XLS2IMG_PARSER_H */
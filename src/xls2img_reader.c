@@ -25,6 +25,14 @@
  */
 
 #include "xls2img.h"
+#include "xls2img_alloc.h"
+#include "xls2img_control.h"
+#include "xls2img_index.h"
+#include "xls2img_parser.h"
+#include "xls2img_stats.h"
+#include "xls2img_trace.h"
+#include "xls2img_zip.h"
+#include <limits.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -71,30 +79,133 @@ typedef struct {
 
 #pragma pack(pop)
 
+// Word 97-2003 FIB at the start of the WordDocument stream
+#define WORD_FIB_IDENT 0xA5EC
+#define WORD_FIB_FLAGS 0x000A
+#define WORD_FIB_WHICH_TABLE 0x0200     // the table stream is 1Table rather than 0Table
+#define WORD_FIB_BASE_SIZE 32
+#define WORD_FIB_DGG_INFO 50            // index of fcDggInfo/lcbDggInfo in FibRgFcLcb97
+#define WORD_FIB_READ_SIZE 1024         // covers the FibRgFcLcb97 pairs of every Word 97-2003 FIB
+
+// OfficeArt records of the drawing group
+enum {
+    OFFICEART_DGG_CONTAINER = 0xF000,
+    OFFICEART_BSTORE_CONTAINER = 0xF001,
+    OFFICEART_FBSE = 0xF007,
+};
+#define OFFICEART_FBSE_SIZE 36          // OfficeArtFBSE up to its name
+
 struct XLS2IMG_READER {
     const uint8_t* buffer;
     size_t bufferLen;
     const COMPOUND_FILE_HDR* hdr;
     size_t sectorSize;
     size_t minisectorSize;
-    size_t miniStreamStartSector;
+    XLS2IMG_RELEASE_FUNC release;   // set when the reader owns buffer
+    void* releaseUser;
+    XLS2IMG_ALLOCATOR* allocator;   // NULL for malloc
+    size_t sectorCount;             // sectors present in the buffer, bounds every chain walk
+    uint32_t* fatSectors;           // FAT sector locations, resolved once through the header and the DIFAT chain
+    size_t fatSectorCount;
+    uint32_t* dirSectors;           // directory chain
+    size_t dirSectorCount;
+    uint32_t* miniStreamSectors;    // mini stream chain, starting at the root entry
+    size_t miniStreamSectorCount;
+    uint32_t* miniFatSectors;       // MiniFAT chain
+    size_t miniFatSectorCount;
+    int miniError;                  // set if the mini stream or MiniFAT chain is broken, reported when a mini stream is read
+    const COMPOUND_FILE_ENTRY* workbook;    // resolved once by the open
+    int workbookError;              // set if there is no usable workbook, reported by every workbook read
+    XLS2IMG_CONTAINER container;
+    XLS2IMG_ZIP_ENTRY* media;       // OOXML media entries, from the central directory
+    size_t mediaCount;
+    int mediaError;                 // set if the package has no workbook part, reported by every image read
+    XLS2IMG_LIMITS limits;
+    XLS2IMG_CONTROL* control;
+#ifdef XLS2IMG_ENABLE_STATS
+    XLS2IMG_STATS* stats;
+#endif
+#ifdef XLS2IMG_ENABLE_TRACE
+    XLS2IMG_TRACE* trace;
+#endif
+};
+
+// Everything a workbook read modifies. The reader-level functions use a cursor on the stack configured from the reader.
+// Cursors read the workbook, except inside the library, which also points them at the picture streams of documents.
+struct XLS2IMG_CURSOR {
+    const XLS2IMG_READER* reader;
+    const COMPOUND_FILE_ENTRY* stream;  // NULL if the reader has no workbook
+    uint64_t streamSize;            // size of stream, see xls2img_stream_size
+    int mini;                       // the stream is stored in the mini stream
+    size_t unitCount;               // sectors or mini sectors the stream chain can visit
+    XLS2IMG_ALLOCATOR* allocator;
+    XLS2IMG_LIMITS limits;
+#ifdef XLS2IMG_ENABLE_STATS
+    XLS2IMG_STATS* stats;
+#endif
+#ifdef XLS2IMG_ENABLE_TRACE
+    XLS2IMG_TRACE* trace;
+#endif
+    XLS2IMG_CHECKPOINT checkpoint;  // polls the control across the stream, restarted by xls2img_cursor_select
+    uint8_t* visited;               // one bit per workbook unit, allocated by the first seek
+    size_t sector;                  // sector or mini sector holding streamPos
+    size_t streamPos;               // workbook offset of the first byte of sector
+    int positioned;
 };
 
+// A search through the objects embedded in a file, see XLS2IMG_EXTRACT_OPTIONS.embedded_depth. Every image goes
+// through xls2img_embed_image. Files wrapped in streams do not count as levels, so the recursion and the object count
+// have fixed bounds of their own.
+#define XLS2IMG_EMBED_MAX_NESTING 32
+#define XLS2IMG_EMBED_MAX_OBJECTS 4096
+#define XLS2IMG_ENTRY_NAME_SIZE 96      // a directory entry name of 32 UTF-16 units in UTF-8
+
+typedef struct {
+    XLS2IMG_IMAGE_FUNC onImage;
+    void* user;
+    const XLS2IMG_EXTRACT_OPTIONS* options;     // with the limits and allocator resolved
+    const char* path;               // path of the object being searched, NULL in the file itself
+    int count;                      // images delivered by the whole search
+    uint64_t outputBytes;
+    int stop;                       // the callback's return value or exceeded limit that ended the search
+    unsigned int nesting;           // objects and storages being searched, one inside the other
+    unsigned int objects;           // objects searched
+    uint8_t* storages;              // one bit per directory entry of the compound file being searched
+} XLS2IMG_EMBED;
+
+static uint16_t parse_uint16(const void* buffer);
 static uint32_t parse_uint32(const void* buffer);
+static int xls2img_load_fat_sectors(XLS2IMG_READER* reader);
+static int xls2img_load_chain(const XLS2IMG_READER* reader, uint32_t start, uint32_t** sectors, size_t* count);
+static void xls2img_free_tables(XLS2IMG_READER* reader);
+static int xls2img_visit(uint8_t* visited, size_t count, size_t sector);
 static uint32_t xls2img_get_fat_sector_location(const XLS2IMG_READER* reader, size_t fatSectorNumber);
 static uint32_t xls2img_get_next_sector(const XLS2IMG_READER* reader, size_t sector);
 static const uint8_t* xls2img_sector_offset_to_address(const XLS2IMG_READER* reader, size_t sector, size_t offset);
-static void xls2img_locate_final_sector(const XLS2IMG_READER* reader, size_t sector, size_t offset,
-    size_t* finalSector, size_t* finalOffset);
-static void xls2img_read_stream(const XLS2IMG_READER* reader, size_t sector, size_t offset, char* buffer, size_t len);
 static uint32_t xls2img_get_next_mini_sector(const XLS2IMG_READER* reader, size_t miniSector);
 static const uint8_t* xls2img_mini_sector_offset_to_address(const XLS2IMG_READER* reader, size_t sector, size_t offset);
-static void xls2img_locate_final_mini_sector(const XLS2IMG_READER* reader, size_t sector, size_t offset,
-    size_t* finalSector, size_t* finalOffset);
-static void xls2img_read_mini_stream(const XLS2IMG_READER* reader, size_t sector, size_t offset, char* buffer, size_t len);
 static const COMPOUND_FILE_ENTRY* xls2img_get_entry(const XLS2IMG_READER* reader, uint32_t entryID);
-static void xls2img_read_file(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* entry, char* buffer);
-static int xls2img_string_compare(const uint16_t* str1, const uint16_t* str2, size_t len);
+static uint64_t xls2img_stream_size(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* entry);
+static int xls2img_find_stream(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* storage, const char* name, const COMPOUND_FILE_ENTRY** stream);
+static int xls2img_find_document(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* storage, XLS2IMG_CONTAINER* container, const COMPOUND_FILE_ENTRY** workbook);
+static void xls2img_cursor_init(XLS2IMG_CURSOR* cursor, const XLS2IMG_READER* reader);
+static void xls2img_cursor_setup(XLS2IMG_CURSOR* cursor, const XLS2IMG_READER* reader, const XLS2IMG_EXTRACT_OPTIONS* options);
+static void xls2img_cursor_select(XLS2IMG_CURSOR* cursor, const COMPOUND_FILE_ENTRY* stream);
+static void xls2img_cursor_cleanup(XLS2IMG_CURSOR* cursor);
+static int xls2img_cursor_check(const XLS2IMG_CURSOR* cursor);
+static uint32_t xls2img_cursor_next(const XLS2IMG_CURSOR* cursor, size_t sector);
+static int xls2img_cursor_seek(XLS2IMG_CURSOR* cursor, size_t offset);
+static int xls2img_cursor_map(XLS2IMG_CURSOR* cursor, size_t offset, const uint8_t** src, size_t* len);
+static int xls2img_cursor_copy(XLS2IMG_CURSOR* cursor, size_t offset, char* buffer, size_t len);
+static int xls2img_cursor_workbook(XLS2IMG_CURSOR* cursor, void** data, size_t* size);
+static int xls2img_cursor_extents(XLS2IMG_CURSOR* cursor, size_t offset, size_t size, XLS2IMG_EXTENT* extents, int max_extents);
+static int xls2img_cursor_feed(XLS2IMG_CURSOR* cursor, XLS2IMG_PARSER* parser, size_t offset, size_t size);
+static int xls2img_document_images(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* storage, XLS2IMG_IMAGE_FUNC on_image, void* user, const XLS2IMG_EXTRACT_OPTIONS* options);
+static int xls2img_word_images(XLS2IMG_CURSOR* cursor, XLS2IMG_CURSOR* table, XLS2IMG_PARSER* parser, const COMPOUND_FILE_ENTRY* storage);
+static int xls2img_embed_image(const XLS2IMG_IMAGE* image, void* user);
+static int xls2img_object_images(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* storage, XLS2IMG_EMBED* embed, unsigned int depth);
+static int xls2img_embedded_objects(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* storage, XLS2IMG_EMBED* embed, unsigned int depth);
+static int xls2img_open_package(XLS2IMG_READER* reader);
 
 const char* xls2img_strerror(int error_code)
 {
@@ -106,25 +217,51 @@ const char* xls2img_strerror(int error_code)
         case XLS2IMG_ERROR_INVALID_ARGUMENT:    return "Invalid argument";
         case XLS2IMG_ERROR_NO_WORKBOOK:         return "No workbook found";
         case XLS2IMG_ERROR_NO_IMAGES:           return "No images found";
+        case XLS2IMG_ERROR_OUT_OF_MEMORY:       return "Out of memory";
+        case XLS2IMG_ERROR_UNSUPPORTED:         return "Not supported by this build";
+        case XLS2IMG_ERROR_CHAIN_CYCLE:         return "Sector chain or directory tree contains a cycle";
+        case XLS2IMG_ERROR_LIMIT_EXCEEDED:      return "Work limit exceeded";
+        case XLS2IMG_ERROR_CANCELLED:           return "Cancelled";
+        case XLS2IMG_ERROR_TIMEOUT:             return "Deadline passed";
         default:                                return "Unknown error";
     }
 }
 
 int xls2img_open(XLS2IMG_READER** reader, const void* buffer, size_t len)
 {
-    if (!buffer || len == 0) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+    return xls2img_open_ex(reader, buffer, len, NULL);
+}
+
+int xls2img_open_ex(XLS2IMG_READER** reader, const void* buffer, size_t len, XLS2IMG_ALLOCATOR* allocator)
+{
+    if (!reader || !buffer || len == 0) return XLS2IMG_ERROR_INVALID_ARGUMENT;
 
-    XLS2IMG_READER* r = (XLS2IMG_READER*)malloc(sizeof(XLS2IMG_READER));
-    if (!r) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+    XLS2IMG_READER* r = (XLS2IMG_READER*)xls2img_mem_calloc(allocator, sizeof(XLS2IMG_READER));
+    if (!r) return XLS2IMG_ERROR_OUT_OF_MEMORY;
 
+    r->allocator = allocator;
     r->buffer = (const uint8_t*)buffer;
     r->bufferLen = len;
+
+    if (xls2img_zip_detect(r->buffer, r->bufferLen))
+    {
+        int ret = xls2img_open_package(r);
+        if (ret != XLS2IMG_SUCCESS)
+        {
+            xls2img_mem_free(allocator, r, sizeof(XLS2IMG_READER));
+            return ret;
+        }
+        *reader = r;
+        return XLS2IMG_SUCCESS;
+    }
+
+    r->container = XLS2IMG_CONTAINER_CFB;
     r->hdr = (const COMPOUND_FILE_HDR*)buffer;
 
     if (r->bufferLen < sizeof(COMPOUND_FILE_HDR) ||
         memcmp(r->hdr->signature, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1", 8) != 0)
     {
-        free(r);
+        xls2img_mem_free(allocator, r, sizeof(XLS2IMG_READER));
         return XLS2IMG_ERROR_WRONG_FORMAT;
     }
 
@@ -133,106 +270,424 @@ int xls2img_open(XLS2IMG_READER** reader, const void* buffer, size_t len)
 
     if (r->bufferLen < r->sectorSize * 3)
     {
-        free(r);
+        xls2img_mem_free(allocator, r, sizeof(XLS2IMG_READER));
         return XLS2IMG_ERROR_FILE_CORRUPTED;
     }
 
-    const COMPOUND_FILE_ENTRY* root = xls2img_get_entry(r, 0);
-    if (!root)
+    // a partial last sector still holds addressable entries
+    r->sectorCount = (r->bufferLen - r->sectorSize + r->sectorSize - 1) / r->sectorSize;
+
+    int ret = xls2img_load_fat_sectors(r);
+    if (ret == XLS2IMG_SUCCESS)
+        ret = xls2img_load_chain(r, r->hdr->firstDirectorySectorLocation, &r->dirSectors, &r->dirSectorCount);
+
+    const COMPOUND_FILE_ENTRY* root = ret == XLS2IMG_SUCCESS ? xls2img_get_entry(r, 0) : NULL;
+    if (ret == XLS2IMG_SUCCESS && !root)
+        ret = XLS2IMG_ERROR_FILE_CORRUPTED;
+    if (ret != XLS2IMG_SUCCESS)
     {
-        free(r);
-        return XLS2IMG_ERROR_FILE_CORRUPTED;
+        xls2img_free_tables(r);
+        xls2img_mem_free(allocator, r, sizeof(XLS2IMG_READER));
+        return ret;
+    }
+
+    // the mini stream only matters for streams below the cutoff, so a broken one fails those reads instead of the open
+    r->miniError = xls2img_load_chain(r, root->startSectorLocation, &r->miniStreamSectors, &r->miniStreamSectorCount);
+    if (r->miniError == XLS2IMG_SUCCESS)
+        r->miniError = xls2img_load_chain(r, r->hdr->firstMiniFATSectorLocation, &r->miniFatSectors, &r->miniFatSectorCount);
+    if (r->miniError == XLS2IMG_ERROR_OUT_OF_MEMORY)
+    {
+        xls2img_free_tables(r);
+        xls2img_mem_free(allocator, r, sizeof(XLS2IMG_READER));
+        return XLS2IMG_ERROR_OUT_OF_MEMORY;
     }
 
-    r->miniStreamStartSector = root->startSectorLocation;
+    // the workbook lookup is the last index; nothing is built after the open, so a shared reader is only ever read
+    r->workbookError = xls2img_find_document(r, NULL, &r->container, &r->workbook);
+
     *reader = r;
     return XLS2IMG_SUCCESS;
 }
 
+int xls2img_open_owned(XLS2IMG_READER** reader, void* buffer, size_t len, XLS2IMG_RELEASE_FUNC release, void* user)
+{
+    if (!release) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    int ret = xls2img_open(reader, buffer, len);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+
+    (*reader)->release = release;
+    (*reader)->releaseUser = user;
+    return XLS2IMG_SUCCESS;
+}
+
+int xls2img_set_stats(XLS2IMG_READER* reader, XLS2IMG_STATS* stats)
+{
+    if (!reader) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+#ifdef XLS2IMG_ENABLE_STATS
+    reader->stats = stats;
+    return XLS2IMG_SUCCESS;
+#else
+    (void)stats;
+    return XLS2IMG_ERROR_UNSUPPORTED;
+#endif
+}
+
+int xls2img_set_trace(XLS2IMG_READER* reader, XLS2IMG_TRACE* trace)
+{
+    if (!reader) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+#ifdef XLS2IMG_ENABLE_TRACE
+    reader->trace = trace;
+    return XLS2IMG_SUCCESS;
+#else
+    (void)trace;
+    return XLS2IMG_ERROR_UNSUPPORTED;
+#endif
+}
+
+void xls2img_trace_flush(XLS2IMG_TRACE* trace)
+{
+    if (!trace || trace->count == 0) return;
+
+    if (trace->flush)
+    {
+        // the pending events may wrap around the end of the buffer
+        size_t first = trace->capacity - trace->head;
+        if (first > trace->count)
+            first = trace->count;
+        trace->flush(trace->events + trace->head, first, trace->user);
+        if (first < trace->count)
+            trace->flush(trace->events, trace->count - first, trace->user);
+    }
+    trace->head = 0;
+    trace->count = 0;
+}
+
+int xls2img_set_limits(XLS2IMG_READER* reader, const XLS2IMG_LIMITS* limits)
+{
+    if (!reader) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    if (limits)
+        reader->limits = *limits;
+    else
+        memset(&reader->limits, 0, sizeof(reader->limits));
+    return XLS2IMG_SUCCESS;
+}
+
+int xls2img_set_control(XLS2IMG_READER* reader, XLS2IMG_CONTROL* control)
+{
+    if (!reader) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    reader->control = control;
+    return XLS2IMG_SUCCESS;
+}
+
 void xls2img_close(XLS2IMG_READER* reader)
 {
     if (reader)
-        free(reader);
+    {
+        if (reader->release)
+            reader->release((void*)reader->buffer, reader->releaseUser);
+        xls2img_free_tables(reader);
+        xls2img_zip_close(reader->allocator, reader->media, reader->mediaCount);
+        xls2img_mem_free(reader->allocator, reader, sizeof(XLS2IMG_READER));
+    }
+}
+
+XLS2IMG_ALLOCATOR* xls2img_reader_allocator(const XLS2IMG_READER* reader)
+{
+    return reader->allocator;
+}
+
+XLS2IMG_CONTAINER xls2img_get_container(const XLS2IMG_READER* reader)
+{
+    return reader ? reader->container : XLS2IMG_CONTAINER_CFB;
+}
+
+const uint8_t* xls2img_reader_data(const XLS2IMG_READER* reader, size_t* size)
+{
+    *size = reader->bufferLen;
+    return reader->buffer;
+}
+
+const XLS2IMG_ZIP_ENTRY* xls2img_reader_media(const XLS2IMG_READER* reader, size_t* count)
+{
+    *count = reader->mediaCount;
+    return reader->media;
+}
+
+int xls2img_picture_cursor_open(XLS2IMG_CURSOR** cursor, uint64_t* size, const XLS2IMG_READER* reader,
+    const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    *cursor = NULL;
+    *size = 0;
+
+    const COMPOUND_FILE_ENTRY* stream = reader->workbook;
+    if (reader->container == XLS2IMG_CONTAINER_PPT)
+    {
+        if (xls2img_find_stream(reader, NULL, "Pictures", &stream) != XLS2IMG_SUCCESS)
+            return XLS2IMG_SUCCESS;
+    }
+    else if (reader->container != XLS2IMG_CONTAINER_CFB)
+        return XLS2IMG_SUCCESS;
+
+    int ret = xls2img_cursor_open(cursor, reader, options);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+    xls2img_cursor_select(*cursor, stream);
+    if (stream)
+        *size = (*cursor)->streamSize;
+    return XLS2IMG_SUCCESS;
+}
+
+int xls2img_stream_images(const XLS2IMG_READER* reader, XLS2IMG_IMAGE_FUNC on_image, void* user, const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    if (!reader || !on_image) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    XLS2IMG_EXTRACT_OPTIONS resolved;
+    if (options)
+        resolved = *options;
+    else
+        memset(&resolved, 0, sizeof(resolved));
+    if (!resolved.allocator)
+        resolved.allocator = reader->allocator;
+    if (!resolved.limits)
+        resolved.limits = &reader->limits;
+    if (!resolved.control)
+        resolved.control = reader->control;
+
+    if (!resolved.embedded_depth)
+        return xls2img_document_images(reader, NULL, on_image, user, &resolved);
+
+    // every image goes through the search context, which tags it and applies the limits to the whole search
+    XLS2IMG_EMBED embed;
+    memset(&embed, 0, sizeof(embed));
+    embed.onImage = on_image;
+    embed.user = user;
+    embed.options = &resolved;
+    int ret = xls2img_document_images(reader, NULL, xls2img_embed_image, &embed, &resolved);
+    if (ret < 0 && ret != XLS2IMG_ERROR_NO_IMAGES) return ret;
+
+    ret = xls2img_embedded_objects(reader, NULL, &embed, resolved.embedded_depth);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+    return embed.count > 0 ? embed.count : XLS2IMG_ERROR_NO_IMAGES;
 }
 
 int xls2img_get_workbook(XLS2IMG_READER* reader, void** data, size_t* size)
 {
-    const COMPOUND_FILE_ENTRY* root = xls2img_get_entry(reader, 0);
-    if (!root) return XLS2IMG_ERROR_FILE_CORRUPTED;
+    if (!reader || !data || !size) return XLS2IMG_ERROR_INVALID_ARGUMENT;
 
-    uint32_t childID = root->childID;
-    while (childID != 0xFFFFFFFF)
+    XLS2IMG_CURSOR cursor;
+    xls2img_cursor_init(&cursor, reader);
+    int ret = xls2img_cursor_workbook(&cursor, data, size);
+    xls2img_cursor_cleanup(&cursor);
+    return ret;
+}
+
+int xls2img_get_workbook_extents(XLS2IMG_READER* reader, size_t offset, size_t size, XLS2IMG_EXTENT* extents, int max_extents)
+{
+    if (!reader || max_extents < 0 || (max_extents > 0 && !extents)) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    XLS2IMG_CURSOR cursor;
+    xls2img_cursor_init(&cursor, reader);
+    int ret = xls2img_cursor_extents(&cursor, offset, size, extents, max_extents);
+    xls2img_cursor_cleanup(&cursor);
+    return ret;
+}
+
+int xls2img_cursor_open(XLS2IMG_CURSOR** cursor, const XLS2IMG_READER* reader, const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    if (!cursor || !reader) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    XLS2IMG_ALLOCATOR* allocator = options && options->allocator ? options->allocator : reader->allocator;
+    XLS2IMG_CURSOR* c = (XLS2IMG_CURSOR*)xls2img_mem_alloc(allocator, sizeof(XLS2IMG_CURSOR));
+    if (!c) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+
+    // the stats, trace and control attached to the reader are not inherited, they would be shared between threads
+    xls2img_cursor_init(c, reader);
+    c->allocator = allocator;
+    if (options && options->limits)
+        c->limits = *options->limits;
+    c->checkpoint.control = options ? options->control : NULL;
+#ifdef XLS2IMG_ENABLE_STATS
+    c->stats = options ? options->stats : NULL;
+#endif
+#ifdef XLS2IMG_ENABLE_TRACE
+    c->trace = options ? options->trace : NULL;
+#endif
+
+    *cursor = c;
+    return XLS2IMG_SUCCESS;
+}
+
+void xls2img_cursor_close(XLS2IMG_CURSOR* cursor)
+{
+    if (cursor)
     {
-        const COMPOUND_FILE_ENTRY* entry = xls2img_get_entry(reader, childID);
-        if (!entry) break;
+        xls2img_cursor_cleanup(cursor);
+        xls2img_mem_free(cursor->allocator, cursor, sizeof(XLS2IMG_CURSOR));
+    }
+}
 
-        if (entry->type == 2)
-        {
-            // stream type
-            static const uint16_t workbookStr[] = { 'W','o','r','k','b','o','o','k',0 };
-            static const uint16_t WORKBOOKStr[] = { 'W','O','R','K','B','O','O','K',0 };
+int xls2img_cursor_get_workbook(XLS2IMG_CURSOR* cursor, void** data, size_t* size)
+{
+    if (!cursor || !data || !size) return XLS2IMG_ERROR_INVALID_ARGUMENT;
 
-            size_t nameLen = entry->nameLen / 2;
-            if (nameLen > 0)
-            {
-                if (xls2img_string_compare(entry->name, workbookStr, nameLen) ||
-                    xls2img_string_compare(entry->name, WORKBOOKStr, nameLen))
-                {
-
-                    char* workbook_data = (char*)malloc((size_t)entry->size);
-                    if (!workbook_data) return XLS2IMG_ERROR_INVALID_ARGUMENT;
-
-                    xls2img_read_file(reader, entry, workbook_data);
-                    *data = workbook_data;
-                    *size = (size_t)entry->size;
-                    return XLS2IMG_SUCCESS;
-                }
-            }
-        }
+    return xls2img_cursor_workbook(cursor, data, size);
+}
 
-        if (entry->leftSiblingID != 0xFFFFFFFF)
-            childID = entry->leftSiblingID;
-        else if (entry->rightSiblingID != 0xFFFFFFFF)
-            childID = entry->rightSiblingID;
-        else
-            break;
+int xls2img_cursor_read(XLS2IMG_CURSOR* cursor, size_t offset, void* buffer, size_t size)
+{
+    if (!cursor || (size > 0 && !buffer)) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    // image offsets of a package are package offsets
+    const XLS2IMG_READER* reader = cursor->reader;
+    if (reader->container == XLS2IMG_CONTAINER_OOXML)
+    {
+        if (offset > reader->bufferLen || size > reader->bufferLen - offset) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+        if (size > 0)
+            memcpy(buffer, reader->buffer + offset, size);
+        return XLS2IMG_SUCCESS;
     }
 
-    return XLS2IMG_ERROR_NO_WORKBOOK;
+    int ret = xls2img_cursor_check(cursor);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+
+    uint64_t workbookSize = cursor->streamSize;
+    if (offset > workbookSize || size > workbookSize - offset) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    return xls2img_cursor_copy(cursor, offset, (char*)buffer, size);
+}
+
+int xls2img_cursor_get_workbook_extents(XLS2IMG_CURSOR* cursor, size_t offset, size_t size, XLS2IMG_EXTENT* extents, int max_extents)
+{
+    if (!cursor || max_extents < 0 || (max_extents > 0 && !extents)) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    return xls2img_cursor_extents(cursor, offset, size, extents, max_extents);
 }
 
 void xls2img_free_workbook_data(void* data)
 {
-    if (data)
-        free(data);
+    xls2img_block_free(data);
+}
+
+static uint16_t parse_uint16(const void* buffer)
+{
+    const uint8_t* p = (const uint8_t*)buffer;
+    return (uint16_t)(p[0] | (p[1] << 8));
 }
 
 static uint32_t parse_uint32(const void* buffer)
 {
-    return *((const uint32_t*)buffer);
+    const uint8_t* p = (const uint8_t*)buffer;
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 
-static uint32_t xls2img_get_fat_sector_location(const XLS2IMG_READER* reader, size_t fatSectorNumber)
+// Resolves the location of every FAT sector the buffer can need. The DIFAT chain is walked once, and never
+// further than the table, so a cyclic DIFAT only yields bogus locations that fail later bounds checks.
+static int xls2img_load_fat_sectors(XLS2IMG_READER* reader)
 {
-    if (fatSectorNumber < 109)
-        return reader->hdr->headerDIFAT[fatSectorNumber];
+    size_t entriesPerSector = reader->sectorSize / 4;
+    reader->fatSectorCount = (reader->sectorCount + entriesPerSector - 1) / entriesPerSector;
+    reader->fatSectors = (uint32_t*)xls2img_mem_alloc(reader->allocator, reader->fatSectorCount * sizeof(uint32_t));
+    if (!reader->fatSectors) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+
+    size_t i = 0;
+    for (; i < reader->fatSectorCount && i < 109; i++)
+        reader->fatSectors[i] = reader->hdr->headerDIFAT[i];
 
-    fatSectorNumber -= 109;
-    size_t entriesPerSector = reader->sectorSize / 4 - 1;
     uint32_t difatSectorLocation = reader->hdr->firstDIFATSectorLocation;
+    while (i < reader->fatSectorCount)
+    {
+        const uint8_t* difat = xls2img_sector_offset_to_address(reader, difatSectorLocation, 0);
+        if (!difat || reader->buffer + reader->bufferLen < difat + reader->sectorSize) break;
+
+        for (size_t j = 0; j < entriesPerSector - 1 && i < reader->fatSectorCount; j++)
+            reader->fatSectors[i++] = parse_uint32(difat + j * 4);
+        difatSectorLocation = parse_uint32(difat + reader->sectorSize - 4);
+    }
+
+    for (; i < reader->fatSectorCount; i++)
+        reader->fatSectors[i] = 0xFFFFFFFF;
+    return XLS2IMG_SUCCESS;
+}
+
+// Copies a FAT chain into a table so it can be indexed instead of walked. A chain longer than the buffer has
+// sectors must revisit one of them.
+static int xls2img_load_chain(const XLS2IMG_READER* reader, uint32_t start, uint32_t** sectors, size_t* count)
+{
+    uint32_t* table = NULL;
+    size_t n = 0;
+    size_t capacity = 0;
 
-    while (fatSectorNumber >= entriesPerSector)
+    uint32_t sector = start;
+    while (sector < 0xFFFFFFFA)
     {
-        fatSectorNumber -= entriesPerSector;
-        const uint8_t* addr = xls2img_sector_offset_to_address(reader, difatSectorLocation, reader->sectorSize - 4);
-        if (!addr) return 0xFFFFFFFF;
-        difatSectorLocation = parse_uint32(addr);
+        if (n >= reader->sectorCount)
+        {
+            xls2img_mem_free(reader->allocator, table, capacity * sizeof(uint32_t));
+            return XLS2IMG_ERROR_CHAIN_CYCLE;
+        }
+        if (n == capacity)
+        {
+            size_t newCapacity = capacity ? capacity * 2 : 16;
+            uint32_t* newTable = (uint32_t*)xls2img_mem_realloc(reader->allocator, table, capacity * sizeof(uint32_t),
+                newCapacity * sizeof(uint32_t));
+            if (!newTable)
+            {
+                xls2img_mem_free(reader->allocator, table, capacity * sizeof(uint32_t));
+                return XLS2IMG_ERROR_OUT_OF_MEMORY;
+            }
+            table = newTable;
+            capacity = newCapacity;
+        }
+        table[n++] = sector;
+        sector = xls2img_get_next_sector(reader, sector);
+    }
+
+    // trim to the chain length, which is all xls2img_free_tables knows
+    if (n < capacity)
+    {
+        uint32_t* newTable = (uint32_t*)xls2img_mem_realloc(reader->allocator, table, capacity * sizeof(uint32_t), n * sizeof(uint32_t));
+        if (!newTable)
+        {
+            xls2img_mem_free(reader->allocator, table, capacity * sizeof(uint32_t));
+            return XLS2IMG_ERROR_OUT_OF_MEMORY;
+        }
+        table = newTable;
     }
 
-    const uint8_t* addr = xls2img_sector_offset_to_address(reader, difatSectorLocation, fatSectorNumber * 4);
-    if (!addr) return 0xFFFFFFFF;
+    *sectors = table;
+    *count = n;
+    return XLS2IMG_SUCCESS;
+}
 
-    return parse_uint32(addr);
+static void xls2img_free_tables(XLS2IMG_READER* reader)
+{
+    xls2img_mem_free(reader->allocator, reader->fatSectors, reader->fatSectorCount * sizeof(uint32_t));
+    xls2img_mem_free(reader->allocator, reader->dirSectors, reader->dirSectorCount * sizeof(uint32_t));
+    xls2img_mem_free(reader->allocator, reader->miniStreamSectors, reader->miniStreamSectorCount * sizeof(uint32_t));
+    xls2img_mem_free(reader->allocator, reader->miniFatSectors, reader->miniFatSectorCount * sizeof(uint32_t));
+}
+
+// Marks a sector of a chain walk as visited, returns 0 if it was already. Sectors outside the bitmap are left to
+// the address bounds checks.
+static int xls2img_visit(uint8_t* visited, size_t count, size_t sector)
+{
+    if (sector >= count) return 1;
+
+    uint8_t bit = (uint8_t)(1u << (sector & 7));
+    if (visited[sector >> 3] & bit) return 0;
+    visited[sector >> 3] |= bit;
+    return 1;
+}
+
+static uint32_t xls2img_get_fat_sector_location(const XLS2IMG_READER* reader, size_t fatSectorNumber)
+{
+    if (fatSectorNumber >= reader->fatSectorCount)
+        return 0xFFFFFFFF;
+    return reader->fatSectors[fatSectorNumber];
 }
 
 static uint32_t xls2img_get_next_sector(const XLS2IMG_READER* reader, size_t sector)
@@ -242,8 +697,7 @@ static uint32_t xls2img_get_next_sector(const XLS2IMG_READER* reader, size_t sec
     uint32_t fatSectorLocation = xls2img_get_fat_sector_location(reader, fatSectorNumber);
 
     const uint8_t* addr = xls2img_sector_offset_to_address(reader, fatSectorLocation, (sector % entriesPerSector) * 4);
-    if (!addr) return 0xFFFFFFFF;
-
+    if (!addr || reader->buffer + reader->bufferLen < addr + 4) return 0xFFFFFFFF;
     return parse_uint32(addr);
 }
 
@@ -251,128 +705,977 @@ static const uint8_t* xls2img_sector_offset_to_address(const XLS2IMG_READER* rea
 {
     if (sector >= 0xFFFFFFFA || offset >= reader->sectorSize) return NULL;
 
-    size_t pos = reader->sectorSize + reader->sectorSize * sector + offset;
+    // Sector n starts after the header sector, at (n + 1) * sectorSize. Check the product before forming it so
+    // that a sector number near the limit cannot wrap pos back into the buffer on a 32-bit build
+    size_t index = sector + 1;
+    if (index > (SIZE_MAX - offset) / reader->sectorSize) return NULL;
+    size_t pos = reader->sectorSize * index + offset;
     if (pos >= reader->bufferLen) return NULL;
 
     return reader->buffer + pos;
 }
 
-static void xls2img_locate_final_sector(const XLS2IMG_READER* reader, size_t sector, size_t offset, size_t* finalSector, size_t* finalOffset)
+static uint32_t xls2img_get_next_mini_sector(const XLS2IMG_READER* reader, size_t miniSector)
+{
+    size_t entriesPerSector = reader->sectorSize / 4;
+    if (miniSector / entriesPerSector >= reader->miniFatSectorCount) return 0xFFFFFFFF;
+
+    const uint8_t* addr = xls2img_sector_offset_to_address(reader, reader->miniFatSectors[miniSector / entriesPerSector],
+        (miniSector % entriesPerSector) * 4);
+    if (!addr || reader->buffer + reader->bufferLen < addr + 4) return 0xFFFFFFFF;
+    return parse_uint32(addr);
+}
+
+static const uint8_t* xls2img_mini_sector_offset_to_address(const XLS2IMG_READER* reader, size_t sector, size_t offset)
+{
+    if (offset >= reader->minisectorSize || sector > (SIZE_MAX - offset) / reader->minisectorSize) return NULL;
+    size_t pos = sector * reader->minisectorSize + offset;
+    if (pos / reader->sectorSize >= reader->miniStreamSectorCount) return NULL;
+    return xls2img_sector_offset_to_address(reader, reader->miniStreamSectors[pos / reader->sectorSize], pos % reader->sectorSize);
+}
+
+static const COMPOUND_FILE_ENTRY* xls2img_get_entry(const XLS2IMG_READER* reader, uint32_t entryID)
+{
+    if (entryID == 0xFFFFFFFF) return NULL;
+
+    size_t pos = (size_t)entryID * sizeof(COMPOUND_FILE_ENTRY);
+    if (pos / reader->sectorSize >= reader->dirSectorCount) return NULL;
+
+    const uint8_t* addr = xls2img_sector_offset_to_address(reader, reader->dirSectors[pos / reader->sectorSize], pos % reader->sectorSize);
+    if (!addr || reader->bufferLen <= (size_t)(addr - reader->buffer) + sizeof(COMPOUND_FILE_ENTRY))
+        return NULL;
+
+    return (const COMPOUND_FILE_ENTRY*)addr;
+}
+
+// Version 3 files (512-byte sectors) are limited to 2 GiB streams and some writers leave garbage in the high 32
+// bits of the size, which [MS-CFB] says readers should ignore
+static uint64_t xls2img_stream_size(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* entry)
 {
-    while (offset >= reader->sectorSize)
+    return reader->hdr->majorVersion == 3 ? entry->size & 0xFFFFFFFF : entry->size;
+}
+
+// Orders a directory entry against a name the way sibling trees are sorted: shorter names first, then by the
+// upper-case characters
+static int xls2img_compare_name(const COMPOUND_FILE_ENTRY* entry, const char* name)
+{
+    size_t len = strlen(name) + 1;
+    size_t entryLen = entry->nameLen / 2;
+    if (entryLen != len) return entryLen < len ? -1 : 1;
+
+    for (size_t i = 0; i + 1 < len; i++)
     {
-        offset -= reader->sectorSize;
-        uint32_t next = xls2img_get_next_sector(reader, sector);
-        if (next == 0xFFFFFFFE || next == 0xFFFFFFFF) break;
-        sector = next;
+        uint16_t a = entry->name[i];
+        uint16_t b = (uint8_t)name[i];
+        if (a >= 'a' && a <= 'z') a -= 'a' - 'A';
+        if (b >= 'a' && b <= 'z') b -= 'a' - 'A';
+        if (a != b) return a < b ? -1 : 1;
     }
-    *finalSector = sector;
-    *finalOffset = offset;
+    return 0;
 }
 
-static void xls2img_read_stream(const XLS2IMG_READER* reader, size_t sector, size_t offset, char* buffer, size_t len) {
-    xls2img_locate_final_sector(reader, sector, offset, &sector, &offset);
+// Looks a stream up among the children of a storage, the root storage if NULL, by descending their red-black tree
+static int xls2img_find_stream(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* storage, const char* name, const COMPOUND_FILE_ENTRY** stream)
+{
+    const COMPOUND_FILE_ENTRY* root = storage ? storage : xls2img_get_entry(reader, 0);
+    if (!root) return XLS2IMG_ERROR_FILE_CORRUPTED;
 
-    while (len > 0)
+    // each directory entry can be visited once, more steps than entries means the sibling links loop
+    size_t entryCount = reader->dirSectorCount * (reader->sectorSize / sizeof(COMPOUND_FILE_ENTRY));
+    size_t steps = 0;
+
+    uint32_t childID = root->childID;
+    while (childID != 0xFFFFFFFF)
     {
-        const uint8_t* src = xls2img_sector_offset_to_address(reader, sector, offset);
-        if (!src) break;
+        if (++steps > entryCount) return XLS2IMG_ERROR_CHAIN_CYCLE;
 
-        size_t copylen = len < reader->sectorSize - offset ? len : reader->sectorSize - offset;
-        if (reader->buffer + reader->bufferLen < src + copylen) break;
+        const COMPOUND_FILE_ENTRY* entry = xls2img_get_entry(reader, childID);
+        if (!entry) break;
 
-        memcpy(buffer, src, copylen);
-        buffer += copylen;
-        len -= copylen;
-        sector = xls2img_get_next_sector(reader, sector);
-        offset = 0;
+        int order = xls2img_compare_name(entry, name);
+        if (order == 0)
+        {
+            if (entry->type != 2) break;
+            *stream = entry;
+            return XLS2IMG_SUCCESS;
+        }
+        childID = order > 0 ? entry->leftSiblingID : entry->rightSiblingID;
+    }
+
+    return XLS2IMG_ERROR_NO_WORKBOOK;
+}
 
-        if (sector == 0xFFFFFFFE || sector == 0xFFFFFFFF) break;
+// Tells which Office document the streams of a storage make up, the root storage if NULL. Returns the result of the
+// Workbook lookup; without a workbook the container is CFB unless a presentation or Word document stream is there.
+static int xls2img_find_document(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* storage, XLS2IMG_CONTAINER* container, const COMPOUND_FILE_ENTRY** workbook)
+{
+    *container = XLS2IMG_CONTAINER_CFB;
+    *workbook = NULL;
+    int ret = xls2img_find_stream(reader, storage, "Workbook", workbook);
+    if (ret == XLS2IMG_ERROR_NO_WORKBOOK)
+    {
+        // the streams of the other Office documents are looked up again by each read, which is a few entries
+        const COMPOUND_FILE_ENTRY* document = NULL;
+        if (xls2img_find_stream(reader, storage, "PowerPoint Document", &document) == XLS2IMG_SUCCESS)
+            *container = XLS2IMG_CONTAINER_PPT;
+        else if (xls2img_find_stream(reader, storage, "WordDocument", &document) == XLS2IMG_SUCCESS)
+            *container = XLS2IMG_CONTAINER_DOC;
     }
+    return ret;
 }
 
-static uint32_t xls2img_get_next_mini_sector(const XLS2IMG_READER* reader, size_t miniSector)
+static void xls2img_cursor_init(XLS2IMG_CURSOR* cursor, const XLS2IMG_READER* reader)
 {
-    size_t sector, offset;
-    xls2img_locate_final_sector(reader, reader->hdr->firstMiniFATSectorLocation, miniSector * 4, &sector, &offset);
-    const uint8_t* addr = xls2img_sector_offset_to_address(reader, sector, offset);
-    if (!addr) return 0xFFFFFFFF;
-    return parse_uint32(addr);
+    memset(cursor, 0, sizeof(XLS2IMG_CURSOR));
+    cursor->reader = reader;
+    cursor->allocator = reader->allocator;
+    cursor->limits = reader->limits;
+#ifdef XLS2IMG_ENABLE_STATS
+    cursor->stats = reader->stats;
+#endif
+#ifdef XLS2IMG_ENABLE_TRACE
+    cursor->trace = reader->trace;
+#endif
+    cursor->checkpoint.control = reader->control;
+    xls2img_cursor_select(cursor, reader->workbook);
 }
 
-static const uint8_t* xls2img_mini_sector_offset_to_address(const XLS2IMG_READER* reader, size_t sector, size_t offset)
+// Configures a stack cursor like xls2img_cursor_open, from options whose defaults are already resolved
+static void xls2img_cursor_setup(XLS2IMG_CURSOR* cursor, const XLS2IMG_READER* reader, const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    xls2img_cursor_init(cursor, reader);
+    cursor->allocator = options->allocator;
+    cursor->limits = *options->limits;
+#ifdef XLS2IMG_ENABLE_STATS
+    cursor->stats = options->stats;
+#endif
+#ifdef XLS2IMG_ENABLE_TRACE
+    cursor->trace = options->trace;
+#endif
+    cursor->checkpoint.control = options->control;
+}
+
+// Points the cursor at another stream of the compound file, which restarts its chain walk
+static void xls2img_cursor_select(XLS2IMG_CURSOR* cursor, const COMPOUND_FILE_ENTRY* stream)
+{
+    const XLS2IMG_READER* reader = cursor->reader;
+    xls2img_cursor_cleanup(cursor);
+    cursor->stream = stream;
+    cursor->streamSize = stream ? xls2img_stream_size(reader, stream) : 0;
+    cursor->mini = stream && cursor->streamSize < reader->hdr->miniStreamCutoffSize;
+    cursor->unitCount = cursor->mini ? reader->miniStreamSectorCount * (reader->sectorSize / reader->minisectorSize) : reader->sectorCount;
+    xls2img_checkpoint_init(&cursor->checkpoint, cursor->checkpoint.control, cursor->streamSize);
+}
+
+static void xls2img_cursor_cleanup(XLS2IMG_CURSOR* cursor)
+{
+    xls2img_mem_free(cursor->allocator, cursor->visited, cursor->unitCount / 8 + 1);
+    cursor->visited = NULL;
+    cursor->positioned = 0;
+}
+
+// Rejects a stream the buffer cannot hold before anything is allocated for it, then applies the cursor limits
+static int xls2img_cursor_check(const XLS2IMG_CURSOR* cursor)
 {
-    size_t sectorOffset, sectorPos;
-    xls2img_locate_final_sector(reader, reader->miniStreamStartSector,
-        sector * reader->minisectorSize + offset, &sectorPos, &sectorOffset);
-    return xls2img_sector_offset_to_address(reader, sectorPos, sectorOffset);
+    const XLS2IMG_READER* reader = cursor->reader;
+    if (!cursor->stream) return reader->workbookError;
+
+    int mini = cursor->mini;
+    if (mini && reader->miniError != XLS2IMG_SUCCESS) return reader->miniError;
+
+    uint64_t size = cursor->streamSize;
+    uint64_t available = mini ? (uint64_t)reader->miniStreamSectorCount * reader->sectorSize : (uint64_t)reader->sectorCount * reader->sectorSize;
+    if (size > available) return XLS2IMG_ERROR_FILE_CORRUPTED;
+
+    size_t unit = mini ? reader->minisectorSize : reader->sectorSize;
+    if ((cursor->limits.max_bytes && size > cursor->limits.max_bytes) ||
+        (cursor->limits.max_sectors && (size + unit - 1) / unit > cursor->limits.max_sectors))
+        return XLS2IMG_ERROR_LIMIT_EXCEEDED;
+    return XLS2IMG_SUCCESS;
 }
 
-static void xls2img_locate_final_mini_sector(const XLS2IMG_READER* reader, size_t sector, size_t offset, size_t* finalSector, size_t* finalOffset)
+static uint32_t xls2img_cursor_next(const XLS2IMG_CURSOR* cursor, size_t sector)
 {
-    while (offset >= reader->minisectorSize)
+    uint32_t next;
+    if (cursor->mini)
     {
-        offset -= reader->minisectorSize;
-        uint32_t next = xls2img_get_next_mini_sector(reader, sector);
-        if (next == 0xFFFFFFFE || next == 0xFFFFFFFF) break;
-        sector = next;
+        next = xls2img_get_next_mini_sector(cursor->reader, sector);
+        XLS2IMG_STAT_ADD(cursor->stats, minifat_lookups, 1);
     }
-    *finalSector = sector;
-    *finalOffset = offset;
+    else
+    {
+        next = xls2img_get_next_sector(cursor->reader, sector);
+        XLS2IMG_STAT_ADD(cursor->stats, fat_lookups, 1);
+    }
+    XLS2IMG_TRACE_EVENT(cursor->trace, XLS2IMG_EVENT_FAT_LOOKUP, cursor->mini, sector, next);
+    return next;
+}
+
+// Moves the cursor to the unit holding offset. A seek at or after the current position continues the chain walk, so
+// reads in ascending order follow each link once; an earlier offset restarts from the first unit.
+static int xls2img_cursor_seek(XLS2IMG_CURSOR* cursor, size_t offset)
+{
+    const XLS2IMG_READER* reader = cursor->reader;
+    size_t unit = cursor->mini ? reader->minisectorSize : reader->sectorSize;
+    size_t bitmapSize = cursor->unitCount / 8 + 1;
+
+    if (!cursor->visited)
+    {
+        cursor->visited = (uint8_t*)xls2img_mem_alloc(cursor->allocator, bitmapSize);
+        if (!cursor->visited) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+        cursor->positioned = 0;
+    }
+    if (!cursor->positioned || offset < cursor->streamPos)
+    {
+        memset(cursor->visited, 0, bitmapSize);
+        cursor->sector = cursor->stream->startSectorLocation;
+        cursor->streamPos = 0;
+        cursor->positioned = 1;
+        xls2img_visit(cursor->visited, cursor->unitCount, cursor->sector);
+    }
+
+    while (offset - cursor->streamPos >= unit)
+    {
+        uint32_t next = xls2img_cursor_next(cursor, cursor->sector);
+        int ret = XLS2IMG_SUCCESS;
+        if (next >= 0xFFFFFFFA)
+            ret = XLS2IMG_ERROR_FILE_CORRUPTED;
+        else if (!xls2img_visit(cursor->visited, cursor->unitCount, next))
+            ret = XLS2IMG_ERROR_CHAIN_CYCLE;
+        if (ret != XLS2IMG_SUCCESS)
+        {
+            cursor->positioned = 0;
+            return ret;
+        }
+        cursor->sector = next;
+        cursor->streamPos += unit;
+    }
+    return XLS2IMG_SUCCESS;
 }
 
-static void xls2img_read_mini_stream(const XLS2IMG_READER* reader, size_t sector, size_t offset, char* buffer, size_t len)
+// Locates offset of the workbook in the buffer, clipping len to the bytes left in its unit
+static int xls2img_cursor_map(XLS2IMG_CURSOR* cursor, size_t offset, const uint8_t** src, size_t* len)
 {
-    xls2img_locate_final_mini_sector(reader, sector, offset, &sector, &offset);
+    int ret = xls2img_cursor_seek(cursor, offset);
+    if (ret != XLS2IMG_SUCCESS) return ret;
 
+    const XLS2IMG_READER* reader = cursor->reader;
+    size_t unit = cursor->mini ? reader->minisectorSize : reader->sectorSize;
+    size_t unitOffset = offset - cursor->streamPos;
+    const uint8_t* addr = cursor->mini ? xls2img_mini_sector_offset_to_address(reader, cursor->sector, unitOffset)
+                                               : xls2img_sector_offset_to_address(reader, cursor->sector, unitOffset);
+
+    if (*len > unit - unitOffset)
+        *len = unit - unitOffset;
+    if (!addr || reader->buffer + reader->bufferLen < addr + *len) return XLS2IMG_ERROR_FILE_CORRUPTED;
+
+    *src = addr;
+    return XLS2IMG_SUCCESS;
+}
+
+static int xls2img_cursor_copy(XLS2IMG_CURSOR* cursor, size_t offset, char* buffer, size_t len)
+{
     while (len > 0)
     {
-        const uint8_t* src = xls2img_mini_sector_offset_to_address(reader, sector, offset);
-        if (!src) break;
+        int ret = xls2img_checkpoint(&cursor->checkpoint, offset);
+        if (ret != XLS2IMG_SUCCESS) return ret;
 
-        size_t copylen = len < reader->minisectorSize - offset ? len : reader->minisectorSize - offset;
-        if (reader->buffer + reader->bufferLen < src + copylen) break;
+        const uint8_t* src = NULL;
+        size_t copylen = len;
+        ret = xls2img_cursor_map(cursor, offset, &src, &copylen);
+        if (ret != XLS2IMG_SUCCESS) return ret;
 
         memcpy(buffer, src, copylen);
+        XLS2IMG_TRACE_EVENT(cursor->trace, XLS2IMG_EVENT_SECTOR_READ, cursor->mini, src - cursor->reader->buffer, copylen);
+        XLS2IMG_STAT_ADD(cursor->stats, sectors_visited, 1);
+        XLS2IMG_STAT_ADD(cursor->stats, bytes_copied, copylen);
         buffer += copylen;
+        offset += copylen;
         len -= copylen;
-        sector = xls2img_get_next_mini_sector(reader, sector);
-        offset = 0;
+    }
+    return XLS2IMG_SUCCESS;
+}
+
+static int xls2img_cursor_workbook(XLS2IMG_CURSOR* cursor, void** data, size_t* size)
+{
+    XLS2IMG_STAT_TIMER(start);
+    int ret = xls2img_cursor_check(cursor);
+    if (ret != XLS2IMG_SUCCESS) return ret;
 
-        if (sector == 0xFFFFFFFE || sector == 0xFFFFFFFF) break;
+    size_t workbookSize = (size_t)cursor->streamSize;
+    char* workbook_data = (char*)xls2img_block_alloc(cursor->allocator, workbookSize);
+    if (!workbook_data) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+    XLS2IMG_STAT_ALLOC(cursor->stats, workbookSize);
+    XLS2IMG_TRACE_EVENT(cursor->trace, XLS2IMG_EVENT_ALLOC, 0, 0, workbookSize);
+
+    ret = xls2img_cursor_copy(cursor, 0, workbook_data, workbookSize);
+    if (ret != XLS2IMG_SUCCESS)
+    {
+        xls2img_block_free(workbook_data);
+        XLS2IMG_STAT_FREE(cursor->stats, workbookSize);
+        XLS2IMG_TRACE_EVENT(cursor->trace, XLS2IMG_EVENT_ALLOC, 2, workbookSize, 0);
+        return ret;
     }
+    *data = workbook_data;
+    *size = workbookSize;
+    XLS2IMG_STAT_ELAPSED(cursor->stats, workbook_ns, start);
+    return XLS2IMG_SUCCESS;
 }
 
-static const COMPOUND_FILE_ENTRY* xls2img_get_entry(const XLS2IMG_READER* reader, uint32_t entryID)
+static int xls2img_cursor_extents(XLS2IMG_CURSOR* cursor, size_t offset, size_t size, XLS2IMG_EXTENT* extents, int max_extents)
 {
-    if (entryID == 0xFFFFFFFF) return NULL;
+    const XLS2IMG_READER* reader = cursor->reader;
+    if (reader->container == XLS2IMG_CONTAINER_OOXML)
+    {
+        // one extent: package offsets are file offsets
+        if (offset > reader->bufferLen || size > reader->bufferLen - offset) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+        if (size == 0) return 0;
+        if (max_extents > 0)
+        {
+            extents[0].offset = offset;
+            extents[0].size = size;
+        }
+        return 1;
+    }
 
-    size_t sector = 0;
-    size_t offset = 0;
-    xls2img_locate_final_sector(reader, reader->hdr->firstDirectorySectorLocation,
-        entryID * sizeof(COMPOUND_FILE_ENTRY), &sector, &offset);
+    int ret = xls2img_cursor_check(cursor);
+    if (ret != XLS2IMG_SUCCESS) return ret;
 
-    if (reader->bufferLen <= (size_t)(reader->sectorSize + reader->sectorSize * sector + offset + sizeof(COMPOUND_FILE_ENTRY)))
-        return NULL;
+    if (offset > cursor->streamSize || size > cursor->streamSize - offset) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    int count = 0;
+    size_t runStart = 0, runEnd = 0;
+    while (size > 0)
+    {
+        ret = xls2img_checkpoint(&cursor->checkpoint, offset);
+        if (ret != XLS2IMG_SUCCESS) return ret;
+
+        const uint8_t* src = NULL;
+        size_t len = size;
+        ret = xls2img_cursor_map(cursor, offset, &src, &len);
+        if (ret != XLS2IMG_SUCCESS) return ret;
+
+        size_t pos = (size_t)(src - reader->buffer);
+        if (count > 0 && pos == runEnd)
+            runEnd += len;
+        else
+        {
+            if (count == INT_MAX) return XLS2IMG_ERROR_LIMIT_EXCEEDED;
+            if (count > 0 && count <= max_extents)
+            {
+                extents[count - 1].offset = runStart;
+                extents[count - 1].size = runEnd - runStart;
+            }
+            count++;
+            runStart = pos;
+            runEnd = pos + len;
+        }
+        offset += len;
+        size -= len;
+    }
+
+    if (count > 0 && count <= max_extents)
+    {
+        extents[count - 1].offset = runStart;
+        extents[count - 1].size = runEnd - runStart;
+    }
+    return count;
+}
 
-    return (const COMPOUND_FILE_ENTRY*)(reader->buffer + reader->sectorSize + reader->sectorSize * sector + offset);
+// Feeds [offset, offset + size) of the cursor's stream to a parser. The sectors are read in place; physically adjacent
+// ones go in as one feed of up to XLS2IMG_CONTROL_INTERVAL bytes, so the checkpoint sees the parser's progress.
+static int xls2img_cursor_feed(XLS2IMG_CURSOR* cursor, XLS2IMG_PARSER* parser, size_t offset, size_t size)
+{
+    const uint8_t* run = NULL;
+    size_t runSize = 0;
+    while (size > 0)
+    {
+        int ret = xls2img_checkpoint(&cursor->checkpoint, offset);
+        if (ret != XLS2IMG_SUCCESS) return ret;
+
+        const uint8_t* src = NULL;
+        size_t len = size;
+        ret = xls2img_cursor_map(cursor, offset, &src, &len);
+        if (ret != XLS2IMG_SUCCESS) return ret;
+        XLS2IMG_TRACE_EVENT(cursor->trace, XLS2IMG_EVENT_SECTOR_READ, cursor->mini, src - cursor->reader->buffer, len);
+        XLS2IMG_STAT_ADD(cursor->stats, sectors_visited, 1);
+
+        if (run && run + runSize == src && runSize < XLS2IMG_CONTROL_INTERVAL)
+            runSize += len;
+        else
+        {
+            if (run && (ret = xls2img_parser_feed(parser, run, runSize)) != XLS2IMG_SUCCESS)
+                return ret;
+            run = src;
+            runSize = len;
+        }
+        offset += len;
+        size -= len;
+    }
+    return run ? xls2img_parser_feed(parser, run, runSize) : XLS2IMG_SUCCESS;
 }
 
-static void xls2img_read_file(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* entry, char* buffer)
+// Scans the document held by a storage of the compound file, or the reader's own document if storage is NULL
+static int xls2img_document_images(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* storage, XLS2IMG_IMAGE_FUNC on_image, void* user, const XLS2IMG_EXTRACT_OPTIONS* options)
 {
-    if (entry->size == 0) return;
+    if (reader->container == XLS2IMG_CONTAINER_OOXML)
+    {
+        if (reader->mediaError != XLS2IMG_SUCCESS) return reader->mediaError;
+        return xls2img_zip_images(reader->buffer, reader->media, reader->mediaCount, on_image, user, options);
+    }
+
+    XLS2IMG_CONTAINER container = reader->container;
+    const COMPOUND_FILE_ENTRY* workbook = reader->workbook;
+    if (storage)
+    {
+        // a storage without any document stream is not an error, it just holds no pictures
+        int ret = xls2img_find_document(reader, storage, &container, &workbook);
+        if (ret != XLS2IMG_SUCCESS && ret != XLS2IMG_ERROR_NO_WORKBOOK) return ret;
+        if (ret == XLS2IMG_ERROR_NO_WORKBOOK && container == XLS2IMG_CONTAINER_CFB) return XLS2IMG_ERROR_NO_IMAGES;
+    }
+
+    XLS2IMG_CURSOR cursor;
+    xls2img_cursor_setup(&cursor, reader, options);
+    if (storage)
+        xls2img_cursor_select(&cursor, workbook);
+    XLS2IMG_PARSER* parser = NULL;
+    int ret;
+
+    // the cursor polls the control as it feeds the parser
+    XLS2IMG_EXTRACT_OPTIONS parsing = *options;
+    parsing.control = NULL;
 
-    if (entry->size < reader->hdr->miniStreamCutoffSize)
-        xls2img_read_mini_stream(reader, entry->startSectorLocation, 0, buffer, (size_t)entry->size);
+    if (container == XLS2IMG_CONTAINER_CFB)
+    {
+        ret = xls2img_cursor_check(&cursor);
+        if (ret == XLS2IMG_SUCCESS)
+            ret = xls2img_parser_open(&parser, on_image, user, &parsing);
+        if (ret == XLS2IMG_SUCCESS)
+            ret = xls2img_cursor_feed(&cursor, parser, 0, (size_t)cursor.streamSize);
+    }
+    else if (container == XLS2IMG_CONTAINER_PPT)
+    {
+        // every picture of a presentation is a blip record of the Pictures stream
+        const COMPOUND_FILE_ENTRY* pictures = NULL;
+        ret = xls2img_find_stream(reader, storage, "Pictures", &pictures);
+        if (ret == XLS2IMG_ERROR_NO_WORKBOOK)
+            ret = XLS2IMG_ERROR_NO_IMAGES;
+        if (ret == XLS2IMG_SUCCESS)
+        {
+            xls2img_cursor_select(&cursor, pictures);
+            ret = xls2img_cursor_check(&cursor);
+        }
+        if (ret == XLS2IMG_SUCCESS)
+            ret = xls2img_parser_open_raw(&parser, on_image, user, &parsing);
+        if (ret == XLS2IMG_SUCCESS)
+            ret = xls2img_cursor_feed(&cursor, parser, 0, (size_t)cursor.streamSize);
+    }
     else
-        xls2img_read_stream(reader, entry->startSectorLocation, 0, buffer, (size_t)entry->size);
+    {
+        XLS2IMG_CURSOR table;
+        xls2img_cursor_setup(&table, reader, options);
+        table.checkpoint.control = NULL;
+        ret = xls2img_parser_open_raw(&parser, on_image, user, &parsing);
+        if (ret == XLS2IMG_SUCCESS)
+            ret = xls2img_word_images(&cursor, &table, parser, storage);
+        xls2img_cursor_cleanup(&table);
+    }
+    if (ret == XLS2IMG_SUCCESS)
+        ret = xls2img_parser_finish(parser);
+
+    xls2img_parser_close(parser);
+    xls2img_cursor_cleanup(&cursor);
+    return ret;
+}
+
+// Reads the type and length of the OfficeArt record at offset of the cursor's stream
+static int xls2img_read_art_header(XLS2IMG_CURSOR* cursor, uint64_t offset, uint16_t* type, uint32_t* len)
+{
+    uint8_t header[8];
+    if (offset > cursor->streamSize || cursor->streamSize - offset < sizeof(header))
+        return XLS2IMG_ERROR_FILE_CORRUPTED;
+
+    int ret = xls2img_cursor_copy(cursor, (size_t)offset, (char*)header, sizeof(header));
+    if (ret != XLS2IMG_SUCCESS) return ret;
+    *type = parse_uint16(header + 2);
+    *len = parse_uint32(header + 4);
+    return XLS2IMG_SUCCESS;
 }
 
-static int xls2img_string_compare(const uint16_t* str1, const uint16_t* str2, size_t len)
+// Locates the OfficeArt content of a Word document in its table stream through the FIB. Returns 0 if the FIB is not
+// a Word 97 one or has no drawings.
+static int xls2img_word_dgg_info(const uint8_t* fib, size_t fibSize, uint32_t* fc, uint32_t* lcb)
 {
-    for (size_t i = 0; i < len; i++) {
-        if (str1[i] != str2[i]) return 0;
-        if (str1[i] == 0) break;
+    if (fibSize < WORD_FIB_BASE_SIZE + 2 || parse_uint16(fib) != WORD_FIB_IDENT) return 0;
+
+    // FibRgW97, then FibRgLw97, then the FibRgFcLcb pairs, each preceded by its count
+    size_t pos = WORD_FIB_BASE_SIZE;
+    pos += 2 + (size_t)parse_uint16(fib + pos) * 2;
+    if (pos + 2 > fibSize) return 0;
+    pos += 2 + (size_t)parse_uint16(fib + pos) * 4;
+    if (pos + 2 > fibSize) return 0;
+    size_t pairs = parse_uint16(fib + pos);
+    pos += 2;
+    if (pairs <= WORD_FIB_DGG_INFO || pos + (WORD_FIB_DGG_INFO + 1) * 8 > fibSize) return 0;
+
+    *fc = parse_uint32(fib + pos + WORD_FIB_DGG_INFO * 8);
+    *lcb = parse_uint32(fib + pos + WORD_FIB_DGG_INFO * 8 + 4);
+    return *lcb != 0;
+}
+
+// Scans the blips of a Word document: the Data stream, where inline pictures keep theirs, then every blip of the
+// BStore, which is either embedded in its entry in the table stream or stored at foDelay in the WordDocument stream.
+// The streams are children of storage, the root storage if NULL. cursor ends up on the WordDocument stream and table on
+// the table stream.
+static int xls2img_word_images(XLS2IMG_CURSOR* cursor, XLS2IMG_CURSOR* table, XLS2IMG_PARSER* parser, const COMPOUND_FILE_ENTRY* storage)
+{
+    const XLS2IMG_READER* reader = cursor->reader;
+    const COMPOUND_FILE_ENTRY* stream = NULL;
+    int ret;
+
+    if (xls2img_find_stream(reader, storage, "Data", &stream) == XLS2IMG_SUCCESS)
+    {
+        xls2img_cursor_select(cursor, stream);
+        ret = xls2img_cursor_check(cursor);
+        if (ret == XLS2IMG_SUCCESS)
+            ret = xls2img_cursor_feed(cursor, parser, 0, (size_t)cursor->streamSize);
+        if (ret != XLS2IMG_SUCCESS) return ret;
     }
-    return 1;
-}
\ No newline at end of file
+
+    const COMPOUND_FILE_ENTRY* document = NULL;
+    ret = xls2img_find_stream(reader, storage, "WordDocument", &document);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+    xls2img_cursor_select(cursor, document);
+    ret = xls2img_cursor_check(cursor);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+
+    uint8_t fib[WORD_FIB_READ_SIZE];
+    uint64_t documentSize = cursor->streamSize;
+    size_t fibSize = documentSize < sizeof(fib) ? (size_t)documentSize : sizeof(fib);
+    ret = xls2img_cursor_copy(cursor, 0, (char*)fib, fibSize);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+
+    uint32_t fc = 0, lcb = 0;
+    if (!xls2img_word_dgg_info(fib, fibSize, &fc, &lcb))
+        return XLS2IMG_SUCCESS;
+
+    const char* tableName = parse_uint16(fib + WORD_FIB_FLAGS) & WORD_FIB_WHICH_TABLE ? "1Table" : "0Table";
+    ret = xls2img_find_stream(reader, storage, tableName, &stream);
+    if (ret == XLS2IMG_ERROR_NO_WORKBOOK) return XLS2IMG_ERROR_FILE_CORRUPTED;
+    if (ret != XLS2IMG_SUCCESS) return ret;
+    xls2img_cursor_select(table, stream);
+    ret = xls2img_cursor_check(table);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+
+    // OfficeArtContent starts with the drawing group container, whose children include the BStore
+    uint16_t type;
+    uint32_t len;
+    uint64_t end = (uint64_t)fc + lcb < table->streamSize ? (uint64_t)fc + lcb : table->streamSize;
+    ret = xls2img_read_art_header(table, fc, &type, &len);
+    if (ret != XLS2IMG_SUCCESS || type != OFFICEART_DGG_CONTAINER) return ret;
+
+    uint64_t pos = (uint64_t)fc + 8;
+    uint64_t groupEnd = pos + len < end ? pos + len : end;
+    uint64_t storeEnd = 0;
+    while (pos + 8 <= groupEnd)
+    {
+        ret = xls2img_read_art_header(table, pos, &type, &len);
+        if (ret != XLS2IMG_SUCCESS) return ret;
+        if (type == OFFICEART_BSTORE_CONTAINER)
+        {
+            storeEnd = pos + 8 + len < groupEnd ? pos + 8 + len : groupEnd;
+            pos += 8;
+            break;
+        }
+        pos += 8 + (uint64_t)len;
+    }
+
+    while (pos + 8 <= storeEnd)
+    {
+        ret = xls2img_read_art_header(table, pos, &type, &len);
+        if (ret != XLS2IMG_SUCCESS) return ret;
+        uint64_t entryEnd = pos + 8 + len < storeEnd ? pos + 8 + len : storeEnd;
+
+        uint8_t fbse[OFFICEART_FBSE_SIZE];
+        if (type == OFFICEART_FBSE && entryEnd - pos - 8 >= sizeof(fbse))
+        {
+            ret = xls2img_cursor_copy(table, (size_t)pos + 8, (char*)fbse, sizeof(fbse));
+            if (ret != XLS2IMG_SUCCESS) return ret;
+
+            uint32_t size = parse_uint32(fbse + 20);
+            uint32_t foDelay = parse_uint32(fbse + 28);
+            uint64_t blip = pos + 8 + sizeof(fbse) + fbse[33];
+            if (blip < entryEnd)
+            {
+                ret = xls2img_parser_begin_range(parser, (size_t)blip);
+                if (ret == XLS2IMG_SUCCESS)
+                    ret = xls2img_cursor_feed(table, parser, (size_t)blip, (size_t)(entryEnd - blip));
+            }
+            else if (size > 0 && foDelay < documentSize)
+            {
+                uint64_t available = documentSize - foDelay;
+                ret = xls2img_parser_begin_range(parser, foDelay);
+                if (ret == XLS2IMG_SUCCESS)
+                    ret = xls2img_cursor_feed(cursor, parser, foDelay, (size_t)(size < available ? size : available));
+            }
+            if (ret != XLS2IMG_SUCCESS) return ret;
+        }
+        pos = entryEnd;
+    }
+    return XLS2IMG_SUCCESS;
+}
+
+// Converts the UTF-16 name of a directory entry to UTF-8, into a buffer of XLS2IMG_ENTRY_NAME_SIZE bytes
+static size_t xls2img_entry_name(const COMPOUND_FILE_ENTRY* entry, char* name)
+{
+    size_t len = entry->nameLen / 2 < 32 ? entry->nameLen / 2 : 32;
+    size_t n = 0;
+    for (size_t i = 0; i < len && entry->name[i]; i++)
+    {
+        uint32_t c = entry->name[i];
+        if (c >= 0xD800 && c < 0xDC00 && i + 1 < len && entry->name[i + 1] >= 0xDC00 && entry->name[i + 1] < 0xE000)
+        {
+            c = 0x10000 + ((c - 0xD800) << 10) + (entry->name[i + 1] - 0xDC00);
+            i++;
+        }
+
+        if (c < 0x80)
+            name[n++] = (char)c;
+        else if (c < 0x800)
+        {
+            name[n++] = (char)(0xC0 | (c >> 6));
+            name[n++] = (char)(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            name[n++] = (char)(0xE0 | (c >> 12));
+            name[n++] = (char)(0x80 | ((c >> 6) & 0x3F));
+            name[n++] = (char)(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            name[n++] = (char)(0xF0 | (c >> 18));
+            name[n++] = (char)(0x80 | ((c >> 12) & 0x3F));
+            name[n++] = (char)(0x80 | ((c >> 6) & 0x3F));
+            name[n++] = (char)(0x80 | (c & 0x3F));
+        }
+    }
+    return n;
+}
+
+// Makes the path of an object from the path of the object being searched and the object's name
+static char* xls2img_embed_path(const XLS2IMG_EMBED* embed, const char* name, size_t nameLen, size_t* size)
+{
+    size_t parentLen = embed->path ? strlen(embed->path) + 1 : 0;
+    *size = parentLen + nameLen + 1;
+    char* path = (char*)xls2img_mem_alloc(embed->options->allocator, *size);
+    if (!path) return NULL;
+
+    if (parentLen)
+    {
+        memcpy(path, embed->path, parentLen - 1);
+        path[parentLen - 1] = '/';
+    }
+    memcpy(path + parentLen, name, nameLen);
+    path[parentLen + nameLen] = '\0';
+    return path;
+}
+
+// Tags an image with the path of the object being searched and counts it against the limits of the whole search
+static int xls2img_embed_image(const XLS2IMG_IMAGE* image, void* user)
+{
+    XLS2IMG_EMBED* embed = (XLS2IMG_EMBED*)user;
+    const XLS2IMG_LIMITS* limits = embed->options->limits;
+    size_t size = image->prefix_size + image->size;
+    // The count is returned as an int, so a search cannot deliver more than INT_MAX images even without a limit
+    if (embed->count == INT_MAX || (limits->max_images && (uint64_t)embed->count >= limits->max_images) ||
+        (limits->max_output_bytes && embed->outputBytes + size > limits->max_output_bytes))
+        return embed->stop = XLS2IMG_ERROR_LIMIT_EXCEEDED;
+
+    XLS2IMG_IMAGE tagged = *image;
+    tagged.path = embed->path;
+    int ret = embed->onImage(&tagged, embed->user);
+    if (ret != XLS2IMG_SUCCESS) return embed->stop = ret;
+
+    embed->count++;
+    embed->outputBytes += size;
+    return XLS2IMG_SUCCESS;
+}
+
+// Decides whether the search goes on after an object was scanned with result ret. An object that cannot be read is
+// skipped; the callback stopping, an exceeded limit or a failed allocation ends the search.
+static int xls2img_embed_status(const XLS2IMG_EMBED* embed, int ret)
+{
+    if (embed->stop != XLS2IMG_SUCCESS) return embed->stop;
+    if (ret == XLS2IMG_ERROR_OUT_OF_MEMORY || ret == XLS2IMG_ERROR_LIMIT_EXCEEDED) return ret;
+    return XLS2IMG_SUCCESS;
+}
+
+// Locates the file in an Ole10Native stream. A package object stores it after its label, source path and temporary
+// path; other objects store their native data right after the size.
+static void xls2img_ole_native(const uint8_t* data, size_t size, const uint8_t** file, size_t* fileSize)
+{
+    *file = NULL;
+    *fileSize = 0;
+    if (size < 4) return;
+
+    size_t total = parse_uint32(data);
+    if (total > size - 4) total = size - 4;
+    const uint8_t* p = data + 4;
+    const uint8_t* end = p + total;
+    *file = p;
+    *fileSize = total;
+
+    if (end - p < 2 || parse_uint16(p) != 2) return;
+    p += 2;
+    for (int i = 0; i < 2; i++)
+    {
+        const uint8_t* terminator = (const uint8_t*)memchr(p, 0, (size_t)(end - p));
+        if (!terminator) return;
+        p = terminator + 1;
+    }
+    if (end - p < 8) return;
+    size_t tempLen = parse_uint32(p + 4);
+    p += 8;
+    if ((size_t)(end - p) < tempLen || (size_t)(end - p) - tempLen < 4) return;
+    p += tempLen;
+    size_t dataSize = parse_uint32(p);
+    p += 4;
+    if (dataSize > (size_t)(end - p)) return;
+
+    *file = p;
+    *fileSize = dataSize;
+}
+
+// Opens a compound file or package embedded in another file as a reader over its bytes and searches it as the
+// object being searched. Bytes that are neither are not an error.
+static int xls2img_embedded_file(const uint8_t* data, size_t size, XLS2IMG_EMBED* embed, unsigned int depth)
+{
+    XLS2IMG_READER* sub = NULL;
+    int ret = xls2img_open_ex(&sub, data, size, embed->options->allocator);
+    if (ret != XLS2IMG_SUCCESS) return ret == XLS2IMG_ERROR_OUT_OF_MEMORY ? ret : XLS2IMG_SUCCESS;
+
+    ret = xls2img_object_images(sub, NULL, embed, depth);
+    xls2img_close(sub);
+    return ret;
+}
+
+// Searches the file held by a stream of an object's storage, \x01Ole10Native or Package. The stream is used in
+// place when its sectors are contiguous, which is the common case, and copied otherwise.
+static int xls2img_embedded_stream(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* stream, int native,
+    XLS2IMG_EMBED* embed, unsigned int depth)
+{
+    XLS2IMG_STATS* stats = embed->options->stats;
+    XLS2IMG_TRACE* trace = embed->options->trace;
+    (void)stats;
+    (void)trace;
+
+    XLS2IMG_CURSOR cursor;
+    xls2img_cursor_setup(&cursor, reader, embed->options);
+    xls2img_cursor_select(&cursor, stream);
+
+    const uint8_t* data = NULL;
+    void* copy = NULL;
+    size_t size = 0;
+    XLS2IMG_EXTENT extent;
+    int ret = xls2img_cursor_extents(&cursor, 0, (size_t)cursor.streamSize, &extent, 1);
+    if (ret == 1)
+    {
+        data = reader->buffer + extent.offset;
+        size = extent.size;
+        ret = XLS2IMG_SUCCESS;
+    }
+    else if (ret > 1)
+    {
+        ret = xls2img_cursor_workbook(&cursor, &copy, &size);
+        data = (const uint8_t*)copy;
+    }
+    xls2img_cursor_cleanup(&cursor);
+
+    if (ret == XLS2IMG_SUCCESS && data)
+    {
+        const uint8_t* file = data;
+        size_t fileSize = size;
+        if (native)
+            xls2img_ole_native(data, size, &file, &fileSize);
+        if (fileSize > 0)
+            ret = xls2img_embedded_file(file, fileSize, embed, depth);
+    }
+
+    if (copy)
+    {
+        xls2img_block_free(copy);
+        XLS2IMG_STAT_FREE(stats, size);
+        XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_ALLOC, 2, size, 0);
+    }
+    return ret;
+}
+
+// Searches an embedded object: the document its storage holds, the file in its Ole10Native or Package stream, and
+// while depth is left the objects embedded in them. storage is NULL for the root of a reader opened on an object's file.
+static int xls2img_object_images(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* storage, XLS2IMG_EMBED* embed, unsigned int depth)
+{
+    if (embed->nesting >= XLS2IMG_EMBED_MAX_NESTING || embed->objects >= XLS2IMG_EMBED_MAX_OBJECTS)
+        return XLS2IMG_SUCCESS;
+    embed->nesting++;
+    embed->objects++;
+
+    int ret = xls2img_embed_status(embed, xls2img_document_images(reader, storage, xls2img_embed_image, embed, embed->options));
+    if (ret == XLS2IMG_SUCCESS && reader->container != XLS2IMG_CONTAINER_OOXML)
+    {
+        static const char* const fileStreams[] = { "\x01Ole10Native", "Package" };
+        for (size_t i = 0; i < sizeof(fileStreams) / sizeof(fileStreams[0]) && ret == XLS2IMG_SUCCESS; i++)
+        {
+            const COMPOUND_FILE_ENTRY* stream = NULL;
+            if (xls2img_find_stream(reader, storage, fileStreams[i], &stream) == XLS2IMG_SUCCESS)
+                ret = xls2img_embed_status(embed, xls2img_embedded_stream(reader, stream, i == 0, embed, depth));
+        }
+    }
+    if (ret == XLS2IMG_SUCCESS && depth > 1)
+        ret = xls2img_embed_status(embed, xls2img_embedded_objects(reader, storage, embed, depth - 1));
+
+    embed->nesting--;
+    return ret;
+}
+
+// Searches the parts of a package under xl/embeddings/, each one an object
+static int xls2img_package_objects(const XLS2IMG_READER* reader, XLS2IMG_EMBED* embed, unsigned int depth)
+{
+    XLS2IMG_ALLOCATOR* allocator = embed->options->allocator;
+    const XLS2IMG_LIMITS* limits = embed->options->limits;
+    if (reader->mediaError != XLS2IMG_SUCCESS) return reader->mediaError;
+
+    for (size_t i = 0; i < reader->mediaCount; i++)
+    {
+        const XLS2IMG_ZIP_ENTRY* entry = &reader->media[i];
+        if (entry->format != XLS2IMG_UNKNOWN) continue;
+        if (limits->max_bytes && entry->size > limits->max_bytes) return XLS2IMG_ERROR_LIMIT_EXCEEDED;
+
+        size_t pathSize;
+        char* path = xls2img_embed_path(embed, (const char*)reader->buffer + entry->name_offset, entry->name_len, &pathSize);
+        if (!path) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+
+        const uint8_t* data = NULL;
+        uint8_t* buffer = NULL;
+        int ret = xls2img_zip_entry_data(reader->buffer, entry, allocator, &data, &buffer);
+        if (ret == XLS2IMG_SUCCESS)
+        {
+            const char* parentPath = embed->path;
+            embed->path = path;
+            ret = xls2img_embedded_file(data, entry->size, embed, depth);
+            embed->path = parentPath;
+        }
+        if (buffer)
+            xls2img_mem_free(allocator, buffer, entry->size);
+        xls2img_mem_free(allocator, path, pathSize);
+
+        ret = xls2img_embed_status(embed, ret);
+        if (ret != XLS2IMG_SUCCESS) return ret;
+    }
+    return XLS2IMG_SUCCESS;
+}
+
+// Searches the objects embedded in a document: the child storages of a compound file's storage, the root storage if
+// NULL, or the embedded parts of a package. Word keeps its objects in the storages of ObjectPool, which is not an
+// object itself. Each storage of a compound file is searched once however its directory links it.
+static int xls2img_embedded_objects(const XLS2IMG_READER* reader, const COMPOUND_FILE_ENTRY* storage, XLS2IMG_EMBED* embed, unsigned int depth)
+{
+    if (reader->container == XLS2IMG_CONTAINER_OOXML)
+        return xls2img_package_objects(reader, embed, depth);
+
+    XLS2IMG_ALLOCATOR* allocator = embed->options->allocator;
+    const COMPOUND_FILE_ENTRY* parent = storage ? storage : xls2img_get_entry(reader, 0);
+    if (!parent) return XLS2IMG_ERROR_FILE_CORRUPTED;
+    size_t entryCount = reader->dirSectorCount * (reader->sectorSize / sizeof(COMPOUND_FILE_ENTRY));
+
+    // the bitmap of searched storages covers a whole compound file, the walk of its root storage owns it
+    uint8_t* outerStorages = embed->storages;
+    if (!storage)
+    {
+        embed->storages = (uint8_t*)xls2img_mem_calloc(allocator, entryCount / 8 + 1);
+        if (!embed->storages)
+        {
+            embed->storages = outerStorages;
+            return XLS2IMG_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+    // an in-order walk of the sibling tree, so objects come in name order; more steps than directory entries means
+    // its links loop
+    uint32_t* stack = (uint32_t*)xls2img_mem_alloc(allocator, entryCount * sizeof(uint32_t));
+    int ret = stack ? XLS2IMG_SUCCESS : XLS2IMG_ERROR_OUT_OF_MEMORY;
+    size_t top = 0;
+    size_t steps = 0;
+    uint32_t entryID = parent->childID;
+
+    while (ret == XLS2IMG_SUCCESS && (top > 0 || entryID != 0xFFFFFFFF))
+    {
+        const COMPOUND_FILE_ENTRY* entry;
+        if (entryID != 0xFFFFFFFF)
+        {
+            if (++steps > entryCount)
+            {
+                ret = XLS2IMG_ERROR_CHAIN_CYCLE;
+                break;
+            }
+            entry = xls2img_get_entry(reader, entryID);
+            if (entry)
+            {
+                stack[top++] = entryID;
+                entryID = entry->leftSiblingID;
+            }
+            else
+                entryID = 0xFFFFFFFF;
+            continue;
+        }
+
+        uint32_t id = stack[--top];
+        entry = xls2img_get_entry(reader, id);
+        entryID = entry->rightSiblingID;
+        if (entry->type != 1 || !xls2img_visit(embed->storages, entryCount, id)) continue;
+
+        char name[XLS2IMG_ENTRY_NAME_SIZE];
+        size_t pathSize;
+        char* path = xls2img_embed_path(embed, name, xls2img_entry_name(entry, name), &pathSize);
+        if (!path)
+        {
+            ret = XLS2IMG_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+
+        const char* parentPath = embed->path;
+        embed->path = path;
+        if (xls2img_compare_name(entry, "ObjectPool") == 0 && embed->nesting < XLS2IMG_EMBED_MAX_NESTING)
+        {
+            embed->nesting++;
+            ret = xls2img_embedded_objects(reader, entry, embed, depth);
+            embed->nesting--;
+        }
+        else
+            ret = xls2img_object_images(reader, entry, embed, depth);
+        embed->path = parentPath;
+        xls2img_mem_free(allocator, path, pathSize);
+        ret = xls2img_embed_status(embed, ret);
+    }
+
+    xls2img_mem_free(allocator, stack, entryCount * sizeof(uint32_t));
+    if (!storage)
+    {
+        xls2img_mem_free(allocator, embed->storages, entryCount / 8 + 1);
+        embed->storages = outerStorages;
+    }
+    return ret;
+}
+
+// Indexes the media of an OOXML package; the CFB tables stay empty and every workbook read fails
+static int xls2img_open_package(XLS2IMG_READER* reader)
+{
+    int hasWorkbook = 0;
+    int ret = xls2img_zip_open(reader->buffer, reader->bufferLen, reader->allocator, &reader->media, &reader->mediaCount, &hasWorkbook);
+    if (ret != XLS2IMG_SUCCESS) return ret;
+
+    reader->container = XLS2IMG_CONTAINER_OOXML;
+    reader->workbookError = XLS2IMG_ERROR_NO_WORKBOOK;
+    reader->mediaError = hasWorkbook ? XLS2IMG_SUCCESS : XLS2IMG_ERROR_NO_WORKBOOK;
+    return XLS2IMG_SUCCESS;
+}
@@ -0,0 +1,221 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "xls2img.h"
+#include "xls2img_alloc.h"
+#include <string.h>
+
+// Block sizes are rounded up to classes four to a power of two, so a block is at most 25% larger than requested.
+// A request also takes a cached block of one of the next classes, up to about twice its size, before allocating.
+#define SESSION_CLASS_COUNT 256
+#define SESSION_MIN_BLOCK 64
+#define SESSION_FIT_CLASSES 4
+
+typedef union SESSION_BLOCK {
+    struct {
+        union SESSION_BLOCK* prev;  // live list; unused while cached
+        union SESSION_BLOCK* next;  // live list, or the cache list of the block's class
+        size_t capacity;            // usable bytes after the header
+        size_t size_class;
+    } info;
+    uint64_t align[4];              // keeps the block data 16-byte aligned on 32 and 64-bit targets
+} SESSION_BLOCK;
+
+struct XLS2IMG_SESSION {
+    XLS2IMG_ALLOCATOR allocator;    // handed to readers and options, its callbacks are the functions below
+    XLS2IMG_ALLOCATOR* base;        // where blocks come from, NULL for malloc
+    size_t max_cached;
+    size_t cached_bytes;            // capacity of the cached blocks
+    SESSION_BLOCK live;             // sentinel of the circular list of blocks in use
+    SESSION_BLOCK* cache[SESSION_CLASS_COUNT];
+};
+
+static size_t session_class(size_t size, size_t* capacity)
+{
+    size_t n = (size < SESSION_MIN_BLOCK ? SESSION_MIN_BLOCK : size) - 1;
+    unsigned int shift = 0;
+    while ((n >> shift) > 7)
+        shift++;
+    // n >> shift is 4 to 7: the top three bits of the size pick the class
+    *capacity = ((n >> shift) + 1) << shift;
+    return shift * 4 + (n >> shift) - 4;
+}
+
+static size_t session_block_size(const SESSION_BLOCK* block)
+{
+    return sizeof(SESSION_BLOCK) + block->info.capacity;
+}
+
+static void session_link(XLS2IMG_SESSION* session, SESSION_BLOCK* block)
+{
+    block->info.prev = &session->live;
+    block->info.next = session->live.info.next;
+    session->live.info.next->info.prev = block;
+    session->live.info.next = block;
+}
+
+static void session_unlink(SESSION_BLOCK* block)
+{
+    block->info.prev->info.next = block->info.next;
+    block->info.next->info.prev = block->info.prev;
+}
+
+// Keeps a block that is no longer in use, or releases it once the cache is full
+static void session_cache(XLS2IMG_SESSION* session, SESSION_BLOCK* block)
+{
+    if (session->max_cached && session->cached_bytes + block->info.capacity > session->max_cached)
+    {
+        xls2img_mem_free(session->base, block, session_block_size(block));
+        return;
+    }
+    block->info.next = session->cache[block->info.size_class];
+    session->cache[block->info.size_class] = block;
+    session->cached_bytes += block->info.capacity;
+}
+
+static void* session_alloc(size_t size, void* user)
+{
+    XLS2IMG_SESSION* session = (XLS2IMG_SESSION*)user;
+    if (size > SIZE_MAX / 2) return NULL;
+
+    size_t capacity;
+    size_t size_class = session_class(size, &capacity);
+    SESSION_BLOCK* block = NULL;
+    for (size_t c = size_class; c < size_class + SESSION_FIT_CLASSES && c < SESSION_CLASS_COUNT; c++)
+    {
+        if (session->cache[c])
+        {
+            block = session->cache[c];
+            session->cache[c] = block->info.next;
+            session->cached_bytes -= block->info.capacity;
+            break;
+        }
+    }
+    if (!block)
+    {
+        block = (SESSION_BLOCK*)xls2img_mem_alloc(session->base, sizeof(SESSION_BLOCK) + capacity);
+        if (!block) return NULL;
+        block->info.capacity = capacity;
+        block->info.size_class = size_class;
+    }
+
+    session_link(session, block);
+    return block + 1;
+}
+
+static void session_free(void* ptr, size_t size, void* user)
+{
+    (void)size;
+    SESSION_BLOCK* block = (SESSION_BLOCK*)ptr - 1;
+    session_unlink(block);
+    session_cache((XLS2IMG_SESSION*)user, block);
+}
+
+static void* session_realloc(void* ptr, size_t old_size, size_t new_size, void* user)
+{
+    if (!ptr) return session_alloc(new_size, user);
+
+    // growth within the class, and every shrink, stays in place
+    SESSION_BLOCK* block = (SESSION_BLOCK*)ptr - 1;
+    if (new_size <= block->info.capacity) return ptr;
+
+    void* new_ptr = session_alloc(new_size, user);
+    if (!new_ptr) return NULL;
+    memcpy(new_ptr, ptr, old_size);
+    session_free(ptr, old_size, user);
+    return new_ptr;
+}
+
+int xls2img_session_create(XLS2IMG_SESSION** session, XLS2IMG_ALLOCATOR* allocator, size_t max_cached)
+{
+    if (!session) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    XLS2IMG_SESSION* s = (XLS2IMG_SESSION*)xls2img_mem_calloc(allocator, sizeof(XLS2IMG_SESSION));
+    if (!s) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+
+    s->allocator.alloc = session_alloc;
+    s->allocator.realloc = session_realloc;
+    s->allocator.free = session_free;
+    s->allocator.user = s;
+    s->base = allocator;
+    s->max_cached = max_cached;
+    s->live.info.prev = &s->live;
+    s->live.info.next = &s->live;
+    *session = s;
+    return XLS2IMG_SUCCESS;
+}
+
+XLS2IMG_ALLOCATOR* xls2img_session_allocator(XLS2IMG_SESSION* session)
+{
+    return session ? &session->allocator : NULL;
+}
+
+int xls2img_session_open(XLS2IMG_SESSION* session, XLS2IMG_READER** reader, const void* buffer, size_t len)
+{
+    if (!session) return XLS2IMG_ERROR_INVALID_ARGUMENT;
+
+    return xls2img_open_ex(reader, buffer, len, &session->allocator);
+}
+
+void xls2img_session_reset(XLS2IMG_SESSION* session)
+{
+    if (!session) return;
+
+    SESSION_BLOCK* block = session->live.info.next;
+    while (block != &session->live)
+    {
+        SESSION_BLOCK* next = block->info.next;
+        session_cache(session, block);
+        block = next;
+    }
+    session->live.info.prev = &session->live;
+    session->live.info.next = &session->live;
+    session->allocator.current_bytes = 0;
+}
+
+void xls2img_session_destroy(XLS2IMG_SESSION* session)
+{
+    if (!session) return;
+
+    SESSION_BLOCK* block = session->live.info.next;
+    while (block != &session->live)
+    {
+        SESSION_BLOCK* next = block->info.next;
+        xls2img_mem_free(session->base, block, session_block_size(block));
+        block = next;
+    }
+    for (size_t c = 0; c < SESSION_CLASS_COUNT; c++)
+    {
+        block = session->cache[c];
+        while (block)
+        {
+            SESSION_BLOCK* next = block->info.next;
+            xls2img_mem_free(session->base, block, session_block_size(block));
+            block = next;
+        }
+    }
+    xls2img_mem_free(session->base, session, sizeof(XLS2IMG_SESSION));
+}
@@ -0,0 +1,77 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Internal statistics hooks
+ *
+ * Built with XLS2IMG_ENABLE_STATS the macros below update the XLS2IMG_STATS attached to a
+ * reader or passed to xls2img_extract_images_stats. Without it they expand to nothing, so
+ * neither the counters nor the stats pointers exist in the compiled code.
+ */
+
+#ifndef XLS2IMG_STATS_H
+#define XLS2IMG_STATS_H
+
+#include "xls2img.h"
+
+#ifdef XLS2IMG_ENABLE_STATS
+
+// durations are measured on the monotonic clock of the deadlines
+static inline uint64_t xls2img_stats_now(void)
+{
+    return xls2img_clock_ns();
+}
+
+static inline void xls2img_stats_alloc(XLS2IMG_STATS* stats, size_t oldSize, size_t newSize)
+{
+    stats->allocations++;
+    stats->bytes_allocated += newSize - (newSize > oldSize ? oldSize : newSize);
+    stats->live_bytes += newSize;
+    stats->live_bytes -= oldSize;
+    if (stats->live_bytes > stats->peak_bytes)
+        stats->peak_bytes = stats->live_bytes;
+}
+
+#define XLS2IMG_STAT_ADD(stats, field, n) do { if (stats) (stats)->field += (n); } while (0)
+#define XLS2IMG_STAT_ALLOC(stats, size) do { if (stats) xls2img_stats_alloc((stats), 0, (size)); } while (0)
+#define XLS2IMG_STAT_REALLOC(stats, oldSize, newSize) do { if (stats) xls2img_stats_alloc((stats), (oldSize), (newSize)); } while (0)
+#define XLS2IMG_STAT_FREE(stats, size) do { if (stats) (stats)->live_bytes -= (size); } while (0)
+#define XLS2IMG_STAT_TIMER(name) uint64_t name = xls2img_stats_now()
+#define XLS2IMG_STAT_ELAPSED(stats, field, start) do { if (stats) (stats)->field += xls2img_stats_now() - (start); } while (0)
+
+#else
+
+#define XLS2IMG_STAT_ADD(stats, field, n) ((void)0)
+#define XLS2IMG_STAT_ALLOC(stats, size) ((void)0)
+#define XLS2IMG_STAT_REALLOC(stats, oldSize, newSize) ((void)0)
+#define XLS2IMG_STAT_FREE(stats, size) ((void)0)
+#define XLS2IMG_STAT_TIMER(name) ((void)0)
+#define XLS2IMG_STAT_ELAPSED(stats, field, start) ((void)0)
+
+#endif
+
+#endif /* XLS2IMG_STATS_H */
@@ -0,0 +1,80 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Internal tracing hooks
+ *
+ * Built with XLS2IMG_ENABLE_TRACE the macro below appends an event to the XLS2IMG_TRACE attached to a
+ * reader or passed in XLS2IMG_EXTRACT_OPTIONS. Without it the macro expands to nothing and its arguments
+ * are never evaluated.
+ */
+
+#ifndef XLS2IMG_TRACE_H
+#define XLS2IMG_TRACE_H
+
+#include "xls2img.h"
+
+#ifdef XLS2IMG_ENABLE_TRACE
+
+static inline void xls2img_trace_emit(XLS2IMG_TRACE* trace, int type, uint32_t kind, uint64_t offset, uint64_t size)
+{
+    if (!trace->events || trace->capacity == 0) return;
+
+    if (trace->count == trace->capacity)
+    {
+        // hand a full batch to the callback, or overwrite the oldest event
+        if (trace->flush)
+            xls2img_trace_flush(trace);
+        else
+        {
+            trace->head = (trace->head + 1) % trace->capacity;
+            trace->count--;
+            trace->dropped++;
+        }
+    }
+
+    // the monotonic clock of the stats timers and deadlines, so events line up with both
+    XLS2IMG_EVENT* event = &trace->events[(trace->head + trace->count) % trace->capacity];
+    event->time_ns = xls2img_clock_ns();
+    event->type = (uint16_t)type;
+    event->reserved = 0;
+    event->kind = kind;
+    event->offset = offset;
+    event->size = size;
+    trace->count++;
+}
+
+#define XLS2IMG_TRACE_EVENT(trace, type, kind, offset, size) \
+    do { if (trace) xls2img_trace_emit((trace), (type), (uint32_t)(kind), (uint64_t)(offset), (uint64_t)(size)); } while (0)
+
+#else
+
+#define XLS2IMG_TRACE_EVENT(trace, type, kind, offset, size) ((void)0)
+
+#endif
+
+#endif /* XLS2IMG_TRACE_H */
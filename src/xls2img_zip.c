@@ -0,0 +1,370 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "xls2img_zip.h"
+#include "xls2img_alloc.h"
+#include "xls2img_control.h"
+#include "xls2img_formats.h"
+#include "xls2img_inflate.h"
+#include "xls2img_stats.h"
+#include "xls2img_trace.h"
+#include <limits.h>
+#include <string.h>
+
+#define ZIP_LOCAL_HEADER_SIZE 30
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_EOCD_SIZE 22
+#define ZIP64_LOCATOR_SIZE 20
+#define ZIP64_EOCD_SIZE 56
+#define ZIP_MAX_COMMENT 0xFFFF
+
+static const char media_prefix[] = "xl/media/";
+static const char embeddings_prefix[] = "xl/embeddings/";
+
+static uint16_t read_le16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_le32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t read_le64(const uint8_t* p)
+{
+    return (uint64_t)read_le32(p) | ((uint64_t)read_le32(p + 4) << 32);
+}
+
+static int name_equals(const uint8_t* name, size_t len, const char* str)
+{
+    return len == strlen(str) && memcmp(name, str, len) == 0;
+}
+
+int xls2img_zip_detect(const uint8_t* package, size_t size)
+{
+    return size >= 4 && memcmp(package, "PK\x03\x04", 4) == 0;
+}
+
+// Finds the end of central directory record; the comment behind it is at most 64 KiB
+static const uint8_t* zip_find_eocd(const uint8_t* package, size_t size)
+{
+    if (size < ZIP_EOCD_SIZE) return NULL;
+
+    size_t lowest = size - ZIP_EOCD_SIZE > ZIP_MAX_COMMENT ? size - ZIP_EOCD_SIZE - ZIP_MAX_COMMENT : 0;
+    for (size_t pos = size - ZIP_EOCD_SIZE + 1; pos-- > lowest;)
+    {
+        const uint8_t* p = package + pos;
+        if (p[0] == 'P' && p[1] == 'K' && p[2] == 5 && p[3] == 6 && read_le16(p + 20) == size - pos - ZIP_EOCD_SIZE)
+            return p;
+    }
+    return NULL;
+}
+
+// Takes the ZIP64 values of the fields saturated in a central directory header from its extended information
+// extra field, which lists them in this order
+static int zip64_sizes(const uint8_t* extra, size_t extra_len, uint64_t* size, uint64_t* stored_size, uint64_t* offset)
+{
+    uint64_t* fields[3] = { size, stored_size, offset };
+    while (extra_len >= 4)
+    {
+        uint16_t id = read_le16(extra);
+        uint16_t len = read_le16(extra + 2);
+        if ((size_t)len > extra_len - 4) return 0;
+
+        if (id == 0x0001)
+        {
+            const uint8_t* value = extra + 4;
+            for (int i = 0; i < 3; i++)
+            {
+                if (*fields[i] != 0xFFFFFFFF)
+                    continue;
+                if (value + 8 > extra + 4 + len) return 0;
+                *fields[i] = read_le64(value);
+                value += 8;
+            }
+            return 1;
+        }
+        extra += 4 + len;
+        extra_len -= 4 + (size_t)len;
+    }
+    return 0;
+}
+
+// Appends an entry to the table, growing it by doubling
+static int zip_append(XLS2IMG_ALLOCATOR* allocator, XLS2IMG_ZIP_ENTRY** entries, size_t* count, size_t* capacity,
+    const XLS2IMG_ZIP_ENTRY* entry)
+{
+    if (*count == *capacity)
+    {
+        size_t new_capacity = *capacity ? *capacity * 2 : 16;
+        XLS2IMG_ZIP_ENTRY* new_entries = (XLS2IMG_ZIP_ENTRY*)xls2img_mem_realloc(allocator, *entries,
+            *capacity * sizeof(XLS2IMG_ZIP_ENTRY), new_capacity * sizeof(XLS2IMG_ZIP_ENTRY));
+        if (!new_entries) return 0;
+        *entries = new_entries;
+        *capacity = new_capacity;
+    }
+    (*entries)[(*count)++] = *entry;
+    return 1;
+}
+
+// Locates the data of a media or embedded entry through its local header, 0 if the entry cannot be extracted. An
+// embedded entry keeps XLS2IMG_UNKNOWN as its format.
+static int zip_media_entry(const uint8_t* package, size_t size, const uint8_t* header, int embedded, XLS2IMG_ZIP_ENTRY* entry)
+{
+    uint16_t flags = read_le16(header + 8);
+    uint16_t method = read_le16(header + 10);
+    uint64_t stored_size = read_le32(header + 20);
+    uint64_t data_size = read_le32(header + 24);
+    uint64_t offset = read_le32(header + 42);
+    size_t name_len = read_le16(header + 28);
+    size_t extra_len = read_le16(header + 30);
+
+    if ((flags & 1) || (method != 0 && method != 8))
+        return 0;
+    if ((stored_size == 0xFFFFFFFF || data_size == 0xFFFFFFFF || offset == 0xFFFFFFFF) &&
+        !zip64_sizes(header + ZIP_CENTRAL_HEADER_SIZE + name_len, extra_len, &data_size, &stored_size, &offset))
+        return 0;
+
+    entry->format = embedded ? XLS2IMG_UNKNOWN : xls2img_format_from_name((const char*)header + ZIP_CENTRAL_HEADER_SIZE, name_len);
+    if ((!embedded && entry->format == XLS2IMG_UNKNOWN) || data_size == 0 || (method == 0 && stored_size != data_size))
+        return 0;
+    // a deflated entry cannot expand by more than the DEFLATE limit; the stated size is what gets allocated
+    if (method == 8 && data_size / XLS2IMG_INFLATE_MAX_RATIO > stored_size)
+        return 0;
+
+    if (offset > size || size - offset < ZIP_LOCAL_HEADER_SIZE)
+        return 0;
+    const uint8_t* local = package + offset;
+    if (memcmp(local, "PK\x03\x04", 4) != 0)
+        return 0;
+    uint64_t data_offset = offset + ZIP_LOCAL_HEADER_SIZE + read_le16(local + 26) + read_le16(local + 28);
+    if (data_offset > size || stored_size > size - data_offset || data_size > SIZE_MAX)
+        return 0;
+
+    entry->data_offset = (size_t)data_offset;
+    entry->stored_size = (size_t)stored_size;
+    entry->size = (size_t)data_size;
+    entry->method = method;
+    entry->name_offset = (size_t)(header - package) + ZIP_CENTRAL_HEADER_SIZE;
+    entry->name_len = name_len;
+    return 1;
+}
+
+int xls2img_zip_open(const uint8_t* package, size_t size, XLS2IMG_ALLOCATOR* allocator, XLS2IMG_ZIP_ENTRY** entries,
+    size_t* count, int* has_workbook)
+{
+    const uint8_t* eocd = zip_find_eocd(package, size);
+    if (!eocd) return XLS2IMG_ERROR_FILE_CORRUPTED;
+
+    uint64_t entry_count = read_le16(eocd + 10);
+    uint64_t directory_size = read_le32(eocd + 12);
+    uint64_t directory_offset = read_le32(eocd + 16);
+
+    // a saturated field means the values are in the ZIP64 end of central directory record
+    size_t eocd_pos = (size_t)(eocd - package);
+    if ((entry_count == 0xFFFF || directory_size == 0xFFFFFFFF || directory_offset == 0xFFFFFFFF) &&
+        eocd_pos >= ZIP64_LOCATOR_SIZE && memcmp(eocd - ZIP64_LOCATOR_SIZE, "PK\x06\x07", 4) == 0)
+    {
+        uint64_t record = read_le64(eocd - ZIP64_LOCATOR_SIZE + 8);
+        if (record > eocd_pos - ZIP64_LOCATOR_SIZE || eocd_pos - ZIP64_LOCATOR_SIZE - record < ZIP64_EOCD_SIZE ||
+            memcmp(package + record, "PK\x06\x06", 4) != 0)
+            return XLS2IMG_ERROR_FILE_CORRUPTED;
+        entry_count = read_le64(package + record + 32);
+        directory_size = read_le64(package + record + 40);
+        directory_offset = read_le64(package + record + 48);
+    }
+    if (directory_offset > size || directory_size > size - directory_offset)
+        return XLS2IMG_ERROR_FILE_CORRUPTED;
+
+    XLS2IMG_ZIP_ENTRY* table = NULL;
+    size_t n = 0;
+    size_t capacity = 0;
+    *has_workbook = 0;
+
+    const uint8_t* p = package + directory_offset;
+    const uint8_t* end = p + directory_size;
+    for (uint64_t i = 0; i < entry_count; i++)
+    {
+        if (end - p < ZIP_CENTRAL_HEADER_SIZE || memcmp(p, "PK\x01\x02", 4) != 0)
+            break;
+        size_t name_len = read_le16(p + 28);
+        size_t record_len = ZIP_CENTRAL_HEADER_SIZE + name_len + read_le16(p + 30) + read_le16(p + 32);
+        if ((size_t)(end - p) < record_len)
+            break;
+
+        const uint8_t* name = p + ZIP_CENTRAL_HEADER_SIZE;
+        XLS2IMG_ZIP_ENTRY entry;
+        if (name_equals(name, name_len, "xl/workbook.xml") || name_equals(name, name_len, "xl/workbook.bin"))
+            *has_workbook = 1;
+        else if (((name_len > sizeof(media_prefix) - 1 && memcmp(name, media_prefix, sizeof(media_prefix) - 1) == 0 &&
+            zip_media_entry(package, size, p, 0, &entry)) ||
+            (name_len > sizeof(embeddings_prefix) - 1 && memcmp(name, embeddings_prefix, sizeof(embeddings_prefix) - 1) == 0 &&
+            zip_media_entry(package, size, p, 1, &entry))) && !zip_append(allocator, &table, &n, &capacity, &entry))
+        {
+            xls2img_mem_free(allocator, table, capacity * sizeof(XLS2IMG_ZIP_ENTRY));
+            return XLS2IMG_ERROR_OUT_OF_MEMORY;
+        }
+        p += record_len;
+    }
+
+    // trim to the entry count, which is all xls2img_zip_close knows
+    if (n < capacity)
+    {
+        XLS2IMG_ZIP_ENTRY* new_table = (XLS2IMG_ZIP_ENTRY*)xls2img_mem_realloc(allocator, table,
+            capacity * sizeof(XLS2IMG_ZIP_ENTRY), n * sizeof(XLS2IMG_ZIP_ENTRY));
+        if (!new_table && n > 0)
+        {
+            xls2img_mem_free(allocator, table, capacity * sizeof(XLS2IMG_ZIP_ENTRY));
+            return XLS2IMG_ERROR_OUT_OF_MEMORY;
+        }
+        table = new_table;
+    }
+
+    *entries = table;
+    *count = n;
+    return XLS2IMG_SUCCESS;
+}
+
+void xls2img_zip_close(XLS2IMG_ALLOCATOR* allocator, XLS2IMG_ZIP_ENTRY* entries, size_t count)
+{
+    xls2img_mem_free(allocator, entries, count * sizeof(XLS2IMG_ZIP_ENTRY));
+}
+
+int xls2img_zip_images(const uint8_t* package, const XLS2IMG_ZIP_ENTRY* entries, size_t count,
+    XLS2IMG_IMAGE_FUNC on_image, void* user, const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    XLS2IMG_ALLOCATOR* allocator = options->allocator;
+    XLS2IMG_STATS* stats = options->stats;
+    XLS2IMG_TRACE* trace = options->trace;
+    XLS2IMG_LIMITS limits;
+    if (options->limits)
+        limits = *options->limits;
+    else
+        memset(&limits, 0, sizeof(limits));
+    unsigned int formats = (options->formats ? options->formats : XLS2IMG_FORMATS_ALL) & xls2img_get_formats();
+    (void)stats;
+    (void)trace;
+
+    // progress counts the stored bytes of the media entries
+    XLS2IMG_CHECKPOINT checkpoint;
+    uint64_t stored_bytes = 0;
+    for (size_t i = 0; i < count; i++)
+        stored_bytes += entries[i].stored_size;
+    xls2img_checkpoint_init(&checkpoint, options->control, stored_bytes);
+    stored_bytes = 0;
+
+    XLS2IMG_STAT_TIMER(start);
+    int image_count = 0;
+    uint64_t output_bytes = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const XLS2IMG_ZIP_ENTRY* entry = &entries[i];
+        int ret = xls2img_checkpoint(&checkpoint, stored_bytes);
+        if (ret != XLS2IMG_SUCCESS) return ret;
+        stored_bytes += entry->stored_size;
+
+        if (entry->format == XLS2IMG_UNKNOWN || !(formats & XLS2IMG_FORMAT_MASK(entry->format)))
+            continue;
+        XLS2IMG_STAT_ADD(stats, headers_found, 1);
+        XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_HEADER, entry->format, entry->data_offset, 0);
+
+        if ((limits.max_bytes && entry->size > limits.max_bytes) ||
+            image_count == INT_MAX || (limits.max_images && (uint64_t)image_count >= limits.max_images) ||
+            (limits.max_output_bytes && output_bytes + entry->size > limits.max_output_bytes))
+            return XLS2IMG_ERROR_LIMIT_EXCEEDED;
+
+        XLS2IMG_IMAGE image;
+        image.format = entry->format;
+        image.size = entry->size;
+        image.data = (void*)(package + entry->data_offset);
+        image.offset = entry->data_offset;
+        image.span = entry->stored_size;
+        image.prefix = NULL;
+        image.prefix_size = 0;
+        image.path = NULL;
+
+        uint8_t* inflated = NULL;
+        if (entry->method == 8)
+        {
+            inflated = (uint8_t*)xls2img_mem_alloc(allocator, entry->size);
+            if (!inflated) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+            XLS2IMG_STAT_ALLOC(stats, entry->size);
+            XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_ALLOC, 0, 0, entry->size);
+
+            if (xls2img_inflate(package + entry->data_offset, entry->stored_size, inflated, entry->size) != XLS2IMG_SUCCESS)
+            {
+                xls2img_mem_free(allocator, inflated, entry->size);
+                XLS2IMG_STAT_FREE(stats, entry->size);
+                XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_ALLOC, 2, entry->size, 0);
+                XLS2IMG_STAT_ADD(stats, headers_rejected, 1);
+                XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_IMAGE_REJECTED, entry->format, entry->data_offset, 0);
+                continue;
+            }
+            image.data = inflated;
+        }
+        image.check = options->verify ? xls2img_verify(image.format, (const uint8_t*)image.data, image.size, NULL) : 0;
+
+        XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_IMAGE_ACCEPTED, image.format, image.offset, image.size);
+        ret = on_image(&image, user);
+        if (inflated)
+        {
+            xls2img_mem_free(allocator, inflated, entry->size);
+            XLS2IMG_STAT_FREE(stats, entry->size);
+            XLS2IMG_TRACE_EVENT(trace, XLS2IMG_EVENT_ALLOC, 2, entry->size, 0);
+        }
+        if (ret != XLS2IMG_SUCCESS) return ret;
+
+        image_count++;
+        output_bytes += entry->size;
+    }
+
+    XLS2IMG_STAT_ELAPSED(stats, extract_ns, start);
+    return image_count > 0 ? image_count : XLS2IMG_ERROR_NO_IMAGES;
+}
+
+int xls2img_zip_entry_data(const uint8_t* package, const XLS2IMG_ZIP_ENTRY* entry, XLS2IMG_ALLOCATOR* allocator,
+    const uint8_t** data, uint8_t** buffer)
+{
+    *buffer = NULL;
+    if (entry->method == 0)
+    {
+        *data = package + entry->data_offset;
+        return XLS2IMG_SUCCESS;
+    }
+
+    uint8_t* inflated = (uint8_t*)xls2img_mem_alloc(allocator, entry->size);
+    if (!inflated) return XLS2IMG_ERROR_OUT_OF_MEMORY;
+    int ret = xls2img_inflate(package + entry->data_offset, entry->stored_size, inflated, entry->size);
+    if (ret != XLS2IMG_SUCCESS)
+    {
+        xls2img_mem_free(allocator, inflated, entry->size);
+        return ret;
+    }
+    *data = inflated;
+    *buffer = inflated;
+    return XLS2IMG_SUCCESS;
+}
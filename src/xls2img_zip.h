@@ -0,0 +1,77 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * OOXML package reader
+ *
+ * An .xlsx or .xlsm file is a ZIP archive. The open parses only the end of central directory record and the
+ * central directory: the entries under xl/media/ whose name gives an image format become a table, with their
+ * data located through the local headers, and so do the embedded objects under xl/embeddings/. Nothing else
+ * of the package is read. Stored entries are handed to
+ * the callback as views into the package buffer; deflated ones are decoded by xls2img_inflate into a buffer of
+ * the size the central directory states.
+ */
+
+#ifndef XLS2IMG_ZIP_H
+#define XLS2IMG_ZIP_H
+
+#include "xls2img.h"
+#include <stdint.h>
+
+typedef struct {
+    size_t data_offset;         // offset of the entry data in the package
+    size_t stored_size;         // size of the entry data in the package
+    size_t size;                // decompressed size
+    uint16_t method;            // 0 stored, 8 deflated
+    XLS2IMG_FORMAT format;      // from the extension of the entry name, XLS2IMG_UNKNOWN for an xl/embeddings/ part
+    size_t name_offset;         // entry name in the central directory
+    size_t name_len;
+} XLS2IMG_ZIP_ENTRY;
+
+// The buffer starts with a local file header, as every ZIP archive written by Office does
+int xls2img_zip_detect(const uint8_t* package, size_t size);
+
+// Builds the table of image entries under xl/media/ and of embedded objects under xl/embeddings/, in central
+// directory order. Entries that cannot be
+// extracted (encrypted, an unknown method or format, data outside the package) are left out.
+// has_workbook is set if the package has an xl/workbook part, which makes it a spreadsheet.
+int xls2img_zip_open(const uint8_t* package, size_t size, XLS2IMG_ALLOCATOR* allocator, XLS2IMG_ZIP_ENTRY** entries,
+    size_t* count, int* has_workbook);
+
+void xls2img_zip_close(XLS2IMG_ALLOCATOR* allocator, XLS2IMG_ZIP_ENTRY* entries, size_t count);
+
+// Hands the entries of the selected formats to on_image. options must be set, with the reader's defaults
+// already applied. Returns the number of images delivered, XLS2IMG_ERROR_NO_IMAGES or another error code.
+int xls2img_zip_images(const uint8_t* package, const XLS2IMG_ZIP_ENTRY* entries, size_t count,
+    XLS2IMG_IMAGE_FUNC on_image, void* user, const XLS2IMG_EXTRACT_OPTIONS* options);
+
+// Gives the data of an entry: a view into the package if it is stored, otherwise entry->size bytes inflated into a
+// buffer from the allocator, returned in buffer as well for the caller to free
+int xls2img_zip_entry_data(const uint8_t* package, const XLS2IMG_ZIP_ENTRY* entry, XLS2IMG_ALLOCATOR* allocator,
+    const uint8_t** data, uint8_t** buffer);
+
+#endif /* XLS2IMG_ZIP_H */
@@ -0,0 +1,466 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Persistent extraction cache
+ *
+ * The cache file is an append-only log of records, one per processed workbook, that is
+ * memory-mapped when the cache is opened. A later record for the same path supersedes the
+ * earlier ones. Appends from concurrent processes are serialized with a lock on a byte far
+ * past the end of the file, and every record carries a checksum so a record torn by a
+ * crashed writer is skipped instead of poisoning the rest of the file. A record also keeps the
+ * settings its outputs were written with; the caller treats a record made with other settings
+ * as a miss. A cache file of an older version is emptied when it is opened.
+ *
+ * Layout (little endian, every record 8-byte aligned):
+ *   file header   "X2IC", uint32 version, uint64 reserved
+ *   record        "X2IR", uint32 record size, uint64 checksum of the bytes that follow,
+ *                 uint64 file size, uint64 mtime, uint64 content hash (0 if not recorded),
+ *                 uint32 key length, uint32 image count, uint32 formats, uint32 embedded depth,
+ *                 uint32 verify, uint32 output prefix length, key (UTF-8 full path),
+ *                 output prefix (UTF-8), then per image: uint64 offset, uint64 size, uint64 hash,
+ *                 uint32 format, uint32 output length, uint32 check, uint32 reserved,
+ *                 output path (UTF-8)
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <windows.h>
+#include "xls2img_tool.h"
+
+#define CACHE_MAGIC "X2IC"
+#define CACHE_RECORD_MAGIC "X2IR"
+#define CACHE_VERSION 2
+#define CACHE_HEADER_SIZE 16
+#define CACHE_RECORD_HEADER_SIZE 64
+#define CACHE_IMAGE_HEADER_SIZE 40
+// the writer lock is taken on a byte no cache file will ever reach
+#define CACHE_LOCK_OFFSET_HIGH 0x7FFFFFFF
+
+struct TOOL_CACHE {
+    HANDLE file;
+    HANDLE mapping;
+    const uint8_t* view;
+    size_t view_size;
+    wchar_t* path;
+    size_t* slots;          /* open addressing table of record offsets, 0 = empty */
+    size_t slot_mask;
+    size_t record_count;    /* valid records in the mapped log, including superseded ones */
+    size_t live_count;      /* distinct keys */
+};
+
+static uint32_t load_u32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t load_u64(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+static unsigned long long cache_checksum(const uint8_t* data, size_t size)
+{
+    unsigned long long hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static int cache_lock(HANDLE file)
+{
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.OffsetHigh = CACHE_LOCK_OFFSET_HIGH;
+    return LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov);
+}
+
+static void cache_unlock(HANDLE file)
+{
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.OffsetHigh = CACHE_LOCK_OFFSET_HIGH;
+    UnlockFileEx(file, 0, 1, 0, &ov);
+}
+
+// Size of the record at offset, 0 if it is not a complete and intact record.
+static size_t cache_record_size(const uint8_t* view, size_t view_size, size_t offset)
+{
+    if (view_size - offset < CACHE_RECORD_HEADER_SIZE || memcmp(view + offset, CACHE_RECORD_MAGIC, 4) != 0)
+        return 0;
+
+    size_t size = load_u32(view + offset + 4);
+    if (size < CACHE_RECORD_HEADER_SIZE || size % 8 != 0 || size > view_size - offset)
+        return 0;
+    if (cache_checksum(view + offset + 16, size - 16) != load_u64(view + offset + 8))
+        return 0;
+    return size;
+}
+
+static unsigned long long cache_key_hash(const char* key, size_t key_len)
+{
+    return cache_checksum((const uint8_t*)key, key_len);
+}
+
+static size_t* cache_find_slot(const TOOL_CACHE* cache, const char* key, size_t key_len)
+{
+    size_t i = (size_t)cache_key_hash(key, key_len) & cache->slot_mask;
+    for (;;)
+    {
+        size_t* slot = &cache->slots[i];
+        if (*slot == 0)
+            return slot;
+
+        const uint8_t* record = cache->view + *slot;
+        if (load_u32(record + 40) == key_len && memcmp(record + CACHE_RECORD_HEADER_SIZE, key, key_len) == 0)
+            return slot;
+        i = (i + 1) & cache->slot_mask;
+    }
+}
+
+static int cache_build_index(TOOL_CACHE* cache)
+{
+    // the table is sized for the worst case of one record per 64 bytes of log
+    size_t slot_count = 16;
+    while (slot_count < cache->view_size / 32)
+        slot_count *= 2;
+
+    cache->slots = (size_t*)calloc(slot_count, sizeof(size_t));
+    if (!cache->slots)
+        return 0;
+    cache->slot_mask = slot_count - 1;
+
+    size_t offset = CACHE_HEADER_SIZE;
+    while (offset + CACHE_RECORD_HEADER_SIZE <= cache->view_size)
+    {
+        size_t size = cache_record_size(cache->view, cache->view_size, offset);
+        if (size == 0)
+        {
+            // torn or foreign data: resynchronize on the next aligned record
+            offset += 8;
+            continue;
+        }
+
+        const uint8_t* record = cache->view + offset;
+        size_t key_len = load_u32(record + 40);
+        if (CACHE_RECORD_HEADER_SIZE + key_len <= size)
+        {
+            size_t* slot = cache_find_slot(cache, (const char*)record + CACHE_RECORD_HEADER_SIZE, key_len);
+            if (*slot == 0)
+                cache->live_count++;
+            *slot = offset;
+            cache->record_count++;
+        }
+        offset += size;
+    }
+    return 1;
+}
+
+static void cache_unmap(TOOL_CACHE* cache)
+{
+    if (cache->view)
+        UnmapViewOfFile(cache->view);
+    if (cache->mapping)
+        CloseHandle(cache->mapping);
+    free(cache->slots);
+    cache->view = NULL;
+    cache->mapping = NULL;
+    cache->slots = NULL;
+    cache->record_count = 0;
+    cache->live_count = 0;
+}
+
+// Maps the current contents of the cache file and indexes them.
+static int cache_map(TOOL_CACHE* cache)
+{
+    cache_unmap(cache);
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(cache->file, &size))
+        return 0;
+    cache->view_size = (size_t)size.QuadPart;
+    if (cache->view_size <= CACHE_HEADER_SIZE)
+        return 1;
+
+    cache->mapping = CreateFileMappingW(cache->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (cache->mapping)
+        cache->view = (const uint8_t*)MapViewOfFile(cache->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!cache->view || memcmp(cache->view, CACHE_MAGIC, 4) != 0 || load_u32(cache->view + 4) != CACHE_VERSION)
+        return 0;
+    return cache_build_index(cache);
+}
+
+TOOL_CACHE* cache_open(const wchar_t* path)
+{
+    TOOL_CACHE* cache = (TOOL_CACHE*)calloc(1, sizeof(TOOL_CACHE));
+    if (!cache)
+        return NULL;
+
+    cache->path = _wcsdup(path);
+    cache->file = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (!cache->path || cache->file == INVALID_HANDLE_VALUE)
+    {
+        free(cache->path);
+        free(cache);
+        return NULL;
+    }
+
+    LARGE_INTEGER size;
+    uint8_t header[CACHE_HEADER_SIZE] = { 0 };
+    DWORD got = 0;
+    int ok = cache_lock(cache->file) && GetFileSizeEx(cache->file, &size);
+    if (ok && size.QuadPart >= CACHE_HEADER_SIZE)
+        ok = ReadFile(cache->file, header, CACHE_HEADER_SIZE, &got, NULL) && got == CACHE_HEADER_SIZE;
+
+    // records of an older version lack the extraction settings and cannot be trusted, so such a
+    // cache starts over; a file that is not a cache at all is left alone and fails in cache_map
+    int stale = ok && size.QuadPart != 0 && memcmp(header, CACHE_MAGIC, 4) == 0 && load_u32(header + 4) < CACHE_VERSION;
+    if (stale)
+    {
+        LARGE_INTEGER zero;
+        zero.QuadPart = 0;
+        ok = SetFilePointerEx(cache->file, zero, NULL, FILE_BEGIN) && SetEndOfFile(cache->file);
+    }
+    if (ok && (size.QuadPart == 0 || stale))
+    {
+        // a new cache file, write the header while holding the writer lock
+        uint32_t version = CACHE_VERSION;
+        memset(header, 0, sizeof(header));
+        memcpy(header, CACHE_MAGIC, 4);
+        memcpy(header + 4, &version, sizeof(version));
+        ok = write_all(cache->file, header, sizeof(header));
+    }
+    cache_unlock(cache->file);
+
+    if (!ok || !cache_map(cache))
+    {
+        cache_close(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void cache_close(TOOL_CACHE* cache)
+{
+    if (!cache)
+        return;
+
+    cache_unmap(cache);
+    if (cache->file != INVALID_HANDLE_VALUE)
+        CloseHandle(cache->file);
+    free(cache->path);
+    free(cache);
+}
+
+int cache_lookup(const TOOL_CACHE* cache, const char* key, CACHE_ENTRY* entry)
+{
+    if (!cache->view)
+        return 0;
+
+    size_t key_len = strlen(key);
+    size_t offset = *cache_find_slot(cache, key, key_len);
+    if (offset == 0)
+        return 0;
+
+    const uint8_t* record = cache->view + offset;
+    entry->file_size = load_u64(record + 16);
+    entry->mtime = load_u64(record + 24);
+    entry->content_hash = load_u64(record + 32);
+    entry->image_count = (int)load_u32(record + 44);
+    entry->formats = load_u32(record + 48);
+    entry->embedded_depth = load_u32(record + 52);
+    entry->verify = (int)load_u32(record + 56);
+    entry->output_prefix_len = load_u32(record + 60);
+    entry->output_prefix = (const char*)record + CACHE_RECORD_HEADER_SIZE + align8(key_len);
+    entry->cursor = (const uint8_t*)entry->output_prefix + align8(entry->output_prefix_len);
+    entry->end = record + load_u32(record + 4);
+    if (entry->cursor > entry->end)
+        return 0;
+    return 1;
+}
+
+int cache_entry_next_image(CACHE_ENTRY* entry, CACHE_IMAGE* image)
+{
+    if (entry->end - entry->cursor < CACHE_IMAGE_HEADER_SIZE)
+        return 0;
+
+    const uint8_t* p = entry->cursor;
+    image->offset = load_u64(p);
+    image->size = load_u64(p + 8);
+    image->hash = load_u64(p + 16);
+    image->format = (int)load_u32(p + 24);
+    image->output_len = load_u32(p + 28);
+    image->check = load_u32(p + 32);
+    image->output = (const char*)p + CACHE_IMAGE_HEADER_SIZE;
+
+    size_t size = CACHE_IMAGE_HEADER_SIZE + align8(image->output_len);
+    if ((size_t)(entry->end - p) < size)
+        return 0;
+
+    entry->cursor += size;
+    return 1;
+}
+
+int cache_store(TOOL_CACHE* cache, const char* key, const CACHE_ENTRY* entry, const CACHE_IMAGE* images)
+{
+    size_t key_len = strlen(key);
+    size_t size = CACHE_RECORD_HEADER_SIZE + align8(key_len) + align8(entry->output_prefix_len);
+    for (int i = 0; i < entry->image_count; i++)
+        size += CACHE_IMAGE_HEADER_SIZE + align8(images[i].output_len);
+    if (size > 0xFFFFFFFF)
+        return 0;
+
+    uint8_t* record = (uint8_t*)calloc(1, size);
+    if (!record)
+        return 0;
+
+    uint32_t u32;
+    memcpy(record, CACHE_RECORD_MAGIC, 4);
+    u32 = (uint32_t)size;
+    memcpy(record + 4, &u32, 4);
+    memcpy(record + 16, &entry->file_size, 8);
+    memcpy(record + 24, &entry->mtime, 8);
+    memcpy(record + 32, &entry->content_hash, 8);
+    u32 = (uint32_t)key_len;
+    memcpy(record + 40, &u32, 4);
+    u32 = (uint32_t)entry->image_count;
+    memcpy(record + 44, &u32, 4);
+    memcpy(record + 48, &entry->formats, 4);
+    memcpy(record + 52, &entry->embedded_depth, 4);
+    u32 = (uint32_t)entry->verify;
+    memcpy(record + 56, &u32, 4);
+    u32 = (uint32_t)entry->output_prefix_len;
+    memcpy(record + 60, &u32, 4);
+    memcpy(record + CACHE_RECORD_HEADER_SIZE, key, key_len);
+    memcpy(record + CACHE_RECORD_HEADER_SIZE + align8(key_len), entry->output_prefix, entry->output_prefix_len);
+
+    uint8_t* p = record + CACHE_RECORD_HEADER_SIZE + align8(key_len) + align8(entry->output_prefix_len);
+    for (int i = 0; i < entry->image_count; i++)
+    {
+        memcpy(p, &images[i].offset, 8);
+        memcpy(p + 8, &images[i].size, 8);
+        memcpy(p + 16, &images[i].hash, 8);
+        u32 = (uint32_t)images[i].format;
+        memcpy(p + 24, &u32, 4);
+        u32 = (uint32_t)images[i].output_len;
+        memcpy(p + 28, &u32, 4);
+        memcpy(p + 32, &images[i].check, 4);
+        memcpy(p + CACHE_IMAGE_HEADER_SIZE, images[i].output, images[i].output_len);
+        p += CACHE_IMAGE_HEADER_SIZE + align8(images[i].output_len);
+    }
+
+    unsigned long long checksum = cache_checksum(record + 16, size - 16);
+    memcpy(record + 8, &checksum, 8);
+
+    // one locked append per record keeps concurrent writers from interleaving
+    LARGE_INTEGER zero;
+    zero.QuadPart = 0;
+    int ok = cache_lock(cache->file);
+    if (ok)
+    {
+        ok = SetFilePointerEx(cache->file, zero, NULL, FILE_END) && write_all(cache->file, record, size);
+        cache_unlock(cache->file);
+    }
+
+    free(record);
+    return ok;
+}
+
+int cache_compact(TOOL_CACHE* cache)
+{
+    size_t path_len = wcslen(cache->path);
+    wchar_t* temp_path = (wchar_t*)malloc((path_len + 5) * sizeof(wchar_t));
+    if (!temp_path)
+        return 0;
+    wmemcpy(temp_path, cache->path, path_len);
+    wmemcpy(temp_path + path_len, L".tmp", 5);
+
+    // the writer lock is held throughout, so records appended by this process or another one
+    // since the cache was opened are picked up by mapping the file again and none get lost
+    if (!cache_lock(cache->file))
+    {
+        free(temp_path);
+        return 0;
+    }
+
+    int ok = cache_map(cache);
+    if (!ok || !cache->view || cache->live_count == cache->record_count)
+    {
+        cache_unlock(cache->file);
+        free(temp_path);
+        return ok;
+    }
+
+    HANDLE temp = CreateFileW(temp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    ok = temp != INVALID_HANDLE_VALUE && write_all(temp, cache->view, CACHE_HEADER_SIZE);
+
+    // keep the live records in log order
+    size_t offset = CACHE_HEADER_SIZE;
+    while (ok && offset + CACHE_RECORD_HEADER_SIZE <= cache->view_size)
+    {
+        size_t size = cache_record_size(cache->view, cache->view_size, offset);
+        if (size == 0)
+        {
+            offset += 8;
+            continue;
+        }
+
+        const uint8_t* record = cache->view + offset;
+        size_t key_len = load_u32(record + 40);
+        if (CACHE_RECORD_HEADER_SIZE + key_len <= size &&
+            *cache_find_slot(cache, (const char*)record + CACHE_RECORD_HEADER_SIZE, key_len) == offset)
+            ok = write_all(temp, record, size);
+        offset += size;
+    }
+    if (temp != INVALID_HANDLE_VALUE)
+        CloseHandle(temp);
+
+    // a mapped file cannot be replaced, the cache is only good for cache_close afterwards
+    cache_unmap(cache);
+    ok = ok && MoveFileExW(temp_path, cache->path, MOVEFILE_REPLACE_EXISTING);
+    cache_unlock(cache->file);
+    if (!ok)
+        DeleteFileW(temp_path);
+
+    free(temp_path);
+    return ok;
+}
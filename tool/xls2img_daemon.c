@@ -0,0 +1,895 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Extraction daemon
+ *
+ * Listens on a Unix domain socket and serves one request per connection with a fixed pool of
+ * worker threads. Requests are a single UTF-8 line:
+ *
+ *   EXTRACT [format=png|jpg] [index=N] [payload=inline|path|none|shared] [pid=N] <path>
+ *   HANDLE  [format=png|jpg] [index=N] [payload=inline|path|none|shared] [pid=N] <handle>
+ *   STATS
+ *
+ * The client process is the peer of the connection (SIO_AF_UNIX_GETPEERPID); a pid= that names
+ * another process is rejected. HANDLE takes a handle value in the client process: the daemon
+ * duplicates it from there with read access, requires it to be a disk file, reads the workbook
+ * through its own copy and closes that. Handles in the daemon's process are never taken on trust.
+ * An unknown format= or payload=, or an index= that is not a number from 1, is rejected before the
+ * file is read. With format= only images of that format are extracted, and index= and the IMAGE
+ * indexes count those.
+ *
+ * Extraction responses start with "OK <count> <workbook_size>\n", the size being 0 for an XLSX
+ * package or a Word or PowerPoint file, followed by one "IMAGE <index> <format> <offset> <size>[ <path>]\n" line per image.
+ * With payload=inline the line is followed by <size> raw bytes, with payload=path the image was
+ * written below the daemon's output directory. The response ends with "END\n". Failures are
+ * reported as "ERR <message>\n", and "ERR busy\n" is returned immediately when the queue is full.
+ *
+ * payload=shared writes all images into one pagefile-backed section, laid out as an
+ * XLS2IMG_EXPORT_HEADER, the image files and the XLS2IMG_EXPORT_ENTRY table, and duplicates a
+ * read-only handle to it into process pid, the client. The response is "OK <count> 0\n",
+ * "SHARED <handle> <size>\nEND\n": the client maps <size> bytes with FILE_MAP_READ and closes the
+ * handle. Once the daemon has closed its own handle nobody can write to the section any more.
+ * index= does not apply to it and is rejected.
+ * With --timeout a request still extracting that long after it was accepted fails with
+ * "ERR Deadline passed\n". An extraction stops as soon as its client closes the connection, so
+ * clients must not shut down their sending side before reading the response.
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <xls2img.h>
+#include "xls2img_tool.h"
+
+#define DAEMON_DEFAULT_WORKERS 4
+#define DAEMON_DEFAULT_QUEUE 64
+#define DAEMON_MAX_REQUEST 4096
+// number of recent requests kept for the latency percentiles
+#define DAEMON_LATENCY_WINDOW 1024
+// address space reserved for a payload=shared section; its pages are committed as the images are written
+#define DAEMON_SHARED_RESERVE (SIZE_MAX > 0xFFFFFFFFu ? (size_t)(1ull << 34) : (size_t)1 << 28)
+
+typedef enum {
+    PAYLOAD_INLINE = 0,
+    PAYLOAD_PATH,
+    PAYLOAD_NONE,
+    PAYLOAD_SHARED,
+    PAYLOAD_INVALID,        /* payload= named no known mode */
+} PAYLOAD_MODE;
+
+typedef struct {
+    SOCKET client;
+    unsigned long long accepted_ns;
+} DAEMON_JOB;
+
+typedef struct {
+    SOCKET listener;
+    int worker_count;
+    int queue_capacity;
+    const wchar_t* output_dir;
+    XLS2IMG_LIMITS limits;
+    unsigned long long timeout_ns;  /* per request, from acceptance; 0 for none */
+    volatile LONG stopping;
+    volatile LONG next_request_id;
+
+    // everything below is protected by lock
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE job_ready;
+    DAEMON_JOB* queue;
+    int queue_head;
+    int queue_count;
+    int active;
+    unsigned long long accepted;
+    unsigned long long completed;
+    unsigned long long failed;
+    unsigned long long rejected;
+    unsigned long long latency_ns[DAEMON_LATENCY_WINDOW];
+    size_t latency_count;
+    size_t latency_next;
+} DAEMON;
+
+// Per-worker state kept warm between requests
+typedef struct {
+    DAEMON* daemon;
+    HANDLE thread;
+    unsigned char* buffer;  /* workbook file buffer, grown to the largest file seen */
+    size_t capacity;
+    XLS2IMG_SESSION* session;   /* reader, workbook and result buffers of the previous requests */
+} DAEMON_WORKER;
+
+// Cancellation of one extraction, polled by the library while it reads the file
+typedef struct {
+    SOCKET client;
+    XLS2IMG_CONTROL control;
+} DAEMON_REQUEST;
+
+typedef struct {
+    XLS2IMG_FORMAT format;  /* XLS2IMG_UNKNOWN for all formats */
+    int format_error;       /* format= named no built-in format */
+    int index;              /* 0 for all images, -1 if index= is not a number from 1 */
+    PAYLOAD_MODE payload;
+    DWORD pid;              /* client process, the peer of the connection */
+} DAEMON_FILTER;
+
+// Section a payload=shared export is written to, mapped once at its reserved size so the view never moves
+typedef struct {
+    HANDLE section;
+    unsigned char* view;
+    size_t reserved;
+} DAEMON_SHARED;
+
+static DAEMON* g_daemon = NULL;
+
+static int send_all(SOCKET s, const void* data, size_t size)
+{
+    const char* p = (const char*)data;
+    while (size > 0)
+    {
+        int chunk = size > 0x40000000 ? 0x40000000 : (int)size;
+        int sent = send(s, p, chunk, 0);
+        if (sent <= 0)
+            return 0;
+        p += sent;
+        size -= (size_t)sent;
+    }
+    return 1;
+}
+
+static int send_line(SOCKET s, const char* fmt, ...)
+{
+    char line[DAEMON_MAX_REQUEST];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    if (len < 0 || len >= (int)sizeof(line))
+        return 0;
+    return send_all(s, line, (size_t)len);
+}
+
+// Reports a failed request to the client; always returns 0.
+static int send_error(SOCKET s, const char* message)
+{
+    send_line(s, "ERR %s\n", message);
+    return 0;
+}
+
+// Reads one '\n' terminated request line.
+static int recv_line(SOCKET s, char* line, size_t size)
+{
+    size_t len = 0;
+    while (len + 1 < size)
+    {
+        char c;
+        if (recv(s, &c, 1, 0) != 1)
+            return 0;
+        if (c == '\n')
+        {
+            if (len > 0 && line[len - 1] == '\r')
+                len--;
+            line[len] = '\0';
+            return 1;
+        }
+        line[len++] = c;
+    }
+    return 0;
+}
+
+static const char* format_name(XLS2IMG_FORMAT format)
+{
+    return xls2img_format_extension(format);
+}
+
+// Whether the len bytes at value are exactly name
+static int token_is(const char* value, size_t len, const char* name)
+{
+    return len == strlen(name) && strncmp(value, name, len) == 0;
+}
+
+// Maps an extension name back to its format; returns 0 if no built-in format uses it.
+// "bin", the extension of XLS2IMG_UNKNOWN, is not a format to filter by.
+static int format_from_name(const char* name, size_t len, XLS2IMG_FORMAT* format)
+{
+    unsigned int formats = xls2img_get_formats();
+    for (int f = XLS2IMG_PNG; f <= XLS2IMG_WMF; f++)
+    {
+        if ((formats & XLS2IMG_FORMAT_MASK(f)) && token_is(name, len, xls2img_format_extension((XLS2IMG_FORMAT)f)))
+        {
+            *format = (XLS2IMG_FORMAT)f;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Parses the len bytes at text as a whole decimal number from 1 to INT_MAX, -1 if they are anything else
+static int parse_index(const char* text, size_t len)
+{
+    if (len == 0 || text[0] < '0' || text[0] > '9')
+        return -1;
+
+    char* end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (end != text + len || errno == ERANGE || value < 1 || value > INT_MAX)
+        return -1;
+    return (int)value;
+}
+
+// Grows the worker buffer; the old contents are not preserved.
+static int worker_reserve(DAEMON_WORKER* worker, size_t size)
+{
+    if (size <= worker->capacity)
+        return 1;
+
+    free(worker->buffer);
+    worker->buffer = (unsigned char*)malloc(size);
+    worker->capacity = worker->buffer ? size : 0;
+    return worker->buffer != NULL;
+}
+
+static int worker_read_handle(DAEMON_WORKER* worker, HANDLE file, size_t* size)
+{
+    LARGE_INTEGER file_size, zero;
+    zero.QuadPart = 0;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0 ||
+        !SetFilePointerEx(file, zero, NULL, FILE_BEGIN))
+        return 0;
+    if (!worker_reserve(worker, (size_t)file_size.QuadPart))
+        return 0;
+
+    size_t len = 0;
+    while (len < (size_t)file_size.QuadPart)
+    {
+        size_t want = (size_t)file_size.QuadPart - len;
+        DWORD got = 0;
+        if (!ReadFile(file, worker->buffer + len, want > 0x40000000 ? 0x40000000 : (DWORD)want, &got, NULL) || got == 0)
+            return 0;
+        len += got;
+    }
+
+    *size = len;
+    return 1;
+}
+
+static void daemon_record(DAEMON* daemon, unsigned long long accepted_ns, int ok)
+{
+    unsigned long long latency = now_ns() - accepted_ns;
+
+    EnterCriticalSection(&daemon->lock);
+    daemon->latency_ns[daemon->latency_next] = latency;
+    daemon->latency_next = (daemon->latency_next + 1) % DAEMON_LATENCY_WINDOW;
+    if (daemon->latency_count < DAEMON_LATENCY_WINDOW)
+        daemon->latency_count++;
+    if (ok)
+        daemon->completed++;
+    else
+        daemon->failed++;
+    LeaveCriticalSection(&daemon->lock);
+}
+
+static int compare_u64(const void* a, const void* b)
+{
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int daemon_send_stats(DAEMON* daemon, SOCKET client)
+{
+    unsigned long long sorted[DAEMON_LATENCY_WINDOW];
+
+    EnterCriticalSection(&daemon->lock);
+    size_t n = daemon->latency_count;
+    memcpy(sorted, daemon->latency_ns, n * sizeof(sorted[0]));
+    int queued = daemon->queue_count;
+    int active = daemon->active;
+    unsigned long long accepted = daemon->accepted;
+    unsigned long long completed = daemon->completed;
+    unsigned long long failed = daemon->failed;
+    unsigned long long rejected = daemon->rejected;
+    LeaveCriticalSection(&daemon->lock);
+
+    qsort(sorted, n, sizeof(sorted[0]), compare_u64);
+    unsigned long long p50 = n ? sorted[(n - 1) * 50 / 100] : 0;
+    unsigned long long p90 = n ? sorted[(n - 1) * 90 / 100] : 0;
+    unsigned long long p99 = n ? sorted[(n - 1) * 99 / 100] : 0;
+    unsigned long long max = n ? sorted[n - 1] : 0;
+
+    return send_line(client,
+        "{\"pid\":%lu,\"workers\":%d,\"active\":%d,\"queue_depth\":%d,\"queue_capacity\":%d,"
+        "\"accepted\":%llu,\"completed\":%llu,\"failed\":%llu,\"rejected\":%llu,"
+        "\"latency_samples\":%llu,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}\n",
+        (unsigned long)GetCurrentProcessId(), daemon->worker_count, active, queued, daemon->queue_capacity,
+        accepted, completed, failed, rejected, (unsigned long long)n, p50, p90, p99, max);
+}
+
+// Parses "key=value" filter tokens; returns the remainder of the line (path or handle).
+static char* parse_filters(char* args, DAEMON_FILTER* filter)
+{
+    filter->format = XLS2IMG_UNKNOWN;
+    filter->format_error = 0;
+    filter->index = 0;
+    filter->payload = PAYLOAD_INLINE;
+    filter->pid = 0;
+
+    while (*args)
+    {
+        while (*args == ' ')
+            args++;
+
+        char* end = strchr(args, ' ');
+        size_t len = end ? (size_t)(end - args) : strlen(args);
+
+        if (len > 7 && strncmp(args, "format=", 7) == 0)
+            filter->format_error = !format_from_name(args + 7, len - 7, &filter->format);
+        else if (len > 6 && strncmp(args, "index=", 6) == 0)
+            filter->index = parse_index(args + 6, len - 6);
+        else if (len > 8 && strncmp(args, "payload=", 8) == 0)
+            filter->payload = token_is(args + 8, len - 8, "inline") ? PAYLOAD_INLINE :
+                token_is(args + 8, len - 8, "path") ? PAYLOAD_PATH :
+                token_is(args + 8, len - 8, "none") ? PAYLOAD_NONE :
+                token_is(args + 8, len - 8, "shared") ? PAYLOAD_SHARED : PAYLOAD_INVALID;
+        else if (len > 4 && strncmp(args, "pid=", 4) == 0)
+            filter->pid = strtoul(args + 4, NULL, 10);
+        else
+            break;
+
+        args += len;
+    }
+    return args;
+}
+
+// Process on the other end of a Unix domain socket connection, 0 if it cannot be determined
+static DWORD client_pid(SOCKET client)
+{
+    DWORD pid = 0;
+    DWORD returned = 0;
+    if (WSAIoctl(client, SIO_AF_UNIX_GETPEERPID, NULL, 0, &pid, sizeof(pid), &returned, NULL, NULL) == SOCKET_ERROR)
+        return 0;
+    return pid;
+}
+
+// Rejects a request before any file is read; replaces the pid= the client claims with the peer's.
+// Returns the error message, NULL if the filters are usable.
+static const char* check_filters(SOCKET client, DAEMON_FILTER* filter)
+{
+    if (filter->format_error)
+        return "unknown format";
+    if (filter->index < 0)
+        return "invalid index";
+    if (filter->payload == PAYLOAD_INVALID)
+        return "unknown payload";
+    if (filter->payload == PAYLOAD_SHARED && filter->index != 0)
+        return "index= does not apply to payload=shared";
+
+    DWORD peer = client_pid(client);
+    if (filter->pid != 0 && filter->pid != peer)
+        return "pid= is not the connected process";
+    filter->pid = peer;
+    return NULL;
+}
+
+// Formats are selected by the extraction, so only index= is left to filter
+static int filter_accepts(const DAEMON_FILTER* filter, int index)
+{
+    return filter->index == 0 || filter->index == index;
+}
+
+// Duplicates a handle of the client process into this one and checks it is a file on disk.
+// The returned handle is the daemon's own copy; INVALID_HANDLE_VALUE on failure.
+static HANDLE client_file(DWORD pid, HANDLE remote)
+{
+    HANDLE process = pid ? OpenProcess(PROCESS_DUP_HANDLE, FALSE, pid) : NULL;
+    if (!process)
+        return INVALID_HANDLE_VALUE;
+
+    HANDLE file = NULL;
+    if (!DuplicateHandle(process, remote, GetCurrentProcess(), &file, FILE_GENERIC_READ, FALSE, 0))
+        file = NULL;
+    CloseHandle(process);
+    if (!file)
+        return INVALID_HANDLE_VALUE;
+
+    if (GetFileType(file) != FILE_TYPE_DISK)
+    {
+        CloseHandle(file);
+        return INVALID_HANDLE_VALUE;
+    }
+    return file;
+}
+
+// Runs at each poll of the library: a client that closed its end no longer waits for the images
+static void daemon_progress(uint64_t done, uint64_t total, void* user)
+{
+    DAEMON_REQUEST* request = (DAEMON_REQUEST*)user;
+    (void)done;
+    (void)total;
+
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(request->client, &readable);
+    struct timeval poll = { 0, 0 };
+    char c;
+    if (select(0, &readable, NULL, NULL, &poll) == 1 && recv(request->client, &c, 1, MSG_PEEK) <= 0)
+        xls2img_cancel(&request->control);
+}
+
+// Commits the pages of the section the export grows into
+static void* shared_grow(void* base, size_t size, void* user)
+{
+    DAEMON_SHARED* shared = (DAEMON_SHARED*)user;
+    (void)base;
+    if (size > shared->reserved || !VirtualAlloc(shared->view, size, MEM_COMMIT, PAGE_READWRITE))
+        return NULL;
+    return shared->view;
+}
+
+// Writes the images straight into a new section and hands a read-only handle to it to the client process
+static int daemon_send_shared(SOCKET client, const XLS2IMG_READER* reader, const DAEMON_FILTER* filter,
+    const XLS2IMG_EXTRACT_OPTIONS* options)
+{
+    if (filter->pid == 0)
+        return send_error(client, "cannot identify client process");
+
+    HANDLE process = OpenProcess(PROCESS_DUP_HANDLE, FALSE, filter->pid);
+    if (!process)
+        return send_error(client, "cannot open client process");
+
+    DAEMON_SHARED shared;
+    shared.reserved = DAEMON_SHARED_RESERVE;
+    shared.view = NULL;
+    shared.section = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE | SEC_RESERVE,
+        (DWORD)((unsigned long long)shared.reserved >> 32), (DWORD)shared.reserved, NULL);
+    if (shared.section)
+        shared.view = (unsigned char*)MapViewOfFile(shared.section, FILE_MAP_WRITE, 0, 0, shared.reserved);
+    if (!shared.view)
+    {
+        if (shared.section)
+            CloseHandle(shared.section);
+        CloseHandle(process);
+        return send_error(client, "cannot create shared memory");
+    }
+
+    void* data = NULL;
+    size_t size = 0;
+    int ret = xls2img_export_images(reader, shared_grow, &shared, &data, &size, options);
+    int count = ret == XLS2IMG_SUCCESS ? (int)((const XLS2IMG_EXPORT_HEADER*)data)->count : 0;
+    UnmapViewOfFile(shared.view);
+
+    // the client's handle only grants FILE_MAP_READ, and ours is closed below
+    HANDLE remote = NULL;
+    if (ret == XLS2IMG_SUCCESS &&
+        !DuplicateHandle(GetCurrentProcess(), shared.section, process, &remote, FILE_MAP_READ, FALSE, 0))
+        remote = NULL;
+    CloseHandle(shared.section);
+    CloseHandle(process);
+    if (ret != XLS2IMG_SUCCESS)
+        return send_error(client, xls2img_strerror(ret));
+    if (!remote)
+        return send_error(client, "cannot duplicate handle");
+
+    return send_line(client, "OK %d 0\nSHARED %llu %llu\nEND\n", count, (unsigned long long)(ULONG_PTR)remote,
+        (unsigned long long)size);
+}
+
+static int daemon_send_images(DAEMON_WORKER* worker, const DAEMON_JOB* job, const DAEMON_FILTER* filter, size_t file_size)
+{
+    DAEMON* daemon = worker->daemon;
+    SOCKET client = job->client;
+
+    DAEMON_REQUEST request;
+    memset(&request, 0, sizeof(request));
+    request.client = client;
+    request.control.progress = daemon_progress;
+    request.control.user = &request;
+    if (daemon->timeout_ns)
+    {
+        // the deadline counts the time the request waited in the queue, on the library's clock
+        unsigned long long elapsed = now_ns() - job->accepted_ns;
+        request.control.deadline_ns = xls2img_clock_ns() + (elapsed < daemon->timeout_ns ? daemon->timeout_ns - elapsed : 0);
+    }
+
+    XLS2IMG_READER* reader = NULL;
+    int ret = xls2img_session_open(worker->session, &reader, worker->buffer, file_size);
+    if (ret != XLS2IMG_SUCCESS)
+        return send_error(client, xls2img_strerror(ret));
+    xls2img_set_limits(reader, &daemon->limits);
+    xls2img_set_control(reader, &request.control);
+
+    XLS2IMG_EXTRACT_OPTIONS extract_options;
+    memset(&extract_options, 0, sizeof(extract_options));
+    extract_options.limits = &daemon->limits;
+    extract_options.control = &request.control;
+    extract_options.allocator = xls2img_session_allocator(worker->session);
+    if (filter->format != XLS2IMG_UNKNOWN)
+        extract_options.formats = XLS2IMG_FORMAT_MASK(filter->format);
+
+    // the section is filled straight from the file, without a workbook copy or result buffers
+    if (filter->payload == PAYLOAD_SHARED)
+    {
+        int ok = daemon_send_shared(client, reader, filter, &extract_options);
+        xls2img_close(reader);
+        return ok;
+    }
+
+    // only an XLS file has a workbook stream, the pictures of the other containers are read straight from them
+    void* workbook_data = NULL;
+    size_t workbook_size = 0;
+    int package = xls2img_get_container(reader) != XLS2IMG_CONTAINER_CFB;
+    if (!package)
+        ret = xls2img_get_workbook(reader, &workbook_data, &workbook_size);
+    if (ret != XLS2IMG_SUCCESS)
+    {
+        xls2img_close(reader);
+        return send_error(client, xls2img_strerror(ret));
+    }
+
+    XLS2IMG_RESULT images = { NULL, 0 };
+    if (package)
+        ret = xls2img_read_images(reader, &images, &extract_options);
+    else
+        ret = xls2img_extract_images_ex(workbook_data, workbook_size, &images, &extract_options);
+    if (ret < 0 && ret != XLS2IMG_ERROR_NO_IMAGES)
+    {
+        xls2img_free_workbook_data(workbook_data);
+        xls2img_close(reader);
+        return send_error(client, xls2img_strerror(ret));
+    }
+
+    int selected = 0;
+    for (int i = 0; i < images.count; i++)
+        if (filter_accepts(filter, i + 1))
+            selected++;
+
+    long request_id = InterlockedIncrement(&daemon->next_request_id);
+    int ok = send_line(client, "OK %d %llu\n", selected, (unsigned long long)workbook_size);
+
+    for (int i = 0; ok && i < images.count; i++)
+    {
+        const XLS2IMG_IMAGE* img = &images.images[i];
+        if (!filter_accepts(filter, i + 1))
+            continue;
+
+        if (filter->payload == PAYLOAD_PATH)
+        {
+            wchar_t w_path[MAX_PATH];
+            char path[MAX_PATH * 3];
+            swprintf_s(w_path, MAX_PATH, L"%ls%ld_image_%d.%hs", daemon->output_dir, request_id, i + 1, format_name(img->format));
+
+            HANDLE file = CreateFileW(w_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            int saved = file != INVALID_HANDLE_VALUE && write_all(file, img->data, img->size);
+            if (file != INVALID_HANDLE_VALUE)
+                CloseHandle(file);
+
+            if (!saved || WideCharToMultiByte(CP_UTF8, 0, w_path, -1, path, (int)sizeof(path), NULL, NULL) <= 0)
+            {
+                ok = send_error(client, "cannot write image");
+                break;
+            }
+            ok = send_line(client, "IMAGE %d %s %llu %llu %s\n", i + 1, format_name(img->format),
+                (unsigned long long)img->offset, (unsigned long long)img->size, path);
+        }
+        else
+        {
+            ok = send_line(client, "IMAGE %d %s %llu %llu\n", i + 1, format_name(img->format),
+                (unsigned long long)img->offset, (unsigned long long)img->size);
+            if (ok && filter->payload == PAYLOAD_INLINE)
+                ok = send_all(client, img->data, img->size);
+        }
+    }
+    if (ok)
+        ok = send_line(client, "END\n");
+
+    xls2img_free_result(&images);
+    xls2img_free_workbook_data(workbook_data);
+    xls2img_close(reader);
+    return ok;
+}
+
+static int daemon_serve(DAEMON_WORKER* worker, const DAEMON_JOB* job)
+{
+    SOCKET client = job->client;
+    char line[DAEMON_MAX_REQUEST];
+    if (!recv_line(client, line, sizeof(line)))
+        return send_error(client, "malformed request");
+
+    if (strcmp(line, "STATS") == 0)
+        return daemon_send_stats(worker->daemon, client);
+
+    DAEMON_FILTER filter;
+    size_t file_size = 0;
+    const char* error;
+
+    if (strncmp(line, "EXTRACT ", 8) == 0)
+    {
+        char* path = parse_filters(line + 8, &filter);
+        if ((error = check_filters(client, &filter)) != NULL)
+            return send_error(client, error);
+
+        wchar_t w_path[MAX_PATH];
+        if (MultiByteToWideChar(CP_UTF8, 0, path, -1, w_path, MAX_PATH) <= 0)
+            return send_error(client, "invalid path");
+
+        HANDLE file = CreateFileW(w_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return send_error(client, "cannot open file");
+
+        int ok = worker_read_handle(worker, file, &file_size);
+        CloseHandle(file);
+        if (!ok)
+            return send_error(client, "cannot read file");
+    }
+    else if (strncmp(line, "HANDLE ", 7) == 0)
+    {
+        char* value = parse_filters(line + 7, &filter);
+        if ((error = check_filters(client, &filter)) != NULL)
+            return send_error(client, error);
+
+        HANDLE remote = (HANDLE)(ULONG_PTR)_strtoui64(value, NULL, 0);
+        if (remote == NULL || remote == INVALID_HANDLE_VALUE)
+            return send_error(client, "invalid handle");
+
+        // only a copy the daemon made from the client's handle is read and closed
+        HANDLE file = client_file(filter.pid, remote);
+        if (file == INVALID_HANDLE_VALUE)
+            return send_error(client, "invalid handle");
+
+        int ok = worker_read_handle(worker, file, &file_size);
+        CloseHandle(file);
+        if (!ok)
+            return send_error(client, "cannot read handle");
+    }
+    else
+        return send_error(client, "unknown request");
+
+    return daemon_send_images(worker, job, &filter, file_size);
+}
+
+static DWORD WINAPI daemon_worker_main(LPVOID param)
+{
+    DAEMON_WORKER* worker = (DAEMON_WORKER*)param;
+    DAEMON* daemon = worker->daemon;
+
+    for (;;)
+    {
+        EnterCriticalSection(&daemon->lock);
+        while (daemon->queue_count == 0 && !daemon->stopping)
+            SleepConditionVariableCS(&daemon->job_ready, &daemon->lock, INFINITE);
+
+        if (daemon->queue_count == 0)
+        {
+            LeaveCriticalSection(&daemon->lock);
+            break;
+        }
+
+        DAEMON_JOB job = daemon->queue[daemon->queue_head];
+        daemon->queue_head = (daemon->queue_head + 1) % daemon->queue_capacity;
+        daemon->queue_count--;
+        daemon->active++;
+        LeaveCriticalSection(&daemon->lock);
+
+        int ok = daemon_serve(worker, &job);
+        shutdown(job.client, SD_BOTH);
+        closesocket(job.client);
+
+        EnterCriticalSection(&daemon->lock);
+        daemon->active--;
+        LeaveCriticalSection(&daemon->lock);
+        daemon_record(daemon, job.accepted_ns, ok);
+    }
+    return 0;
+}
+
+// Closes the listening socket once, whether the control handler or daemon_main gets there first
+static void daemon_close_listener(DAEMON* daemon)
+{
+    SOCKET listener = (SOCKET)InterlockedExchangePointer((PVOID volatile*)&daemon->listener, (PVOID)INVALID_SOCKET);
+    if (listener != INVALID_SOCKET)
+        closesocket(listener);
+}
+
+static BOOL WINAPI daemon_ctrl_handler(DWORD type)
+{
+    (void)type;
+    if (g_daemon)
+    {
+        InterlockedExchange(&g_daemon->stopping, 1);
+        // unblocks accept() in the main thread
+        daemon_close_listener(g_daemon);
+    }
+    return TRUE;
+}
+
+int daemon_main(int argc, wchar_t* argv[])
+{
+    if (argc < 3)
+    {
+        fwprintf(stderr, L"Usage: \n./xls2img_tool.exe --daemon <socket> [--workers N] [--queue N] [--output dir] [--timeout ms] [--max-* n]\n");
+        return -1;
+    }
+
+    DAEMON daemon;
+    memset(&daemon, 0, sizeof(daemon));
+    daemon.worker_count = DAEMON_DEFAULT_WORKERS;
+    daemon.queue_capacity = DAEMON_DEFAULT_QUEUE;
+    daemon.output_dir = L"./";
+
+    const wchar_t* socket_path = argv[2];
+    for (int i = 3; i + 1 < argc; i += 2)
+    {
+        if (wcscmp(argv[i], L"--workers") == 0)
+            daemon.worker_count = _wtoi(argv[i + 1]);
+        else if (wcscmp(argv[i], L"--queue") == 0)
+            daemon.queue_capacity = _wtoi(argv[i + 1]);
+        else if (wcscmp(argv[i], L"--output") == 0)
+            daemon.output_dir = argv[i + 1];
+        else if (wcscmp(argv[i], L"--timeout") == 0)
+            daemon.timeout_ns = _wcstoui64(argv[i + 1], NULL, 10) * 1000000ull;
+        else if (!parse_limit_option(argv[i], argv[i + 1], &daemon.limits))
+        {
+            fwprintf(stderr, L"Unknown option: %ls\n", argv[i]);
+            return -1;
+        }
+    }
+    if (daemon.worker_count < 1 || daemon.queue_capacity < 1)
+    {
+        fwprintf(stderr, L"Error: --workers and --queue must be positive\n");
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (WideCharToMultiByte(CP_UTF8, 0, socket_path, -1, addr.sun_path, (int)sizeof(addr.sun_path), NULL, NULL) <= 0)
+    {
+        fwprintf(stderr, L"Error: Socket path is too long: %ls\n", socket_path);
+        return -1;
+    }
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+    {
+        fwprintf(stderr, L"Error: WSAStartup failed\n");
+        return -1;
+    }
+
+    // a stale socket file from a previous run makes bind fail
+    DeleteFileW(socket_path);
+    daemon.listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (daemon.listener == INVALID_SOCKET ||
+        bind(daemon.listener, (const struct sockaddr*)&addr, (int)sizeof(addr)) == SOCKET_ERROR ||
+        listen(daemon.listener, SOMAXCONN) == SOCKET_ERROR)
+    {
+        fwprintf(stderr, L"Error: Cannot listen on %ls (%d)\n", socket_path, WSAGetLastError());
+        if (daemon.listener != INVALID_SOCKET)
+            closesocket(daemon.listener);
+        WSACleanup();
+        return -1;
+    }
+
+    daemon.queue = (DAEMON_JOB*)malloc(daemon.queue_capacity * sizeof(DAEMON_JOB));
+    DAEMON_WORKER* workers = (DAEMON_WORKER*)calloc(daemon.worker_count, sizeof(DAEMON_WORKER));
+    if (!daemon.queue || !workers)
+    {
+        fwprintf(stderr, L"Error: Memory allocation failed\n");
+        free(daemon.queue);
+        free(workers);
+        closesocket(daemon.listener);
+        WSACleanup();
+        return -1;
+    }
+
+    InitializeCriticalSection(&daemon.lock);
+    InitializeConditionVariable(&daemon.job_ready);
+    g_daemon = &daemon;
+    SetConsoleCtrlHandler(daemon_ctrl_handler, TRUE);
+
+    int started = 0;
+    for (; started < daemon.worker_count; started++)
+    {
+        workers[started].daemon = &daemon;
+        if (xls2img_session_create(&workers[started].session, NULL, 0) != XLS2IMG_SUCCESS)
+            break;
+        workers[started].thread = CreateThread(NULL, 0, daemon_worker_main, &workers[started], 0, NULL);
+        if (!workers[started].thread)
+        {
+            xls2img_session_destroy(workers[started].session);
+            break;
+        }
+    }
+
+    if (started > 0)
+        fwprintf(stderr, L"Listening on %ls with %d workers (pid %lu)\n", socket_path, started, (unsigned long)GetCurrentProcessId());
+    else
+        fwprintf(stderr, L"Error: Cannot start workers\n");
+
+    while (!daemon.stopping && started > 0)
+    {
+        SOCKET client = accept(daemon.listener, NULL, NULL);
+        if (client == INVALID_SOCKET)
+        {
+            if (daemon.stopping)
+                break;
+            continue;
+        }
+
+        DAEMON_JOB job = { client, now_ns() };
+        EnterCriticalSection(&daemon.lock);
+        daemon.accepted++;
+        int queued = daemon.queue_count < daemon.queue_capacity;
+        if (queued)
+        {
+            daemon.queue[(daemon.queue_head + daemon.queue_count) % daemon.queue_capacity] = job;
+            daemon.queue_count++;
+            WakeConditionVariable(&daemon.job_ready);
+        }
+        else
+            daemon.rejected++;
+        LeaveCriticalSection(&daemon.lock);
+
+        // backpressure: tell the client to retry instead of queueing without bound
+        if (!queued)
+        {
+            send_line(client, "ERR busy\n");
+            closesocket(client);
+        }
+    }
+
+    EnterCriticalSection(&daemon.lock);
+    InterlockedExchange(&daemon.stopping, 1);
+    WakeAllConditionVariable(&daemon.job_ready);
+    LeaveCriticalSection(&daemon.lock);
+
+    for (int i = 0; i < started; i++)
+    {
+        WaitForSingleObject(workers[i].thread, INFINITE);
+        CloseHandle(workers[i].thread);
+        free(workers[i].buffer);
+        xls2img_session_destroy(workers[i].session);
+    }
+
+    SetConsoleCtrlHandler(daemon_ctrl_handler, FALSE);
+    g_daemon = NULL;
+    daemon_close_listener(&daemon);
+    DeleteCriticalSection(&daemon.lock);
+    free(daemon.queue);
+    free(workers);
+    DeleteFileW(socket_path);
+    WSACleanup();
+    return started > 0 ? 0 : -1;
+}
\ No newline at end of file
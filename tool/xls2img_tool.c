@@ -25,16 +25,110 @@
  */
 
 
+
 #define _CRT_SECURE_NO_WARNINGS
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <io.h>
 #include <fcntl.h>
 #include <wchar.h>
 #include <windows.h>
 #include <shellapi.h>
 #include <xls2img.h>
+#include "xls2img_tool.h"
+
+// ustar archives are made of 512-byte blocks
+#define TAR_BLOCK_SIZE 512
+// largest size that still fits the 11 octal digits of a ustar size field
+#define TAR_MAX_OCTAL_SIZE 077777777777ULL
+// frame header: uint64 size, uint32 format, uint32 image index (little endian)
+#define FRAME_HEADER_SIZE 16
+// format of the frame that starts each workbook: its index is the workbook number, its payload the UTF-8 input path
+#define FRAME_WORKBOOK 0xFFFFFFFFu
+// initial stdin buffer when the input length is unknown
+#define STDIN_INITIAL_CAPACITY (1 << 20)
+// images stored in more fragments than this are written from the extracted copy
+#define MAX_IMAGE_EXTENTS 64
+
+// Formats of the single-stream outputs
+typedef enum {
+    STREAM_NONE = 0,
+    STREAM_TAR,     /* ustar archive */
+    STREAM_FRAMES,  /* length-prefixed frames */
+} STREAM_FORMAT;
+
+typedef struct {
+    HANDLE handle;
+    int owns_handle;
+    STREAM_FORMAT format;
+    unsigned long long mtime;
+    unsigned int workbook;      /* number of the workbook being written, from 1 */
+} OUTPUT_STREAM;
+
+typedef struct {
+    const wchar_t* output_dir;  /* directory for image_N files */
+    const wchar_t* stream_path; /* archive or frame stream path, L"-" for stdout, NULL when writing loose files */
+    STREAM_FORMAT stream_format;
+    const wchar_t* manifest_path; /* NDJSON manifest path, L"-" for stdout, NULL when disabled */
+    int input_count;            /* number of workbooks given on the command line */
+    size_t size_hint;           /* expected stdin length, 0 if unknown */
+    FILE* log;                  /* progress messages, stderr when stdout carries a stream or manifest */
+    FILE* manifest;             /* open NDJSON manifest stream */
+    TOOL_CACHE* cache;          /* persistent cache of processed workbooks, NULL when disabled */
+    int cache_hash;             /* record content hashes so touched but unchanged files stay cached */
+    XLS2IMG_LIMITS limits;      /* work limits for each workbook, zero fields are unlimited */
+    unsigned int embedded_depth; /* levels of embedded objects to search, 0 for none */
+    int write_index;            /* write an .x2i sidecar index next to each workbook */
+    int image_number;           /* extract only this image (from 1) through the sidecar index, 0 for all */
+    int verify;                 /* check PNG chunk CRCs and JPEG marker segments and report invalid images */
+    int large;                  /* write each image as it is found instead of collecting them all first */
+} TOOL_OPTIONS;
+
+// Per-workbook measurements reported in the manifest
+typedef struct {
+    const char* error;          /* NULL when the workbook was processed */
+    int cached;                 /* skipped because the cache was up to date */
+    size_t bytes_read;
+    size_t workbook_size;
+    int image_count;
+    int direct_images;          /* images written straight from the mapped source file */
+    int invalid_images;         /* images that failed --verify */
+    unsigned long long read_ns;     /* reading or mapping the file */
+    unsigned long long open_ns;     /* xls2img_open */
+    unsigned long long workbook_ns; /* xls2img_get_workbook */
+    unsigned long long extract_ns;  /* xls2img_extract_images: BIFF walk and carving */
+    unsigned long long write_ns;    /* writing image files or archive members */
+} FILE_REPORT;
+
+unsigned long long now_ns(void)
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    // split to avoid overflowing 64 bits on machines with a long uptime
+    unsigned long long ticks = (unsigned long long)counter.QuadPart;
+    unsigned long long freq = (unsigned long long)frequency.QuadPart;
+    return ticks / freq * 1000000000ULL + ticks % freq * 1000000000ULL / freq;
+}
+
+// 64-bit FNV-1a over the image payload
+static unsigned long long hash_fnv1a64(const void* data, size_t size)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    unsigned long long hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
 
 static int read_file(const wchar_t* filepath, unsigned char** buffer, size_t* size)
 {
@@ -45,18 +139,19 @@ static int read_file(const wchar_t* filepath, unsigned char** buffer, size_t* si
         return 0;
     }
 
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    // ftell's long is 32 bits on Windows, so a workbook over 2 GiB needs the 64-bit variants
+    _fseeki64(fp, 0, SEEK_END);
+    long long file_size = _ftelli64(fp);
+    _fseeki64(fp, 0, SEEK_SET);
 
-    if (file_size <= 0)
+    if (file_size <= 0 || (unsigned long long)file_size > SIZE_MAX)
     {
         fclose(fp);
         fwprintf(stderr, L"Error: File size is zero or invalid\n");
         return 0;
     }
 
-    *buffer = (unsigned char*)malloc(file_size);
+    *buffer = (unsigned char*)malloc((size_t)file_size);
     if (!*buffer)
     {
         fclose(fp);
@@ -64,7 +159,7 @@ static int read_file(const wchar_t* filepath, unsigned char** buffer, size_t* si
         return 0;
     }
 
-    size_t bytes_read = fread(*buffer, 1, file_size, fp);
+    size_t bytes_read = fread(*buffer, 1, (size_t)file_size, fp);
     fclose(fp);
 
     if (bytes_read != (size_t)file_size)
@@ -79,6 +174,158 @@ static int read_file(const wchar_t* filepath, unsigned char** buffer, size_t* si
     return 1;
 }
 
+static void release_buffer(void* buffer, void* user)
+{
+    (void)user;
+    free(buffer);
+}
+
+// Maps the input read-only; the page cache then backs both parsing and the direct image writes.
+static int map_file(const wchar_t* filepath, unsigned char** buffer, size_t* size)
+{
+    HANDLE file = CreateFileW(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return 0;
+
+    LARGE_INTEGER file_size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 && (unsigned long long)file_size.QuadPart <= SIZE_MAX)
+        mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping)
+        return 0;
+
+    // the view keeps the mapping alive
+    *buffer = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!*buffer)
+        return 0;
+
+    *size = (size_t)file_size.QuadPart;
+    return 1;
+}
+
+static void release_view(void* buffer, void* user)
+{
+    (void)user;
+    UnmapViewOfFile(buffer);
+}
+
+// Reads the whole of stdin. The buffer is allocated once when the length is known
+// (redirected file or size hint) and grows geometrically otherwise.
+static int read_stdin(unsigned char** buffer, size_t* size, size_t size_hint)
+{
+    HANDLE handle = GetStdHandle(STD_INPUT_HANDLE);
+    size_t capacity = size_hint;
+
+    if (GetFileType(handle) == FILE_TYPE_DISK)
+    {
+        LARGE_INTEGER file_size, position, zero;
+        zero.QuadPart = 0;
+        if (GetFileSizeEx(handle, &file_size) && SetFilePointerEx(handle, zero, &position, FILE_CURRENT) &&
+            file_size.QuadPart > position.QuadPart)
+            capacity = (size_t)(file_size.QuadPart - position.QuadPart);
+    }
+    if (capacity == 0)
+        capacity = STDIN_INITIAL_CAPACITY;
+
+    unsigned char* data = (unsigned char*)malloc(capacity);
+    if (!data)
+    {
+        fwprintf(stderr, L"Error: Memory allocation failed\n");
+        return 0;
+    }
+
+    size_t len = 0;
+    for (;;)
+    {
+        DWORD got = 0;
+        if (len == capacity)
+        {
+            // probe for EOF before growing so an exact-size buffer is never reallocated
+            unsigned char probe;
+            if (!ReadFile(handle, &probe, 1, &got, NULL) || got == 0)
+                break;
+
+            size_t new_capacity = capacity * 2;
+            unsigned char* new_data = (unsigned char*)realloc(data, new_capacity);
+            if (!new_data)
+            {
+                free(data);
+                fwprintf(stderr, L"Error: Memory allocation failed\n");
+                return 0;
+            }
+            data = new_data;
+            capacity = new_capacity;
+            data[len++] = probe;
+            continue;
+        }
+
+        size_t want = capacity - len;
+        if (want > 0x40000000)
+            want = 0x40000000;
+        if (!ReadFile(handle, data + len, (DWORD)want, &got, NULL))
+        {
+            // a closed pipe is the normal end of input
+            if (GetLastError() == ERROR_BROKEN_PIPE)
+                break;
+            free(data);
+            fwprintf(stderr, L"Error: Failed to read stdin\n");
+            return 0;
+        }
+        if (got == 0)
+            break;
+        len += got;
+    }
+
+    if (len == 0)
+    {
+        free(data);
+        fwprintf(stderr, L"Error: File size is zero or invalid\n");
+        return 0;
+    }
+
+    *buffer = data;
+    *size = len;
+    return 1;
+}
+
+// WriteFile takes a DWORD length, so large payloads are written in slices.
+int write_all(HANDLE handle, const void* data, size_t size)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    while (size > 0)
+    {
+        DWORD chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+        DWORD written = 0;
+        if (!WriteFile(handle, p, chunk, &written, NULL) || written == 0)
+            return 0;
+        p += written;
+        size -= written;
+    }
+    return 1;
+}
+
+int parse_limit_option(const wchar_t* name, const wchar_t* value, XLS2IMG_LIMITS* limits)
+{
+    uint64_t* field = NULL;
+    if (wcscmp(name, L"--max-sectors") == 0)
+        field = &limits->max_sectors;
+    else if (wcscmp(name, L"--max-bytes") == 0)
+        field = &limits->max_bytes;
+    else if (wcscmp(name, L"--max-records") == 0)
+        field = &limits->max_records;
+    else if (wcscmp(name, L"--max-images") == 0)
+        field = &limits->max_images;
+    else if (wcscmp(name, L"--max-output") == 0)
+        field = &limits->max_output_bytes;
+    else
+        return 0;
+
+    *field = (uint64_t)wcstoull(value, NULL, 10);
+    return 1;
+}
+
 // Updated save_image function using Windows API
 static int save_image(const wchar_t* filename, const void* data, size_t size)
 {
@@ -90,97 +337,1171 @@ static int save_image(const wchar_t* filename, const void* data, size_t size)
         return 0;
     }
 
-    DWORD written = 0;
-    BOOL result = WriteFile(hFile, data, (DWORD)size, &written, NULL);
+    int result = write_all(hFile, data, size);
     CloseHandle(hFile);
 
-    return (result && written == size);
+    return result;
 }
 
-int wmain(int argc, wchar_t* argv[])
+// Writes an image straight from the source file when it is stored contiguously in the workbook
+// stream, so its bytes go from the mapped file to the output without another copy. Returns 1 if
+// written, 0 on a write failure and -1 if the image has to be written from the extracted copy,
+// which is always the case for an image of an embedded object.
+static int save_image_direct(const wchar_t* filename, XLS2IMG_READER* reader, const unsigned char* file_buffer,
+    const XLS2IMG_IMAGE* img)
 {
-    _setmode(_fileno(stdout), _O_U16TEXT);
-    _setmode(_fileno(stderr), _O_U16TEXT);
+    XLS2IMG_EXTENT extents[MAX_IMAGE_EXTENTS];
+    if (img->span != img->size || img->path)
+        return -1;
+
+    int count = xls2img_get_workbook_extents(reader, img->offset, img->size, extents, MAX_IMAGE_EXTENTS);
+    if (count <= 0 || count > MAX_IMAGE_EXTENTS)
+        return -1;
+
+    HANDLE hFile = CreateFileW(filename, GENERIC_WRITE, 0, NULL,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        fwprintf(stderr, L"Error: Cannot create file %ls\n", filename);
+        return 0;
+    }
+
+    int result = 1;
+    for (int i = 0; i < count && result; i++)
+        result = write_all(hFile, file_buffer + extents[i].offset, extents[i].size);
+    CloseHandle(hFile);
+
+    return result;
+}
+
+// Writes value as a NUL terminated octal number filling the whole field.
+static int tar_format_octal(char* field, size_t width, unsigned long long value)
+{
+    field[width - 1] = '\0';
+    for (size_t i = width - 1; i > 0; i--)
+    {
+        field[i - 1] = (char)('0' + (value & 7));
+        value >>= 3;
+    }
+    return value == 0;
+}
+
+// Sizes beyond 8 GiB do not fit in octal and use the GNU base-256 encoding instead.
+static void tar_format_size(char* field, size_t width, unsigned long long value)
+{
+    if (value <= TAR_MAX_OCTAL_SIZE)
+    {
+        tar_format_octal(field, width, value);
+        return;
+    }
+
+    for (size_t i = width; i > 1; i--)
+    {
+        field[i - 1] = (char)(value & 0xFF);
+        value >>= 8;
+    }
+    field[0] = (char)0x80;
+}
+
+// Position of the '/' separating the ustar prefix (155) from the name (100), 0 if the name fits as is.
+static size_t tar_name_split(const char* name, size_t name_len)
+{
+    if (name_len <= 100)
+        return 0;
 
-    if (argc < 2)
+    size_t split = name_len - 101;
+    while (split < name_len && name[split] != '/')
+        split++;
+    return (split < name_len && split <= 155) ? split : (size_t)-1;
+}
+
+static int tar_write_header(OUTPUT_STREAM* tar, const char* name, size_t name_len, unsigned long long size, char typeflag)
+{
+    uint8_t block[TAR_BLOCK_SIZE];
+    char* hdr = (char*)block;
+    memset(block, 0, sizeof(block));
+
+    size_t split = tar_name_split(name, name_len);
+    if (split == 0)
+        memcpy(hdr, name, name_len < 100 ? name_len : 100);
+    else
+    {
+        memcpy(hdr + 345, name, split);
+        memcpy(hdr, name + split + 1, name_len - split - 1);
+    }
+
+    tar_format_octal(hdr + 100, 8, 0644);                   // mode
+    tar_format_octal(hdr + 108, 8, 0);                      // uid
+    tar_format_octal(hdr + 116, 8, 0);                      // gid
+    tar_format_size(hdr + 124, 12, size);                   // size
+    tar_format_octal(hdr + 136, 12, tar->mtime);            // mtime
+    hdr[156] = typeflag;
+    memcpy(hdr + 257, "ustar", 6);                          // magic
+    memcpy(hdr + 263, "00", 2);                             // version
+
+    // the checksum is computed with its own field filled with spaces
+    memset(hdr + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++)
+        checksum += block[i];
+    tar_format_octal(hdr + 148, 7, checksum);
+    hdr[155] = ' ';
+
+    return write_all(tar->handle, block, TAR_BLOCK_SIZE);
+}
+
+static int tar_write_padding(OUTPUT_STREAM* tar, unsigned long long size)
+{
+    static const uint8_t zeros[TAR_BLOCK_SIZE] = { 0 };
+    size_t rem = (size_t)(size % TAR_BLOCK_SIZE);
+    return rem == 0 || write_all(tar->handle, zeros, TAR_BLOCK_SIZE - rem);
+}
+
+// Appends one regular file; the payload is written directly from the caller's buffer.
+static int tar_add_file(OUTPUT_STREAM* tar, const char* name, const void* data, size_t size)
+{
+    size_t name_len = strlen(name);
+
+    if (tar_name_split(name, name_len) == (size_t)-1)
+    {
+        // name cannot be split into prefix/name, emit a GNU long name record first
+        if (!tar_write_header(tar, "././@LongLink", 13, name_len + 1, 'L') ||
+            !write_all(tar->handle, name, name_len + 1) ||
+            !tar_write_padding(tar, name_len + 1))
+            return 0;
+        name_len = 100;
+    }
+
+    return tar_write_header(tar, name, name_len, size, '0') &&
+        write_all(tar->handle, data, size) && tar_write_padding(tar, size);
+}
+
+static int frame_add(OUTPUT_STREAM* stream, uint32_t format, uint32_t index, const void* data, size_t size)
+{
+    uint8_t header[FRAME_HEADER_SIZE];
+
+    for (int i = 0; i < 8; i++)
+        header[i] = (uint8_t)((unsigned long long)size >> (8 * i));
+    for (int i = 0; i < 4; i++)
+    {
+        header[8 + i] = (uint8_t)(format >> (8 * i));
+        header[12 + i] = (uint8_t)(index >> (8 * i));
+    }
+
+    return write_all(stream->handle, header, sizeof(header)) && write_all(stream->handle, data, size);
+}
+
+static int stream_open(OUTPUT_STREAM* stream, const wchar_t* path, STREAM_FORMAT format)
+{
+    stream->format = format;
+    stream->mtime = (unsigned long long)time(NULL);
+    stream->workbook = 0;
+
+    if (wcscmp(path, L"-") == 0)
+    {
+        fflush(stdout);
+        _setmode(_fileno(stdout), _O_BINARY);
+        stream->handle = GetStdHandle(STD_OUTPUT_HANDLE);
+        stream->owns_handle = 0;
+    }
+    else
     {
-        fwprintf(stderr, L"Usage: \n./xls2img_tool.exe <input.xls> [output_dir]\n");
+        stream->handle = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        stream->owns_handle = 1;
+    }
+
+    if (stream->handle == INVALID_HANDLE_VALUE || stream->handle == NULL)
+    {
+        fwprintf(stderr, L"Error: Cannot create output %ls\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+// Starts the next workbook. Image indexes restart at 1 for each workbook, so a frame stream announces every workbook
+// with a FRAME_WORKBOOK frame; tar members carry the workbook in their name instead.
+static int stream_begin_workbook(OUTPUT_STREAM* stream, const wchar_t* input_path)
+{
+    stream->workbook++;
+    if (stream->format != STREAM_FRAMES)
+        return 1;
+
+    char path[MAX_PATH * 3];
+    int len = WideCharToMultiByte(CP_UTF8, 0, input_path, -1, path, (int)sizeof(path), NULL, NULL);
+    return frame_add(stream, FRAME_WORKBOOK, stream->workbook, path, len > 0 ? (size_t)len - 1 : 0);
+}
+
+static int stream_add_image(OUTPUT_STREAM* stream, const char* name, int index, const XLS2IMG_IMAGE* img)
+{
+    if (stream->format == STREAM_FRAMES)
+        return frame_add(stream, (uint32_t)img->format, (uint32_t)index, img->data, img->size);
+    return tar_add_file(stream, name, img->data, img->size);
+}
+
+static int stream_close(OUTPUT_STREAM* stream)
+{
+    // a tar archive ends with two zero blocks, a frame stream with one all-zero frame header
+    static const uint8_t zeros[TAR_BLOCK_SIZE * 2] = { 0 };
+    size_t trailer = stream->format == STREAM_TAR ? sizeof(zeros) : FRAME_HEADER_SIZE;
+    int ok = write_all(stream->handle, zeros, trailer);
+
+    if (stream->owns_handle)
+        CloseHandle(stream->handle);
+    return ok;
+}
+
+// File name of the workbook without directory and extension.
+static void workbook_base_name(const wchar_t* path, wchar_t* base, size_t base_len)
+{
+    const wchar_t* start = path;
+    for (const wchar_t* p = path; *p; p++)
+        if (*p == L'\\' || *p == L'/')
+            start = p + 1;
+
+    const wchar_t* dot = wcsrchr(start, L'.');
+    size_t len = dot && dot != start ? (size_t)(dot - start) : wcslen(start);
+    if (len >= base_len)
+        len = base_len - 1;
+
+    wmemcpy(base, start, len);
+    base[len] = L'\0';
+}
+
+// Writes UTF-8 text as a quoted, escaped JSON string.
+static void json_write_utf8(FILE* fp, const char* str, size_t len)
+{
+    fputc('"', fp);
+    for (const unsigned char* p = (const unsigned char*)str; p < (const unsigned char*)str + len; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            fprintf(fp, "\\%c", *p);
+        else if (*p < 0x20)
+            fprintf(fp, "\\u%04x", *p);
+        else
+            fputc(*p, fp);
+    }
+    fputc('"', fp);
+}
+
+// Writes a wide string as a quoted, escaped UTF-8 JSON string.
+static void json_write_string(FILE* fp, const wchar_t* str)
+{
+    char utf8[MAX_PATH * 3];
+    if (WideCharToMultiByte(CP_UTF8, 0, str, -1, utf8, (int)sizeof(utf8), NULL, NULL) <= 0)
+        utf8[0] = '\0';
+    json_write_utf8(fp, utf8, strlen(utf8));
+}
+
+// output is the UTF-8 output path or member name, NULL if the image was not written. check is the image's
+// XLS2IMG_CHECK_* bits; "valid" is only written for an image that was checked.
+static void manifest_write_image(const TOOL_OPTIONS* options, const wchar_t* input_path, int index, int format,
+    unsigned long long offset, unsigned long long size, unsigned long long hash, unsigned int check, const char* output,
+    size_t output_len)
+{
+    FILE* fp = options->manifest;
+    fputs("{\"type\":\"image\",\"path\":", fp);
+    json_write_string(fp, input_path);
+    fprintf(fp, ",\"index\":%d,\"format\":\"%s\",\"offset\":%llu,\"size\":%llu,\"hash\":\"fnv1a64:%016llx\",",
+        index, xls2img_format_extension((XLS2IMG_FORMAT)format), offset, size, hash);
+    if (check & XLS2IMG_CHECK_VERIFIED)
+        fprintf(fp, "\"valid\":%s,", check == XLS2IMG_CHECK_VERIFIED ? "true" : "false");
+    fputs("\"output\":", fp);
+    if (output)
+        json_write_utf8(fp, output, output_len);
+    else
+        fputs("null", fp);
+    fputs("}\n", fp);
+}
+
+static void manifest_write_file(const TOOL_OPTIONS* options, const wchar_t* input_path, const FILE_REPORT* report)
+{
+    FILE* fp = options->manifest;
+    if (!fp)
+        return;
+
+    fputs("{\"type\":\"file\",\"path\":", fp);
+    json_write_string(fp, input_path);
+    if (report->error)
+        fprintf(fp, ",\"status\":\"error\",\"error\":\"%s\"", report->error);
+    else
+        fprintf(fp, ",\"status\":\"%s\"", report->cached ? "cached" : "ok");
+    fprintf(fp, ",\"bytes_read\":%llu,\"workbook_size\":%llu,\"images\":%d,\"direct_images\":%d,\"invalid_images\":%d,"
+        "\"read_ns\":%llu,\"open_ns\":%llu,\"workbook_ns\":%llu,\"extract_ns\":%llu,\"write_ns\":%llu}\n",
+        (unsigned long long)report->bytes_read, (unsigned long long)report->workbook_size, report->image_count, report->direct_images,
+        report->invalid_images, report->read_ns, report->open_ns, report->workbook_ns, report->extract_ns, report->write_ns);
+}
+
+// What --verify found wrong with an image, NULL if it is valid or its format has no check
+static const char* check_problem(unsigned int check)
+{
+    if (check & XLS2IMG_CHECK_BAD_CRC)
+        return check & XLS2IMG_CHECK_BAD_STRUCTURE ? "CRC mismatch and broken structure" : "CRC mismatch";
+    return check & XLS2IMG_CHECK_BAD_STRUCTURE ? "broken structure" : NULL;
+}
+
+// Fills the cache key (UTF-8 full path), size and last write time of an input file, and the
+// settings of this run that decide which images are written where; prefix holds the output prefix.
+static int cache_stat(const TOOL_OPTIONS* options, const wchar_t* input_path, char* key, size_t key_len,
+    char* prefix, size_t prefix_len, CACHE_ENTRY* current)
+{
+    wchar_t full_path[MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    DWORD len = GetFullPathNameW(input_path, MAX_PATH, full_path, NULL);
+    if (len == 0 || len >= MAX_PATH ||
+        WideCharToMultiByte(CP_UTF8, 0, full_path, -1, key, (int)key_len, NULL, NULL) <= 0 ||
+        !GetFileAttributesExW(input_path, GetFileExInfoStandard, &attributes))
+        return 0;
+
+    // the part of the output paths in front of image_N.<ext>, as write_image builds them
+    wchar_t output_prefix[MAX_PATH], base_name[MAX_PATH];
+    len = GetFullPathNameW(options->output_dir, MAX_PATH, output_prefix, NULL);
+    if (len == 0 || len >= MAX_PATH)
+        return 0;
+    if (options->input_count > 1)
+    {
+        workbook_base_name(input_path, base_name, MAX_PATH);
+        if (swprintf_s(output_prefix + len, MAX_PATH - len, L"%ls_", base_name) < 0)
+            return 0;
+    }
+    int prefix_size = WideCharToMultiByte(CP_UTF8, 0, output_prefix, -1, prefix, (int)prefix_len, NULL, NULL);
+    if (prefix_size <= 0)
+        return 0;
+
+    memset(current, 0, sizeof(*current));
+    current->file_size = ((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+    current->mtime = ((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+        attributes.ftLastWriteTime.dwLowDateTime;
+    current->formats = xls2img_get_formats();
+    current->embedded_depth = options->embedded_depth;
+    current->verify = options->verify != 0;
+    current->output_prefix = prefix;
+    current->output_prefix_len = (size_t)prefix_size - 1;
+    return 1;
+}
+
+// Whether a cache record was written with the output location and extraction options of this run;
+// outputs made with others would be reported for images this run does not extract or write there
+static int cache_settings_match(const CACHE_ENTRY* cached, const CACHE_ENTRY* current)
+{
+    return cached->formats == current->formats && cached->embedded_depth == current->embedded_depth &&
+        cached->verify == current->verify && cached->output_prefix_len == current->output_prefix_len &&
+        memcmp(cached->output_prefix, current->output_prefix, current->output_prefix_len) == 0;
+}
+
+// Reports a workbook from its cache entry instead of extracting it again. Returns 0 when an
+// output recorded in the cache is missing, so the workbook has to be extracted after all.
+// A different current mtime or content hash is written back to the cache. The images are decoded
+// from a copy of entry, so the same entry can be replayed again.
+static int cache_replay(const TOOL_OPTIONS* options, const wchar_t* input_path, const char* key,
+    const CACHE_ENTRY* entry, const CACHE_ENTRY* current)
+{
+    CACHE_IMAGE* images = (CACHE_IMAGE*)malloc((entry->image_count + 1) * sizeof(CACHE_IMAGE));
+    if (!images)
+        return 0;
+
+    CACHE_ENTRY cursor = *entry;
+    int count = 0;
+    while (count < entry->image_count && cache_entry_next_image(&cursor, &images[count]))
+    {
+        wchar_t w_output[MAX_PATH];
+        int len = MultiByteToWideChar(CP_UTF8, 0, images[count].output, (int)images[count].output_len, w_output, MAX_PATH - 1);
+        if (len <= 0)
+            break;
+        w_output[len] = L'\0';
+        if (GetFileAttributesW(w_output) == INVALID_FILE_ATTRIBUTES)
+            break;
+        count++;
+    }
+    if (count != entry->image_count)
+    {
+        free(images);
+        return 0;
+    }
+
+    fwprintf(options->log, L"Unchanged, skipped (%d images)\n", count);
+    if (options->manifest)
+    {
+        for (int i = 0; i < count; i++)
+            manifest_write_image(options, input_path, i + 1, images[i].format, images[i].offset, images[i].size,
+                images[i].hash, images[i].check, images[i].output, images[i].output_len);
+    }
+
+    if (current->mtime != entry->mtime || current->content_hash != entry->content_hash)
+    {
+        CACHE_ENTRY updated = *current;
+        updated.image_count = count;
+        cache_store(options->cache, key, &updated, images);
+    }
+
+    FILE_REPORT report;
+    memset(&report, 0, sizeof(report));
+    report.cached = 1;
+    report.image_count = count;
+    for (int i = 0; i < count; i++)
+        if (check_problem(images[i].check))
+            report.invalid_images++;
+    free(images);
+    manifest_write_file(options, input_path, &report);
+    return 1;
+}
+
+// Size and last write time (FILETIME units) of a file
+static int file_identity(const wchar_t* path, unsigned long long* size, unsigned long long* mtime)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &attributes))
+        return 0;
+
+    *size = ((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+    *mtime = ((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+        attributes.ftLastWriteTime.dwLowDateTime;
+    return 1;
+}
+
+// Builds the image index of a workbook and writes it to <input>.x2i through a temporary file, so a
+// concurrent reader sees either the old index or the new one. The index bytes are returned in index,
+// even if writing them failed; returns 0 only if the index could not be built.
+static int sidecar_write(const wchar_t* input_path, const XLS2IMG_READER* reader, unsigned long long mtime,
+    const XLS2IMG_EXTRACT_OPTIONS* options, void** index, size_t* index_size)
+{
+    wchar_t path[MAX_PATH], temp_path[MAX_PATH];
+    if (swprintf_s(path, MAX_PATH, L"%ls.x2i", input_path) < 0 || swprintf_s(temp_path, MAX_PATH, L"%ls.x2i.tmp", input_path) < 0)
+        return 0;
+
+    int ret = xls2img_index_build(reader, mtime, index, index_size, options);
+    if (ret != XLS2IMG_SUCCESS)
+    {
+        fwprintf(stderr, L"Failed to index workbook: %hs\n", xls2img_strerror(ret));
+        return 0;
+    }
+
+    HANDLE file = CreateFileW(temp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    int ok = file != INVALID_HANDLE_VALUE && write_all(file, *index, *index_size);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+    ok = ok && MoveFileExW(temp_path, path, MOVEFILE_REPLACE_EXISTING);
+    if (!ok)
+    {
+        fwprintf(stderr, L"Error: Cannot write index %ls\n", path);
+        DeleteFileW(temp_path);
+    }
+    return 1;
+}
+
+// Writes image number (from 1) of a workbook through its .x2i sidecar index, which is rebuilt when it is
+// missing or does not match the workbook's size and mtime. With an up to date index the workbook is not
+// parsed at all: the image is copied out of the mapped file. Returns 0 on success, -1 on failure.
+static int serve_image(const wchar_t* input_path, int number, const TOOL_OPTIONS* options)
+{
+    unsigned long long file_size, mtime;
+    unsigned char* file = NULL;
+    size_t mapped_size = 0;
+    if (!file_identity(input_path, &file_size, &mtime) || !map_file(input_path, &file, &mapped_size))
+    {
+        fwprintf(stderr, L"Error: Failed to open file: %ls\n", input_path);
         return -1;
     }
 
-    const wchar_t* input_path = argv[1];
-    const wchar_t* output_path = (argc > 2) ? argv[2] : L"./";
+    wchar_t sidecar[MAX_PATH];
+    unsigned char* view = NULL;
+    size_t view_size = 0;
+    XLS2IMG_INDEX* index = NULL;
+    XLS2IMG_INDEX_INFO info;
+    if (swprintf_s(sidecar, MAX_PATH, L"%ls.x2i", input_path) > 0 && map_file(sidecar, &view, &view_size) &&
+        (xls2img_index_open(&index, view, view_size) != XLS2IMG_SUCCESS || xls2img_index_get_info(index, &info) != XLS2IMG_SUCCESS ||
+        info.file_size != file_size || info.mtime != mtime))
+    {
+        // stale or unreadable, and a mapped file cannot be replaced
+        xls2img_index_close(index);
+        index = NULL;
+        release_view(view, NULL);
+        view = NULL;
+    }
+
+    XLS2IMG_EXTRACT_OPTIONS extract_options;
+    memset(&extract_options, 0, sizeof(extract_options));
+    extract_options.limits = &options->limits;
+
+    XLS2IMG_READER* reader = NULL;
+    void* built = NULL;
+    size_t built_size = 0;
+    int ret = XLS2IMG_SUCCESS;
+    if (!index)
+    {
+        fwprintf(options->log, L"Indexing %ls\n", input_path);
+        ret = xls2img_open(&reader, file, mapped_size);
+        if (ret == XLS2IMG_SUCCESS)
+        {
+            xls2img_set_limits(reader, &options->limits);
+            ret = sidecar_write(input_path, reader, mtime, &extract_options, &built, &built_size) ?
+                xls2img_index_open(&index, built, built_size) : XLS2IMG_ERROR_FILE_CORRUPTED;
+        }
+        if (ret == XLS2IMG_SUCCESS)
+            ret = xls2img_index_get_info(index, &info);
+    }
+
+    XLS2IMG_INDEX_IMAGE image;
+    if (ret == XLS2IMG_SUCCESS && (number < 1 || number > info.image_count))
+    {
+        fwprintf(stderr, L"Error: %ls has %d images\n", input_path, info.image_count);
+        ret = XLS2IMG_ERROR_INVALID_ARGUMENT;
+    }
+    if (ret == XLS2IMG_SUCCESS)
+        ret = xls2img_index_get_image(index, number - 1, &image);
+
+    unsigned char* data = NULL;
+    size_t data_size = 0;
+    if (ret == XLS2IMG_SUCCESS)
+    {
+        data_size = image.prefix_size + image.size;
+        data = (unsigned char*)malloc(data_size ? data_size : 1);
+        ret = data ? xls2img_index_read_image(index, number - 1, file, mapped_size, data, data_size) : XLS2IMG_ERROR_OUT_OF_MEMORY;
+    }
+
+    // images the index cannot locate in the file, those of a DOC file, come from a regular extraction
+    XLS2IMG_RESULT images = { NULL, 0 };
+    if (ret == XLS2IMG_ERROR_UNSUPPORTED)
+    {
+        if (!reader && (ret = xls2img_open(&reader, file, mapped_size)) == XLS2IMG_SUCCESS)
+            xls2img_set_limits(reader, &options->limits);
+        if (reader)
+            ret = xls2img_read_images(reader, &images, &extract_options);
+        if (ret >= number && images.images[number - 1].size == data_size)
+        {
+            memcpy(data, images.images[number - 1].data, data_size);
+            ret = XLS2IMG_SUCCESS;
+        }
+        else if (ret > 0)
+            ret = XLS2IMG_ERROR_FILE_CORRUPTED;
+        xls2img_free_result(&images);
+    }
+
+    int status = 0;
+    if (ret == XLS2IMG_SUCCESS)
+    {
+        wchar_t base_name[MAX_PATH], w_output[MAX_PATH];
+        workbook_base_name(input_path, base_name, MAX_PATH);
+        if (options->input_count > 1)
+            swprintf_s(w_output, MAX_PATH, L"%ls%ls_image_%d.%hs", options->output_dir, base_name, number, xls2img_format_extension(image.format));
+        else
+            swprintf_s(w_output, MAX_PATH, L"%lsimage_%d.%hs", options->output_dir, number, xls2img_format_extension(image.format));
+
+        fwprintf(options->log, L"Image %d: Format=%hs, Size=%zu bytes\n", number, xls2img_format_extension(image.format), data_size);
+        const char* problem = options->verify ? check_problem(xls2img_verify_image(image.format, data, data_size)) : NULL;
+        if (problem)
+            fwprintf(stderr, L"  -> Invalid: %hs\n", problem);
+        if (save_image(w_output, data, data_size))
+            fwprintf(options->log, L"  -> Saved to: %ls\n", w_output);
+        else
+        {
+            fwprintf(stderr, L"  -> Failed to save: %ls\n", w_output);
+            status = -1;
+        }
+    }
+    else
+    {
+        fwprintf(stderr, L"Failed to read image %d: %hs\n", number, xls2img_strerror(ret));
+        status = -1;
+    }
+
+    free(data);
+    xls2img_index_close(index);
+    xls2img_free_index_data(built);
+    if (view)
+        release_view(view, NULL);
+    xls2img_close(reader);
+    release_view(file, NULL);
+    return status;
+}
+
+// State of writing the images of one workbook, shared by the result loop and the large-file callback
+typedef struct {
+    const TOOL_OPTIONS* options;
+    const wchar_t* input_path;
+    const wchar_t* base_name;
+    OUTPUT_STREAM* stream;
+    XLS2IMG_READER* reader;
+    const unsigned char* file_buffer;
+    FILE_REPORT* report;
+    CACHE_IMAGE* cache_images;  /* NULL when the workbook is not cached */
+    char (*cache_outputs)[MAX_PATH * 3];
+    int use_cache;              /* cleared when an image cannot be saved */
+    int count;                  /* images written so far */
+    int status;                 /* -2 once the output stream failed */
+} IMAGE_WRITER;
+
+// Writes the next image of a workbook as a stream member or an image file and records it in the manifest and the
+// cache arrays
+static void write_image(IMAGE_WRITER* writer, const XLS2IMG_IMAGE* img)
+{
+    const TOOL_OPTIONS* options = writer->options;
+    FILE_REPORT* report = writer->report;
+    int i = writer->count++;
+    wchar_t format_str[8];
+    swprintf_s(format_str, 8, L"%hs", xls2img_format_extension(img->format));
+    const wchar_t* output = NULL;
+    char output_utf8[MAX_PATH * 3];
+
+    if (img->path)
+        fwprintf(options->log, L"Image %d: Format=%ls, Size=%zu bytes, Object=%hs\n", i + 1, format_str, img->size, img->path);
+    else
+        fwprintf(options->log, L"Image %d: Format=%ls, Size=%zu bytes\n", i + 1, format_str, img->size);
+    if (check_problem(img->check))
+    {
+        fwprintf(stderr, L"  -> Invalid: %hs\n", check_problem(img->check));
+        report->invalid_images++;
+    }
+
+    wchar_t w_output[MAX_PATH];
+    unsigned long long t0 = now_ns();
+    if (writer->stream)
+    {
+        // archive members are grouped per workbook: <workbook>/image_N.ext, with the workbook number in front
+        // when there are several inputs, which may share a base name
+        char member[MAX_PATH * 3];
+        if (options->input_count > 1)
+            swprintf_s(w_output, MAX_PATH, L"%u_%ls/image_%d.%ls", writer->stream->workbook, writer->base_name, i + 1, format_str);
+        else
+            swprintf_s(w_output, MAX_PATH, L"%ls/image_%d.%ls", writer->base_name, i + 1, format_str);
+
+        if (WideCharToMultiByte(CP_UTF8, 0, w_output, -1, member, (int)sizeof(member), NULL, NULL) > 0 &&
+            stream_add_image(writer->stream, member, i + 1, img))
+        {
+            fwprintf(options->log, L"  -> Streamed as: %ls\n", w_output);
+            output = w_output;
+        }
+        else
+        {
+            fwprintf(stderr, L"  -> Failed to stream: %ls\n", w_output);
+            report->error = "Failed to write output stream";
+            writer->status = -2;
+        }
+    }
+    else
+    {
+        // Prepare filename with wide characters
+        if (options->input_count > 1)
+            swprintf_s(w_output, MAX_PATH, L"%ls%ls_image_%d.%ls", options->output_dir, writer->base_name, i + 1, format_str);
+        else
+            swprintf_s(w_output, MAX_PATH, L"%lsimage_%d.%ls", options->output_dir, i + 1, format_str);
+
+        // Save image using Windows API, from the source file when it is stored contiguously
+        int saved = save_image_direct(w_output, writer->reader, writer->file_buffer, img);
+        if (saved > 0)
+            report->direct_images++;
+        else if (saved < 0)
+            saved = save_image(w_output, img->data, img->size);
+
+        if (saved)
+        {
+            fwprintf(options->log, L"  -> Saved to: %ls\n", w_output);
+            output = w_output;
+        }
+        else
+        {
+            fwprintf(stderr, L"  -> Failed to save: %ls\n", w_output);
+            writer->use_cache = 0;
+        }
+    }
+    report->write_ns += now_ns() - t0;
+
+    if (!output || WideCharToMultiByte(CP_UTF8, 0, output, -1, output_utf8, (int)sizeof(output_utf8), NULL, NULL) <= 0)
+        output_utf8[0] = '\0';
+
+    unsigned long long hash = hash_fnv1a64(img->data, img->size);
+    if (options->manifest)
+        manifest_write_image(options, writer->input_path, i + 1, img->format, img->offset, img->size, hash, img->check,
+            output ? output_utf8 : NULL, strlen(output_utf8));
+    if (writer->use_cache)
+    {
+        CACHE_IMAGE* entry = &writer->cache_images[i];
+        memcpy(writer->cache_outputs[i], output_utf8, sizeof(output_utf8));
+        entry->format = img->format;
+        entry->offset = img->offset;
+        entry->size = img->size;
+        entry->hash = hash;
+        entry->check = img->check;
+        entry->output = writer->cache_outputs[i];
+        entry->output_len = strlen(output_utf8);
+    }
+}
+
+// xls2img_stream_images callback of large-file mode. An image is written while the parser still holds it; only one
+// with a synthesized prefix is copied, to write it as one complete file.
+static int write_streamed_image(const XLS2IMG_IMAGE* image, void* user)
+{
+    IMAGE_WRITER* writer = (IMAGE_WRITER*)user;
+    XLS2IMG_IMAGE whole = *image;
+    unsigned char* copy = NULL;
+    if (image->prefix_size)
+    {
+        copy = (unsigned char*)malloc(image->prefix_size + image->size);
+        if (!copy)
+            return XLS2IMG_ERROR_OUT_OF_MEMORY;
+        memcpy(copy, image->prefix, image->prefix_size);
+        memcpy(copy + image->prefix_size, image->data, image->size);
+        whole.data = copy;
+        whole.size = image->prefix_size + image->size;
+        whole.prefix = NULL;
+        whole.prefix_size = 0;
+    }
+
+    write_image(writer, &whole);
+    free(copy);
+    return writer->status == 0 ? XLS2IMG_SUCCESS : XLS2IMG_ERROR_CANCELLED;
+}
+
+// Returns 0 on success, -1 if the workbook could not be processed and -2 if the output failed.
+static int process_workbook(const wchar_t* input_path, const TOOL_OPTIONS* options, OUTPUT_STREAM* stream)
+{
+    FILE_REPORT report;
+    memset(&report, 0, sizeof(report));
+
+    // every input is numbered, also one that fails, so the numbers match the command line
+    if (stream && !stream_begin_workbook(stream, input_path))
+    {
+        fwprintf(stderr, L"Failed to write output stream\n");
+        report.error = "Failed to write output stream";
+        manifest_write_file(options, input_path, &report);
+        return -2;
+    }
 
     // Read file
     unsigned char* file_buffer = NULL;
     size_t file_size = 0;
 
-    if (!read_file(input_path, &file_buffer, &file_size))
+    // "-" reads the workbook from stdin
+    int from_stdin = wcscmp(input_path, L"-") == 0;
+    XLS2IMG_RELEASE_FUNC release = release_buffer;
+
+    // like the cache, the index records the mtime from before the file was read
+    unsigned long long index_file_size, index_mtime;
+    int write_index = options->write_index && !from_stdin && file_identity(input_path, &index_file_size, &index_mtime);
+
+    // Unchanged workbooks are skipped on the size and mtime alone; the file is stat'ed before
+    // it is read so a concurrent modification shows up as a change on the next run
+    char cache_key[MAX_PATH * 3], cache_prefix[MAX_PATH * 3];
+    CACHE_ENTRY current, cached;
+    int use_cache = options->cache && !stream && !from_stdin &&
+        cache_stat(options, input_path, cache_key, sizeof(cache_key), cache_prefix, sizeof(cache_prefix), &current);
+    int cache_found = use_cache && cache_lookup(options->cache, cache_key, &cached) &&
+        cached.file_size == current.file_size && cache_settings_match(&cached, &current);
+    if (cache_found && cached.mtime == current.mtime && (!options->cache_hash || cached.content_hash != 0))
+    {
+        current.content_hash = cached.content_hash;
+        if (cache_replay(options, input_path, cache_key, &cached, &current))
+            return 0;
+    }
+
+    // Large-file mode only maps the file: a heap copy of a multi-GiB workbook is what it avoids
+    unsigned long long t0 = now_ns();
+    if (!from_stdin && map_file(input_path, &file_buffer, &file_size))
+        release = release_view;
+    else if (options->large)
+    {
+        fwprintf(stderr, L"Error: --large needs a file that can be memory-mapped: %ls\n", input_path);
+        report.error = "Failed to map file";
+        manifest_write_file(options, input_path, &report);
+        return -1;
+    }
+    else if (from_stdin ? !read_stdin(&file_buffer, &file_size, options->size_hint) : !read_file(input_path, &file_buffer, &file_size))
     {
+        report.error = "Failed to read file";
+        manifest_write_file(options, input_path, &report);
         return -1;
     }
+    report.read_ns = now_ns() - t0;
+    report.bytes_read = file_size;
 
-    // Initialize xls2img reader
+    // With content hashes a touched file is still a hit if its bytes did not change
+    if (use_cache && options->cache_hash)
+    {
+        current.content_hash = hash_fnv1a64(file_buffer, file_size);
+        if (cache_found && cached.content_hash == current.content_hash &&
+            cache_replay(options, input_path, cache_key, &cached, &current))
+        {
+            release(file_buffer, NULL);
+            return 0;
+        }
+    }
+
+    // Initialize xls2img reader, handing it the file buffer
     XLS2IMG_READER* reader = NULL;
-    int ret = xls2img_open(&reader, file_buffer, file_size);
+    t0 = now_ns();
+    int ret = xls2img_open_owned(&reader, file_buffer, file_size, release, NULL);
+    report.open_ns = now_ns() - t0;
     if (ret != XLS2IMG_SUCCESS)
     {
         fwprintf(stderr, L"Initialization failed: %hs\n", xls2img_strerror(ret));
-        free(file_buffer);
+        release(file_buffer, NULL);
+        report.error = xls2img_strerror(ret);
+        manifest_write_file(options, input_path, &report);
         return -1;
     }
+    xls2img_set_limits(reader, &options->limits);
 
-    // Extract workbook stream
+    // Extract workbook stream; only an XLS file has one, the pictures of the other containers are read straight from them.
+    // Large-file mode reads the stream in place through the reader instead.
     void* workbook_data = NULL;
     size_t workbook_size = 0;
+    int package = xls2img_get_container(reader) != XLS2IMG_CONTAINER_CFB;
 
-    ret = xls2img_get_workbook(reader, &workbook_data, &workbook_size);
+    t0 = now_ns();
+    if (!package && !options->large)
+        ret = xls2img_get_workbook(reader, &workbook_data, &workbook_size);
+    report.workbook_ns = now_ns() - t0;
     if (ret != XLS2IMG_SUCCESS)
     {
         fwprintf(stderr, L"Failed to extract workbook: %hs\n", xls2img_strerror(ret));
         xls2img_close(reader);
-        free(file_buffer);
+        report.error = xls2img_strerror(ret);
+        manifest_write_file(options, input_path, &report);
         return -1;
     }
+    report.workbook_size = workbook_size;
+
+    wchar_t base_name[MAX_PATH];
+    workbook_base_name(from_stdin ? L"stdin" : input_path, base_name, MAX_PATH);
+
+    IMAGE_WRITER writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.options = options;
+    writer.input_path = input_path;
+    writer.base_name = base_name;
+    writer.stream = stream;
+    writer.reader = reader;
+    writer.file_buffer = file_buffer;
+    writer.report = &report;
 
     // Extract images
     XLS2IMG_RESULT images = { NULL, 0 };
-    ret = xls2img_extract_images(workbook_data, workbook_size, &images);
-
-    // Process results
-    if (ret > 0)
+    t0 = now_ns();
+    XLS2IMG_EXTRACT_OPTIONS extract_options;
+    memset(&extract_options, 0, sizeof(extract_options));
+    extract_options.limits = &options->limits;
+    extract_options.embedded_depth = options->embedded_depth;
+    extract_options.verify = options->verify;
+    if (options->large)
     {
-        wprintf(L"Extracted %d images\n", images.count);
+        // images are written as they are delivered, so extraction time includes writing them
+        ret = xls2img_stream_images(reader, write_streamed_image, &writer, &extract_options);
+        report.extract_ns = now_ns() - t0 - report.write_ns;
+        report.image_count = writer.count;
+        if (writer.count > 0)
+            fwprintf(options->log, L"Extracted %d images\n", writer.count);
+        if (ret < 0 && writer.status == 0)
+        {
+            fwprintf(stderr, L"Failed to extract images: %hs\n", xls2img_strerror(ret));
+            if (ret != XLS2IMG_ERROR_NO_IMAGES)
+                report.error = xls2img_strerror(ret);
+        }
+    }
+    else
+    {
+        if (package || options->embedded_depth)
+            ret = xls2img_read_images(reader, &images, &extract_options);
+        else
+            ret = xls2img_extract_images_ex(workbook_data, workbook_size, &images, &extract_options);
+        report.extract_ns = now_ns() - t0;
 
-        // Process each image
-        for (int i = 0; i < images.count; i++)
+        // Outputs of the workbook, kept for the cache record
+        if (use_cache && ret > 0)
         {
-            const XLS2IMG_IMAGE* img = &images.images[i];
-            const wchar_t* format_str = (img->format == XLS2IMG_PNG) ? L"png" : L"jpg";
+            writer.cache_images = (CACHE_IMAGE*)malloc(images.count * sizeof(CACHE_IMAGE));
+            writer.cache_outputs = (char(*)[MAX_PATH * 3])malloc(images.count * sizeof(*writer.cache_outputs));
+            use_cache = writer.cache_images && writer.cache_outputs;
+        }
+        writer.use_cache = use_cache;
 
-            // Prepare filename with wide characters
-            wchar_t w_filename[MAX_PATH];
-            swprintf_s(w_filename, MAX_PATH, L"%lsimage_%d.%ls", output_path, i + 1, format_str);
+        // Process results
+        if (ret > 0)
+        {
+            fwprintf(options->log, L"Extracted %d images\n", images.count);
+            report.image_count = images.count;
 
-            wprintf(L"Image %d: Format=%ls, Size=%zu bytes\n", i + 1, format_str, img->size);
+            // Process each image
+            for (int i = 0; i < images.count && writer.status == 0; i++)
+                write_image(&writer, &images.images[i]);
 
-            // Save image using Windows API
-            if (save_image(w_filename, img->data, img->size))
-                wprintf(L"  -> Saved to: %ls\n", w_filename);
-            else
-                fwprintf(stderr, L"  -> Failed to save: %ls\n", w_filename);
+            // Free images
+            xls2img_free_result(&images);
+        }
+        else
+        {
+            fwprintf(stderr, L"Failed to extract images: %hs\n", xls2img_strerror(ret));
+            if (ret != XLS2IMG_ERROR_NO_IMAGES)
+                report.error = xls2img_strerror(ret);
         }
+        use_cache = writer.use_cache;
+    }
 
-        // Free images
-        xls2img_free_result(&images);
+    if (write_index && (ret > 0 || ret == XLS2IMG_ERROR_NO_IMAGES))
+    {
+        void* index = NULL;
+        size_t index_size = 0;
+        if (sidecar_write(input_path, reader, index_mtime, &extract_options, &index, &index_size))
+            xls2img_free_index_data(index);
     }
-    else
-        fwprintf(stderr, L"Failed to extract images: %hs\n", xls2img_strerror(ret));
+
+    // Only complete results are cached, a workbook without images included
+    if (use_cache && (ret > 0 || ret == XLS2IMG_ERROR_NO_IMAGES))
+    {
+        current.image_count = ret > 0 ? report.image_count : 0;
+        if (!cache_store(options->cache, cache_key, &current, writer.cache_images))
+            fwprintf(stderr, L"Warning: Failed to update the cache\n");
+    }
+    free(writer.cache_images);
+    free(writer.cache_outputs);
 
     // Cleanup
     xls2img_free_workbook_data(workbook_data);
     xls2img_close(reader);
 
-    wprintf(L"Image extraction completed.\n");
-    return 0;
+    manifest_write_file(options, input_path, &report);
+    if (writer.status != 0)
+        return writer.status;
+    return report.error ? -1 : 0;
+}
+
+static void print_usage(void)
+{
+    fwprintf(stderr, L"Usage: \n"
+        L"./xls2img_tool.exe <input.xls> [output_dir]\n"
+        L"./xls2img_tool.exe [options] <input.xls|->...\n"
+        L"Options:\n"
+        L"  -o, --output <dir>      write image files to <dir>\n"
+        L"  -t, --tar <file|->      write all images into one tar archive, '-' for stdout\n"
+        L"  -f, --frames <file|->   write all images as length-prefixed frames, '-' for stdout\n"
+        L"  -s, --size-hint <bytes> expected length of a workbook read from stdin ('-')\n"
+        L"  -m, --manifest <file|-> write an NDJSON record per workbook and per image, '-' for stdout\n"
+        L"  -c, --cache <file>      skip workbooks whose size and mtime are unchanged since a previous run\n"
+        L"                          with the same output directory, --embedded and --verify\n"
+        L"  -e, --embedded <depth>  also extract the images of embedded objects, <depth> levels deep\n"
+        L"  -x, --index             write an <input>.x2i image index next to each workbook\n"
+        L"  -n, --image <n>         extract only image n, straight from the file through its .x2i index\n"
+        L"                          (built when missing or out of date)\n"
+        L"  -V, --verify            check PNG chunk CRCs and JPEG marker segments and report invalid images\n"
+        L"  -L, --large             write each image as it is found, from the memory-mapped file, without\n"
+        L"                          holding the workbook stream or all images in memory (files over 2 GiB)\n"
+        L"      --cache-hash        also record content hashes, so touched but unchanged workbooks stay cached\n"
+        L"      --cache-compact     drop superseded cache records (no other process may use the cache)\n"
+        L"      --max-sectors <n>   give up on a workbook stream longer than n sectors\n"
+        L"      --max-bytes <n>     give up on a workbook stream larger than n bytes\n"
+        L"      --max-records <n>   give up after walking n BIFF records\n"
+        L"      --max-images <n>    give up on a workbook holding more than n images\n"
+        L"      --max-output <n>    give up once the images of a workbook exceed n bytes\n"
+        L"./xls2img_tool.exe --daemon <socket> [--workers N] [--queue N] [--output dir] [--timeout ms] [--max-* n]\n"
+        L"  serve extraction requests on a Unix domain socket\n");
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    _setmode(_fileno(stdout), _O_U16TEXT);
+    _setmode(_fileno(stderr), _O_U16TEXT);
+
+    if (argc > 1 && wcscmp(argv[1], L"--daemon") == 0)
+        return daemon_main(argc, argv);
+
+    TOOL_OPTIONS options = { NULL, NULL, STREAM_NONE, NULL, 0, 0, stdout, NULL, NULL, 0, { 0 }, 0, 0, 0, 0, 0 };
+    const wchar_t* cache_path = NULL;
+    int cache_compact_requested = 0;
+    const wchar_t** inputs = (const wchar_t**)malloc(argc * sizeof(const wchar_t*));
+    if (!inputs)
+        return -1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((wcscmp(argv[i], L"-o") == 0 || wcscmp(argv[i], L"--output") == 0) && i + 1 < argc)
+            options.output_dir = argv[++i];
+        else if ((wcscmp(argv[i], L"-t") == 0 || wcscmp(argv[i], L"--tar") == 0) && i + 1 < argc)
+        {
+            options.stream_path = argv[++i];
+            options.stream_format = STREAM_TAR;
+        }
+        else if ((wcscmp(argv[i], L"-f") == 0 || wcscmp(argv[i], L"--frames") == 0) && i + 1 < argc)
+        {
+            options.stream_path = argv[++i];
+            options.stream_format = STREAM_FRAMES;
+        }
+        else if ((wcscmp(argv[i], L"-s") == 0 || wcscmp(argv[i], L"--size-hint") == 0) && i + 1 < argc)
+            options.size_hint = (size_t)wcstoull(argv[++i], NULL, 10);
+        else if ((wcscmp(argv[i], L"-m") == 0 || wcscmp(argv[i], L"--manifest") == 0) && i + 1 < argc)
+            options.manifest_path = argv[++i];
+        else if ((wcscmp(argv[i], L"-c") == 0 || wcscmp(argv[i], L"--cache") == 0) && i + 1 < argc)
+            cache_path = argv[++i];
+        else if ((wcscmp(argv[i], L"-e") == 0 || wcscmp(argv[i], L"--embedded") == 0) && i + 1 < argc)
+            options.embedded_depth = (unsigned int)wcstoul(argv[++i], NULL, 10);
+        else if (wcscmp(argv[i], L"-V") == 0 || wcscmp(argv[i], L"--verify") == 0)
+            options.verify = 1;
+        else if (wcscmp(argv[i], L"-L") == 0 || wcscmp(argv[i], L"--large") == 0)
+            options.large = 1;
+        else if (wcscmp(argv[i], L"-x") == 0 || wcscmp(argv[i], L"--index") == 0)
+            options.write_index = 1;
+        else if ((wcscmp(argv[i], L"-n") == 0 || wcscmp(argv[i], L"--image") == 0) && i + 1 < argc)
+            options.image_number = (int)wcstol(argv[++i], NULL, 10);
+        else if (wcscmp(argv[i], L"--cache-hash") == 0)
+            options.cache_hash = 1;
+        else if (wcscmp(argv[i], L"--cache-compact") == 0)
+            cache_compact_requested = 1;
+        else if (i + 1 < argc && parse_limit_option(argv[i], argv[i + 1], &options.limits))
+            i++;
+        else if (argv[i][0] == L'-' && argv[i][1] != L'\0')
+        {
+            fwprintf(stderr, L"Unknown option: %ls\n", argv[i]);
+            print_usage();
+            free(inputs);
+            return -1;
+        }
+        else
+            inputs[options.input_count++] = argv[i];
+    }
+
+    // keep the original "<input.xls> [output_dir]" form working
+    if (!options.output_dir && !options.stream_path && options.input_count == 2)
+    {
+        options.output_dir = inputs[1];
+        options.input_count = 1;
+    }
+
+    if (options.input_count < 1)
+    {
+        print_usage();
+        free(inputs);
+        return -1;
+    }
+
+    // stdin can only be consumed once
+    int stdin_inputs = 0;
+    for (int i = 0; i < options.input_count; i++)
+        if (wcscmp(inputs[i], L"-") == 0)
+            stdin_inputs++;
+    if (stdin_inputs > 1)
+    {
+        fwprintf(stderr, L"Error: '-' (stdin) can only be given once\n");
+        free(inputs);
+        return -1;
+    }
+
+    if (!options.output_dir)
+        options.output_dir = L"./";
+
+    if (options.stream_path && options.manifest_path &&
+        wcscmp(options.stream_path, L"-") == 0 && wcscmp(options.manifest_path, L"-") == 0)
+    {
+        fwprintf(stderr, L"Error: The output stream and the manifest cannot both be written to stdout\n");
+        free(inputs);
+        return -1;
+    }
+
+    // cache entries point at image files, a single output stream is rebuilt every run
+    if (cache_path && options.stream_path)
+    {
+        fwprintf(stderr, L"Error: --cache cannot be combined with --tar or --frames\n");
+        free(inputs);
+        return -1;
+    }
+
+    // large-file mode keeps no image list, which the cache record is built from
+    if (options.large && cache_path)
+    {
+        fwprintf(stderr, L"Error: --large cannot be combined with --cache\n");
+        free(inputs);
+        return -1;
+    }
+
+    // a single image is served from its index, outside the regular extraction and its outputs
+    if (options.image_number && (options.stream_path || options.manifest_path || cache_path || options.embedded_depth))
+    {
+        fwprintf(stderr, L"Error: --image cannot be combined with --tar, --frames, --manifest, --cache or --embedded\n");
+        free(inputs);
+        return -1;
+    }
+
+    if (cache_path)
+    {
+        options.cache = cache_open(cache_path);
+        if (!options.cache)
+        {
+            fwprintf(stderr, L"Error: Cannot open cache %ls\n", cache_path);
+            free(inputs);
+            return -1;
+        }
+    }
+
+    if (options.manifest_path)
+    {
+        if (wcscmp(options.manifest_path, L"-") == 0)
+        {
+            fflush(stdout);
+            _setmode(_fileno(stdout), _O_BINARY);
+            options.manifest = stdout;
+            options.log = stderr;
+        }
+        else
+            options.manifest = _wfopen(options.manifest_path, L"wb");
+
+        if (!options.manifest)
+        {
+            fwprintf(stderr, L"Error: Cannot create manifest %ls\n", options.manifest_path);
+            cache_close(options.cache);
+            free(inputs);
+            return -1;
+        }
+    }
+
+    OUTPUT_STREAM stream;
+    if (options.stream_path)
+    {
+        if (!stream_open(&stream, options.stream_path, options.stream_format))
+        {
+            if (options.manifest && options.manifest != stdout)
+                fclose(options.manifest);
+            cache_close(options.cache);
+            free(inputs);
+            return -1;
+        }
+        if (wcscmp(options.stream_path, L"-") == 0)
+            options.log = stderr;
+    }
+
+    int status = 0;
+    for (int i = 0; i < options.input_count; i++)
+    {
+        if (options.input_count > 1)
+            fwprintf(options.log, L"Processing: %ls\n", inputs[i]);
+
+        int ret = options.image_number ? serve_image(inputs[i], options.image_number, &options) :
+            process_workbook(inputs[i], &options, options.stream_path ? &stream : NULL);
+        if (ret != 0)
+            status = -1;
+
+        // a broken output stream cannot be continued with the next workbook
+        if (ret == -2)
+            break;
+    }
+
+    if (options.stream_path && !stream_close(&stream))
+    {
+        fwprintf(stderr, L"Error: Failed to finish output %ls\n", options.stream_path);
+        status = -1;
+    }
+
+    if (options.manifest)
+    {
+        if (fflush(options.manifest) != 0)
+            status = -1;
+        if (options.manifest != stdout)
+            fclose(options.manifest);
+    }
+
+    if (options.cache)
+    {
+        if (cache_compact_requested && !cache_compact(options.cache))
+            fwprintf(stderr, L"Warning: Failed to compact cache %ls\n", cache_path);
+        cache_close(options.cache);
+    }
+
+    free(inputs);
+    fwprintf(options.log, L"Image extraction completed.\n");
+    return status;
 }
\ No newline at end of file
@@ -0,0 +1,130 @@
+/*
+ * Project: xls2img
+ * Repository: https://github.com/capp-adocia/xls2img
+ * Author: SiLan (https://github.com/capp-adocia)
+ *
+ * Copyright (c) 2026 SiLan
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef XLS2IMG_TOOL_H
+#define XLS2IMG_TOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <windows.h>
+#include <xls2img.h>
+
+/**
+ * @brief Monotonic timestamp in nanoseconds
+ */
+unsigned long long now_ns(void);
+
+/**
+ * @brief Writes the whole buffer to a file handle
+ * @return 1 on success, 0 on failure
+ */
+int write_all(HANDLE handle, const void* data, size_t size);
+
+/**
+ * @brief Parses a --max-* work limit option into limits
+ * @return 1 if name is a limit option, 0 otherwise
+ */
+int parse_limit_option(const wchar_t* name, const wchar_t* value, XLS2IMG_LIMITS* limits);
+
+/**
+ * @brief Persistent cache of processed workbooks (xls2img_cache.c)
+ */
+typedef struct TOOL_CACHE TOOL_CACHE;
+
+/**
+ * @brief Cached description of one workbook; images are decoded with cache_entry_next_image
+ */
+typedef struct {
+    unsigned long long file_size;
+    unsigned long long mtime;           /* last write time, FILETIME units */
+    unsigned long long content_hash;    /* FNV-1a 64 of the file, 0 when not recorded */
+    int image_count;
+    unsigned int formats;               /* xls2img_get_formats() of the library that extracted the images */
+    unsigned int embedded_depth;        /* levels of embedded objects searched */
+    int verify;                         /* images were checked with --verify */
+    const char* output_prefix;          /* UTF-8 full path the image_N.<ext> names were appended to, not NUL terminated */
+    size_t output_prefix_len;
+    const uint8_t* cursor;
+    const uint8_t* end;
+} CACHE_ENTRY;
+
+/**
+ * @brief Cached description of one extracted image
+ */
+typedef struct {
+    int format;                         /* XLS2IMG_FORMAT */
+    unsigned long long offset;          /* offset in the workbook stream */
+    unsigned long long size;
+    unsigned long long hash;            /* FNV-1a 64 of the image */
+    unsigned int check;                 /* XLS2IMG_CHECK_* bits of a --verify run, 0 otherwise */
+    const char* output;                 /* UTF-8 output path, not NUL terminated */
+    size_t output_len;
+} CACHE_IMAGE;
+
+/**
+ * @brief Opens or creates a cache file and maps its current contents
+ * @return The cache, NULL on failure
+ */
+TOOL_CACHE* cache_open(const wchar_t* path);
+
+/**
+ * @brief Unmaps and closes the cache
+ */
+void cache_close(TOOL_CACHE* cache);
+
+/**
+ * @brief Finds the latest record for a key (full UTF-8 path)
+ * @return 1 if found, 0 otherwise
+ */
+int cache_lookup(const TOOL_CACHE* cache, const char* key, CACHE_ENTRY* entry);
+
+/**
+ * @brief Decodes the next image of a looked up entry
+ * @return 1 if an image was decoded, 0 at the end
+ */
+int cache_entry_next_image(CACHE_ENTRY* entry, CACHE_IMAGE* image);
+
+/**
+ * @brief Appends a record; safe against concurrent writers in other processes
+ * @return 1 on success, 0 on failure
+ */
+int cache_store(TOOL_CACHE* cache, const char* key, const CACHE_ENTRY* entry, const CACHE_IMAGE* images);
+
+/**
+ * @brief Rewrites the cache file without superseded records; afterwards the cache can only be closed
+ * @details Other processes must not have the cache open while it is compacted
+ * @return 1 on success, 0 if the file was left unchanged
+ */
+int cache_compact(TOOL_CACHE* cache);
+
+/**
+ * @brief Runs the extraction daemon: xls2img_tool.exe --daemon <socket> [options]
+ * @return Process exit code
+ */
+int daemon_main(int argc, wchar_t* argv[]);
+
+#endif /* XLS2IMG_TOOL_H */
\ No newline at end of file